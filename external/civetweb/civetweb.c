@@ -274,6 +274,7 @@ typedef long off_t;
 #define SHUT_RD (0)
 #define SHUT_WR (1)
 #define SHUT_BOTH (2)
+#define SHUT_RDWR SHUT_BOTH
 #define vsnprintf_impl _vsnprintf
 #define access _access
 #define mg_sleep(x) (Sleep(x))
@@ -6123,6 +6124,43 @@ int mg_connection_active(struct mg_connection *conn) {
   return 1;
 }
 
+struct mg_connection *mg_detach_connection(struct mg_connection *conn) {
+  struct mg_connection *detached;
+  if ((conn == NULL) || (conn->client.sock == INVALID_SOCKET)) {
+    return NULL;
+  }
+  detached = (struct mg_connection *)mg_calloc(1, sizeof(*detached));
+  if (detached == NULL) {
+    return NULL;
+  }
+  mg_lock_connection(conn);
+  detached->ctx = conn->ctx;
+  detached->ssl = conn->ssl;
+  detached->client = conn->client;
+  detached->conn_birth_time = conn->conn_birth_time;
+  detached->request_info.is_ssl = conn->request_info.is_ssl;
+  detached->request_info.remote_port = conn->request_info.remote_port;
+  detached->request_info.local_port = conn->request_info.local_port;
+  memcpy(detached->request_info.remote_addr, conn->request_info.remote_addr,
+         sizeof(detached->request_info.remote_addr));
+  detached->must_close = 1;
+  (void)pthread_mutex_init(&detached->mutex, &pthread_mutex_attr);
+
+  /* the worker ends its keep-alive loop and has nothing left to close */
+  conn->ssl = NULL;
+  conn->client.sock = INVALID_SOCKET;
+  conn->must_close = 1;
+  mg_unlock_connection(conn);
+  return detached;
+}
+
+void mg_shutdown_connection(const struct mg_connection *conn) {
+  /* no connection lock, a writer blocked in send() is holding it */
+  if ((conn != NULL) && (conn->client.sock != INVALID_SOCKET)) {
+    shutdown(conn->client.sock, SHUT_RDWR);
+  }
+}
+
 /* Parse HTTP headers from the given buffer, advance buffer to the point
  * where parsing stopped. */
 static void
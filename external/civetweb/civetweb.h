@@ -794,6 +794,20 @@ CIVETWEB_API unsigned mg_check_feature(unsigned feature);
 
 CIVETWEB_API int mg_connection_active(struct mg_connection *conn);
 
+/* Takes the socket of a request away from its worker thread, which is
+   released as soon as the request handler returns. The returned connection
+   can be written with mg_write and is closed with mg_close_connection.
+   No further requests are read from it.
+
+   Return:
+     The detached connection, NULL on failure. */
+CIVETWEB_API struct mg_connection *mg_detach_connection(struct mg_connection *conn);
+
+/* Shuts the socket of a connection down in both directions, which makes
+   a write blocked on a peer that stopped reading return with an error.
+   The connection itself stays valid until its worker closes it. */
+CIVETWEB_API void mg_shutdown_connection(const struct mg_connection *conn);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -255,6 +255,12 @@ namespace dss {
                             _other.m_timeval.tv_sec));
   } // difference
 
+  long long DateTime::differenceMS(const DateTime& _other) const {
+    struct timeval result;
+    timersub(&m_timeval, &_other.m_timeval, &result);
+    return static_cast<long long>(result.tv_sec) * 1000 + result.tv_usec / 1000;
+  } // differenceMS
+
   time_t DateTime::secondsSinceEpoch() const {
     return m_timeval.tv_sec;
   }
@@ -409,6 +415,12 @@ namespace dss {
    * TODO: is ms really part of 8601
    */
   std::string DateTime::toISO8601_ms_local() const {
+    char buf[sizeof "2011-10-08T07:07:09.000+02:00"];
+    toISO8601_ms_local(buf, sizeof buf);
+    return std::string(buf);
+  }
+
+  void DateTime::toISO8601_ms_local(char* _buf, size_t _size) const {
     struct tm tm;
     char buf[sizeof "2011-10-08T07:07:09.000+02:00"];
     char fmt[sizeof "2011-10-08T07:07:09.000+02:00"];
@@ -425,7 +437,7 @@ namespace dss {
         buf[27] = buf[26];
         buf[26] = ':';
     }
-    return std::string(buf);
+    snprintf(_buf, _size, "%s", buf);
   }
 
   /*
@@ -121,6 +121,8 @@ namespace dss {
 
     /** Returns the difference in seconds */
     int difference(const DateTime& _other) const;
+    /** Returns the difference in milliseconds */
+    long long differenceMS(const DateTime& _other) const;
 
     /** Returns the seconds since epoch */
     time_t secondsSinceEpoch() const;
@@ -196,6 +198,9 @@ namespace dss {
      * timezone needs to be appended
      */
     std::string toISO8601_ms_local() const;
+    /** Same as toISO8601_ms_local, but formats into \a _buf without
+     * allocating, \a _size should be at least 30 */
+    void toISO8601_ms_local(char* _buf, size_t _size) const;
 
     /**
      * Emit ISO8601 or RFC3339 with ms precision
@@ -25,6 +25,8 @@
 
 #include <string>
 
+#include <boost/functional/hash.hpp>
+
 #include <digitalSTROM/dsuid.h>
 #include <digitalSTROM/dsm-api-v2/dsm-api-const.h>
 
@@ -44,6 +46,20 @@ namespace dss {
       return !dsuid_equal(&l, &r);
   }
 
+  /** Hash and equality functors to key unordered containers by dSUID,
+    * std::equal_to does not find the operator above through ADL */
+  struct DsuidHash {
+    std::size_t operator()(const dsuid_t& _dsuid) const {
+      return boost::hash_range(_dsuid.id, _dsuid.id + DSUID_SIZE);
+    }
+  };
+
+  struct DsuidEqual {
+    bool operator()(const dsuid_t& _lhs, const dsuid_t& _rhs) const {
+      return dsuid_equal(&_lhs, &_rhs);
+    }
+  };
+
   std::string dsuid2str(dsuid_t dsuid);
   dsuid_t str2dsuid(std::string dsuid_str);
   dsid_t str2dsid(std::string dsid_str);
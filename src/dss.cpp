@@ -54,6 +54,7 @@
 #include <ds/asio/io-service.h>
 #include "logger.h"
 #include "propertysystem.h"
+#include "expatparser.h"
 #include "eventinterpreterplugins.h"
 #include "eventinterpretersystemplugins.h"
 #include "handler/system_states.h"
@@ -61,6 +62,7 @@
 #include "src/ds485/dsbusinterface.h"
 #include "src/model/apartment.h"
 #include "src/model/modelmaintenance.h"
+#include "src/model/statestore.h"
 #include "src/web/webserver.h"
 #include "heatingregistering.h"
 #include "sensor_data_uploader.h"
@@ -272,6 +274,12 @@ const char* kDatabaseDirectory = PACKAGE_DATADIR "/data/databases";
       delete m_commChannel;
       m_commChannel = NULL;
     }
+
+    // write out whatever is still buffered
+    if (!StateStore::flushAll()) {
+      log("Could not write the persistent states", lsError);
+    }
+    Logger::getInstance()->setAsync(false);
   }
 
   void DSS::setupDirectories()
@@ -426,9 +434,19 @@ const char* kDatabaseDirectory = PACKAGE_DATADIR "/data/databases";
                          m_pSecurity));
     m_pWebServer->setSessionManager(m_pSessionManager);
 
+    m_pPropertySystem->setBoolValue("/config/xmlsnapshots", true, true, false);
+
     Logger::getInstance()->log("parse command line 1st time", lsWarning);
     parseProperties(_properties);
 
+    // binary snapshots of the parsed XML files speed up the next start,
+    // only the command line can turn them off since config.xml itself is
+    // loaded from a snapshot
+    if (m_pPropertySystem->getBoolValue("/config/xmlsnapshots")) {
+      ExpatParser::setSnapshotDirectory(getDataDirectory() + "snapshots/");
+      ExpatParser::removeOrphanedSnapshots();
+    }
+
     // -- setup logging
     if(!loadConfig(_configFile)) {
       log("Could not parse config file", lsFatal);
@@ -464,6 +482,12 @@ const char* kDatabaseDirectory = PACKAGE_DATADIR "/data/databases";
       aLogSeverity logLevel = static_cast<aLogSeverity> (pNode->getIntegerValue());
       Logger::getInstance()->getLogChannel()->setMinimumSeverity(logLevel);
     }
+    // keeps log file I/O off the event processing threads, opt-in as the
+    // last records before a crash may get lost
+    pNode = getPropertySystem().getProperty("/config/logasync");
+    if (pNode && pNode->getBoolValue()) {
+      Logger::getInstance()->setAsync(true);
+    }
 
     m_pWatchdog = boost::make_shared<Watchdog>(this);
     m_Subsystems.push_back(m_pWatchdog.get());
@@ -789,10 +813,10 @@ const char* kDatabaseDirectory = PACKAGE_DATADIR "/data/databases";
         {
 #if defined(BOOST_VERSION_135)
           log("Loading config from " + itr->path().file_string(), lsInfo);
-          if (loadFromXML(itr->path().file_string(), getPropertySystem().getProperty("/config")))
+          if (loadFromXML(itr->path().file_string(), getPropertySystem().getProperty("/config"), true))
 #else
           log("Loading config from " + itr->path().string(), lsInfo);
-          if (loadFromXML(itr->path().string(), getPropertySystem().getProperty("/config")))
+          if (loadFromXML(itr->path().string(), getPropertySystem().getProperty("/config"), true))
 #endif
             n++;
         }
@@ -810,7 +834,7 @@ const char* kDatabaseDirectory = PACKAGE_DATADIR "/data/databases";
       cfgFile = getConfigDirectory() + "config.xml";
 
     log("Loading config file " + cfgFile, lsInfo);
-    loadFromXML(cfgFile, getPropertySystem().getProperty("/config"));
+    loadFromXML(cfgFile, getPropertySystem().getProperty("/config"), true);
 
     loadConfigDir(getConfigDirectory() + "config.d");
     return true;
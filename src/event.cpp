@@ -34,6 +34,7 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/chrono.hpp>
 
 #include "logger.h"
 #include "dss.h"
@@ -43,6 +44,7 @@
 #include "foreach.h"
 #include "src/model/apartment.h"
 #include "src/model/zone.h"
+#include "src/model/group.h"
 #include "src/model/modelconst.h"
 #include "src/model/device.h"
 #include "src/model/devicereference.h"
@@ -52,6 +54,7 @@
 
 #include <web/webserver.h>
 #include "propertysystem_common_paths.h"
+#include "event/event_fields.h"
 
 using std::set;
 
@@ -117,7 +120,7 @@ namespace dss {
     m_TimeSet = false;
   } // reset
 
-  const std::string& Event::getPropertyByName(const std::string& _name) const {
+  std::string Event::getPropertyByName(const std::string& _name) const {
     if (_name == EventProperty::Name) {
       return m_Name;
     } else if (_name == EventProperty::Location) {
@@ -132,11 +135,10 @@ namespace dss {
 
   template <>
   SensorType Event::getPropertyByName<SensorType>(const std::string& value) const {
-    auto&& strValue = getPropertyByName(value);
-    if (strValue.empty()) {
+    if (!m_Properties.has(value) || m_Properties.get(value).empty()) {
       return SensorType::UnknownType;
     }
-    return static_cast<SensorType>(strToInt(strValue));
+    return static_cast<SensorType>(m_Properties.getInt(value, 0));
   }
 
   bool Event::hasPropertySet(const std::string& _name) const {
@@ -187,7 +189,15 @@ namespace dss {
   }
 
   void Event::setProperty(const std::string& name, int value) {
-    m_Properties.set(name, intToString(value));
+    m_Properties.setInt(name, value);
+  }
+
+  void Event::setProperty(const std::string& name, const dsuid_t& value) {
+    m_Properties.setDSUID(name, value);
+  }
+
+  void Event::setFloatProperty(const std::string& name, double value) {
+    m_Properties.setDouble(name, value);
   }
 
   boost::shared_ptr<const Group> Event::getRaisedAtGroup(Apartment& _apartment) const {
@@ -215,9 +225,15 @@ namespace dss {
     return sameName && sameContext && sameLocation;
   } // isReplacementFor
 
-  void Event::applyProperties(const Properties& _others) {
-    foreach (auto&& kv, _others.getContainer()) {
-      setProperty(kv.first, kv.second);
+  void Event::applyProperties(const EventPayload& _others) {
+    foreach (const EventPayload::Entry& entry, _others.getEntries()) {
+      if ((entry.getKey() == EventProperty::Location) ||
+          (entry.getKey() == EventProperty::Context) ||
+          (entry.getKey() == EventProperty::Time)) {
+        setProperty(entry.getKey(), entry.getValue());
+      } else {
+        m_Properties.set(entry);
+      }
     }
   } // applyProperties
 
@@ -275,8 +291,16 @@ namespace dss {
     Thread("EventInterpreter"),
     m_Queue(NULL),
     m_EventRunner(NULL),
-    m_EventsProcessed(0)
+    m_EventsProcessed(0),
+    m_MonitorPath("/system/EventInterpreter"),
+    m_RunningPath("running"),
+    m_RunningTimePath("running/time"),
+    m_RunningEventPath("running/event"),
+    m_RunningHandlerPath("running/handler"),
+    m_ParallelDispatch(false),
+    m_LaneQueueLimit(1000)
   {
+    m_SubscriptionIndex = boost::make_shared<SubscriptionIndex>();
     if(DSS::hasInstance()) {
       getDSS().getPropertySystem().createProperty(getPropertyBasePath() + "eventsProcessed")
           ->linkToProxy(PropertyProxyPointer<int>(&m_EventsProcessed));
@@ -287,6 +311,8 @@ namespace dss {
   } // ctor()
 
   EventInterpreter::~EventInterpreter() {
+    // lanes may still be executing plugin code
+    m_DispatchLanes.clear();
     scrubVector(m_Plugins);
     if (m_SubscriptionsMutex_locked) {
       m_SubscriptionsMutex.unlock();
@@ -308,6 +334,18 @@ namespace dss {
 
     getDSS().getPropertySystem().setStringValue(getConfigPropertyBasePath() + "subscriptionfile", getDSS().getConfigDirectory() + "subscriptions.xml", true, false);
     getDSS().getPropertySystem().setStringValue(getConfigPropertyBasePath() + "subscriptiondir", getDSS().getConfigDirectory() + "subscriptions.d", true, false);
+    getDSS().getPropertySystem().setBoolValue(getConfigPropertyBasePath() + "parallelDispatch", false, true, false);
+    m_ParallelDispatch = getDSS().getPropertySystem().getBoolValue(getConfigPropertyBasePath() + "parallelDispatch");
+    getDSS().getPropertySystem().setIntValue(getConfigPropertyBasePath() + "laneQueueLimit", m_LaneQueueLimit, true, false);
+    m_LaneQueueLimit = getDSS().getPropertySystem().getIntValue(getConfigPropertyBasePath() + "laneQueueLimit");
+    getDSS().getPropertySystem().setIntValue(getConfigPropertyBasePath() + "queueLimit", 10000, true, false);
+    getDSS().getPropertySystem().setBoolValue(getConfigPropertyBasePath() + "coalesceSensorValues", true, true, false);
+    if (m_Queue != NULL) {
+      int queueLimit = getDSS().getPropertySystem().getIntValue(getConfigPropertyBasePath() + "queueLimit");
+      m_Queue->setMaxSize(queueLimit > 0 ? queueLimit : 0);
+      m_Queue->setCoalesceSensorValues(getDSS().getPropertySystem().getBoolValue(getConfigPropertyBasePath() + "coalesceSensorValues"));
+      m_Queue->publishCounters(getDSS().getPropertySystem().createProperty(getPropertyBasePath() + "queue"));
+    }
 
     PropertySystem subProperties;
     boost::shared_ptr<SubscriptionParserProxy> subParser = boost::make_shared<SubscriptionParserProxy>(
@@ -353,6 +391,7 @@ namespace dss {
       log("EventInterpreter: setup messed up, lost early subscriptions", lsFatal);
     }
     m_Subscriptions.clear();
+    publishSubscriptions();
 
     // reload subscriptions
     m_SubscriptionsMutex.unlock();
@@ -369,6 +408,11 @@ namespace dss {
 
   EventInterpreter& EventInterpreter::addPlugin(EventInterpreterPlugin* _plugin) {
     m_Plugins.push_back(_plugin);
+    if (!m_SubscriptionsMutex_locked) {
+      // resolve subscriptions that were waiting for this plugin
+      boost::mutex::scoped_lock lock(m_SubscriptionsMutex);
+      publishSubscriptions();
+    }
     return *this;
   } // addPlugin
 
@@ -397,60 +441,76 @@ namespace dss {
       if(toProcess != NULL) {
         PropertyNodePtr evtMonitor;
 
-        log(std::string("Interpreter: got event from queue: '") + toProcess->getName() + "'");
+        bool debug = maylog(lsDebug);
+        if (debug) {
+          log(std::string("Interpreter: got event from queue: '") + toProcess->getName() + "'");
+        }
         if (DSS::hasInstance()) {
-           evtMonitor = getDSS().getPropertySystem().getProperty("/system/EventInterpreter");
+           evtMonitor = getDSS().getPropertySystem().getProperty(m_MonitorPath);
            if (evtMonitor) {
              DateTime now;
-             evtMonitor->createProperty("running/time")->setIntegerValue(now.secondsSinceEpoch());
-             evtMonitor->createProperty("running/event")->setStringValue(toProcess->getName());
+             evtMonitor->createProperty(m_RunningTimePath)->setIntegerValue(now.secondsSinceEpoch());
+             evtMonitor->createProperty(m_RunningEventPath)->setStringValue(toProcess->getName());
            }
         }
 
-        foreach (auto&& param, toProcess->getProperties().getContainer()) {
-          log("Interpreter: - parameter '" + param.first + "' = '" + param.second + "'");
-        }
-
-        SubscriptionVector subscriptionsCopy;
-        {
-          boost::mutex::scoped_lock lock(m_SubscriptionsMutex);
-          subscriptionsCopy = m_Subscriptions;
+        if (debug) {
+          foreach (auto&& param, toProcess->getProperties().getEntries()) {
+            log("Interpreter: - parameter '" + param.getKey() + "' = '" + param.getValue() + "'");
+          }
         }
 
-        for(SubscriptionVector::iterator ipSubscription = subscriptionsCopy.begin(), e = subscriptionsCopy.end();
-            ipSubscription != e; ++ipSubscription)
-        {
-          if (((*ipSubscription)->getEventName() == toProcess->getName()) &&
-              (*ipSubscription)->matches(toProcess)) {
-            log(std::string("Interpreter: subscription '") + (*ipSubscription)->getID() + "' matches event");
-            EventInterpreterPlugin* plugin = getPluginByName((*ipSubscription)->getHandlerName());
+        boost::shared_ptr<const SubscriptionIndex> subscriptions = loadSubscriptions();
+        SubscriptionIndex::ByEventName::const_iterator iMatching =
+            subscriptions->byEventName.find(toProcess->getName());
+        if (iMatching != subscriptions->byEventName.end()) {
+          foreach (const SubscriptionEntry& entry, iMatching->second) {
+            if (!entry.subscription->matches(toProcess)) {
+              continue;
+            }
+            if (debug) {
+              log(std::string("Interpreter: subscription '") + entry.subscription->getID() + "' matches event");
+            }
+            EventInterpreterPlugin* plugin = entry.plugin;
             if(plugin != NULL) {
+              if (m_ParallelDispatch) {
+                std::string laneName = plugin->getDispatchLane();
+                if (!laneName.empty()) {
+                  EventDispatchLane& lane = getDispatchLane(laneName);
+                  bool congested = lane.isCongested();
+                  if (!lane.dispatch(plugin, *toProcess, entry.subscription) && !congested) {
+                    // once per burst, the lane stays congested until it had room again
+                    log("Interpreter: dispatch lane '" + laneName + "' is full, waiting for it (" +
+                        intToString(lane.getEventsDelayed()) + " times so far)", lsWarning);
+                  }
+                  continue;
+                }
+              }
               if (evtMonitor) {
-                evtMonitor->createProperty("running/handler")->setStringValue((*ipSubscription)->getHandlerName());
+                evtMonitor->createProperty(m_RunningHandlerPath)->setStringValue(entry.subscription->getHandlerName());
               }
               try {
-                plugin->handleEvent(*toProcess, **ipSubscription);
+                plugin->handleEvent(*toProcess, *entry.subscription);
               } catch(std::runtime_error& e) {
                 log(std::string("Interpreter: error handling event:") + toProcess->getName() + std::string(" plugin:") + plugin->getName() + std::string(" what:") + e.what(), lsError);
               }
             }
             else {
-              log(std::string("Interpreter: could not find handler '") + (*ipSubscription)->getHandlerName(), lsError);
+              log(std::string("Interpreter: could not find handler '") + entry.subscription->getHandlerName(), lsError);
             }
-
           }
         }
 
         if (DSS::hasInstance()) {
-          // TODO: filter events
+          // zone/group/dSUID filters are checked when the event gets serialized
           WebServer& webserver = getDSS().getWebServer();
-          if (webserver.WebSocketClientCount() > 0) {
+          if (webserver.getWebSocketFilters()->wantsEvent(toProcess->getName())) {
             getDSS().getModelMaintenance().publishWebSocketEvent(toProcess);
           }
         }
 
         if (evtMonitor) {
-          evtMonitor->removeChild(evtMonitor->getProperty("running"));
+          evtMonitor->removeChild(evtMonitor->getProperty(m_RunningPath));
         }
 
         m_EventsProcessed++;
@@ -474,6 +534,7 @@ namespace dss {
     assert(subscriptionByID(_subscription->getID()) == NULL);
     boost::mutex::scoped_lock lock(m_SubscriptionsMutex);
     m_Subscriptions.push_back(_subscription);
+    publishSubscriptions();
   } // subscribe
 
   void EventInterpreter::unsubscribe(const std::string& _subscriptionID) {
@@ -483,6 +544,7 @@ namespace dss {
     {
       if((*ipSubscription)->getID() == _subscriptionID) {
         m_Subscriptions.erase(ipSubscription);
+        publishSubscriptions();
         break;
       }
     }
@@ -496,11 +558,41 @@ namespace dss {
     {
       if((*ipSubscription)->getID() == _subscription->getID()) {
         m_Subscriptions.erase(ipSubscription);
+        publishSubscriptions();
         break;
       }
     }
   } // unsubscribe
 
+  void EventInterpreter::publishSubscriptions() {
+    boost::shared_ptr<SubscriptionIndex> index = boost::make_shared<SubscriptionIndex>();
+    index->all = m_Subscriptions;
+    foreach (const boost::shared_ptr<EventSubscription>& subscription, m_Subscriptions) {
+      SubscriptionEntry entry;
+      entry.subscription = subscription;
+      entry.plugin = getPluginByName(subscription->getHandlerName());
+      index->byEventName[subscription->getEventName()].push_back(entry);
+    }
+    boost::atomic_store(&m_SubscriptionIndex, boost::shared_ptr<const SubscriptionIndex>(index));
+  } // publishSubscriptions
+
+  boost::shared_ptr<const EventInterpreter::SubscriptionIndex> EventInterpreter::loadSubscriptions() const {
+    return boost::atomic_load(&m_SubscriptionIndex);
+  } // loadSubscriptions
+
+
+  EventDispatchLane& EventInterpreter::getDispatchLane(const std::string& _name) {
+    boost::shared_ptr<EventDispatchLane>& lane = m_DispatchLanes[_name];
+    if (lane == NULL) {
+      PropertyNodePtr lanesNode;
+      if (DSS::hasInstance()) {
+        lanesNode = getDSS().getPropertySystem().createProperty(getPropertyBasePath() + "lanes");
+      }
+      lane = boost::make_shared<EventDispatchLane>(_name, lanesNode, m_LaneQueueLimit);
+      log("Interpreter: created dispatch lane '" + _name + "'", lsInfo);
+    }
+    return *lane;
+  } // getDispatchLane
 
   boost::shared_ptr<EventSubscription> EventInterpreter::subscriptionByID(const std::string& _subscriptionID) {
     boost::shared_ptr<EventSubscription> result;
@@ -672,12 +764,65 @@ namespace dss {
   //================================================== EventQueue
 
   EventQueue::EventQueue(Subsystem* _subsystem, const int _eventTimeoutMS)
-  : m_Subsystem(_subsystem),
+  : m_Size(0),
+    m_Subsystem(_subsystem),
     m_EventRunner(NULL),
     m_EventTimeoutMS(_eventTimeoutMS),
-    m_ScheduledEventCounter(0)
+    m_ScheduledEventCounter(0),
+    m_MaxSize(0),
+    m_CoalesceSensorValues(true),
+    m_Dropped(0),
+    m_DroppedReported(0),
+    m_Merged(0),
+    m_PeakSize(0)
   { } // ctor
 
+  EventQueue::~EventQueue() {
+    if (m_pCountersNode != NULL) {
+      m_pCountersNode->unlinkProxy(true);
+    }
+  } // dtor
+
+  EventPriority EventQueue::priorityOf(const Event& _event) {
+    const std::string& name = _event.getName();
+    if ((name == EventName::CallScene) ||
+        (name == EventName::CallSceneBus) ||
+        (name == EventName::UndoScene) ||
+        (name == EventName::DeviceButtonClick) ||
+        (name == EventName::ButtonClickBus)) {
+      return epHigh;
+    }
+    if ((name == EventName::DeviceSensorValue) ||
+        (name == EventName::ZoneSensorValue) ||
+        (name == EventName::DebugMonitorUpdate) ||
+        (name == EventName::LogFileData)) {
+      return epLow;
+    }
+    return epNormal;
+  } // priorityOf
+
+  std::string EventQueue::coalescingKey(const Event& _event) {
+    std::string key;
+    if (_event.getName() == EventName::DeviceSensorValue) {
+      boost::shared_ptr<const DeviceReference> device = _event.getRaisedAtDevice();
+      if ((_event.getRaiseLocation() != erlDevice) || (device == NULL)) {
+        return key;
+      }
+      key = _event.getName() + "/" + dsuid2str(device->getDSID()) + "/" +
+            _event.getPropertyByName(ef_sensorIndex);
+    } else if (_event.getName() == EventName::ZoneSensorValue) {
+      boost::shared_ptr<const Group> group = _event.getRaisedAtGroup();
+      if (group == NULL) {
+        return key;
+      }
+      key = _event.getName() + "/" + intToString(group->getZoneID()) + "/" +
+            intToString(group->getID());
+    } else {
+      return key;
+    }
+    return key + "/" + _event.getPropertyByName("sensorType");
+  } // coalescingKey
+
   boost::shared_ptr<Schedule> EventQueue::scheduleFromEvent(boost::shared_ptr<Event> _event) {
     boost::shared_ptr<Schedule> result;
     if(_event->hasPropertySet(EventProperty::Time)) {
@@ -723,37 +868,129 @@ namespace dss {
   } // scheduleFromEvent
 
   void EventQueue::pushEvent(boost::shared_ptr<Event> _event) {
-    log(std::string("Queue: new event '") + _event->getName() + "' in queue...", lsDebug);
+    if ((m_Subsystem != NULL) && m_Subsystem->maylog(lsDebug)) {
+      log(std::string("Queue: new event '") + _event->getName() + "' in queue...", lsDebug);
+    }
     boost::shared_ptr<Schedule> schedule = scheduleFromEvent(_event);
     if(schedule != NULL) {
       ScheduledEvent* scheduledEvent = new ScheduledEvent(_event, schedule, m_ScheduledEventCounter++);
       assert(m_EventRunner != NULL);
       m_EventRunner->addEvent(scheduledEvent);
     } else {
-      bool addToQueue = true;
-      if(!_event->getPropertyByName(EventProperty::Unique).empty()) {
-        boost::mutex::scoped_lock lock(m_QueueMutex);
+      std::string key;
+      if (m_CoalesceSensorValues) {
+        key = coalescingKey(*_event);
+      }
+      EventPriority priority = priorityOf(*_event);
 
-        foreach(boost::shared_ptr<Event> pEvent, m_EventQueue) {
-          if(_event->isReplacementFor(*pEvent)) {
-              pEvent->setProperties(_event->getProperties());
-              if(_event->hasPropertySet("time")) {
-                pEvent->setTime(_event->getPropertyByName("time"));
-              }
-              addToQueue = false;
-              break;
-          }
+      boost::mutex::scoped_lock lock(m_QueueMutex);
+      if(!_event->getPropertyByName(EventProperty::Unique).empty()) {
+        if (mergeUnique(_event)) {
+          return;
         }
       }
-      if(addToQueue) {
-        boost::mutex::scoped_lock lock(m_QueueMutex);
-        m_EventQueue.push_back(_event);
-        lock.unlock();
+      if (!key.empty() && mergeCoalescable(_event, key)) {
+        return;
+      }
+      bool queued = makeRoomFor(priority);
+      if (queued) {
+        m_EventQueue[priority].push_back(_event);
+        if (!key.empty()) {
+          m_Coalescable[key] = _event;
+        }
+        m_Size++;
+        if (m_Size > static_cast<size_t>(m_PeakSize)) {
+          m_PeakSize = m_Size;
+        }
+      } else {
+        m_Dropped++;
+      }
+      std::string dropSummary = takeDropSummary();
+      lock.unlock();
+      if (!dropSummary.empty()) {
+        log(dropSummary, lsWarning);
+      }
+      if (queued) {
         m_EntryInQueueEvt.signal();
       }
     }
   } // pushEvent
 
+  bool EventQueue::mergeUnique(const boost::shared_ptr<Event>& _event) {
+    for (int priority = epHigh; priority < epCount; priority++) {
+      foreach(boost::shared_ptr<Event> pEvent, m_EventQueue[priority]) {
+        if(_event->isReplacementFor(*pEvent)) {
+            pEvent->setProperties(_event->getProperties());
+            if(_event->hasPropertySet("time")) {
+              pEvent->setTime(_event->getPropertyByName("time"));
+            }
+            m_Merged++;
+            return true;
+        }
+      }
+    }
+    return false;
+  } // mergeUnique
+
+  bool EventQueue::mergeCoalescable(const boost::shared_ptr<Event>& _event, const std::string& _key) {
+    std::unordered_map<std::string, boost::shared_ptr<Event> >::iterator it = m_Coalescable.find(_key);
+    if (it == m_Coalescable.end()) {
+      return false;
+    }
+    // the queued event keeps its position but carries the latest value
+    it->second->setProperties(_event->getProperties());
+    m_Merged++;
+    return true;
+  } // mergeCoalescable
+
+  bool EventQueue::makeRoomFor(EventPriority _priority) {
+    if ((m_MaxSize == 0) || (m_Size < m_MaxSize)) {
+      return true;
+    }
+    for (int priority = epCount - 1; priority >= _priority; priority--) {
+      if (!m_EventQueue[priority].empty()) {
+        boost::shared_ptr<Event> victim = m_EventQueue[priority].front();
+        m_EventQueue[priority].pop_front();
+        forgetCoalescable(victim);
+        m_Size--;
+        m_Dropped++;
+        return true;
+      }
+    }
+    return false;
+  } // makeRoomFor
+
+  std::string EventQueue::takeDropSummary() {
+    // an overflowing queue drops an event per push, one line per drop
+    // would flood the log
+    const boost::chrono::seconds kDropReportInterval(10);
+    if (m_Dropped == m_DroppedReported) {
+      return std::string();
+    }
+    boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+    if ((m_DroppedReported != 0) && (now - m_LastDropReport < kDropReportInterval)) {
+      return std::string();
+    }
+    int count = m_Dropped - m_DroppedReported;
+    m_DroppedReported = m_Dropped;
+    m_LastDropReport = now;
+    return "Queue: full, dropped " + intToString(count) + " event(s) since the last report";
+  } // takeDropSummary
+
+  void EventQueue::forgetCoalescable(const boost::shared_ptr<Event>& _event) {
+    if (m_Coalescable.empty()) {
+      return;
+    }
+    std::string key = coalescingKey(*_event);
+    if (key.empty()) {
+      return;
+    }
+    std::unordered_map<std::string, boost::shared_ptr<Event> >::iterator it = m_Coalescable.find(key);
+    if ((it != m_Coalescable.end()) && (it->second == _event)) {
+      m_Coalescable.erase(it);
+    }
+  } // forgetCoalescable
+
   std::string EventQueue::pushTimedEvent(boost::shared_ptr<Event> _event) {
     boost::shared_ptr<Schedule> schedule = scheduleFromEvent(_event);
     if(schedule != NULL) {
@@ -770,23 +1007,68 @@ namespace dss {
   boost::shared_ptr<Event> EventQueue::popEvent() {
     boost::mutex::scoped_lock lock(m_QueueMutex);
     boost::shared_ptr<Event> result;
-    if(!m_EventQueue.empty()) {
-      result = m_EventQueue.front();
-      m_EventQueue.pop_front();
+    for (int priority = epHigh; priority < epCount; priority++) {
+      if(!m_EventQueue[priority].empty()) {
+        result = m_EventQueue[priority].front();
+        m_EventQueue[priority].pop_front();
+        forgetCoalescable(result);
+        m_Size--;
+        break;
+      }
     }
     return result;
   } // popEvent
 
   bool EventQueue::waitForEvent() {
     boost::mutex::scoped_lock lock(m_QueueMutex);
-    if(m_EventQueue.empty()) {
+    if(m_Size == 0) {
       lock.unlock();
       m_EntryInQueueEvt.waitFor(m_EventTimeoutMS);
       lock.lock();
     }
-    return !m_EventQueue.empty();
+    return m_Size > 0;
   } // waitForEvent
 
+  void EventQueue::setMaxSize(size_t _value) {
+    boost::mutex::scoped_lock lock(m_QueueMutex);
+    m_MaxSize = _value;
+  } // setMaxSize
+
+  int EventQueue::getSize() const {
+    boost::mutex::scoped_lock lock(m_QueueMutex);
+    return m_Size;
+  } // getSize
+
+  int EventQueue::getDropped() const {
+    boost::mutex::scoped_lock lock(m_QueueMutex);
+    return m_Dropped;
+  } // getDropped
+
+  int EventQueue::getMerged() const {
+    boost::mutex::scoped_lock lock(m_QueueMutex);
+    return m_Merged;
+  } // getMerged
+
+  int EventQueue::getPeakSize() const {
+    boost::mutex::scoped_lock lock(m_QueueMutex);
+    return m_PeakSize;
+  } // getPeakSize
+
+  void EventQueue::publishCounters(PropertyNodePtr _node) {
+    if (m_pCountersNode != NULL) {
+      m_pCountersNode->unlinkProxy(true);
+    }
+    m_pCountersNode = _node;
+    m_pCountersNode->createProperty("size")
+      ->linkToProxy(PropertyProxyMemberFunction<EventQueue, int>(*this, &EventQueue::getSize));
+    m_pCountersNode->createProperty("peakSize")
+      ->linkToProxy(PropertyProxyMemberFunction<EventQueue, int>(*this, &EventQueue::getPeakSize));
+    m_pCountersNode->createProperty("dropped")
+      ->linkToProxy(PropertyProxyMemberFunction<EventQueue, int>(*this, &EventQueue::getDropped));
+    m_pCountersNode->createProperty("merged")
+      ->linkToProxy(PropertyProxyMemberFunction<EventQueue, int>(*this, &EventQueue::getMerged));
+  } // publishCounters
+
   void EventQueue::shutdown() {
     m_EntryInQueueEvt.broadcast();
   } // shutdown
@@ -802,7 +1084,8 @@ namespace dss {
   const bool DebugEventRunner = false;
 
   EventRunner::EventRunner(Subsystem* _subsystem, PropertyNodePtr _monitorNode)
-  : m_Subsystem(_subsystem),
+  : m_Rescan(false),
+    m_Subsystem(_subsystem),
     m_EventQueue(NULL),
     m_ShutdownFlag(false),
     m_MonitorNode(_monitorNode)
@@ -813,8 +1096,9 @@ namespace dss {
   } // ctor
 
   void EventRunner::shutdown() {
+    boost::mutex::scoped_lock lock(m_EventsMutex);
     m_ShutdownFlag = true;
-    m_NewItem.broadcast();
+    m_NewItem.notify_all();
   }
 
   size_t EventRunner::getSize() const {
@@ -849,6 +1133,8 @@ namespace dss {
     while (it != m_ScheduledEvents.end()) {
       if (it->getEvent()->getName() == _eventName) {
         // TODO also remove event from pending queue
+        // its deadline goes stale and gets dropped from the heap lazily
+        m_Timers.erase(it->getID());
         it = m_ScheduledEvents.erase(it);
       } else {
         it++;
@@ -864,6 +1150,7 @@ namespace dss {
         if (DebugEventRunner) {
           log("Runner: remove event \"" + it->getName() + "\" with id " + _eventID, lsDebug);
         }
+        m_Timers.erase(_eventID);
         m_ScheduledEvents.erase(it);
         return;
      }
@@ -873,10 +1160,9 @@ namespace dss {
 
   const ScheduledEvent& EventRunner::getEvent(const std::string& _eventID) const {
     boost::mutex::scoped_lock lock(m_EventsMutex);
-    for (size_t i = 0; i < m_ScheduledEvents.size(); i++) {
-      if (m_ScheduledEvents.at(i).getID() == _eventID) {
-        return m_ScheduledEvents.at(i);
-      }
+    std::unordered_map<std::string, TimerState>::const_iterator it = m_Timers.find(_eventID);
+    if (it != m_Timers.end()) {
+      return *it->second.event;
     }
     throw std::runtime_error("Event with id '" + _eventID + "' not found");
   } // getEvent
@@ -898,7 +1184,7 @@ namespace dss {
           if (DebugEventRunner) {
             log("Runner: merge unique event " +
                 _scheduledEvent->getEvent()->getName() + " scheduled " +
-                scheduledEvent.getSchedule().getNextOccurence(DateTime()).toString());
+                scheduledEvent.getNextOccurenceString());
           }
           break;
         }
@@ -909,20 +1195,63 @@ namespace dss {
         m_MonitorNode->createProperty(id + "/id")->setStringValue(id);
         m_MonitorNode->createProperty(id + "/name")->setStringValue(
                                     _scheduledEvent->getEvent()->getName());
+        _scheduledEvent->publish(m_MonitorNode->getProperty(id));
       }
 
       m_ScheduledEvents.push_back(_scheduledEvent);
+      m_Timers[id].event = _scheduledEvent;
+      m_Timers[id].generation = 0;
+      // the next occurence is evaluated by the runner, right away
+      scheduleAt(*_scheduledEvent, DateTime());
+      m_Rescan = true;
+      m_NewItem.notify_all();
     } else {
       delete _scheduledEvent;
     }
-    lock.unlock();
-    m_NewItem.signal();
   } // addEvent
 
+  void EventRunner::scheduleAt(ScheduledEvent& _event, const DateTime& _due) {
+    TimerState& state = m_Timers[_event.getID()];
+    state.generation++;
+    TimerEntry entry;
+    entry.due = _due;
+    entry.id = _event.getID();
+    entry.generation = state.generation;
+    m_Deadlines.push(entry);
+    _event.setNextOccurence(_due);
+  } // scheduleAt
+
+  bool EventRunner::isCurrent(const TimerEntry& _entry) const {
+    std::unordered_map<std::string, TimerState>::const_iterator it = m_Timers.find(_entry.id);
+    return (it != m_Timers.end()) && (it->second.generation == _entry.generation);
+  } // isCurrent
+
+  int EventRunner::getWaitTimeMS() {
+    // upper bound, so that wall clock adjustments get picked up
+    const int kMaxWaitMS = 60 * 1000;
+    while (!m_Deadlines.empty() && !isCurrent(m_Deadlines.top())) {
+      m_Deadlines.pop();
+    }
+    if (m_Deadlines.empty()) {
+      return kMaxWaitMS;
+    }
+    long long waitMS = m_Deadlines.top().due.differenceMS(DateTime());
+    if (waitMS < 0) {
+      return 0;
+    }
+    return static_cast<int>(std::min<long long>(waitMS, kMaxWaitMS));
+  } // getWaitTimeMS
+
   void EventRunner::run() {
+    boost::mutex::scoped_lock lock(m_EventsMutex);
     while(!m_ShutdownFlag) {
+      m_Rescan = false;
+      lock.unlock();
       raisePendingEvents();
-      m_NewItem.waitFor(500);
+      lock.lock();
+      if (!m_Rescan && !m_ShutdownFlag) {
+        m_NewItem.timed_wait(lock, boost::posix_time::milliseconds(getWaitTimeMS()));
+      }
     }
   } // run
 
@@ -933,9 +1262,19 @@ namespace dss {
 
     std::vector<std::string> removeIDs;
     boost::mutex::scoped_lock lock(m_EventsMutex);
-    for(boost::ptr_vector<ScheduledEvent>::iterator ipSchedEvt = m_ScheduledEvents.begin(), e = m_ScheduledEvents.end();
-        ipSchedEvt != e; ++ipSchedEvt)
-    {
+    while (!m_Deadlines.empty()) {
+      TimerEntry entry = m_Deadlines.top();
+      if (!isCurrent(entry)) {
+        m_Deadlines.pop();
+        continue;
+      }
+      if (now < entry.due) {
+        break;
+      }
+      m_Deadlines.pop();
+      ScheduledEvent* ipSchedEvt = m_Timers[entry.id].event;
+
+      // deadlines are estimates, the schedule has the final word
       DateTime nextOccurence = ipSchedEvt->getSchedule().getNextOccurence(now);
 
       if(nextOccurence == DateTime::NullDate) {
@@ -944,47 +1283,49 @@ namespace dss {
         continue;
       }
 
-      if (m_MonitorNode) {
-        if (NULL == m_MonitorNode->getProperty(ipSchedEvt->getID() + "/time")) {
-          m_MonitorNode->createProperty(ipSchedEvt->getID() + "/time")->setStringValue(nextOccurence.toString());
-        }
-        m_MonitorNode->createProperty(ipSchedEvt->getID() + "/ticks")->setIntegerValue(nextOccurence.difference(now));
+      if (now < nextOccurence) {
+        scheduleAt(*ipSchedEvt, nextOccurence);
+        continue;
       }
 
-      if (nextOccurence <= now) {
-        result = true;
-        if(m_EventQueue != NULL) {
-          boost::shared_ptr<Event> evt = ipSchedEvt->getEvent();
-          if (evt->hasPropertySet(EventProperty::Time)) {
-            evt->unsetProperty(EventProperty::Time);
-          }
-          if (evt->hasPropertySet(EventProperty::ICalStartTime)) {
-            evt->unsetProperty(EventProperty::ICalStartTime);
-          }
-          if (evt->hasPropertySet(EventProperty::ICalRRule)) {
-            evt->unsetProperty(EventProperty::ICalRRule);
-          }
+      if (m_EventQueue == NULL) {
+        log("Runner: cannot push event back to queue because the queue is NULL", lsFatal);
+        // keep the event, it gets raised once a queue is set
+        scheduleAt(*ipSchedEvt, nextSecond);
+        continue;
+      }
 
-          m_EventQueue->pushEvent(evt);
+      result = true;
+      boost::shared_ptr<Event> evt = ipSchedEvt->getEvent();
+      if (evt->hasPropertySet(EventProperty::Time)) {
+        evt->unsetProperty(EventProperty::Time);
+      }
+      if (evt->hasPropertySet(EventProperty::ICalStartTime)) {
+        evt->unsetProperty(EventProperty::ICalStartTime);
+      }
+      if (evt->hasPropertySet(EventProperty::ICalRRule)) {
+        evt->unsetProperty(EventProperty::ICalRRule);
+      }
 
-          // check if the event will be raised again
-          if (!ipSchedEvt->getSchedule().hasRecurrence() || (ipSchedEvt->getSchedule().getNextOccurence(nextSecond) == DateTime::NullDate)) {
-            log("Runner: event " + ipSchedEvt->getID() + " has no further schedule");
-            removeIDs.push_back(ipSchedEvt->getID());
-          }
+      m_EventQueue->pushEvent(evt);
 
-          // protect recurrent events against time leaps
-          if (ipSchedEvt->getSchedule().hasRecurrence()) {
-            size_t skipped = ipSchedEvt->getSchedule().leapAdjust(nextSecond.secondsSinceEpoch());
-            if (skipped) {
-              log("Runner: event " + ipSchedEvt->getID() + " skipped execution: " + std::to_string(skipped), lsWarning);
-            }
-          }
+      // check if the event will be raised again
+      DateTime followUp;
+      if (ipSchedEvt->getSchedule().hasRecurrence()) {
+        followUp = ipSchedEvt->getSchedule().getNextOccurence(nextSecond);
+      }
+      if (!ipSchedEvt->getSchedule().hasRecurrence() || (followUp == DateTime::NullDate)) {
+        log("Runner: event " + ipSchedEvt->getID() + " has no further schedule");
+        removeIDs.push_back(ipSchedEvt->getID());
+        continue;
+      }
 
-        } else {
-          log("Runner: cannot push event back to queue because the queue is NULL", lsFatal);
-        }
+      // protect recurrent events against time leaps
+      size_t skipped = ipSchedEvt->getSchedule().leapAdjust(nextSecond.secondsSinceEpoch());
+      if (skipped) {
+        log("Runner: event " + ipSchedEvt->getID() + " skipped execution: " + std::to_string(skipped), lsWarning);
       }
+      scheduleAt(*ipSchedEvt, (followUp < nextSecond) ? nextSecond : followUp);
     }
     lock.unlock();
     for(size_t iID = 0; iID < removeIDs.size(); iID++) {
@@ -1084,6 +1425,84 @@ namespace dss {
   } // loadParameterFromProperty
 
 
+  //================================================== EventDispatchLane
+
+  EventDispatchLane::EventDispatchLane(const std::string& _name, PropertyNodePtr _parentNode,
+                                       int _maxQueueDepth)
+  : m_Name(_name),
+    m_MaxQueueDepth(_maxQueueDepth),
+    m_QueueDepth(0),
+    m_EventsProcessed(0),
+    m_EventsDelayed(0),
+    m_Congested(false),
+    m_LastLatencyMS(0),
+    m_MaxLatencyMS(0)
+  {
+    if (_parentNode != NULL) {
+      m_pPropertyNode = _parentNode->createProperty(_name);
+      m_pPropertyNode->createProperty("queueDepth")
+        ->linkToProxy(PropertyProxyMemberFunction<EventDispatchLane, int>(*this, &EventDispatchLane::getQueueDepth));
+      m_pPropertyNode->createProperty("eventsProcessed")
+        ->linkToProxy(PropertyProxyMemberFunction<EventDispatchLane, int>(*this, &EventDispatchLane::getEventsProcessed));
+      m_pPropertyNode->createProperty("eventsDelayed")
+        ->linkToProxy(PropertyProxyMemberFunction<EventDispatchLane, int>(*this, &EventDispatchLane::getEventsDelayed));
+      m_pPropertyNode->createProperty("latency")
+        ->linkToProxy(PropertyProxyMemberFunction<EventDispatchLane, int>(*this, &EventDispatchLane::getLastLatencyMS));
+      m_pPropertyNode->createProperty("maxLatency")
+        ->linkToProxy(PropertyProxyMemberFunction<EventDispatchLane, int>(*this, &EventDispatchLane::getMaxLatencyMS));
+    }
+  } // ctor
+
+  EventDispatchLane::~EventDispatchLane() {
+    if (m_pPropertyNode != NULL) {
+      m_pPropertyNode->unlinkProxy(true);
+      if (m_pPropertyNode->getParentNode() != NULL) {
+        m_pPropertyNode->getParentNode()->removeChild(m_pPropertyNode);
+      }
+    }
+  } // dtor
+
+  bool EventDispatchLane::dispatch(EventInterpreterPlugin* _plugin,
+                                   const Event& _event,
+                                   boost::shared_ptr<EventSubscription> _subscription) {
+    // backpressure instead of dropping, system triggers and scripts must
+    // see every event
+    m_Congested = false;
+    if (m_MaxQueueDepth > 0) {
+      boost::mutex::scoped_lock lock(m_DepthMutex);
+      while (m_QueueDepth >= m_MaxQueueDepth) {
+        if (!m_Congested) {
+          m_Congested = true;
+          m_EventsDelayed++;
+        }
+        m_DepthChanged.wait(lock);
+      }
+    }
+    boost::chrono::steady_clock::time_point queued = boost::chrono::steady_clock::now();
+    boost::shared_ptr<Event> event = boost::make_shared<Event>(_event);
+    m_QueueDepth++;
+    m_Processor.addEvent(makeTask([this, _plugin, event, _subscription, queued] () {
+      try {
+        _plugin->handleEvent(*event, *_subscription);
+      } catch(std::runtime_error& e) {
+        _plugin->log(std::string("Interpreter: error handling event:") + event->getName() + std::string(" plugin:") + _plugin->getName() + std::string(" what:") + e.what(), lsError);
+      }
+      int latency = boost::chrono::duration_cast<boost::chrono::milliseconds>(
+          boost::chrono::steady_clock::now() - queued).count();
+      m_LastLatencyMS = latency;
+      if (latency > m_MaxLatencyMS) {
+        m_MaxLatencyMS = latency;
+      }
+      m_EventsProcessed++;
+      {
+        boost::mutex::scoped_lock lock(m_DepthMutex);
+        m_QueueDepth--;
+      }
+      m_DepthChanged.notify_one();
+    }));
+    return !m_Congested;
+  } // dispatch
+
   //================================================== EventInterpreterPlugin
 
   EventInterpreterPlugin::EventInterpreterPlugin(const std::string& _name, EventInterpreter* _interpreter)
@@ -1142,8 +1561,31 @@ namespace dss {
                                  {
     m_EventID = uintToString(_counterID) + "-" +
                 uintToString(static_cast<long long unsigned>(DateTime().secondsSinceEpoch())) + '_' + _pEvt->getName();
+    m_NextOccurence = DateTime().secondsSinceEpoch();
   } // ScheduledEvent
 
+  ScheduledEvent::~ScheduledEvent() {
+    if (m_pMonitorNode != NULL) {
+      // the nodes may have been removed from the tree meanwhile
+      PropertyNodePtr node = m_pMonitorNode->getPropertyByName("time");
+      if (node != NULL) {
+        node->unlinkProxy();
+      }
+      node = m_pMonitorNode->getPropertyByName("ticks");
+      if (node != NULL) {
+        node->unlinkProxy();
+      }
+    }
+  } // dtor
+
+  void ScheduledEvent::publish(PropertyNodePtr _node) {
+    m_pMonitorNode = _node;
+    m_pMonitorNode->createProperty("time")
+      ->linkToProxy(PropertyProxyMemberFunction<ScheduledEvent, std::string, false>(*this, &ScheduledEvent::getNextOccurenceString));
+    m_pMonitorNode->createProperty("ticks")
+      ->linkToProxy(PropertyProxyMemberFunction<ScheduledEvent, int>(*this, &ScheduledEvent::getTicks));
+  } // publish
+
   //================================================== External consts
 
 } // namespace dss
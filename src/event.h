@@ -30,15 +30,22 @@
 #include "subsystem.h"
 #include "propertysystem.h"
 #include "model/modelmaintenance.h"
+#include "taskprocessor.h"
+#include "event/event_payload.h"
 
 #include <string>
 #include <deque>
+#include <queue>
 #include <vector>
+#include <map>
+#include <unordered_map>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
 
 namespace dss {
 
@@ -151,7 +158,7 @@ namespace dss {
     boost::shared_ptr<State> m_RaisedAtState;
     boost::shared_ptr<DeviceReference> m_RaisedAtDevice;
 
-    Properties m_Properties;
+    EventPayload m_Properties;
     DateTime m_timestamp;
   private:
     void reset();
@@ -166,11 +173,13 @@ namespace dss {
 
     const std::string& getName() const { return m_Name; }
 
-    const std::string& getPropertyByName(const std::string& _name) const;
+    std::string getPropertyByName(const std::string& _name) const;
     bool hasPropertySet(const std::string& _name) const;
     void unsetProperty(const std::string& _name);
     bool setProperty(const std::string& _name, const std::string& _value);
     void setProperty(const std::string& name, int value);
+    void setProperty(const std::string& name, const dsuid_t& value);
+    void setFloatProperty(const std::string& name, double value);
     void setProperty(const std::string& name, SensorType x) { setProperty(name, static_cast<int>(x)); }
     void setProperty(const std::string& name, BinaryInputType x) { setProperty(name, static_cast<int>(x)); }
     void setProperty(const std::string& name, BinaryInputStateValue x) { setProperty(name, static_cast<int>(x)); }
@@ -188,9 +197,9 @@ namespace dss {
     boost::shared_ptr<const State> getRaisedAtState() const { return m_RaisedAtState; }
     EventRaiseLocation getRaiseLocation() const { return m_RaiseLocation; }
 
-    const Properties& getProperties() const { return m_Properties; }
-    void setProperties(const Properties& _value) { m_Properties = _value; }
-    void applyProperties(const Properties& _others);
+    const EventPayload& getProperties() const { return m_Properties; }
+    void setProperties(const EventPayload& _value) { m_Properties = _value; }
+    void applyProperties(const EventPayload& _others);
     /** Checks whether _other and this are the same regarding uniqueness */
     bool isReplacementFor(const Event& _other);
     boost::shared_ptr<Event> getptr() {
@@ -357,6 +366,12 @@ namespace dss {
      */
     virtual void subscribe() {};
     virtual void handleEvent(Event& _event, const EventSubscription& _subscription) = 0;
+    /**
+     * Name of the dispatch lane this plugin runs on when parallel dispatch
+     * is enabled. Plugins sharing a lane see events in queue order, an empty
+     * name keeps the plugin on the EventInterpreter thread.
+     */
+    virtual std::string getDispatchLane() const { return std::string(); }
 
     void log(const std::string& _message, aLogSeverity _severity = lsDebug);
   }; // EventInterpreterPlugin
@@ -364,11 +379,22 @@ namespace dss {
 
   //-------------------------------------------------- EventQueue
 
+  /** Events leave the queue ordered by priority, FIFO within a priority */
+  typedef enum {
+    epHigh,
+    epNormal,
+    epLow,
+    epCount
+  } EventPriority;
+
   class EventQueue {
   private:
-    std::deque< boost::shared_ptr<Event> > m_EventQueue;
+    std::deque< boost::shared_ptr<Event> > m_EventQueue[epCount];
+    /** Queued sensor value events by coalescing key */
+    std::unordered_map<std::string, boost::shared_ptr<Event> > m_Coalescable;
+    size_t m_Size;
     SyncEvent m_EntryInQueueEvt;
-    boost::mutex m_QueueMutex;
+    mutable boost::mutex m_QueueMutex;
 
     Subsystem* m_Subsystem;
     EventRunner* m_EventRunner;
@@ -377,8 +403,26 @@ namespace dss {
 
     boost::atomic<unsigned long int> m_ScheduledEventCounter;
 
+    size_t m_MaxSize;
+    bool m_CoalesceSensorValues;
+    int m_Dropped;
+    /** m_Dropped as of the last warning, drops are logged in summaries */
+    int m_DroppedReported;
+    boost::chrono::steady_clock::time_point m_LastDropReport;
+    int m_Merged;
+    int m_PeakSize;
+    PropertyNodePtr m_pCountersNode;
+  private:
+    bool mergeUnique(const boost::shared_ptr<Event>& _event);
+    bool mergeCoalescable(const boost::shared_ptr<Event>& _event, const std::string& _key);
+    bool makeRoomFor(EventPriority _priority);
+    /** Returns the warning for drops not reported yet, if it is time for
+      * one. m_QueueMutex has to be held, the caller logs without it. */
+    std::string takeDropSummary();
+    void forgetCoalescable(const boost::shared_ptr<Event>& _event);
   public:
     EventQueue(Subsystem* _subsystem, const int _eventTimeoutMS = 1000);
+    ~EventQueue();
     void pushEvent(boost::shared_ptr<Event> _event);
     std::string pushTimedEvent(boost::shared_ptr<Event> _event);
     boost::shared_ptr<Event> popEvent();
@@ -387,22 +431,60 @@ namespace dss {
     void shutdown();
     void setEventRunner(EventRunner* _value) { m_EventRunner = _value; }
     void log(const std::string& _message, aLogSeverity _severity = lsDebug);
-  };
+
+    static EventPriority priorityOf(const Event& _event);
+    /** Key under which queued events replace each other, empty if the
+     * event must be delivered as is */
+    static std::string coalescingKey(const Event& _event);
+
+    /** Maximum number of queued events, 0 means unbounded. Once the limit
+     * is reached the oldest event of the lowest priority gets dropped. */
+    void setMaxSize(size_t _value);
+    size_t getMaxSize() const { return m_MaxSize; }
+    void setCoalesceSensorValues(bool _value) { m_CoalesceSensorValues = _value; }
+    int getSize() const;
+    int getDropped() const;
+    int getMerged() const;
+    int getPeakSize() const;
+    /** Links size, peakSize, dropped and merged below _node */
+    void publishCounters(PropertyNodePtr _node);
+  }; // EventQueue
 
 
   //-------------------------------------------------- EventRunner
 
   class EventRunner : public PropertyListener {
   private:
+    /** Deadline of a scheduled event, stale once the generation moved on */
+    struct TimerEntry {
+      DateTime due;
+      std::string id;
+      unsigned int generation;
+      bool operator>(const TimerEntry& _other) const { return due > _other.due; }
+    };
+    struct TimerState {
+      ScheduledEvent* event;
+      unsigned int generation;
+    };
+    typedef std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry> > Deadlines;
+
     boost::ptr_vector<ScheduledEvent> m_ScheduledEvents;
     typedef boost::ptr_vector<ScheduledEvent> m_ScheduledEvents_t;
-    DateTime m_WakeTime;
-    SyncEvent m_NewItem;
+    /** Min-heap on the next occurrence, the runner only sleeps until its top */
+    Deadlines m_Deadlines;
+    std::unordered_map<std::string, TimerState> m_Timers;
+    boost::condition_variable m_NewItem;
+    bool m_Rescan;
     Subsystem* m_Subsystem;
     EventQueue* m_EventQueue;
     mutable boost::mutex m_EventsMutex;
     bool m_ShutdownFlag;
     PropertyNodePtr m_MonitorNode;
+  private:
+    /** m_EventsMutex has to be held */
+    void scheduleAt(ScheduledEvent& _event, const DateTime& _due);
+    bool isCurrent(const TimerEntry& _entry) const;
+    int getWaitTimeMS();
   public:
     EventRunner(Subsystem* _subsystem, PropertyNodePtr _monitorNode = PropertyNodePtr());
 
@@ -428,24 +510,102 @@ namespace dss {
   }; // EventRunner
 
 
+  //-------------------------------------------------- EventDispatchLane
+
+  /** Serial worker running the handlers of one or more plugins.
+   * Events are handled in the order they were dispatched, queue depth and
+   * latency are published below \a _parentNode. Each dispatched handler
+   * gets its own copy of the event, so plugins may modify it while other
+   * lanes and the interpreter are still looking at the original.
+   * A full lane blocks the dispatcher until the handlers caught up, the
+   * bounded EventQueue in front of the interpreter decides what to shed. */
+  class EventDispatchLane : boost::noncopyable {
+  private:
+    std::string m_Name;
+    PropertyNodePtr m_pPropertyNode;
+    const int m_MaxQueueDepth;
+    boost::atomic<int> m_QueueDepth;
+    boost::atomic<int> m_EventsProcessed;
+    boost::atomic<int> m_EventsDelayed;
+    /** Whether the last dispatch had to wait, dispatcher only */
+    bool m_Congested;
+    boost::mutex m_DepthMutex;
+    boost::condition_variable m_DepthChanged;
+    boost::atomic<int> m_LastLatencyMS;
+    boost::atomic<int> m_MaxLatencyMS;
+    // declared last so the worker is joined before the counters go away
+    TaskProcessor m_Processor;
+  public:
+    EventDispatchLane(const std::string& _name, PropertyNodePtr _parentNode = PropertyNodePtr(),
+                      int _maxQueueDepth = 1000);
+    ~EventDispatchLane();
+
+    /** Queues a copy of \a _event for \a _plugin, waits while the lane is full.
+     * @return false if the caller had to wait */
+    bool dispatch(EventInterpreterPlugin* _plugin,
+                  const Event& _event,
+                  boost::shared_ptr<EventSubscription> _subscription);
+
+    const std::string& getName() const { return m_Name; }
+    int getQueueDepth() const { return m_QueueDepth; }
+    int getEventsProcessed() const { return m_EventsProcessed; }
+    /** Number of dispatches that had to wait for the lane */
+    int getEventsDelayed() const { return m_EventsDelayed; }
+    bool isCongested() const { return m_Congested; }
+    /** Time from dispatch until the handler returned, in milliseconds */
+    int getLastLatencyMS() const { return m_LastLatencyMS; }
+    int getMaxLatencyMS() const { return m_MaxLatencyMS; }
+  }; // EventDispatchLane
+
+
   //-------------------------------------------------- EventInterpreter
 
   class EventInterpreter : public Subsystem,
                            public Thread {
   private:
     typedef std::vector< boost::shared_ptr<EventSubscription> > SubscriptionVector;
+
+    /** Subscription together with its pre-resolved plugin */
+    struct SubscriptionEntry {
+      boost::shared_ptr<EventSubscription> subscription;
+      EventInterpreterPlugin* plugin;
+    };
+    /** Immutable view on the subscriptions, indexed by event name.
+     * Rebuilt on every (un)subscribe and published atomically, so that
+     * dispatching does not need to lock or copy anything. */
+    struct SubscriptionIndex {
+      typedef std::unordered_map<std::string, std::vector<SubscriptionEntry> > ByEventName;
+      SubscriptionVector all;
+      ByEventName byEventName;
+    };
+
+    /** Master list, guarded by m_SubscriptionsMutex */
     SubscriptionVector m_Subscriptions;
+    boost::shared_ptr<const SubscriptionIndex> m_SubscriptionIndex;
     boost::mutex m_SubscriptionsMutex;
     bool m_SubscriptionsMutex_locked;
     std::vector<EventInterpreterPlugin*> m_Plugins;
     EventQueue* m_Queue;
     EventRunner* m_EventRunner;
     int m_EventsProcessed;
+    const PropertyPath m_MonitorPath;
+    const PropertyPath m_RunningPath;
+    const PropertyPath m_RunningTimePath;
+    const PropertyPath m_RunningEventPath;
+    const PropertyPath m_RunningHandlerPath;
+    /** Lanes by name, only touched by the interpreter thread */
+    std::map<std::string, boost::shared_ptr<EventDispatchLane> > m_DispatchLanes;
+    bool m_ParallelDispatch;
+    int m_LaneQueueLimit;
   private:
     void loadSubscription(PropertyNodePtr _node);
     void loadState(PropertyNodePtr _node);
     void loadFilter(PropertyNodePtr _node, boost::shared_ptr<EventSubscription> _subscription);
     boost::shared_ptr<EventSubscription> subscriptionByID(const std::string& _name);
+    /** Rebuilds m_SubscriptionIndex, m_SubscriptionsMutex has to be held */
+    void publishSubscriptions();
+    boost::shared_ptr<const SubscriptionIndex> loadSubscriptions() const;
+    EventDispatchLane& getDispatchLane(const std::string& _name);
   protected:
     virtual void doStart();
   public:
@@ -474,8 +634,11 @@ namespace dss {
     void setEventQueue(EventQueue* _queue) { m_Queue = _queue; }
     EventRunner& getEventRunner() { return *m_EventRunner; }
     void setEventRunner(EventRunner* _runner) { m_EventRunner = _runner; }
-    int getNumberOfSubscriptions() const { return m_Subscriptions.size(); }
-    SubscriptionVector getSubscriptions() const { return m_Subscriptions; }
+    /** If enabled, plugins with a dispatch lane handle events off the interpreter thread */
+    void setParallelDispatch(bool _value) { m_ParallelDispatch = _value; }
+    bool getParallelDispatch() const { return m_ParallelDispatch; }
+    int getNumberOfSubscriptions() const { return loadSubscriptions()->all.size(); }
+    SubscriptionVector getSubscriptions() const { return loadSubscriptions()->all; }
   }; // EventInterpreter
 
 
@@ -490,10 +653,13 @@ namespace dss {
     boost::shared_ptr<Schedule> m_Schedule;
     std::string m_Name;
     std::string m_EventID;
+    boost::atomic<time_t> m_NextOccurence;
+    PropertyNodePtr m_pMonitorNode;
   public:
     ScheduledEvent(boost::shared_ptr<Event> _pEvt,
                    boost::shared_ptr<Schedule> _pSchedule,
                    unsigned long int _counterID);
+    ~ScheduledEvent();
 
     /** Returns the event that will be raised */
     boost::shared_ptr<Event> getEvent() { return m_Event; }
@@ -506,6 +672,14 @@ namespace dss {
     void setName(const std::string& _value) { m_Name = _value; }
     /** Returns the event ID */
     const std::string& getID() const { return m_EventID; }
+    /** Sets the time the EventRunner expects to raise the event next */
+    void setNextOccurence(const DateTime& _value) { m_NextOccurence = _value.secondsSinceEpoch(); }
+    DateTime getNextOccurence() const { return DateTime(m_NextOccurence.load()); }
+    std::string getNextOccurenceString() const { return getNextOccurence().toString(); }
+    /** Returns the seconds left until the next occurence */
+    int getTicks() const { return getNextOccurence().difference(DateTime()); }
+    /** Links time and ticks below _node, they are computed on read */
+    void publish(PropertyNodePtr _node);
   }; // ScheduledEvent
 
 
@@ -97,8 +97,8 @@ createDeviceStatusEvent(boost::shared_ptr<DeviceReference> _devRef,
 {
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::DeviceStatus, _devRef);
-  event->setProperty("statusIndex", intToString(_index));
-  event->setProperty("statusValue", intToString(_value));
+  event->setProperty("statusIndex", _index);
+  event->setProperty("statusValue", _value);
   return event;
 }
 
@@ -108,7 +108,7 @@ createDeviceBinaryInputEvent(boost::shared_ptr<DeviceReference> _devRef,
 {
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::DeviceBinaryInputEvent, _devRef);
-  event->setProperty("inputIndex", intToString(_index));
+  event->setProperty("inputIndex", _index);
   event->setProperty("inputType", _type);
   event->setProperty("inputState", _state);
   return event;
@@ -122,7 +122,7 @@ createDeviceCustomActionChangedEvent(boost::shared_ptr<DeviceReference> _devRef,
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::DeviceCustomActionChangedEvent, _devRef);
 
-  Properties actionParams;
+  EventPayload actionParams;
   actionParams.set("customActionId", name);
   actionParams.set("actionId", action);
   actionParams.set("customActionTitle", title);
@@ -146,7 +146,7 @@ createDeviceActionEvent(boost::shared_ptr<DeviceReference> _devRef, const std::s
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::DeviceActionEvent, _devRef);
 
-  Properties actionParams;
+  EventPayload actionParams;
   actionParams.set("actionId", name);
   for (int n = 0; n < params.elements_size(); n++) {
     const vdcapi::PropertyElement& pelement = params.elements(n);
@@ -189,10 +189,10 @@ createDeviceSensorValueEvent(boost::shared_ptr<DeviceReference> _devRef,
   double floatValue = sensorValueToDouble(_type, _value);
 
   event = boost::make_shared<Event>(EventName::DeviceSensorValue, _devRef);
-  event->setProperty(ef_sensorIndex, intToString(_index));
+  event->setProperty(ef_sensorIndex, _index);
   event->setProperty("sensorType", _type);
-  event->setProperty("sensorValue", intToString(_value));
-  event->setProperty("sensorValueFloat", doubleToString(floatValue));
+  event->setProperty("sensorValue", _value);
+  event->setFloatProperty("sensorValueFloat", floatValue);
   return event;
 }
 
@@ -205,9 +205,9 @@ createDeviceSensorValueExEvent(boost::shared_ptr<DeviceReference> _devRef,
   DateTime now;
 
   event = boost::make_shared<Event>(EventName::DeviceSensorValue, _devRef);
-  event->setProperty(ef_sensorIndex, intToString(_index));
+  event->setProperty(ef_sensorIndex, _index);
   event->setProperty("sensorType", _type);
-  event->setProperty("sensorValueFloat", doubleToString(_value));
+  event->setFloatProperty("sensorValueFloat", _value);
   event->setProperty("contextId", intToString(_contextId));
   event->setProperty("contextMsg", _contextMsg);
   if (_age > 0) {
@@ -223,7 +223,7 @@ createDeviceInvalidSensorEvent(boost::shared_ptr<DeviceReference> _devRef,
 {
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::DeviceInvalidSensor, _devRef);
-  event->setProperty(ef_sensorIndex, intToString(_index));
+  event->setProperty(ef_sensorIndex, _index);
   event->setProperty("sensorType", _type);
   event->setProperty("lastValueTS", _ts.toISO8601_ms());
   return event;
@@ -239,9 +239,9 @@ createZoneSensorValueEvent(boost::shared_ptr<Group> _group, SensorType _type,
 
   event = boost::make_shared<Event>(EventName::ZoneSensorValue, _group);
   event->setProperty("sensorType", _type);
-  event->setProperty("sensorValue", intToString(_value));
-  event->setProperty("sensorValueFloat", doubleToString(floatValue));
-  event->setProperty("originDSID", dsuid2str(_sourceDevice));
+  event->setProperty("sensorValue", _value);
+  event->setFloatProperty("sensorValueFloat", floatValue);
+  event->setProperty("originDSID", _sourceDevice);
   return event;
 }
 
@@ -266,11 +266,11 @@ createGroupCallSceneEvent(boost::shared_ptr<Group> _group, int _sceneID,
 {
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::CallScene, _group);
-  event->setProperty(ef_sceneID, intToString(_sceneID));
-  event->setProperty("groupID", intToString(_groupID));
-  event->setProperty("zoneID", intToString(_zoneID));
-  event->setProperty(ef_originDSUID, dsuid2str(_originDSUID));
-  event->setProperty(ef_callOrigin, intToString(_callOrigin));
+  event->setProperty(ef_sceneID, _sceneID);
+  event->setProperty("groupID", _groupID);
+  event->setProperty("zoneID", _zoneID);
+  event->setProperty(ef_originDSUID, _originDSUID);
+  event->setProperty(ef_callOrigin, _callOrigin);
   event->setProperty("originToken", _originToken);
   if (_forced) {
     event->setProperty(ef_forced, "true");
@@ -287,11 +287,11 @@ createGroupUndoSceneEvent(boost::shared_ptr<Group> _group, int _sceneID,
 {
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::UndoScene, _group);
-  event->setProperty(ef_sceneID, intToString(_sceneID));
-  event->setProperty("groupID", intToString(_groupID));
-  event->setProperty("zoneID", intToString(_zoneID));
-  event->setProperty(ef_originDSUID, dsuid2str(_originDSUID));
-  event->setProperty(ef_callOrigin, intToString(_callOrigin));
+  event->setProperty(ef_sceneID, _sceneID);
+  event->setProperty("groupID", _groupID);
+  event->setProperty("zoneID", _zoneID);
+  event->setProperty(ef_originDSUID, _originDSUID);
+  event->setProperty(ef_callOrigin, _callOrigin);
   event->setProperty("originToken", _originToken);
   return event;
 }
@@ -311,9 +311,9 @@ createStateChangeEvent(boost::shared_ptr<State> _state, int _oldstate,
 
   event->setProperty("statename", _state->getName());
   event->setProperty("state", _state->toString());
-  event->setProperty("value", intToString(_state->getState()));
-  event->setProperty("oldvalue", intToString(_oldstate));
-  event->setProperty(ef_callOrigin, intToString(_callOrigin));
+  event->setProperty("value", _state->getState());
+  event->setProperty("oldvalue", _oldstate);
+  event->setProperty(ef_callOrigin, _callOrigin);
   return event;
 }
 
@@ -366,33 +366,33 @@ createHeatingControllerConfig(int _zoneID, const dsuid_t &_ctrlDsuid,
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::HeatingControllerSetup);
 
-  event->setProperty("ZoneID", intToString(_zoneID));
-  event->setProperty("ControlDSUID", dsuid2str(_ctrlDsuid));
-  event->setProperty("ControlMode", intToString(static_cast<uint8_t>(_config.mode)));
-  event->setProperty("EmergencyValue", intToString(_config.EmergencyValue - 100));
+  event->setProperty("ZoneID", _zoneID);
+  event->setProperty("ControlDSUID", _ctrlDsuid);
+  event->setProperty("ControlMode", static_cast<uint8_t>(_config.mode));
+  event->setProperty("EmergencyValue", _config.EmergencyValue - 100);
   switch (_config.mode) {
     case HeatingControlMode::OFF:
       break;
     case HeatingControlMode::PID:
-      event->setProperty("CtrlKp", doubleToString((double)_config.Kp * 0.025));
-      event->setProperty("CtrlTs", intToString(_config.Ts));
-      event->setProperty("CtrlTi", intToString(_config.Ti));
-      event->setProperty("CtrlKd", intToString(_config.Kd));
-      event->setProperty("CtrlImin", doubleToString((double)_config.Imin * 0.025));
-      event->setProperty("CtrlImax", doubleToString((double)_config.Imax * 0.025));
-      event->setProperty("CtrlYmin", intToString(_config.Ymin - 100));
-      event->setProperty("CtrlYmax", intToString(_config.Ymax - 100));
+      event->setFloatProperty("CtrlKp", (double)_config.Kp * 0.025);
+      event->setProperty("CtrlTs", _config.Ts);
+      event->setProperty("CtrlTi", _config.Ti);
+      event->setProperty("CtrlKd", _config.Kd);
+      event->setFloatProperty("CtrlImin", (double)_config.Imin * 0.025);
+      event->setFloatProperty("CtrlImax", (double)_config.Imax * 0.025);
+      event->setProperty("CtrlYmin", _config.Ymin - 100);
+      event->setProperty("CtrlYmax", _config.Ymax - 100);
       event->setProperty("CtrlAntiWindUp", (_config.AntiWindUp > 0) ? "true" : "false");
       event->setProperty("CtrlKeepFloorWarm", (_config.KeepFloorWarm > 0) ? "true" : "false");
       break;
     case HeatingControlMode::ZONE_FOLLOWER:
-      event->setProperty("ReferenceZone", intToString(_config.SourceZoneId));
-      event->setProperty("CtrlOffset", intToString(_config.Offset));
+      event->setProperty("ReferenceZone", _config.SourceZoneId);
+      event->setProperty("CtrlOffset", _config.Offset);
       break;
     case HeatingControlMode::FIXED:
       break;
     case HeatingControlMode::MANUAL:
-      event->setProperty("ManualValue", intToString(_config.ManualValue - 100));
+      event->setProperty("ManualValue", _config.ManualValue - 100);
       break;
   }
   return event;
@@ -406,64 +406,64 @@ createHeatingControllerValue(int _zoneID, const dsuid_t &_ctrlDsuid,
     boost::shared_ptr<Event> event;
     event = boost::make_shared<Event>(EventName::HeatingControllerValue);
 
-    event->setProperty("ZoneID", intToString(_zoneID));
-    event->setProperty("ControlDSUID", dsuid2str(_ctrlDsuid));
+    event->setProperty("ZoneID", _zoneID);
+    event->setProperty("ControlDSUID", _ctrlDsuid);
     switch (_properties.m_mode) {
       case HeatingControlMode::OFF:
         break;
       case HeatingControlMode::PID:
-        event->setProperty("NominalTemperature_Off",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[0])));
-        event->setProperty("NominalTemperature_Comfort",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[1])));
-        event->setProperty("NominalTemperature_Economy",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[2])));
-        event->setProperty("NominalTemperature_NotUsed",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[3])));
-        event->setProperty("NominalTemperature_Night",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[4])));
-        event->setProperty("NominalTemperature_Holiday",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[5])));
-        event->setProperty("NominalTemperature_Cooling",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[6])));
-        event->setProperty("NominalTemperature_CoolingOff",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[7])));
-        event->setProperty("NominalTemperature_CoolingEconomy",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[8])));
-        event->setProperty("NominalTemperature_CoolingNotUsed",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[9])));
-        event->setProperty("NominalTemperature_CoolingNight",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[10])));
-        event->setProperty("NominalTemperature_CoolingHoliday",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[11])));
+        event->setFloatProperty("NominalTemperature_Off",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[0]));
+        event->setFloatProperty("NominalTemperature_Comfort",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[1]));
+        event->setFloatProperty("NominalTemperature_Economy",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[2]));
+        event->setFloatProperty("NominalTemperature_NotUsed",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[3]));
+        event->setFloatProperty("NominalTemperature_Night",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[4]));
+        event->setFloatProperty("NominalTemperature_Holiday",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[5]));
+        event->setFloatProperty("NominalTemperature_Cooling",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[6]));
+        event->setFloatProperty("NominalTemperature_CoolingOff",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[7]));
+        event->setFloatProperty("NominalTemperature_CoolingEconomy",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[8]));
+        event->setFloatProperty("NominalTemperature_CoolingNotUsed",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[9]));
+        event->setFloatProperty("NominalTemperature_CoolingNight",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[10]));
+        event->setFloatProperty("NominalTemperature_CoolingHoliday",
+            sensorValueToDouble(SensorType::RoomTemperatureSetpoint, _mode.opModes[11]));
         break;
       case HeatingControlMode::ZONE_FOLLOWER:
         break;
       case HeatingControlMode::FIXED:
-        event->setProperty("ControlValue_Off",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[0])));
-        event->setProperty("ControlValue_Comfort",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[1])));
-        event->setProperty("ControlValue_Economy",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[2])));
-        event->setProperty("ControlValue_NotUsed",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[3])));
-        event->setProperty("ControlValue_Night",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[4])));
-        event->setProperty("ControlValue_Holiday",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[5])));
-        event->setProperty("ControlValue_Cooling",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[6])));
-        event->setProperty("ControlValue_CoolingOff",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[7])));
-        event->setProperty("ControlValue_CoolingEconomy",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[8])));
-        event->setProperty("ControlValue_CoolingNotUsed",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[9])));
-        event->setProperty("ControlValue_CoolingNight",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[10])));
-        event->setProperty("ControlValue_CoolingHoliday",
-            doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[11])));
+        event->setFloatProperty("ControlValue_Off",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[0]));
+        event->setFloatProperty("ControlValue_Comfort",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[1]));
+        event->setFloatProperty("ControlValue_Economy",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[2]));
+        event->setFloatProperty("ControlValue_NotUsed",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[3]));
+        event->setFloatProperty("ControlValue_Night",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[4]));
+        event->setFloatProperty("ControlValue_Holiday",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[5]));
+        event->setFloatProperty("ControlValue_Cooling",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[6]));
+        event->setFloatProperty("ControlValue_CoolingOff",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[7]));
+        event->setFloatProperty("ControlValue_CoolingEconomy",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[8]));
+        event->setFloatProperty("ControlValue_CoolingNotUsed",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[9]));
+        event->setFloatProperty("ControlValue_CoolingNight",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[10]));
+        event->setFloatProperty("ControlValue_CoolingHoliday",
+            sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _mode.opModes[11]));
         break;
       case HeatingControlMode::MANUAL:
         break;
@@ -479,7 +479,7 @@ createHeatingControllerValueDsHub(int _zoneID, int _operationMode,
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::HeatingControllerValueDsHub);
 
-  event->setProperty("ZoneID", intToString(_zoneID));
+  event->setProperty("ZoneID", _zoneID);
   switch (_operationMode) {
   case 0: event->setProperty("OperationMode", "Off"); break;
   case 1: event->setProperty("OperationMode", "Comfort"); break;
@@ -494,14 +494,14 @@ createHeatingControllerValueDsHub(int _zoneID, int _operationMode,
     case HeatingControlMode::OFF:
       break;
     case HeatingControlMode::PID:
-      event->setProperty("NominalTemperature",
-          doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _stat.m_NominalValue.value_or(0))));
+      event->setFloatProperty("NominalTemperature",
+          sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _stat.m_NominalValue.value_or(0)));
       break;
     case HeatingControlMode::ZONE_FOLLOWER:
       break;
     case HeatingControlMode::FIXED:
-      event->setProperty("ControlValue",
-          doubleToString(sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _stat.m_ControlValue.value_or(0))));
+      event->setFloatProperty("ControlValue",
+          sensorValueToDouble(SensorType::RoomTemperatureControlVariable, _stat.m_ControlValue.value_or(0)));
       break;
     case HeatingControlMode::MANUAL:
       break;
@@ -515,9 +515,9 @@ boost::shared_ptr<Event>
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::HeatingControllerState);
 
-  event->setProperty("ZoneID", intToString(_zoneID));
-  event->setProperty("ControlDSUID", dsuid2str(_ctrlDsuid));
-  event->setProperty("ControlState", intToString(_ctrlState));
+  event->setProperty("ZoneID", _zoneID);
+  event->setProperty("ControlDSUID", _ctrlDsuid);
+  event->setProperty("ControlState", _ctrlState);
   return event;
 }
 
@@ -531,7 +531,7 @@ boost::shared_ptr<Event>
   event->setProperty("scriptID", _scriptId);
   event->setProperty("statename", _name);
   event->setProperty("state", _value);
-  event->setProperty(ef_callOrigin, intToString(static_cast<int>(_origin)));
+  event->setProperty(ef_callOrigin, static_cast<int>(_origin));
   return event;
 }
 
@@ -544,9 +544,9 @@ boost::shared_ptr<Event> createGenericSignalSunshine(const uint8_t &_value,
   assert(_value == 1 || _value == 2);
   assert(validOrigin(_origin));
   assert(valid(_direction));
-  event->setProperty("value", intToString(_value));
+  event->setProperty("value", _value);
   event->setProperty("direction", toString(_direction));
-  event->setProperty(ef_callOrigin, intToString(static_cast<int>(_origin)));
+  event->setProperty(ef_callOrigin, static_cast<int>(_origin));
   return event;
 }
 
@@ -558,8 +558,8 @@ boost::shared_ptr<Event>
   // value: {active=1, inactive=2}
   assert(_value == 1 || _value == 2);
   assert(validOrigin(_origin));
-  event->setProperty("value", intToString(_value));
-  event->setProperty(ef_callOrigin, intToString(static_cast<int>(_origin)));
+  event->setProperty("value", _value);
+  event->setProperty(ef_callOrigin, static_cast<int>(_origin));
   return event;
 }
 
@@ -569,8 +569,8 @@ boost::shared_ptr<Event>
   event = boost::make_shared<Event>(EventName::HeatingModeSwitch);
 
   assert(validOrigin(_origin));
-  event->setProperty("value", intToString(static_cast<int>(value)));
-  event->setProperty(ef_callOrigin, intToString(static_cast<int>(_origin)));
+  event->setProperty("value", static_cast<int>(value));
+  event->setProperty(ef_callOrigin, static_cast<int>(_origin));
   return event;
 }
 
@@ -582,8 +582,8 @@ boost::shared_ptr<Event>
   // value: {active=1, inactive=2}
   assert(_value == 1 || _value == 2);
   assert(validOrigin(_origin));
-  event->setProperty("value", intToString(_value));
-  event->setProperty(ef_callOrigin, intToString(static_cast<int>(_origin)));
+  event->setProperty("value", _value);
+  event->setProperty(ef_callOrigin, static_cast<int>(_origin));
   return event;
 }
 
@@ -592,10 +592,10 @@ createOperationLockEvent(boost::shared_ptr<Group> _group, const int _zoneID, con
     const bool _lock, callOrigin_t _origin) {
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::OperationLock, _group);
-  event->setProperty("zoneID", intToString(_zoneID));
-  event->setProperty("groupID", intToString(_groupID));
-  event->setProperty("lock", intToString(_lock));
-  event->setProperty(ef_callOrigin, intToString(static_cast<int>(_origin)));
+  event->setProperty("zoneID", _zoneID);
+  event->setProperty("groupID", _groupID);
+  event->setProperty("lock", _lock);
+  event->setProperty(ef_callOrigin, static_cast<int>(_origin));
   return event;
 }
 
@@ -604,10 +604,10 @@ createClusterConfigLockEvent(boost::shared_ptr<Group> _group, const int _zoneID,
     const bool _lock, callOrigin_t _origin) {
   boost::shared_ptr<Event> event;
   event = boost::make_shared<Event>(EventName::ClusterConfigLock, _group);
-  event->setProperty("zoneID", intToString(_zoneID));
-  event->setProperty("groupID", intToString(_groupID));
-  event->setProperty("lock", intToString(_lock));
-  event->setProperty(ef_callOrigin, intToString(static_cast<int>(_origin)));
+  event->setProperty("zoneID", _zoneID);
+  event->setProperty("groupID", _groupID);
+  event->setProperty("lock", _lock);
+  event->setProperty(ef_callOrigin, static_cast<int>(_origin));
   return event;
 }
 
@@ -0,0 +1,210 @@
+/*
+ *  Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+ *
+ *  This file is part of digitalSTROM Server.
+ *
+ *  digitalSTROM Server is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  digitalSTROM Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/event/event_payload.h"
+
+#include <stdexcept>
+
+#include "src/base.h"
+#include "src/foreach.h"
+#include "src/event/event_fields.h"
+
+namespace dss {
+
+  //================================================== EventPayload::Entry
+
+  std::string EventPayload::Entry::getValue() const {
+    switch (m_Type) {
+    case vtInt:
+      return intToString(m_Int);
+    case vtDouble:
+      return doubleToString(m_Double);
+    case vtDSUID:
+      return dsuid2str(m_DSUID);
+    case vtString:
+    default:
+      return m_String;
+    }
+  } // getValue
+
+  //================================================== EventPayload
+
+  static const std::string* const kWellKnownKeys[] = {
+    &ef_callOrigin, &ef_originDSUID, &ef_zone, &ef_group, &ef_scene,
+    &ef_sceneID, &ef_dsuid, &ef_forced, &ef_sensorEvent, &ef_sensorIndex,
+    &ef_eventid, &ef_evt
+  };
+
+  const std::string* EventPayload::wellKnownKey(const std::string& _key) {
+    // callers mostly pass the constant itself
+    foreach (const std::string* key, kWellKnownKeys) {
+      if (key == &_key) {
+        return key;
+      }
+    }
+    foreach (const std::string* key, kWellKnownKeys) {
+      if (*key == _key) {
+        return key;
+      }
+    }
+    return NULL;
+  } // wellKnownKey
+
+  const EventPayload::Entry* EventPayload::find(const std::string& _key) const {
+    foreach (const Entry& entry, m_Entries) {
+      if ((entry.m_Key == &_key) || (entry.getKey() == _key)) {
+        return &entry;
+      }
+    }
+    return NULL;
+  } // find
+
+  EventPayload::Entry& EventPayload::entryFor(const std::string& _key) {
+    Entry* entry = const_cast<Entry*>(find(_key));
+    if (entry == NULL) {
+      m_Entries.push_back(Entry());
+      entry = &m_Entries.back();
+      entry->m_Key = wellKnownKey(_key);
+      if (entry->m_Key == NULL) {
+        entry->m_OwnKey = _key;
+      }
+    }
+    return *entry;
+  } // entryFor
+
+  bool EventPayload::has(const std::string& _key) const {
+    return find(_key) != NULL;
+  } // has
+
+  void EventPayload::set(const std::string& _key, const std::string& _value) {
+    Entry& entry = entryFor(_key);
+    entry.m_Type = vtString;
+    entry.m_String = _value;
+  } // set
+
+  void EventPayload::setInt(const std::string& _key, int _value) {
+    Entry& entry = entryFor(_key);
+    entry.m_Type = vtInt;
+    entry.m_Int = _value;
+    entry.m_String.clear();
+  } // setInt
+
+  void EventPayload::setDouble(const std::string& _key, double _value) {
+    Entry& entry = entryFor(_key);
+    entry.m_Type = vtDouble;
+    entry.m_Double = _value;
+    entry.m_String.clear();
+  } // setDouble
+
+  void EventPayload::setDSUID(const std::string& _key, const dsuid_t& _value) {
+    Entry& entry = entryFor(_key);
+    entry.m_Type = vtDSUID;
+    entry.m_DSUID = _value;
+    entry.m_String.clear();
+  } // setDSUID
+
+  void EventPayload::set(const Entry& _entry) {
+    Entry& entry = entryFor(_entry.getKey());
+    entry = _entry;
+  } // set(entry)
+
+  std::string EventPayload::get(const std::string& _key) const {
+    const Entry* entry = find(_key);
+    if (entry == NULL) {
+      throw std::runtime_error(std::string("could not find value for '") + _key + "' in properties");
+    }
+    return entry->getValue();
+  } // get
+
+  std::string EventPayload::get(const std::string& _key, const std::string& _default) const {
+    const Entry* entry = find(_key);
+    if (entry == NULL) {
+      return _default;
+    }
+    return entry->getValue();
+  } // get(with default)
+
+  int EventPayload::getInt(const std::string& _key, int _default) const {
+    const Entry* entry = find(_key);
+    if (entry == NULL) {
+      return _default;
+    }
+    switch (entry->m_Type) {
+    case vtInt:
+      return entry->m_Int;
+    case vtString:
+      return strToIntDef(entry->m_String, _default);
+    default:
+      return strToIntDef(entry->getValue(), _default);
+    }
+  } // getInt
+
+  double EventPayload::getDouble(const std::string& _key, double _default) const {
+    const Entry* entry = find(_key);
+    if (entry == NULL) {
+      return _default;
+    }
+    switch (entry->m_Type) {
+    case vtDouble:
+      return entry->m_Double;
+    case vtInt:
+      return entry->m_Int;
+    case vtString:
+      return strToDouble(entry->m_String, _default);
+    default:
+      return _default;
+    }
+  } // getDouble
+
+  dsuid_t EventPayload::getDSUID(const std::string& _key, const dsuid_t& _default) const {
+    const Entry* entry = find(_key);
+    if (entry == NULL) {
+      return _default;
+    }
+    if (entry->m_Type == vtDSUID) {
+      return entry->m_DSUID;
+    }
+    dsuid_t result;
+    if (::dsuid_from_string(entry->getValue().c_str(), &result) != DSUID_RC_OK) {
+      return _default;
+    }
+    return result;
+  } // getDSUID
+
+  bool EventPayload::unset(const std::string& _key) {
+    for (Entries::iterator it = m_Entries.begin(); it != m_Entries.end(); ++it) {
+      if (it->getKey() == _key) {
+        m_Entries.erase(it);
+        return true;
+      }
+    }
+    return false;
+  } // unset
+
+  std::string EventPayload::toString() const {
+    std::string ret;
+    const char *delim = "";
+    foreach (const Entry& entry, m_Entries) {
+      ret += delim + entry.getKey() + ":" + entry.getValue();
+      delim = " ";
+    }
+    return ret;
+  } // toString
+
+} // namespace dss
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+ *
+ *  This file is part of digitalSTROM Server.
+ *
+ *  digitalSTROM Server is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  digitalSTROM Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __EVENT_PAYLOAD___
+#define __EVENT_PAYLOAD___
+
+#include <string>
+
+#include <boost/container/small_vector.hpp>
+#include "src/ds485types.h"
+
+namespace dss {
+
+  /** Parameters of an event.
+   * The well known parameter names (the ef_* constants) are stored as a
+   * pointer to the constant, any other name is copied into its entry.
+   * Values keep the type they were set with and are rendered as
+   * string only when asked for, e.g. for JavaScript or JSON, in the same
+   * format intToString, doubleToString and dsuid2str produce. Entries live
+   * in a small inline vector in the order they were first set. */
+  class EventPayload {
+  public:
+    typedef enum {
+      vtString,
+      vtInt,
+      vtDouble,
+      vtDSUID
+    } ValueType;
+
+    class Entry {
+    public:
+      const std::string& getKey() const { return (m_Key != NULL) ? *m_Key : m_OwnKey; }
+      ValueType getType() const { return m_Type; }
+      /** The value as string, as it used to be stored */
+      std::string getValue() const;
+    private:
+      friend class EventPayload;
+      /** One of the ef_* constants, NULL if the key is in m_OwnKey */
+      const std::string* m_Key;
+      std::string m_OwnKey;
+      ValueType m_Type;
+      union {
+        int m_Int;
+        double m_Double;
+        dsuid_t m_DSUID;
+      };
+      std::string m_String;
+    }; // Entry
+
+    typedef boost::container::small_vector<Entry, 8> Entries;
+
+    bool has(const std::string& _key) const;
+    void set(const std::string& _key, const std::string& _value);
+    void setInt(const std::string& _key, int _value);
+    void setDouble(const std::string& _key, double _value);
+    void setDSUID(const std::string& _key, const dsuid_t& _value);
+    /** Copies \a _entry of another payload, keeping its type */
+    void set(const Entry& _entry);
+    /** throws std::runtime_error if \a _key is not set */
+    std::string get(const std::string& _key) const;
+    std::string get(const std::string& _key, const std::string& _default) const;
+    /** Typed access, string values get parsed, \a _default is returned for
+      * missing or unparsable values */
+    int getInt(const std::string& _key, int _default) const;
+    double getDouble(const std::string& _key, double _default) const;
+    dsuid_t getDSUID(const std::string& _key, const dsuid_t& _default) const;
+
+    bool unset(const std::string& _key);
+
+    const Entries& getEntries() const { return m_Entries; }
+    bool empty() const { return m_Entries.empty(); }
+    std::string toString() const;
+
+    /** The ef_* constant equal to \a _key or NULL */
+    static const std::string* wellKnownKey(const std::string& _key);
+  private:
+    const Entry* find(const std::string& _key) const;
+    Entry& entryFor(const std::string& _key);
+
+    Entries m_Entries;
+  }; // EventPayload
+
+} // namespace dss
+
+#endif
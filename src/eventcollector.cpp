@@ -28,40 +28,120 @@
 
 #include "eventcollector.h"
 
+#include <algorithm>
+
+#include <boost/make_shared.hpp>
+
+#include "src/foreach.h"
+
 namespace dss {
 
-  EventCollector::EventCollector(EventInterpreterInternalRelay& _relay) : EventRelayTarget(_relay) {}
+  static size_t estimateEventSize(const Event& _event) {
+    size_t result = sizeof(Event) + _event.getName().size();
+    foreach (auto&& param, _event.getProperties().getEntries()) {
+      result += sizeof(EventPayload::Entry) + param.getValue().size();
+    }
+    return result;
+  } // estimateEventSize
+
+  EventCollector::EventCollector(EventInterpreterInternalRelay& _relay,
+                                 size_t _capacity, size_t _maxBytes)
+  : EventRelayTarget(_relay),
+    m_PendingEvents(std::max(_capacity, (size_t)1)),
+    m_PendingSizes(std::max(_capacity, (size_t)1)),
+    m_PendingBytes(0),
+    m_MaxBytes(_maxBytes),
+    m_Dropped(0),
+    m_EventArrivedToken(0)
+  { }
 
   bool EventCollector::hasEvent() {
+    boost::mutex::scoped_lock lock(m_PendingEventsMutex);
     return !m_PendingEvents.empty();
   }
 
+  size_t EventCollector::getPendingCount() {
+    boost::mutex::scoped_lock lock(m_PendingEventsMutex);
+    return m_PendingEvents.size();
+  } // getPendingCount
+
+  size_t EventCollector::getPendingBytes() {
+    boost::mutex::scoped_lock lock(m_PendingEventsMutex);
+    return m_PendingBytes;
+  } // getPendingBytes
+
+  void EventCollector::dropOldest() {
+    m_PendingBytes -= m_PendingSizes.front();
+    m_PendingSizes.pop_front();
+    m_PendingEvents.pop_front();
+    m_Dropped++;
+  } // dropOldest
+
   void EventCollector::handleEvent(Event& _event, const EventSubscription& _subscription) {
+    boost::shared_ptr<const Event> event;
+    try {
+      event = _event.shared_from_this();
+    } catch (boost::bad_weak_ptr&) {
+      // not owned by a shared_ptr, keep a copy
+      event = boost::make_shared<Event>(_event);
+    }
+    size_t size = estimateEventSize(*event);
+
+    boost::function<void()> callback;
     {
       boost::mutex::scoped_lock lock(m_PendingEventsMutex);
-      m_PendingEvents.push_back(_event);
+      if (m_PendingEvents.full()) {
+        dropOldest();
+      }
+      while (!m_PendingEvents.empty() && (m_PendingBytes + size > m_MaxBytes)) {
+        dropOldest();
+      }
+      m_PendingEvents.push_back(event);
+      m_PendingSizes.push_back(size);
+      m_PendingBytes += size;
+      callback = m_EventArrivedCallback;
     }
     m_EventArrived.signal();
+    if (callback) {
+      callback();
+    }
   } // handleEvent
 
+  unsigned EventCollector::setEventArrivedCallback(boost::function<void()> _callback) {
+    boost::mutex::scoped_lock lock(m_PendingEventsMutex);
+    m_EventArrivedCallback = _callback;
+    return ++m_EventArrivedToken;
+  } // setEventArrivedCallback
+
+  void EventCollector::clearEventArrivedCallback(unsigned _token) {
+    boost::mutex::scoped_lock lock(m_PendingEventsMutex);
+    // a newer request of the same subscription may have taken over
+    if (m_EventArrivedToken == _token) {
+      m_EventArrivedCallback.clear();
+    }
+  } // clearEventArrivedCallback
+
   bool EventCollector::waitForEvent(const int _timeoutMS) {
-    if(m_PendingEvents.empty()) {
+    if(!hasEvent()) {
       if(_timeoutMS == 0) {
         m_EventArrived.waitFor();
       } else if(_timeoutMS > 0) {
         m_EventArrived.waitFor(_timeoutMS);
       }
     }
-    return !m_PendingEvents.empty();
+    return hasEvent();
   } // waitForEvent
 
-  Event EventCollector::popEvent() {
-    Event result;
+  int EventCollector::popAll(std::vector<boost::shared_ptr<const Event> >& _events) {
     boost::mutex::scoped_lock lock(m_PendingEventsMutex);
-    result = m_PendingEvents.front();
-    m_PendingEvents.erase(m_PendingEvents.begin());
-    return result;
-  } // popEvent
+    _events.insert(_events.end(), m_PendingEvents.begin(), m_PendingEvents.end());
+    m_PendingEvents.clear();
+    m_PendingSizes.clear();
+    m_PendingBytes = 0;
+    int dropped = m_Dropped;
+    m_Dropped = 0;
+    return dropped;
+  } // popAll
 
   std::string EventCollector::subscribeTo(const std::string& _eventName) {
     boost::shared_ptr<EventSubscription> subscription(
@@ -25,32 +25,62 @@
 #define __EVENT_COLLECTOR_H__
 
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/circular_buffer.hpp>
 #include <vector>
 #include <string>
 
 #include "src/eventinterpreterplugins.h"
 #include "src/syncevent.h"
 
+#define EVENT_COLLECTOR_CAPACITY 1000
+#define EVENT_COLLECTOR_MAX_BYTES (1024 * 1024)
 
 namespace dss {
 
+  /** Collects the events of a subscription until a client fetches them.
+    * Events are shared with the interpreter, not copied. The buffer is
+    * bounded by event count and estimated size, when it overflows the
+    * oldest events are dropped and counted. */
   class EventCollector : public EventRelayTarget {
   public:
-    EventCollector(EventInterpreterInternalRelay& _relay);
+    EventCollector(EventInterpreterInternalRelay& _relay,
+                   size_t _capacity = EVENT_COLLECTOR_CAPACITY,
+                   size_t _maxBytes = EVENT_COLLECTOR_MAX_BYTES);
 
     virtual void handleEvent(Event& _event, const EventSubscription& _subscription);
 
     bool waitForEvent(const int _timeoutMS);
-    Event popEvent();
+    /** Moves all pending events to \a _events, oldest first. Returns the
+      * number of events dropped since the last call. */
+    int popAll(std::vector<boost::shared_ptr<const Event> >& _events);
     bool hasEvent();
+    size_t getPendingCount();
+    /** Estimated memory held by the pending events, shared events are
+      * accounted in full by every collector holding them */
+    size_t getPendingBytes();
+    /** \a _callback gets called from the event interpreter after an
+      * event was queued. Replaces any previous callback, the returned
+      * token identifies this one for clearEventArrivedCallback. */
+    unsigned setEventArrivedCallback(boost::function<void()> _callback);
+    /** Removes the callback if it is still the one \a _token belongs to */
+    void clearEventArrivedCallback(unsigned _token);
 
     using EventRelayTarget::subscribeTo;
     virtual std::string subscribeTo(const std::string& _eventName);
   private:
+    void dropOldest();
+
     SyncEvent m_EventArrived;
     boost::mutex m_PendingEventsMutex;
-    std::vector<Event> m_PendingEvents;
+    boost::circular_buffer<boost::shared_ptr<const Event> > m_PendingEvents;
+    boost::circular_buffer<size_t> m_PendingSizes;
+    size_t m_PendingBytes;
+    const size_t m_MaxBytes;
+    int m_Dropped;
+    boost::function<void()> m_EventArrivedCallback;
+    unsigned m_EventArrivedToken;
   }; // EventCollector
 
 } // dss namespace
@@ -307,6 +307,9 @@ namespace dss {
       (*ipScriptContextWrapper)->get()->detachWrapper();
       ipScriptContextWrapper = m_WrappedContexts.erase(ipScriptContextWrapper);
     }
+    if (m_pContextPool != NULL) {
+      m_pContextPool->clear();
+    }
     log("All scripts Terminated", lsInfo);
   }
 
@@ -341,7 +344,12 @@ namespace dss {
         stopWatch.setSubscriptionName(scriptID);
       }
 
-      boost::shared_ptr<ScriptContext> ctx(m_pEnvironment->getContext());
+      // contexts are pooled per subscription, they keep its compiled scripts
+      bool pooled = false;
+      boost::shared_ptr<ScriptContext> ctx = m_pContextPool->acquire(_subscription.getID(), pooled);
+      if (timingEnabled) {
+        stopWatch.setContextPooled(pooled);
+      }
       boost::shared_ptr<ScriptContextWrapper> wrapper
         (new ScriptContextWrapper(ctx, m_pScriptRootNode, scriptID, uniqueNode));
       ctx->attachWrapper(wrapper);
@@ -432,10 +440,10 @@ namespace dss {
 
         // add raisedEvent.parameter
         ScriptObject param(*ctx, NULL);
-        foreach (auto&& elt, _event.getProperties().getContainer()) {
-          Logger::getInstance()->log("JavaScript Event Handler: setting parameter " + elt.first +
-                                      " to " + elt.second);
-          param.setProperty<const std::string&>(elt.first, elt.second);
+        foreach (auto&& elt, _event.getProperties().getEntries()) {
+          Logger::getInstance()->log("JavaScript Event Handler: setting parameter " + elt.getKey() +
+                                      " to " + elt.getValue());
+          param.setProperty<const std::string&>(elt.getKey(), elt.getValue());
         }
         raisedEvent.setProperty("parameter", &param);
 
@@ -479,6 +487,10 @@ namespace dss {
 
           ctx->evaluateScript<void>(scriptName);
 
+          if (timingEnabled) {
+            stopWatch.setScriptCached(ctx->wasLastScriptCached());
+          }
+
         } catch(ScriptException& ex) {
           Logger::getInstance()->log(
               std::string("JavaScript Event Handler: "
@@ -519,6 +531,7 @@ namespace dss {
       } else {
         ctx->detachWrapper();
         wrapper->destroy();
+        m_pContextPool->release(_subscription.getID(), ctx);
       }
 
       if (timingEnabled) {
@@ -577,6 +590,8 @@ namespace dss {
       m_pEnvironment.reset(new ScriptEnvironment());
       m_pEnvironment->initialize();
     }
+    m_pContextPool.reset(new ScriptContextPool(*m_pEnvironment,
+                                               std::max(m_pEnvironment->getContextPoolSize(), 0)));
   } // initializeEnvironment
 
   void EventInterpreterPluginJavascript::setupCleanupEvent() {
@@ -989,8 +1004,8 @@ namespace dss {
       return;
     }
 
-    foreach (auto&& elt, _event.getProperties().getContainer()) {
-      Logger::getInstance()->log(" name " + elt.first + " : " + elt.second);
+    foreach (auto&& elt, _event.getProperties().getEntries()) {
+      Logger::getInstance()->log(" name " + elt.getKey() + " : " + elt.getValue());
     }
 
     WebserviceMsHub::ChangeType type;
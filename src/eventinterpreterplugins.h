@@ -57,6 +57,7 @@ namespace dss {
     __DECL_LOG_CHANNEL__
   private:
     boost::shared_ptr<ScriptEnvironment> m_pEnvironment;
+    boost::shared_ptr<ScriptContextPool> m_pContextPool;
     boost::shared_ptr<InternalEventRelayTarget> m_pRelayTarget;
     static const std::string kCleanupScriptsEventName;
     PropertyNodePtr m_pScriptRootNode;
@@ -71,6 +72,7 @@ namespace dss {
     ~EventInterpreterPluginJavascript();
 
     virtual void handleEvent(Event& _event, const EventSubscription& _subscription);
+    virtual std::string getDispatchLane() const { return getName(); }
   }; // EventInterpreterPluginJavascript
 
   //-------------------------------------------------- Event Relay
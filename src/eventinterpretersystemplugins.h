@@ -75,6 +75,7 @@ namespace dss {
       EventInterpreterPluginSystemTrigger(EventInterpreter* _pInterpreter);
       virtual ~EventInterpreterPluginSystemTrigger();
       virtual void handleEvent(Event& _event, const EventSubscription& _subscription);
+      virtual std::string getDispatchLane() const { return getName(); }
   };
 
   class EventInterpreterPluginSystemEventLog :
@@ -83,9 +83,9 @@ namespace dss {
     assert(m_pEventCollector != NULL);
   }
 
-  Event EventSubscriptionSession::popEvent() {
+  int EventSubscriptionSession::popAll(std::vector<boost::shared_ptr<const Event> >& _events) {
     createCollector();
-    return m_pEventCollector->popEvent();
+    return m_pEventCollector->popAll(_events);
   }
 
   bool EventSubscriptionSession::hasEvent() {
@@ -93,9 +93,24 @@ namespace dss {
     return m_pEventCollector->hasEvent();
   }
 
+  size_t EventSubscriptionSession::getPendingBytes() {
+    createCollector();
+    return m_pEventCollector->getPendingBytes();
+  }
+
   bool EventSubscriptionSession::waitForEvent(const int _timeoutMS) {
     createCollector();
     return m_pEventCollector->waitForEvent(_timeoutMS);
   }
 
+  unsigned EventSubscriptionSession::setEventArrivedCallback(boost::function<void()> _callback) {
+    createCollector();
+    return m_pEventCollector->setEventArrivedCallback(_callback);
+  }
+
+  void EventSubscriptionSession::clearEventArrivedCallback(unsigned _token) {
+    createCollector();
+    m_pEventCollector->clearEventArrivedCallback(_token);
+  }
+
 } // namespace dss
@@ -26,9 +26,11 @@
 #include <map>
 #include <deque>
 #include <string>
+#include <vector>
 
 #include <boost/shared_array.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
 
 #include "dssfwd.h"
 
@@ -44,12 +46,30 @@ namespace dss {
 
     std::string subscribe(const std::string& _eventName);
     void unsubscribe(const std::string& _eventName);
-    Event popEvent();
+    /**
+     * moves all pending events to _events, returns the number of events
+     * dropped since the last call because the client didn't keep up
+     */
+    int popAll(std::vector<boost::shared_ptr<const Event> >& _events);
     bool hasEvent();
+    /**
+     * estimated memory held by events waiting to be fetched
+     */
+    size_t getPendingBytes();
     /**
      * blocks if no events are available
      */
     bool waitForEvent(const int _timeoutMS);
+    /**
+     * _callback is called whenever an event arrives, used to resume
+     * parked long-poll requests instead of blocking in waitForEvent.
+     * Returns a token for clearEventArrivedCallback.
+     */
+    unsigned setEventArrivedCallback(boost::function<void()> _callback);
+    /**
+     * removes the callback unless another one was set after _token's
+     */
+    void clearEventArrivedCallback(unsigned _token);
     const std::string& subscriptionId() const { return m_subscription_id; }
   private:
     boost::shared_ptr<EventCollector> m_pEventCollector;
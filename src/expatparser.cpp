@@ -25,19 +25,353 @@
 #endif
 
 #include <sstream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <climits>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include "expatparser.h"
+#include "base.h"
+#include "foreach.h"
 #include "logger.h"
 
 #define XML_PARSER_BUFFER_SIZE 256
 
+#define XML_SNAPSHOT_VERSION 2
+#define XML_SNAPSHOT_MAGIC "DSSXSNAP"
+
 namespace dss {
     
-  ExpatParser::ExpatParser() : m_forceStop(false) {}
+  /* A snapshot is the header below, the name of the parsed file and the
+   * recorded callbacks:
+   *   'S' <uint16 attribute count> name\0 (key\0 value\0)*
+   *   'E' name\0
+   *   'C' <int32 length> data
+   * All strings are stored NUL terminated, so the replay hands out pointers
+   * into the loaded buffer without copying. */
+  struct SnapshotHeader {
+    char m_Magic[8];
+    uint32_t m_Version;
+    uint32_t m_PayloadCRC;
+    uint64_t m_PayloadSize;
+    // identity of the parsed file, the snapshot is stale once it differs
+    uint64_t m_FileSize;
+    uint64_t m_FileInode;
+    int64_t m_FileMTimeSec;
+    int64_t m_FileMTimeNSec;
+    uint64_t m_FileNameSize;
+  }; // SnapshotHeader
+
+  enum {
+    SnapshotElementStart = 'S',
+    SnapshotElementEnd = 'E',
+    SnapshotCharacterData = 'C'
+  };
+
+  static boost::mutex s_snapshotMutex;
+  static std::string s_snapshotDirectory;
+
+  static bool getFileIdentity(const std::string& _fileName, SnapshotHeader& _header) {
+    struct stat st;
+    if (stat(_fileName.c_str(), &st) != 0) {
+      return false;
+    }
+    _header.m_FileSize = st.st_size;
+    _header.m_FileInode = st.st_ino;
+    _header.m_FileMTimeSec = st.st_mtim.tv_sec;
+    _header.m_FileMTimeNSec = st.st_mtim.tv_nsec;
+    return true;
+  } // getFileIdentity
+
+  static bool isSameFile(const SnapshotHeader& _a, const SnapshotHeader& _b) {
+    return (_a.m_FileSize == _b.m_FileSize) &&
+           (_a.m_FileInode == _b.m_FileInode) &&
+           (_a.m_FileMTimeSec == _b.m_FileMTimeSec) &&
+           (_a.m_FileMTimeNSec == _b.m_FileMTimeNSec);
+  } // isSameFile
+
+  template <typename T>
+  static void appendRaw(std::string& _buffer, const T _value) {
+    _buffer.append(reinterpret_cast<const char*>(&_value), sizeof(_value));
+  } // appendRaw
+
+  // returns the NUL terminated string at _pos and moves past it
+  static const char* takeString(const std::vector<char>& _buffer, size_t& _pos) {
+    if (_pos >= _buffer.size()) {
+      return NULL;
+    }
+    const void* end = memchr(&_buffer[_pos], '\0', _buffer.size() - _pos);
+    if (end == NULL) {
+      return NULL;
+    }
+    const char* result = &_buffer[_pos];
+    _pos = static_cast<const char*>(end) - &_buffer[0] + 1;
+    return result;
+  } // takeString
+
+  // reads the header and the name of the parsed file of a snapshot
+  static bool readSnapshotHeader(std::ifstream& _ifs, SnapshotHeader& _header,
+                                 std::string& _fileName) {
+    if (!_ifs || !_ifs.read(reinterpret_cast<char*>(&_header), sizeof(_header))) {
+      return false;
+    }
+    if ((memcmp(_header.m_Magic, XML_SNAPSHOT_MAGIC, sizeof(_header.m_Magic)) != 0) ||
+        (_header.m_Version != XML_SNAPSHOT_VERSION) ||
+        (_header.m_FileNameSize == 0) || (_header.m_FileNameSize > PATH_MAX)) {
+      return false;
+    }
+    _fileName.resize(_header.m_FileNameSize);
+    return _ifs.read(&_fileName[0], _fileName.size()).good();
+  } // readSnapshotHeader
+
+  ExpatParser::ExpatParser() : m_forceStop(false), m_recordSnapshot(false) {}
+
+  void ExpatParser::setSnapshotDirectory(const std::string& _directory) {
+    boost::mutex::scoped_lock lock(s_snapshotMutex);
+    s_snapshotDirectory = _directory.empty() ? _directory : addTrailingBackslash(_directory);
+  } // setSnapshotDirectory
+
+  std::string ExpatParser::getSnapshotDirectory() {
+    boost::mutex::scoped_lock lock(s_snapshotMutex);
+    return s_snapshotDirectory;
+  } // getSnapshotDirectory
+
+  std::string ExpatParser::getSnapshotFileName(const std::string& _fileName) {
+    std::string directory = getSnapshotDirectory();
+    if (directory.empty()) {
+      return "";
+    }
+    // the hash tells apart equally named files of different directories
+    boost::crc_32_type crc;
+    crc.process_bytes(_fileName.data(), _fileName.size());
+    return directory + boost::filesystem::path(_fileName).filename().string() +
+           "-" + uintToString(crc.checksum(), true) + ".snap";
+  } // getSnapshotFileName
+
+  void ExpatParser::removeOrphanedSnapshots() {
+    std::string directory = getSnapshotDirectory();
+    boost::system::error_code ec;
+    if (directory.empty() || !boost::filesystem::is_directory(directory, ec)) {
+      return;
+    }
+
+    std::vector<boost::filesystem::path> orphans;
+    boost::filesystem::directory_iterator end;
+    for (boost::filesystem::directory_iterator it(directory, ec); !ec && (it != end); it.increment(ec)) {
+      const boost::filesystem::path& path = it->path();
+      if (path.extension() != ".snap") {
+        // leftovers of an interrupted saveSnapshot()
+        if (path.extension() == ".tmp") {
+          orphans.push_back(path);
+        }
+        continue;
+      }
+      // snapshots of files that are gone or changed since will never be
+      // replayed, the loaders overwrite the ones of files they still read
+      std::ifstream ifs(path.string().c_str(), std::ios::binary);
+      SnapshotHeader header;
+      std::string parsedFile;
+      SnapshotHeader current;
+      if (!readSnapshotHeader(ifs, header, parsedFile) ||
+          (getSnapshotFileName(parsedFile) != path.string()) ||
+          !getFileIdentity(parsedFile, current) ||
+          !isSameFile(header, current)) {
+        orphans.push_back(path);
+      }
+    }
+
+    foreach (const boost::filesystem::path& path, orphans) {
+      boost::filesystem::remove(path, ec);
+    }
+    if (!orphans.empty()) {
+      Logger::getInstance()->log("ExpatParser::removeOrphanedSnapshots: removed " +
+                                 intToString(orphans.size()) + " snapshots", lsInfo);
+    }
+  } // removeOrphanedSnapshots
+
+  bool ExpatParser::parseFileWithSnapshot(const std::string& _fileName) {
+    bool result;
+    if (replaySnapshot(_fileName, result)) {
+      return result;
+    }
+
+    SnapshotHeader before;
+    bool record = m_recordSnapshot;
+    m_recordSnapshot = !getSnapshotDirectory().empty() &&
+                       getFileIdentity(_fileName, before);
+    result = parseFile(_fileName);
+    if (m_recordSnapshot) {
+      // don't keep a snapshot of a file that was replaced while parsing it,
+      // nor an outdated one of a file that doesn't parse anymore
+      SnapshotHeader after;
+      if (!result || !getFileIdentity(_fileName, after) ||
+          !isSameFile(before, after) || !saveSnapshot(_fileName)) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(getSnapshotFileName(_fileName), ec);
+      }
+    }
+    m_recordSnapshot = record;
+    m_recording.clear();
+    return result;
+  } // parseFileWithSnapshot
+
+  bool ExpatParser::saveSnapshot(const std::string& _fileName) {
+    std::string snapshotFile = getSnapshotFileName(_fileName);
+    if (snapshotFile.empty() || m_recording.empty()) {
+      return false;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_Magic, XML_SNAPSHOT_MAGIC, sizeof(header.m_Magic));
+    header.m_Version = XML_SNAPSHOT_VERSION;
+    header.m_PayloadSize = m_recording.size();
+    boost::crc_32_type crc;
+    crc.process_bytes(m_recording.data(), m_recording.size());
+    header.m_PayloadCRC = crc.checksum();
+    header.m_FileNameSize = _fileName.size();
+    if (!getFileIdentity(_fileName, header)) {
+      return false;
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(getSnapshotDirectory(), ec);
+
+    std::string tmpOut = snapshotFile + ".tmp";
+    std::ofstream ofs(tmpOut.c_str(), std::ios::binary | std::ios::trunc);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(_fileName.data(), _fileName.size());
+    ofs.write(m_recording.data(), m_recording.size());
+    ofs.close();
+    m_recording.clear();
+
+    if (!ofs || (rename(tmpOut.c_str(), snapshotFile.c_str()) != 0)) {
+      Logger::getInstance()->log("ExpatParser::saveSnapshot: could not write "
+                                 "snapshot " + snapshotFile, lsWarning);
+      boost::filesystem::remove(tmpOut, ec);
+      return false;
+    }
+    return true;
+  } // saveSnapshot
+
+  bool ExpatParser::replaySnapshot(const std::string& _fileName, bool& _result) {
+    std::string snapshotFile = getSnapshotFileName(_fileName);
+    SnapshotHeader current;
+    if (snapshotFile.empty() || !getFileIdentity(_fileName, current)) {
+      return false;
+    }
+
+    std::ifstream ifs(snapshotFile.c_str(), std::ios::binary);
+    SnapshotHeader header;
+    std::string parsedFile;
+    if (!readSnapshotHeader(ifs, header, parsedFile) ||
+        (parsedFile != _fileName) ||
+        !isSameFile(header, current) ||
+        (header.m_PayloadSize == 0) ||
+        (header.m_PayloadSize > 16 * header.m_FileSize)) {
+      return false;
+    }
+
+    std::vector<char> payload(header.m_PayloadSize);
+    if (!ifs.read(&payload[0], payload.size())) {
+      return false;
+    }
+    boost::crc_32_type crc;
+    crc.process_bytes(&payload[0], payload.size());
+    if (crc.checksum() != header.m_PayloadCRC) {
+      Logger::getInstance()->log("ExpatParser::replaySnapshot: checksum "
+                                 "mismatch in " + snapshotFile, lsWarning);
+      return false;
+    }
+
+    // a snapshot that doesn't decode is caught before any callback was
+    // delivered, so the XML can still be parsed instead
+    if (!replayPayload(payload, false)) {
+      Logger::getInstance()->log("ExpatParser::replaySnapshot: malformed "
+                                 "snapshot " + snapshotFile, lsWarning);
+      boost::system::error_code ec;
+      boost::filesystem::remove(snapshotFile, ec);
+      return false;
+    }
+
+    m_forceStop = false;
+    replayPayload(payload, true);
+    _result = !m_forceStop;
+    return true;
+  } // replaySnapshot
+
+  bool ExpatParser::replayPayload(const std::vector<char>& _payload,
+                                  bool _deliver) {
+    std::vector<const char*> attrs;
+    size_t pos = 0;
+    while (pos < _payload.size()) {
+      if (_deliver && m_forceStop) {
+        return true;
+      }
+      char type = _payload[pos++];
+      if (type == SnapshotElementStart) {
+        uint16_t count;
+        if (pos + sizeof(count) > _payload.size()) {
+          return false;
+        }
+        memcpy(&count, &_payload[pos], sizeof(count));
+        pos += sizeof(count);
+        const char* name = takeString(_payload, pos);
+        if (name == NULL) {
+          return false;
+        }
+        attrs.resize(2 * count + 1);
+        for (int i = 0; i < 2 * count; i++) {
+          attrs[i] = takeString(_payload, pos);
+          if (attrs[i] == NULL) {
+            return false;
+          }
+        }
+        attrs[2 * count] = NULL;
+        if (_deliver) {
+          expatElStart(this, name, &attrs[0]);
+        }
+      } else if (type == SnapshotElementEnd) {
+        const char* name = takeString(_payload, pos);
+        if (name == NULL) {
+          return false;
+        }
+        if (_deliver) {
+          expatElEnd(this, name);
+        }
+      } else if (type == SnapshotCharacterData) {
+        int32_t len;
+        if (pos + sizeof(len) > _payload.size()) {
+          return false;
+        }
+        memcpy(&len, &_payload[pos], sizeof(len));
+        pos += sizeof(len);
+        if ((len < 0) || (pos + len > _payload.size())) {
+          return false;
+        }
+        if (_deliver) {
+          expatCharData(this, &_payload[pos], len);
+        }
+        pos += len;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  } // replayPayload
 
   bool ExpatParser::parseFile(const std::string& _fileName)
   {
     char buffer[XML_PARSER_BUFFER_SIZE];
     m_forceStop = false;
+    m_recording.clear();
 
     XML_Parser parser = XML_ParserCreate(NULL);
     if (parser == NULL) {
@@ -92,12 +426,27 @@ namespace dss {
     
     fclose(f);
     XML_ParserFree(parser);
+    if (m_forceStop) {
+      m_recording.clear();
+    }
     return (!m_forceStop);
   }
 
   void XMLCALL ExpatParser::expatElStart(void *_userdata, const char *_name,
                                          const char **_attrs) {
     ExpatParser *ep = (ExpatParser *)_userdata;
+    if (ep->m_recordSnapshot) {
+      uint16_t count = 0;
+      while (_attrs[2 * count] != NULL) {
+        count++;
+      }
+      ep->m_recording += static_cast<char>(SnapshotElementStart);
+      appendRaw(ep->m_recording, count);
+      ep->m_recording.append(_name, strlen(_name) + 1);
+      for (int i = 0; i < 2 * count; i++) {
+        ep->m_recording.append(_attrs[i], strlen(_attrs[i]) + 1);
+      }
+    }
     try {
       ep->elementStart(_name, _attrs);
     } catch (...) {
@@ -109,6 +458,10 @@ namespace dss {
 
   void XMLCALL ExpatParser::expatElEnd(void *_userdata, const char *_name) {
     ExpatParser *ep = (ExpatParser *)_userdata;
+    if (ep->m_recordSnapshot) {
+      ep->m_recording += static_cast<char>(SnapshotElementEnd);
+      ep->m_recording.append(_name, strlen(_name) + 1);
+    }
     try {
       ep->elementEnd(_name);
     } catch (...) {
@@ -121,6 +474,11 @@ namespace dss {
   void XMLCALL ExpatParser::expatCharData(void *_userdata, const XML_Char *_s,
                                           int _len) {
     ExpatParser *ep = (ExpatParser *)_userdata;
+    if (ep->m_recordSnapshot) {
+      ep->m_recording += static_cast<char>(SnapshotCharacterData);
+      appendRaw(ep->m_recording, static_cast<int32_t>(_len));
+      ep->m_recording.append(_s, _len);
+    }
     try {
       ep->characterData(_s, _len);
     } catch (...) {
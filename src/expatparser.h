@@ -25,24 +25,58 @@
 
 #include <expat.h>
 #include <string>
+#include <vector>
 
 namespace dss {
+  /** Base for the SAX style parsers of the configuration files.
+    * Parsed files can be cached as binary snapshots: the sequence of
+    * callbacks expat produced is recorded into a compact, position
+    * independent buffer and replayed on the next load as long as the file
+    * is unchanged (same size, mtime and inode). This skips tokenizing,
+    * entity decoding and attribute splitting while the subclasses see
+    * exactly the same callbacks. Snapshots are disabled until a snapshot
+    * directory is set and only the loaders run on startup use them. */
   class ExpatParser
   {
   public:
     ExpatParser();
+
+    /** Enables snapshots, stored in \a _directory. An empty string disables them */
+    static void setSnapshotDirectory(const std::string& _directory);
+    static std::string getSnapshotDirectory();
+    /** Snapshot file used for \a _fileName, empty if snapshots are disabled */
+    static std::string getSnapshotFileName(const std::string& _fileName);
+    /** Deletes snapshots whose file is gone or changed since */
+    static void removeOrphanedSnapshots();
   protected:
     // set this variable to true in your callback if you encountered an
     // unrecoverable error, this will stop the file read out loop
     bool m_forceStop;
+    // record the callbacks of the next parseFile(), see saveSnapshot()
+    bool m_recordSnapshot;
 
     bool parseFile(const std::string& _fileName);
+    /** Replays a valid snapshot of \a _fileName if there is one, parses
+      * the file and stores a new snapshot otherwise */
+    bool parseFileWithSnapshot(const std::string& _fileName);
+    /** Stores the callbacks recorded by the last parseFile() as snapshot of
+      * \a _fileName, which must have the same content as the parsed file */
+    bool saveSnapshot(const std::string& _fileName);
 
     // implement your logic in these callbacks
     virtual void elementStart(const char *_name, const char **_attrs) = 0;
     virtual void elementEnd(const char *_name) = 0;
     virtual void characterData(const XML_Char *_s, int _len) = 0;
   private:
+    std::string m_recording;
+
+    /** Returns false if there is no valid snapshot, \a _result is the
+      * parse result if there is */
+    bool replaySnapshot(const std::string& _fileName, bool& _result);
+    /** Walks the recorded callbacks, delivers them if \a _deliver is set.
+      * Returns false if the payload is malformed */
+    bool replayPayload(const std::vector<char>& _payload, bool _deliver);
+
     static void XMLCALL expatElStart(void *_userdata, const char *_name,
                                      const char **_attrs);
     static void XMLCALL expatElEnd(void *_userdata, const char *_name);
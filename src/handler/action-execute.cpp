@@ -46,7 +46,7 @@
 
 namespace dss {
 
-ActionExecute::ActionExecute(const Properties &properties) : m_properties(properties) {}
+ActionExecute::ActionExecute(const EventPayload &properties) : m_properties(properties) {}
 
 std::string ActionExecute::getActionName(PropertyNodePtr _actionNode) {
   std::string action_name;
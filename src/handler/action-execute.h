@@ -22,6 +22,7 @@
 
 #include "base.h"
 #include "propertysystem.h"
+#include "event/event_payload.h"
 
 namespace dss {
 
@@ -29,12 +30,12 @@ class Device;
 
 class ActionExecute {
 public:
-    ActionExecute(const Properties &properties);
+    ActionExecute(const EventPayload &properties);
     void executeWithDelay(std::string _path, std::string _delay);
     void execute(std::string _path);
 
 private:
-    Properties m_properties;
+    EventPayload m_properties;
 
 private:
     void executeZoneScene(PropertyNodePtr _actionNode);
@@ -564,7 +564,7 @@ namespace dss {
         EventLog, NULL));
     int sceneId = -1;
     if (m_properties.has("sceneID")) {
-        sceneId = strToIntDef(m_properties.get("sceneID"), -1);
+        sceneId = m_properties.getInt("sceneID", -1);
     }
 
     bool isForced = false;
@@ -586,7 +586,7 @@ namespace dss {
 
     callOrigin_t callOrigin = coUnknown;
     if (m_properties.has(ef_callOrigin)) {
-      callOrigin = (callOrigin_t)strToIntDef(m_properties.get(ef_callOrigin), 0);
+      callOrigin = (callOrigin_t)m_properties.getInt(ef_callOrigin, 0);
     }
 
     if ((m_evtRaiseLocation == erlGroup) && (m_raisedAtGroup != NULL)) {
@@ -637,7 +637,7 @@ namespace dss {
 
     callOrigin_t callOrigin = coUnknown;
     if (m_properties.has(ef_callOrigin)) {
-      callOrigin = (callOrigin_t)strToIntDef(m_properties.get(ef_callOrigin), 0);
+      callOrigin = (callOrigin_t)m_properties.getInt(ef_callOrigin, 0);
     }
 
     if ((m_evtRaiseLocation == erlGroup) && (m_raisedAtGroup != NULL)) {
@@ -665,7 +665,7 @@ namespace dss {
         EventLog, NULL));
     int sceneId = -1;
     if (m_properties.has("sceneID")) {
-        sceneId = strToIntDef(m_properties.get("sceneID"), -1);
+        sceneId = m_properties.getInt("sceneID", -1);
     }
 
     std::string token;
@@ -680,7 +680,7 @@ namespace dss {
 
     callOrigin_t callOrigin = coUnknown;
     if (m_properties.has(ef_callOrigin)) {
-      callOrigin = (callOrigin_t)strToIntDef(m_properties.get(ef_callOrigin), 0);
+      callOrigin = (callOrigin_t)m_properties.getInt(ef_callOrigin, 0);
     }
 
     if ((m_evtRaiseLocation == erlGroup) && (m_raisedAtGroup != NULL)) {
@@ -798,7 +798,7 @@ namespace dss {
     }
     callOrigin_t callOrigin = coUnknown;
     if (m_properties.has(ef_callOrigin)) {
-      callOrigin = (callOrigin_t)strToIntDef(m_properties.get(ef_callOrigin), 0);
+      callOrigin = (callOrigin_t)m_properties.getInt(ef_callOrigin, 0);
     }
     if ((m_evtRaiseLocation == erlState) && (m_raisedAtState != NULL)) {
       boost::shared_ptr<ScriptLogger> logger(new ScriptLogger(DSS::getInstance()->getJSLogDirectory(),
@@ -991,7 +991,7 @@ namespace dss {
 
     callOrigin_t callOrigin = coUnknown;
     if (m_properties.has(ef_callOrigin)) {
-      callOrigin = (callOrigin_t)strToIntDef(m_properties.get(ef_callOrigin), 0);
+      callOrigin = (callOrigin_t)m_properties.getInt(ef_callOrigin, 0);
     }
 
     if ((m_evtRaiseLocation == erlGroup) && (m_raisedAtGroup != NULL)) {
@@ -1042,7 +1042,7 @@ namespace dss {
 
     callOrigin_t callOrigin = coUnknown;
     if (m_properties.has(ef_callOrigin)) {
-      callOrigin = (callOrigin_t)strToIntDef(m_properties.get(ef_callOrigin), 0);
+      callOrigin = (callOrigin_t)m_properties.getInt(ef_callOrigin, 0);
     }
 
     boost::shared_ptr<ScriptLogger> logger(new ScriptLogger(DSS::getInstance()->getJSLogDirectory(),
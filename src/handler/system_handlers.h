@@ -31,7 +31,7 @@ namespace dss {
       virtual ~SystemEvent();
       virtual void run() = 0;
     protected:
-      Properties m_properties;
+      EventPayload m_properties;
       std::string m_evtName;
       EventRaiseLocation m_evtRaiseLocation;
       boost::shared_ptr<const Group> m_raisedAtGroup;
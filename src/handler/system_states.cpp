@@ -380,7 +380,7 @@ std::string SystemState::getData(int *zoneId, int *groupId, int *sceneId,
 
   *callOrigin = coUnknown;
   if (m_properties.has(ef_callOrigin)) {
-      *callOrigin = (callOrigin_t)strToIntDef(m_properties.get(ef_callOrigin), 0);
+      *callOrigin = (callOrigin_t)m_properties.getInt(ef_callOrigin, 0);
   }
 
   if (!zoneId || !groupId || !sceneId) {
@@ -392,7 +392,7 @@ std::string SystemState::getData(int *zoneId, int *groupId, int *sceneId,
   *sceneId = -1;
 
   if (m_properties.has("sceneID")) {
-      *sceneId = strToIntDef(m_properties.get("sceneID"), -1);
+      *sceneId = m_properties.getInt("sceneID", -1);
   }
 
   if (m_properties.has(ef_originDSUID)) {
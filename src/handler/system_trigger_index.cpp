@@ -0,0 +1,381 @@
+/*
+ *  Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+ *
+ *  This file is part of digitalSTROM Server.
+ *
+ *  digitalSTROM Server is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  digitalSTROM Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system_trigger_index.h"
+
+#include <algorithm>
+
+#include "base.h"
+#include "foreach.h"
+#include "logger.h"
+#include "event/event_fields.h"
+#include "system_triggers.h"
+
+namespace dss {
+
+  namespace {
+    typedef enum {
+      kkScene,      //< integer scene, must match
+      kkSceneOrAny, //< integer scene, -1 matches all
+      kkDSUID,      //< dsuid string, -1 matches all
+      kkName        //< any value, compared as string
+    } KeyKind;
+
+    struct ConditionType {
+      const char* m_Type;
+      const char* m_Field;
+      KeyKind m_Kind;
+    };
+
+    /* The condition types SystemTrigger::checkTriggerNode knows, with the
+     * field SystemTrigger::getIndexKeys provides the event's value for.
+     * Types without a field are only filed under their type. */
+    const ConditionType kConditionTypes[] = {
+      { "zone-scene", "scene", kkScene },
+      { "bus-zone-scene", "scene", kkScene },
+      { "undo-zone-scene", "scene", kkSceneOrAny },
+      { "device-scene", "dsuid", kkDSUID },
+      { "device-msg", "dsuid", kkDSUID },
+      { "device-action", "dsuid", kkDSUID },
+      { "device-sensor", "dsuid", kkDSUID },
+      { "device-sensor-value", "dsuid", kkDSUID },
+      { "zone-sensor-value", NULL, kkName },
+      { "device-binary-input", "dsuid", kkDSUID },
+      { "device-named-action", "dsuid", kkDSUID },
+      { "device-named-event", "dsuid", kkDSUID },
+      { "custom-event", "event", kkName },
+      { "state-change", "name", kkName },
+      { "addon-state-change", "name", kkName },
+      { "event", "name", kkName },
+    };
+
+    const ConditionType* findConditionType(const std::string& _type) {
+      for (size_t i = 0; i < sizeof(kConditionTypes) / sizeof(kConditionTypes[0]); i++) {
+        if (_type == kConditionTypes[i].m_Type) {
+          return &kConditionTypes[i];
+        }
+      }
+      return NULL;
+    } // findConditionType
+
+    /** The value the condition matches, false if it may match any */
+    bool getConditionValue(const ConditionType& _type, PropertyNodePtr _condition,
+                           std::string& _value) {
+      if (_type.m_Field == NULL) {
+        return false;
+      }
+      PropertyNodePtr field = _condition->getPropertyByName(_type.m_Field);
+      if (field == NULL) {
+        return false;
+      }
+      switch (_type.m_Kind) {
+      case kkScene:
+      case kkSceneOrAny:
+        // anything but an integer fails the check anyway
+        if (field->getValueType() != vTypeInteger) {
+          return false;
+        }
+        if ((_type.m_Kind == kkSceneOrAny) && (field->getIntegerValue() < 0)) {
+          return false;
+        }
+        _value = intToString(field->getIntegerValue());
+        return true;
+      case kkDSUID:
+        if (field->getValueType() != vTypeString) {
+          return false;
+        }
+        _value = field->getStringValue();
+        return !_value.empty() && (_value != "-1");
+      case kkName:
+        _value = field->getAsString();
+        return true;
+      }
+      return false;
+    } // getConditionValue
+
+    /** Values the triggers update on their own while firing */
+    bool isRuntimeData(PropertyNode* _node, PropertyNode* _caller) {
+      for (PropertyNode* node = _node; (node != NULL) && (node != _caller);
+           node = node->getParentNode()) {
+        const std::string& name = node->getName();
+        if ((name == ptn_damping) || (name == ptn_action_lag) ||
+            (name == ptn_damp_start_ts) || (name == ptn_action_ts) ||
+            (name == ptn_action_eventid)) {
+          return true;
+        }
+      }
+      return false;
+    } // isRuntimeData
+
+    bool isAttached(PropertyNode* _node, PropertyNode* _root) {
+      while (_node->getParentNode() != NULL) {
+        _node = _node->getParentNode();
+      }
+      return _node == _root;
+    } // isAttached
+  }
+
+  SystemTriggerIndex::SystemTriggerIndex()
+  : m_CompileCount(0),
+    m_TriggersNode(NULL),
+    m_NeedsRebuild(true)
+  { } // ctor
+
+  SystemTriggerIndex::~SystemTriggerIndex() {
+    unsubscribe();
+  } // dtor
+
+  SystemTriggerIndex& SystemTriggerIndex::getInstance() {
+    static SystemTriggerIndex instance;
+    return instance;
+  } // getInstance
+
+  std::string SystemTriggerIndex::makeKey(const std::string& _type,
+                                          const std::string& _value) {
+    // types never contain a newline, the plain type is the wildcard key
+    return _type + "\n" + _value;
+  } // makeKey
+
+  void SystemTriggerIndex::subscribe(PropertyNodePtr _node) {
+    if (m_Subscribed.insert(_node.get()).second) {
+      _node->addListener(this);
+    }
+  } // subscribe
+
+  void SystemTriggerIndex::compile(PropertySystem& _propSystem, Entry& _entry) {
+    m_CompileCount++;
+    _entry.m_Stale = false;
+    if ((_entry.m_ParamNode != NULL) &&
+        !isAttached(_entry.m_ParamNode.get(), _propSystem.getRootNode().get()) &&
+        (m_Subscribed.erase(_entry.m_ParamNode.get()) > 0)) {
+      // gone from the tree, a new node may get the same address
+      _entry.m_ParamNode->removeListener(this);
+    }
+    _entry.m_ParamNode.reset();
+    _entry.m_TriggerPath.clear();
+    _entry.m_Conditions.clear();
+
+    PropertyNodePtr pathNode = _entry.m_TriggerNode->getPropertyByName("triggerPath");
+    if ((pathNode == NULL) || (pathNode->getValueType() != vTypeString)) {
+      return;
+    }
+    _entry.m_TriggerPath = pathNode->getStringValue();
+    _entry.m_ParamNode = _propSystem.getProperty(_entry.m_TriggerPath);
+    if (_entry.m_ParamNode == NULL) {
+      // refresh() retries, the node might get created later
+      return;
+    }
+    subscribe(_entry.m_ParamNode);
+
+    PropertyNodePtr conditions = _entry.m_ParamNode->getPropertyByName(ptn_triggers);
+    if (conditions == NULL) {
+      return;
+    }
+    for (int i = 0; i < conditions->getChildCount(); i++) {
+      PropertyNodePtr conditionNode = conditions->getChild(i);
+      PropertyNodePtr typeNode = conditionNode->getPropertyByName(ptn_type);
+      if (typeNode == NULL) {
+        continue;
+      }
+      std::string type = typeNode->getAsString();
+      const ConditionType* conditionType = findConditionType(type);
+      if (conditionType == NULL) {
+        // never matches any event
+        continue;
+      }
+
+      Condition condition;
+      condition.m_Node = conditionNode;
+      std::string value;
+      condition.m_Key = getConditionValue(*conditionType, conditionNode, value) ?
+                        makeKey(type, value) : type;
+      _entry.m_Conditions.push_back(condition);
+    }
+  } // compile
+
+  void SystemTriggerIndex::fileConditions() {
+    m_Buckets.clear();
+    for (size_t i = 0; i < m_Entries.size(); i++) {
+      const std::vector<Condition>& conditions = m_Entries[i].m_Conditions;
+      for (size_t j = 0; j < conditions.size(); j++) {
+        m_Buckets[conditions[j].m_Key].push_back(std::make_pair(i, j));
+      }
+    }
+  } // fileConditions
+
+  void SystemTriggerIndex::rebuild(PropertySystem& _propSystem, PropertyNodePtr _triggers) {
+    unsubscribe();
+    m_Subscribed.clear();
+    m_Entries.clear();
+
+    m_Triggers = _triggers;
+    subscribe(m_Triggers);
+    for (int i = 0; i < m_Triggers->getChildCount(); i++) {
+      Entry entry;
+      entry.m_TriggerNode = m_Triggers->getChild(i);
+      compile(_propSystem, entry);
+      m_Entries.push_back(entry);
+    }
+    fileConditions();
+
+    Logger::getInstance()->log("SystemTriggerIndex: compiled " +
+                               intToString(m_Entries.size()) + " triggers", lsDebug);
+  } // rebuild
+
+  bool SystemTriggerIndex::refresh(PropertySystem& _propSystem) {
+    PropertyNode* root = _propSystem.getRootNode().get();
+    bool changed = false;
+    foreach (Entry& entry, m_Entries) {
+      if (entry.m_ParamNode == NULL) {
+        // not there yet, or a broken path
+        entry.m_Stale = entry.m_Stale ||
+          (!entry.m_TriggerPath.empty() &&
+           (_propSystem.getProperty(entry.m_TriggerPath) != NULL));
+      } else if (!isAttached(entry.m_ParamNode.get(), root)) {
+        // removed from the tree, possibly replaced by another node
+        entry.m_Stale = true;
+      }
+      if (entry.m_Stale) {
+        compile(_propSystem, entry);
+        changed = true;
+      }
+    }
+    if (changed) {
+      fileConditions();
+    }
+    return changed;
+  } // refresh
+
+  void SystemTriggerIndex::lookup(PropertySystem& _propSystem, PropertyNodePtr _triggers,
+                                  const Keys& _keys, Matches& _matches) {
+    boost::mutex::scoped_lock lock(m_Mutex);
+
+    bool needsRebuild;
+    std::vector<std::pair<PropertyNode*, bool> > staleNodes;
+    {
+      boost::mutex::scoped_lock staleLock(m_StaleMutex);
+      needsRebuild = m_NeedsRebuild || (_triggers.get() != m_TriggersNode);
+      m_NeedsRebuild = false;
+      m_TriggersNode = _triggers.get();
+      staleNodes.swap(m_StaleNodes);
+    }
+
+    typedef std::pair<PropertyNode*, bool> StaleNode;
+    for (size_t i = 0; !needsRebuild && (i < staleNodes.size()); i++) {
+      const StaleNode& stale = staleNodes[i];
+      bool found = false;
+      foreach (Entry& entry, m_Entries) {
+        if ((entry.m_TriggerNode.get() == stale.first) ||
+            (entry.m_ParamNode.get() == stale.first)) {
+          entry.m_Stale = true;
+          found = true;
+        }
+      }
+      if (stale.second && !found) {
+        // a new trigger, children only get appended
+        PropertyNodePtr last = (m_Triggers->getChildCount() > 0) ?
+          m_Triggers->getChild(m_Triggers->getChildCount() - 1) : PropertyNodePtr();
+        if ((last.get() == stale.first) &&
+            (m_Entries.size() + 1 == (size_t)m_Triggers->getChildCount())) {
+          Entry entry;
+          entry.m_TriggerNode = last;
+          entry.m_Stale = true;
+          m_Entries.push_back(entry);
+        } else {
+          needsRebuild = true;
+        }
+      }
+    }
+
+    if (needsRebuild) {
+      rebuild(_propSystem, _triggers);
+    } else {
+      refresh(_propSystem);
+    }
+
+    Bucket positions;
+    foreach (const Keys::value_type& key, _keys) {
+      std::unordered_map<std::string, Bucket>::const_iterator it;
+      it = m_Buckets.find(makeKey(key.first, key.second));
+      if (it != m_Buckets.end()) {
+        positions.insert(positions.end(), it->second.begin(), it->second.end());
+      }
+      it = m_Buckets.find(key.first);
+      if (it != m_Buckets.end()) {
+        positions.insert(positions.end(), it->second.begin(), it->second.end());
+      }
+    }
+    std::sort(positions.begin(), positions.end());
+    positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+    foreach (const Bucket::value_type& position, positions) {
+      const Entry& entry = m_Entries[position.first];
+      if (_matches.empty() || (_matches.back().m_TriggerNode != entry.m_TriggerNode)) {
+        Match match;
+        match.m_TriggerNode = entry.m_TriggerNode;
+        match.m_ParamNode = entry.m_ParamNode;
+        match.m_TriggerPath = entry.m_TriggerPath;
+        _matches.push_back(match);
+      }
+      _matches.back().m_Conditions.push_back(entry.m_Conditions[position.second].m_Node);
+    }
+  } // lookup
+
+  int SystemTriggerIndex::getCompileCount() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_CompileCount;
+  } // getCompileCount
+
+  void SystemTriggerIndex::invalidate(PropertyNodePtr _caller, PropertyNodePtr _node) {
+    if (isRuntimeData(_node.get(), _caller.get())) {
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(m_StaleMutex);
+    if (_caller.get() != m_TriggersNode) {
+      m_StaleNodes.push_back(std::make_pair(_caller.get(), false));
+      return;
+    }
+
+    // find the /usr/triggers/<n> the node belongs to
+    PropertyNode* node = _node.get();
+    while ((node != NULL) && (node->getParentNode() != m_TriggersNode)) {
+      node = node->getParentNode();
+    }
+    if (node == NULL) {
+      // removed, which trigger is gone can't be told anymore
+      m_NeedsRebuild = true;
+      return;
+    }
+    m_StaleNodes.push_back(std::make_pair(node, true));
+  } // invalidate
+
+  void SystemTriggerIndex::propertyChanged(PropertyNodePtr _caller, PropertyNodePtr _changedNode) {
+    invalidate(_caller, _changedNode);
+  } // propertyChanged
+
+  void SystemTriggerIndex::propertyRemoved(PropertyNodePtr _parent, PropertyNodePtr _child) {
+    invalidate(_parent, _child);
+  } // propertyRemoved
+
+  void SystemTriggerIndex::propertyAdded(PropertyNodePtr _parent, PropertyNodePtr _child) {
+    invalidate(_parent, _child);
+  } // propertyAdded
+
+} // namespace dss
@@ -0,0 +1,129 @@
+/*
+ *  Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+ *
+ *  This file is part of digitalSTROM Server.
+ *
+ *  digitalSTROM Server is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  digitalSTROM Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "propertysystem.h"
+
+namespace dss {
+
+  /**
+   * Lookup table from event to the triggers in /usr/triggers that may match.
+   *
+   * Each trigger condition (child of <triggerPath>/triggers) is filed under
+   * its type and the one value an event has to match exactly, e.g. the scene
+   * of a "zone-scene" or the dsuid of a "device-msg" condition. Conditions
+   * using the "-1" wildcard, or whose value can't be told without running
+   * the full check, are filed under their type only.
+   *
+   * The lookup only narrows down the candidates, SystemTrigger still runs
+   * the full check on every condition returned. Changes below /usr/triggers
+   * or below a referenced trigger node mark the affected entries stale,
+   * they get recompiled on the next lookup. Runtime data the trigger writes
+   * itself (damping, lag) is ignored.
+   */
+  class SystemTriggerIndex : public PropertyListener, boost::noncopyable {
+  public:
+    /** Condition type and the value the event has for it */
+    typedef std::vector<std::pair<std::string, std::string> > Keys;
+
+    struct Match {
+      PropertyNodePtr m_TriggerNode; //< /usr/triggers/<n>
+      PropertyNodePtr m_ParamNode; //< node referenced by triggerPath
+      std::string m_TriggerPath;
+      /** The conditions that may match, in tree order */
+      std::vector<PropertyNodePtr> m_Conditions;
+    };
+    typedef std::vector<Match> Matches;
+
+    SystemTriggerIndex();
+    virtual ~SystemTriggerIndex();
+
+    /** The index shared by all SystemTrigger instances */
+    static SystemTriggerIndex& getInstance();
+
+    /**
+     * lookup() - find the triggers an event may match
+     * @_propSystem - resolves the triggerPath of each trigger
+     * @_triggers - the /usr/triggers node
+     * @_keys - condition types and values of the event
+     * @_matches - candidates in /usr/triggers order
+     */
+    void lookup(PropertySystem& _propSystem, PropertyNodePtr _triggers,
+                const Keys& _keys, Matches& _matches);
+
+    /** Number of trigger entries compiled so far, for testing */
+    int getCompileCount() const;
+  protected:
+    virtual void propertyChanged(PropertyNodePtr _caller, PropertyNodePtr _changedNode);
+    virtual void propertyRemoved(PropertyNodePtr _parent, PropertyNodePtr _child);
+    virtual void propertyAdded(PropertyNodePtr _parent, PropertyNodePtr _child);
+  private:
+    struct Condition {
+      PropertyNodePtr m_Node;
+      std::string m_Key;
+    };
+
+    struct Entry {
+      PropertyNodePtr m_TriggerNode;
+      PropertyNodePtr m_ParamNode;
+      std::string m_TriggerPath;
+      std::vector<Condition> m_Conditions;
+      bool m_Stale;
+    };
+
+    /** (entry, condition) positions filed under one key */
+    typedef std::vector<std::pair<size_t, size_t> > Bucket;
+
+    void rebuild(PropertySystem& _propSystem, PropertyNodePtr _triggers);
+    /** Recompiles stale entries, returns true if any was */
+    bool refresh(PropertySystem& _propSystem);
+    void compile(PropertySystem& _propSystem, Entry& _entry);
+    void fileConditions();
+    void subscribe(PropertyNodePtr _node);
+    void invalidate(PropertyNodePtr _caller, PropertyNodePtr _node);
+
+    static std::string makeKey(const std::string& _type, const std::string& _value);
+
+    /** Held while looking up and compiling */
+    mutable boost::mutex m_Mutex;
+    PropertyNodePtr m_Triggers;
+    std::vector<Entry> m_Entries;
+    std::unordered_map<std::string, Bucket> m_Buckets;
+    std::set<PropertyNode*> m_Subscribed;
+    int m_CompileCount;
+
+    /** Guards what the listener callbacks record, these run on the thread
+      * modifying the tree, possibly while it holds the property lock */
+    boost::mutex m_StaleMutex;
+    PropertyNode* m_TriggersNode;
+    bool m_NeedsRebuild;
+    /** Changed trigger or parameter nodes, true for /usr/triggers children */
+    std::vector<std::pair<PropertyNode*, bool> > m_StaleNodes;
+  }; // SystemTriggerIndex
+
+} // namespace dss
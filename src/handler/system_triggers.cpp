@@ -24,6 +24,7 @@
 
 #include "event/event_create.h"
 #include "event/event_fields.h"
+#include "foreach.h"
 #include "model/group.h"
 #include "security/security.h"
 #include "systemcondition.h"
@@ -48,7 +49,8 @@ namespace dss {
       m_evtSrcIsGroup(false),
       m_evtSrcIsDevice(false),
       m_evtSrcZone(0),
-      m_evtSrcGroup(0)
+      m_evtSrcGroup(0),
+      m_evtSrcDSID(DSUID_NULL)
   {
     EventRaiseLocation raiseLocation = event.getRaiseLocation();
     if ((raiseLocation == erlGroup) || (raiseLocation == erlApartment)) {
@@ -82,11 +84,8 @@ namespace dss {
       return false;
     }
 
-    int scene = strToIntDef(m_properties.get(ef_sceneID), -1);
-    dsuid_t originDSUID;
-    if (m_properties.has(ef_originDSUID)) {
-      originDSUID = str2dsuid(m_properties.get(ef_originDSUID));
-    }
+    int scene = m_properties.getInt(ef_sceneID, -1);
+    dsuid_t originDSUID = m_properties.getDSUID(ef_originDSUID, DSUID_NULL);
     bool forced = false;
     if (m_properties.has(ef_forced)) {
       std::string sForced = m_properties.get(ef_forced);
@@ -182,11 +181,8 @@ namespace dss {
       return false;
     }
 
-    int scene = strToIntDef(m_properties.get(ef_sceneID), -1);
-    dsuid_t originDSUID;
-    if (m_properties.has(ef_originDSUID)) {
-      originDSUID = str2dsuid(m_properties.get(ef_originDSUID));
-    }
+    int scene = m_properties.getInt(ef_sceneID, -1);
+    dsuid_t originDSUID = m_properties.getDSUID(ef_originDSUID, DSUID_NULL);
 
     PropertyNodePtr triggerZone = _triggerProp->getPropertyByName(ef_zone);
     if (triggerZone == NULL) {
@@ -260,7 +256,7 @@ namespace dss {
     }
 
     dsuid_t dsuid = m_evtSrcDSID;
-    int scene = strToIntDef(m_properties.get(ef_sceneID), -1);
+    int scene = m_properties.getInt(ef_sceneID, -1);
 
     if (dsuid == DSUID_NULL) {
       return false;
@@ -916,6 +912,45 @@ namespace dss {
     return false;
   }
 
+  void SystemTrigger::getIndexKeys(SystemTriggerIndex::Keys& _keys) {
+    // same dispatch as checkTriggerNode
+    if (m_evtName == EventName::CallScene) {
+      std::string scene = intToString(m_properties.getInt(ef_sceneID, -1));
+      _keys.push_back(std::make_pair("zone-scene", scene));
+      _keys.push_back(std::make_pair("device-scene", dsuid2str(m_evtSrcDSID)));
+    } else if (m_evtName == EventName::CallSceneBus) {
+      _keys.push_back(std::make_pair("bus-zone-scene",
+                                     intToString(m_properties.getInt(ef_sceneID, -1))));
+    } else if (m_evtName == EventName::UndoScene) {
+      _keys.push_back(std::make_pair("undo-zone-scene",
+                                     intToString(m_properties.getInt(ef_sceneID, -1))));
+    } else if (m_evtName == EventName::DeviceButtonClick) {
+      _keys.push_back(std::make_pair("device-msg", dsuid2str(m_evtSrcDSID)));
+    } else if (m_evtName == EventName::ButtonDeviceAction) {
+      _keys.push_back(std::make_pair("device-action", dsuid2str(m_evtSrcDSID)));
+    } else if (m_evtName == "deviceSensorEvent") {
+      _keys.push_back(std::make_pair("device-sensor", dsuid2str(m_evtSrcDSID)));
+    } else if (m_evtName == "deviceSensorValue") {
+      _keys.push_back(std::make_pair("device-sensor-value", dsuid2str(m_evtSrcDSID)));
+    } else if (m_evtName == "zoneSensorValue") {
+      _keys.push_back(std::make_pair("zone-sensor-value", std::string()));
+    } else if (m_evtName == EventName::DeviceBinaryInputEvent) {
+      _keys.push_back(std::make_pair("device-binary-input", dsuid2str(m_evtSrcDSID)));
+    } else if (m_evtName == EventName::DeviceActionEvent) {
+      _keys.push_back(std::make_pair("device-named-action", dsuid2str(m_evtSrcDSID)));
+    } else if (m_evtName == EventName::DeviceEventEvent) {
+      _keys.push_back(std::make_pair("device-named-event", dsuid2str(m_evtSrcDSID)));
+    } else if (m_evtName == "highlevelevent") {
+      _keys.push_back(std::make_pair("custom-event", m_properties.get("id", "")));
+    } else if (m_evtName == EventName::StateChange) {
+      _keys.push_back(std::make_pair("state-change", m_properties.get("statename", "")));
+    } else if (m_evtName == EventName::AddonStateChange) {
+      _keys.push_back(std::make_pair("addon-state-change", m_properties.get("statename", "")));
+    } else {
+      _keys.push_back(std::make_pair("event", m_evtName));
+    }
+  }
+
   /**
    * damping() - decide if trigger shall be damped or an event emitted
    * @_triggerParamNode complete trigger parameter node
@@ -1104,28 +1139,27 @@ namespace dss {
       return;
     }
 
-    PropertyNodePtr triggerPathNode;
+    SystemTriggerIndex::Keys keys;
+    getIndexKeys(keys);
+    SystemTriggerIndex::Matches matches;
+    SystemTriggerIndex::getInstance().lookup(propSystem, triggerProperty, keys, matches);
+
     std::string sTriggerPath;
     try {
-      for (int i = 0; i < triggerProperty->getChildCount(); i++) {
-        PropertyNodePtr triggerNode = triggerProperty->getChild(i);
-        if (triggerNode == NULL) {
-          continue;
-        }
-        triggerPathNode = triggerNode->getPropertyByName("triggerPath");
-        if (triggerPathNode == NULL) {
-          continue;
-        }
-
-        PropertyNodePtr triggerParamNode =
-          propSystem.getProperty(triggerPathNode->getStringValue());
-        if (triggerParamNode == NULL) {
-          continue;
+      foreach (const SystemTriggerIndex::Match& match, matches) {
+        PropertyNodePtr triggerNode = match.m_TriggerNode;
+        PropertyNodePtr triggerParamNode = match.m_ParamNode;
+        sTriggerPath = match.m_TriggerPath;
+
+        bool matched = false;
+        foreach (const PropertyNodePtr& condition, match.m_Conditions) {
+          if (checkTriggerNode(condition)) {
+            matched = true;
+            break;
+          }
         }
 
-        sTriggerPath = triggerPathNode->getStringValue();
-
-        if (checkTrigger(triggerParamNode) && checkSystemCondition(sTriggerPath)) {
+        if (matched && checkSystemCondition(sTriggerPath)) {
 
 
           PropertyNodePtr lagNode = triggerParamNode->getProperty(ptn_action_lag);
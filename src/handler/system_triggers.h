@@ -22,6 +22,7 @@
 #include <string>
 
 #include "system_handlers.h"
+#include "system_trigger_index.h"
 
 namespace dss {
 
@@ -75,6 +76,13 @@ namespace dss {
        */
       bool checkTriggerNode(PropertyNodePtr _triggerProp);
 
+      /**
+       * getIndexKeys() - condition types checkTriggerNode() handles for
+       * this event, with the value a condition must have to match
+       * @_keys - receives the keys for SystemTriggerIndex::lookup()
+       */
+      void getIndexKeys(SystemTriggerIndex::Keys& _keys);
+
       /* subclasses of trigger type */
       bool checkSceneZone(PropertyNodePtr _triggerProp);
       bool checkUndoSceneZone(PropertyNodePtr _triggerProp);
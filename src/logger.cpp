@@ -33,6 +33,7 @@
 #include <iostream>
 #include <boost/make_shared.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
 
 namespace dss {
 
@@ -94,9 +95,18 @@ namespace dss {
 
   Logger::Logger()
     : m_logTarget(boost::make_shared<CoutLogTarget>()),
-      m_defaultLogChannel(new LogChannel("System"))
+      m_defaultLogChannel(new LogChannel("System")),
+      m_MaxPending(LOGGER_MAX_PENDING_BYTES),
+      m_Dropped(0),
+      m_DroppedTotal(0),
+      m_Async(false),
+      m_StopWriter(false)
   {}
 
+  Logger::~Logger() {
+    setAsync(false);
+  }
+
   Logger* Logger::getInstance() {
     if(m_Instance == NULL) {
       m_Instance = new Logger();
@@ -113,37 +123,146 @@ namespace dss {
   }
 
   void Logger::log(const std::string& _message, const aLogSeverity _severity) {
-    log(*m_defaultLogChannel, std::string(_message), _severity);
+    log(*m_defaultLogChannel, _message, _severity);
   } // log
 
   void Logger::log(const LogChannel& _channel, const std::string& _message, const aLogSeverity _severity) {
-    if(_channel.maylog(_severity)) {
-      std::string logMessage;
+    if(!_channel.maylog(_severity)) {
+      return;
+    }
 
-      DateTime d = DateTime();
+    // formatting scratch, keeps its capacity from record to record
+    static thread_local std::string logMessage;
+    logMessage.clear();
+    format(logMessage, _channel.getName(), _message, _severity);
+
+    boost::mutex::scoped_lock lock(m_PendingMutex);
+    if (m_Async) {
+      // the writer can't keep up, don't let the buffer eat up the memory
+      if ((_severity < lsError) &&
+          (m_Pending.size() + logMessage.size() > m_MaxPending)) {
+        m_Dropped++;
+        m_DroppedTotal++;
+        return;
+      }
+      // the writer only sleeps on an empty buffer
+      bool wakeWriter = m_Pending.empty();
+      m_Pending.append(logMessage);
+      lock.unlock();
+      // errors are often the last thing logged before a crash
+      if (_severity >= lsError) {
+        flush();
+      } else if (wakeWriter) {
+        m_PendingCondition.notify_one();
+      }
+      return;
+    }
+    lock.unlock();
+    write(logMessage);
+  } // log
 
-      logMessage = "[" + d.toISO8601_ms_local() + "]"
-        + SeverityToString<const std::string>(_severity)
-        + "[" + _channel.getName() + "]"
-        + " " + _message + "\n";
+  void Logger::format(std::string& _out, const std::string& _channel,
+                      const std::string& _message, const aLogSeverity _severity) {
+    char timestamp[32];
+    DateTime().toISO8601_ms_local(timestamp, sizeof(timestamp));
+    _out.append("[").append(timestamp).append("]")
+      .append(SeverityToString<const char*>(_severity))
+      .append("[").append(_channel).append("]")
+      .append(" ").append(_message).append("\n");
+  } // format
+
+  void Logger::write(const std::string& _records) {
+    {
+      boost::mutex::scoped_lock lock(m_streamMutex);
+      m_logTarget->outputStream() << _records; // only for backward compatibility
+    }
 
-      {
-        boost::mutex::scoped_lock lock(m_streamMutex);
-        m_logTarget->outputStream() << logMessage; // only for backward compatibility
+    {
+      boost::mutex::scoped_lock lock(m_handlerListMutex);
+      foreach(LogHandler *h,m_handlerList) {
+        h->handle(_records);
       }
-
-      {
-        boost::mutex::scoped_lock lock(m_handlerListMutex);
-        foreach(LogHandler *h,m_handlerList) {
-          h->handle(logMessage);
-        }
+    }
+  } // write
+
+  void Logger::flush() {
+    boost::mutex::scoped_lock flushLock(m_FlushMutex);
+    unsigned long dropped;
+    {
+      boost::mutex::scoped_lock lock(m_PendingMutex);
+      // hands the drained buffer back to the producers
+      m_Writing.swap(m_Pending);
+      dropped = m_Dropped;
+      m_Dropped = 0;
+    }
+    if (dropped > 0) {
+      // records only get dropped while the buffer is full, so the gap is
+      // right after its content
+      format(m_Writing, m_defaultLogChannel->getName(),
+             uintToString(dropped) + " log records dropped, the log writer "
+             "could not keep up", lsWarning);
+    }
+    if (!m_Writing.empty()) {
+      write(m_Writing);
+      m_Writing.clear();
+    }
+  } // flush
+
+  void Logger::writerThread() {
+    // collect records for a while instead of fighting the producers
+    // for m_PendingMutex on every single one
+    const boost::posix_time::milliseconds kBatchInterval(20);
+    boost::mutex::scoped_lock lock(m_PendingMutex);
+    while (!m_StopWriter) {
+      if (m_Pending.empty()) {
+        m_PendingCondition.wait(lock);
+        continue;
       }
+      m_PendingCondition.timed_wait(lock, kBatchInterval);
+      lock.unlock();
+      flush();
+      lock.lock();
     }
-  } // log
+  } // writerThread
+
+  void Logger::setAsync(bool _value) {
+    boost::shared_ptr<boost::thread> writer;
+    {
+      boost::mutex::scoped_lock lock(m_PendingMutex);
+      if (m_Async == _value) {
+        return;
+      }
+      m_Async = _value;
+      m_StopWriter = !_value;
+      if (_value) {
+        m_Writer = boost::make_shared<boost::thread>(boost::bind(&Logger::writerThread, this));
+        return;
+      }
+      writer.swap(m_Writer);
+      m_PendingCondition.notify_all();
+    }
+    writer->join();
+    flush();
+  } // setAsync
+
+  bool Logger::isAsync() {
+    boost::mutex::scoped_lock lock(m_PendingMutex);
+    return m_Async;
+  } // isAsync
+
+  void Logger::setMaxPendingBytes(size_t _value) {
+    boost::mutex::scoped_lock lock(m_PendingMutex);
+    m_MaxPending = _value;
+  } // setMaxPendingBytes
 
+  unsigned long Logger::getDroppedRecords() {
+    boost::mutex::scoped_lock lock(m_PendingMutex);
+    return m_DroppedTotal;
+  } // getDroppedRecords
 
   bool Logger::setLogTarget(boost::shared_ptr<LogTarget>& _logTarget) {
     if (_logTarget->open()) {
+      boost::mutex::scoped_lock lock(m_streamMutex);
       m_logTarget->close();
       m_logTarget = _logTarget;
       return true;
@@ -152,6 +271,7 @@ namespace dss {
   } // setLogTarget
 
   bool Logger::reopenLogTarget() {
+    boost::mutex::scoped_lock lock(m_streamMutex);
     m_logTarget->close();
     return m_logTarget->open();
   }
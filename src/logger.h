@@ -29,8 +29,13 @@
 #include <iostream>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
 #include <list>
 
+/** Bytes the asynchronous log buffer may hold before records get dropped */
+#define LOGGER_MAX_PENDING_BYTES (4 * 1024 * 1024)
+
 /*
  * Usage:
  * class FooBar {
@@ -79,9 +84,32 @@ class LogHandler;
 
     boost::shared_ptr<LogChannel> getLogChannel() { return m_defaultLogChannel; }
 
+    /**
+     * In asynchronous mode records are appended to a buffer and written
+     * by a background thread, errors flush the buffer synchronously.
+     * Handlers may then receive several records in one call.
+     * Disabling it flushes the buffer and joins the writer.
+     * Records below errors that would grow the buffer beyond the limit
+     * are dropped, the writer reports how many after the records that
+     * made it.
+     */
+    void setAsync(bool _value);
+    bool isAsync();
+    void setMaxPendingBytes(size_t _value);
+    /** Number of records dropped since startup */
+    unsigned long getDroppedRecords();
+    /** Writes all pending records */
+    void flush();
+
   private:
     Logger();
-    
+    ~Logger();
+
+    static void format(std::string& _out, const std::string& _channel,
+                       const std::string& _message, const aLogSeverity _severity);
+    void write(const std::string& _records);
+    void writerThread();
+
     static Logger* m_Instance;
     
     boost::shared_ptr<LogTarget> m_logTarget;
@@ -90,6 +118,22 @@ class LogHandler;
     static boost::mutex m_handlerListMutex;
     static std::list<LogHandler *> m_handlerList;
     static boost::mutex m_streamMutex;
+
+    boost::mutex m_PendingMutex;
+    boost::condition_variable m_PendingCondition;
+    /** formatted records not yet written, guarded by m_PendingMutex */
+    std::string m_Pending;
+    /** records being written, guarded by m_FlushMutex */
+    std::string m_Writing;
+    size_t m_MaxPending;
+    /** records dropped since the last flush and in total, guarded by
+      * m_PendingMutex */
+    unsigned long m_Dropped;
+    unsigned long m_DroppedTotal;
+    bool m_Async;
+    bool m_StopWriter;
+    boost::mutex m_FlushMutex;
+    boost::shared_ptr<boost::thread> m_Writer;
   }; // Logger
 
   class LogChannel {
@@ -34,6 +34,7 @@
 #include <algorithm>
 #include <functional>
 #include <iterator>
+#include <limits>
 #include <sys/types.h>
 #include <time.h>
 #include <rrd.h>
@@ -60,6 +61,100 @@ namespace dss {
 
 static const int MAX_INTERPOLATION_INTERVAL = 7*24*60*60; // data not interpolated, if interval is longer
 static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
+static const int RRD_HEARTBEAT = 5; // see createDB
+static const unsigned int RRD_POWER_MAX = 40000;
+static const size_t RECENT_SAMPLE_COUNT = 3600; // one hour at the bus polling rate
+static const size_t RECENT_SAMPLE_COUNT_MAX = 24 * 3600; // allocated per meter, keep it bounded
+static const size_t SERIES_CACHE_SIZE = 128;
+static const time_t SERIES_CACHE_BLOCK_ROWS = 60; // cached windows are whole blocks of rows
+static const time_t SERIES_CACHE_UNSTAMPED_TTL = 60; // meters without recent samples can't invalidate
+
+  //================================================== MeteringRingBuffer
+
+  MeteringRingBuffer::MeteringRingBuffer(size_t _capacity)
+  : m_Capacity(std::max(_capacity, (size_t)1)),
+    m_Slots(new Slot[m_Capacity]),
+    m_Written(0),
+    m_First(0),
+    m_Latest(0)
+  {
+    for (size_t i = 0; i < m_Capacity; ++i) {
+      m_Slots[i].m_Sequence.store(0, boost::memory_order_relaxed);
+    }
+  } // ctor
+
+  void MeteringRingBuffer::push(time_t _timestamp, unsigned int _power, unsigned long long _energy) {
+    unsigned long long index = m_Written.load(boost::memory_order_relaxed);
+    if ((index > m_First.load(boost::memory_order_relaxed)) && (_timestamp <= m_Latest)) {
+      return;
+    }
+    Slot& slot = m_Slots[index % m_Capacity];
+    slot.m_Sequence.store(2 * index + 1, boost::memory_order_relaxed);
+    boost::atomic_thread_fence(boost::memory_order_release);
+    slot.m_Sample.m_Timestamp = _timestamp;
+    slot.m_Sample.m_Power = _power;
+    slot.m_Sample.m_Energy = _energy;
+    slot.m_Sequence.store(2 * index + 2, boost::memory_order_release);
+    m_Latest = _timestamp;
+    m_Written.store(index + 1, boost::memory_order_release);
+  } // push
+
+  void MeteringRingBuffer::reset() {
+    m_First.store(m_Written.load(boost::memory_order_relaxed), boost::memory_order_release);
+  } // reset
+
+  MeteringRingBuffer::Stamp MeteringRingBuffer::getStamp() const {
+    Stamp stamp;
+    for (;;) {
+      stamp.m_Written = m_Written.load(boost::memory_order_acquire);
+      stamp.m_First = m_First.load(boost::memory_order_acquire);
+      stamp.m_Latest = 0;
+      if (stamp.m_Written <= stamp.m_First) {
+        return stamp;
+      }
+      const Slot& slot = m_Slots[(stamp.m_Written - 1) % m_Capacity];
+      if (slot.m_Sequence.load(boost::memory_order_acquire) == 2 * stamp.m_Written) {
+        time_t latest = slot.m_Sample.m_Timestamp;
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        if (slot.m_Sequence.load(boost::memory_order_relaxed) == 2 * stamp.m_Written) {
+          stamp.m_Latest = latest;
+          return stamp;
+        }
+      }
+      // the writer went all the way around meanwhile, read again
+    }
+  } // getStamp
+
+  bool MeteringRingBuffer::copySince(time_t _from, std::vector<Sample>& _samples) const {
+    _samples.clear();
+    unsigned long long written = m_Written.load(boost::memory_order_acquire);
+    unsigned long long first = m_First.load(boost::memory_order_acquire);
+    if (written - first > m_Capacity) {
+      first = written - m_Capacity;
+    }
+    bool covered = false;
+    for (unsigned long long index = written; index > first; --index) {
+      const Slot& slot = m_Slots[(index - 1) % m_Capacity];
+      // the slot holds sample index-1 only while its sequence is 2*index
+      if (slot.m_Sequence.load(boost::memory_order_acquire) != 2 * index) {
+        break;
+      }
+      Sample sample = slot.m_Sample;
+      boost::atomic_thread_fence(boost::memory_order_acquire);
+      if (slot.m_Sequence.load(boost::memory_order_relaxed) != 2 * index) {
+        break;
+      }
+      _samples.push_back(sample);
+      if (sample.m_Timestamp <= _from) {
+        covered = true;
+        break;
+      }
+    }
+    std::reverse(_samples.begin(), _samples.end());
+    return covered;
+  } // copySince
+
+  //================================================== Metering
 
   struct find_rrd
   {
@@ -74,7 +169,9 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
 
   Metering::Metering(DSS* _pDSS)
     : ThreadedSubsystem(_pDSS, "Metering")
-    , m_pMeteringBusInterface(NULL) {
+    , m_pMeteringBusInterface(NULL)
+    , m_RecentSamples(boost::make_shared<const RecentSamplesMap>())
+    , m_RecentSampleCount(RECENT_SAMPLE_COUNT) {
     m_ConfigChain.reset(new MeteringConfigChain(1));
     m_ConfigChain->addConfig(MeteringConfig(                1,  600));
     m_ConfigChain->addConfig(MeteringConfig(               60,  720));
@@ -92,6 +189,14 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
         getDSS().getDataDirectory() + "metering/");
     m_MeteringStorageLocation = addTrailingBackslash(m_MeteringStorageLocation);
     m_RrdcachedPath = config->getOrCreateChildValue<std::string>("rrdDaemonAddress", "unix:/var/run/rrdcached.sock");
+    int recentSamples = config->getOrCreateChildValue<int>("recentSamples", RECENT_SAMPLE_COUNT);
+    if ((recentSamples < 1) || (static_cast<size_t>(recentSamples) > RECENT_SAMPLE_COUNT_MAX)) {
+      int clamped = (recentSamples < 1) ? 1 : RECENT_SAMPLE_COUNT_MAX;
+      log("recentSamples " + intToString(recentSamples) + " out of range, using " +
+          intToString(clamped), lsWarning);
+      recentSamples = clamped;
+    }
+    m_RecentSampleCount = recentSamples;
 
     if (isEnabled()) {
       if (!boost::filesystem::is_directory(m_MeteringStorageLocation)) {
@@ -295,8 +400,30 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
     if (result < 0) {
       log(rrd_get_error());
     }
+    recordRecentSample(_meter->getDSID(), _sampledAt.secondsSinceEpoch(), _valuePower, _valueEnergy);
   } // postMeteringEvent
 
+  void Metering::recordRecentSample(const dsuid_t& _dsuid, time_t _timestamp,
+                                    unsigned int _valuePower, unsigned long long _valueEnergy) {
+    // called with m_ValuesMutex held, which makes us the only writer
+    boost::shared_ptr<const RecentSamplesMap> recent = boost::atomic_load(&m_RecentSamples);
+    boost::shared_ptr<MeteringRingBuffer> buffer;
+    RecentSamplesMap::const_iterator it = recent->find(_dsuid);
+    if (it == recent->end()) {
+      boost::shared_ptr<RecentSamplesMap> copy = boost::make_shared<RecentSamplesMap>(*recent);
+      buffer = boost::make_shared<MeteringRingBuffer>(m_RecentSampleCount);
+      (*copy)[_dsuid] = buffer;
+      boost::atomic_store(&m_RecentSamples, boost::shared_ptr<const RecentSamplesMap>(copy));
+    } else {
+      buffer = it->second;
+    }
+    if (buffer->getLatest() - _timestamp > MAX_INTERPOLATION_INTERVAL) {
+      // the database gets recreated in this case, start over as well
+      buffer->reset();
+    }
+    buffer->push(_timestamp, _valuePower, _valueEnergy);
+  } // recordRecentSample
+
   int Metering::createDB(std::string& _filename, boost::shared_ptr<MeteringConfigChain> _pChain)
   {
     log("Creating new RRD database.", lsInfo);
@@ -418,6 +545,7 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
       if (result < 0) {
         log(rrd_get_error(), lsError);
       }
+      clearSeriesCache();
       if (!m_RrdcachedPath.empty()) {
         /* TODO sv restart rrdcached might hang */
         if (system("killall -9 rrdcached") != 0) {
@@ -456,32 +584,214 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
     }
   }
 
-  boost::shared_ptr<std::deque<Value> > Metering::getSeries(std::vector<boost::shared_ptr<DSMeter> > _meters,
-                                                            int &_resolution,
-                                                            SeriesTypes _type,
-                                                            bool _energyInWh,
-                                                            DateTime &_startTime,
-                                                            DateTime &_endTime,
-                                                            int &_valueCount) {
-    if (_meters.size() == 0) {
-      _meters = getDSS().getApartment().getDSMeters();
+  struct MeteringSegment {
+    time_t m_From;
+    time_t m_To;
+    double m_Rate;
+  }; // MeteringSegment
+
+  /** Turns samples into the rates rrdtool would see: a sample covers the
+    * time since its predecessor unless that gap exceeds the heartbeat,
+    * energy is derived like the DERIVE data source with a minimum of 0. */
+  static void buildSegments(const std::vector<MeteringRingBuffer::Sample>& _samples,
+                            bool _useEnergy,
+                            std::vector<MeteringSegment>& _segments) {
+    _segments.clear();
+    for (size_t i = 1; i < _samples.size(); ++i) {
+      const MeteringRingBuffer::Sample& previous = _samples[i - 1];
+      const MeteringRingBuffer::Sample& current = _samples[i];
+      time_t gap = current.m_Timestamp - previous.m_Timestamp;
+      if (gap > RRD_HEARTBEAT) {
+        continue;
+      }
+      MeteringSegment segment;
+      segment.m_From = previous.m_Timestamp;
+      segment.m_To = current.m_Timestamp;
+      if (_useEnergy) {
+        if (current.m_Energy < previous.m_Energy) {
+          continue;
+        }
+        segment.m_Rate = (double)(current.m_Energy - previous.m_Energy) / gap;
+      } else {
+        if (current.m_Power > RRD_POWER_MAX) {
+          continue;
+        }
+        segment.m_Rate = current.m_Power;
+      }
+      _segments.push_back(segment);
     }
+  } // buildSegments
+
+  /** Averages the segments over the rows (timeStamp - step, timeStamp] of
+    * \a _column, unknown rows (xff 0.5) stay 0 like the UN,0,IF in the
+    * database query. */
+  static void consolidateSegments(const std::vector<MeteringSegment>& _segments,
+                                  const std::vector<time_t>& _timestamps,
+                                  unsigned long _step,
+                                  std::vector<double>& _column) {
+    _column.assign(_timestamps.size(), 0.0);
+    size_t firstSegment = 0;
+    for (size_t row = 0; row < _timestamps.size(); ++row) {
+      time_t rowEnd = _timestamps[row];
+      time_t rowStart = rowEnd - _step;
+      while ((firstSegment < _segments.size()) && (_segments[firstSegment].m_To <= rowStart)) {
+        ++firstSegment;
+      }
+      double integral = 0.0;
+      time_t known = 0;
+      for (size_t i = firstSegment; (i < _segments.size()) && (_segments[i].m_From < rowEnd); ++i) {
+        time_t overlap = std::min(_segments[i].m_To, rowEnd) - std::max(_segments[i].m_From, rowStart);
+        integral += overlap * _segments[i].m_Rate;
+        known += overlap;
+      }
+      if ((known > 0) && (2 * (unsigned long)known >= _step)) {
+        _column[row] = integral / known;
+      }
+    }
+  } // consolidateSegments
 
-    int numberOfValues = 0;
+  static bool dsuidLess(const dsuid_t& _lhs, const dsuid_t& _rhs) {
+    return memcmp(_lhs.id, _rhs.id, DSUID_SIZE) < 0;
+  }
+
+  void Metering::getStamps(const std::vector<dsuid_t>& _meters,
+                           std::vector<MeteringRingBuffer::Stamp>& _stamps) const {
+    boost::shared_ptr<const RecentSamplesMap> recent = boost::atomic_load(&m_RecentSamples);
+    _stamps.clear();
+    foreach (const dsuid_t& dsuid, _meters) {
+      RecentSamplesMap::const_iterator it = recent->find(dsuid);
+      if (it == recent->end()) {
+        MeteringRingBuffer::Stamp none = { 0, 0, 0 };
+        _stamps.push_back(none);
+      } else {
+        _stamps.push_back(it->second->getStamp());
+      }
+    }
+  } // getStamps
+
+  boost::shared_ptr<const Metering::Series> Metering::lookupSeries(const SeriesKey& _key,
+                                                                  time_t _lastRow) {
+    boost::shared_ptr<const Series> result;
+    CachedSeries cached;
+    {
+      boost::mutex::scoped_lock lock(m_SeriesCacheMutex);
+      boost::unordered_map<SeriesKey, CachedSeries>::const_iterator it = m_SeriesCache.find(_key);
+      if (it == m_SeriesCache.end()) {
+        return result;
+      }
+      cached = it->second;
+    }
+    if ((cached.m_Expires != 0) && (DateTime().secondsSinceEpoch() >= cached.m_Expires)) {
+      return result;
+    }
+
+    // a sample only changes rows after its predecessor, so new samples
+    // don't matter once the meter had one at or past the last requested
+    // row, later rows of the entry are not handed out
+    std::vector<MeteringRingBuffer::Stamp> stamps;
+    getStamps(_key.m_Meters, stamps);
+    for (size_t i = 0; i < stamps.size(); ++i) {
+      const MeteringRingBuffer::Stamp& then = cached.m_Stamps[i];
+      const MeteringRingBuffer::Stamp& now = stamps[i];
+      if ((now.m_Written == then.m_Written) && (now.m_First == then.m_First)) {
+        continue;
+      }
+      if ((now.m_First != then.m_First) ||
+          (then.m_Written == then.m_First) ||
+          (then.m_Latest < _lastRow)) {
+        return result;
+      }
+    }
+    result = cached.m_Series;
+    return result;
+  } // lookupSeries
+
+  void Metering::storeSeries(const SeriesKey& _key,
+                             boost::shared_ptr<const Series> _series,
+                             const std::vector<MeteringRingBuffer::Stamp>& _stamps) {
+    boost::mutex::scoped_lock lock(m_SeriesCacheMutex);
+    if (m_SeriesCache.size() >= SERIES_CACHE_SIZE) {
+      m_SeriesCache.clear();
+    }
+    CachedSeries& cached = m_SeriesCache[_key];
+    cached.m_Series = _series;
+    cached.m_Stamps = _stamps;
+    cached.m_Expires = 0;
+    foreach (const MeteringRingBuffer::Stamp& stamp, _stamps) {
+      if (stamp.m_Written == 0) {
+        // no ring buffer tells us about new samples of this meter, re-read it after a while
+        cached.m_Expires = DateTime().secondsSinceEpoch() +
+                           std::min((time_t)_key.m_Step, SERIES_CACHE_UNSTAMPED_TTL);
+        break;
+      }
+    }
+  } // storeSeries
+
+  void Metering::clearSeriesCache() {
+    boost::mutex::scoped_lock lock(m_SeriesCacheMutex);
+    m_SeriesCache.clear();
+  } // clearSeriesCache
+
+  bool Metering::getRecentSeries(const SeriesKey& _key, Series& _series) {
+    // only serve steps the database keeps as well, it would pick another one otherwise
+    bool knownStep = false;
     for (int i = 0; i < m_ConfigChain->size(); ++i) {
-      if (m_ConfigChain->getResolution(i) <= _resolution) {
-        numberOfValues = m_ConfigChain->getNumberOfValues(i);
+      if (m_ConfigChain->getResolution(i) == (int)_key.m_Step) {
+        knownStep = true;
       }
     }
+    if (!knownStep || _key.m_Meters.empty() || (_key.m_End <= _key.m_Start)) {
+      return false;
+    }
 
-    boost::shared_ptr<std::deque<Value> > returnVector = boost::make_shared<std::deque<Value> >();
-    if (_meters.size() == 0) {
-      _valueCount = 0;
-      return returnVector;
+    _series.m_Start = _key.m_Start;
+    _series.m_End = _key.m_End;
+    _series.m_Step = _key.m_Step;
+    _series.m_Timestamps.clear();
+    for (time_t timeStamp = _key.m_Start + _key.m_Step; timeStamp <= (time_t)(_key.m_End - _key.m_Step); timeStamp += _key.m_Step) {
+      _series.m_Timestamps.push_back(timeStamp);
+    }
+    const size_t rows = _series.m_Timestamps.size();
+    _series.m_Values.assign(rows, 0.0);
+
+    bool useEnergy = !((_key.m_Type == etConsumption) && (_key.m_Step == 1));
+    boost::shared_ptr<const RecentSamplesMap> recent = boost::atomic_load(&m_RecentSamples);
+    std::vector<MeteringRingBuffer::Sample> samples;
+    std::vector<MeteringSegment> segments;
+    std::vector<double> column;
+    foreach (const dsuid_t& dsuid, _key.m_Meters) {
+      RecentSamplesMap::const_iterator it = recent->find(dsuid);
+      if ((it == recent->end()) || !it->second->copySince(_key.m_Start, samples)) {
+        return false;
+      }
+      buildSegments(samples, useEnergy, segments);
+      consolidateSegments(segments, _series.m_Timestamps, _key.m_Step, column);
+      // plain loop over two contiguous columns, left to the vectorizer
+      double* sum = rows ? &_series.m_Values[0] : NULL;
+      const double* values = rows ? &column[0] : NULL;
+      for (size_t row = 0; row < rows; ++row) {
+        sum[row] += values[row];
+      }
     }
+
+    foreach (double& value, _series.m_Values) {
+      if ((value < 0) || (value > RRD_POWER_MAX)) {
+        value = std::numeric_limits<double>::quiet_NaN();
+      } else if (_key.m_Type != etConsumption) {
+        value *= _key.m_Step;
+        if (_key.m_EnergyInWh) {
+          value /= 3600;
+        }
+      }
+    }
+    return true;
+  } // getRecentSeries
+
+  bool Metering::getStoredSeries(const std::vector<boost::shared_ptr<DSMeter> >& _meters,
+                                 const SeriesKey& _key, Series& _series) {
     std::vector<std::string> rrdFileNames;
 
-    for (std::vector<boost::shared_ptr<DSMeter> >::iterator iter = _meters.begin();
+    for (std::vector<boost::shared_ptr<DSMeter> >::const_iterator iter = _meters.begin();
          iter < _meters.end();
          ++iter) {
       if (! (*iter)->getCapability_HasMetering()) {
@@ -490,38 +800,9 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
       rrdFileNames.push_back(getOrCreateCachedSeries(m_ConfigChain, *iter));
     }
 
-    DateTime iCurrentTimeStamp;
-    long unsigned int step = _resolution;
-    time_t end = (iCurrentTimeStamp.secondsSinceEpoch() / step) * step;
-    time_t start = end - (step * numberOfValues);
-    _valueCount = std::min(_valueCount, numberOfValues);
-
-    if ((_startTime == DateTime::NullDate) && (_endTime == DateTime::NullDate) && (_valueCount == 0)) {
-      // now-(step*numberOfValues)..now
-    } else if ((_startTime == DateTime::NullDate) && (_endTime == DateTime::NullDate) && (_valueCount != 0)) {
-      // now-(step*valueCount)..now
-      start = end - (step * _valueCount);
-    } else if ((_startTime == DateTime::NullDate) && (_endTime != DateTime::NullDate) && (_valueCount == 0)) {
-      // now-(step*numberOfValues)..endTime
-      end = (_endTime.secondsSinceEpoch() / step) * step;
-    } else if ((_startTime == DateTime::NullDate) && (_endTime != DateTime::NullDate) && (_valueCount != 0)) {
-      // endTime-(step*valueCount)..endTime
-      end = (_endTime.secondsSinceEpoch() / step) * step;
-      start = end - (step * _valueCount);
-    } else if ((_startTime != DateTime::NullDate) && (_endTime == DateTime::NullDate) && (_valueCount == 0)) {
-      // startTime..now
-      start = (_startTime.secondsSinceEpoch() / step) * step;
-    } else if ((_startTime != DateTime::NullDate) && (_endTime == DateTime::NullDate) && (_valueCount != 0)) {
-      // startTime..startTime+(step*valueCount)
-      start = (_startTime.secondsSinceEpoch() / step) * step;
-      end = start + (step * _valueCount);
-    } else if ((_startTime != DateTime::NullDate) && (_endTime != DateTime::NullDate)) {
-      // startTime..endTime
-      start = (_startTime.secondsSinceEpoch() / step) * step;
-      end = (_endTime.secondsSinceEpoch() / step) * step;
-    }
-    end += step;
-
+    time_t start = _key.m_Start;
+    time_t end = _key.m_End;
+    long unsigned int step = _key.m_Step;
     unsigned long dscount = 0;
     char **names = 0;
     rrd_value_t *data = 0;
@@ -554,7 +835,7 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
         for (i = 0; i < size; ++i) {
           const char* filename = rrdFileNames.at(i).c_str();
           sstream << "DEF:raw" << i << "=" << filename;
-          if ((_type == etConsumption) && (step == 1)) {
+          if ((_key.m_Type == etConsumption) && (step == 1)) {
             sstream << ":power";
           } else {
             sstream << ":energy";
@@ -574,11 +855,11 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
         lines.push_back(sstream.str());
       }
       lines.push_back("CDEF:limit=sum,0,40000,LIMIT");
-      switch (_type) {
+      switch (_key.m_Type) {
       case etEnergy:
       case etEnergyDelta: {
         lines.push_back("CDEF:ratePerStep=limit," + intToString(step) + ",*");
-        if (_energyInWh) {
+        if (_key.m_EnergyInWh) {
           lines.push_back("CDEF:adj=ratePerStep,3600,/");
           lines.push_back("XPORT:adj");
         } else {
@@ -611,17 +892,140 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
 
     if (result != 0) {
       log(rrd_get_error());
-      return returnVector;
+      return false;
     }
     for (unsigned long i = 0; i < dscount; ++i) {
       rrd_freemem(names[i]);
     }
     rrd_freemem(names);
+    _series.m_Start = start;
+    _series.m_End = end;
+    _series.m_Step = step;
     rrd_value_t *currentData = data;
     for (time_t timeStamp = start + step; timeStamp <= (time_t)(end - step); timeStamp += step) {
-      returnVector->push_back(Value(*currentData, DateTime(timeStamp)));
+      _series.m_Timestamps.push_back(timeStamp);
+      _series.m_Values.push_back(*currentData);
       currentData++;
     }
+    rrd_freemem(data);
+    return true;
+  } // getStoredSeries
+
+  boost::shared_ptr<std::deque<Value> > Metering::getSeries(std::vector<boost::shared_ptr<DSMeter> > _meters,
+                                                            int &_resolution,
+                                                            SeriesTypes _type,
+                                                            bool _energyInWh,
+                                                            DateTime &_startTime,
+                                                            DateTime &_endTime,
+                                                            int &_valueCount) {
+    if (_meters.size() == 0) {
+      _meters = getDSS().getApartment().getDSMeters();
+    }
+
+    int numberOfValues = 0;
+    for (int i = 0; i < m_ConfigChain->size(); ++i) {
+      if (m_ConfigChain->getResolution(i) <= _resolution) {
+        numberOfValues = m_ConfigChain->getNumberOfValues(i);
+      }
+    }
+
+    boost::shared_ptr<std::deque<Value> > returnVector = boost::make_shared<std::deque<Value> >();
+    if (_meters.size() == 0) {
+      _valueCount = 0;
+      return returnVector;
+    }
+
+    DateTime iCurrentTimeStamp;
+    long unsigned int step = _resolution;
+    time_t end = (iCurrentTimeStamp.secondsSinceEpoch() / step) * step;
+    time_t start = end - (step * numberOfValues);
+    _valueCount = std::min(_valueCount, numberOfValues);
+
+    if ((_startTime == DateTime::NullDate) && (_endTime == DateTime::NullDate) && (_valueCount == 0)) {
+      // now-(step*numberOfValues)..now
+    } else if ((_startTime == DateTime::NullDate) && (_endTime == DateTime::NullDate) && (_valueCount != 0)) {
+      // now-(step*valueCount)..now
+      start = end - (step * _valueCount);
+    } else if ((_startTime == DateTime::NullDate) && (_endTime != DateTime::NullDate) && (_valueCount == 0)) {
+      // now-(step*numberOfValues)..endTime
+      end = (_endTime.secondsSinceEpoch() / step) * step;
+    } else if ((_startTime == DateTime::NullDate) && (_endTime != DateTime::NullDate) && (_valueCount != 0)) {
+      // endTime-(step*valueCount)..endTime
+      end = (_endTime.secondsSinceEpoch() / step) * step;
+      start = end - (step * _valueCount);
+    } else if ((_startTime != DateTime::NullDate) && (_endTime == DateTime::NullDate) && (_valueCount == 0)) {
+      // startTime..now
+      start = (_startTime.secondsSinceEpoch() / step) * step;
+    } else if ((_startTime != DateTime::NullDate) && (_endTime == DateTime::NullDate) && (_valueCount != 0)) {
+      // startTime..startTime+(step*valueCount)
+      start = (_startTime.secondsSinceEpoch() / step) * step;
+      end = start + (step * _valueCount);
+    } else if ((_startTime != DateTime::NullDate) && (_endTime != DateTime::NullDate)) {
+      // startTime..endTime
+      start = (_startTime.secondsSinceEpoch() / step) * step;
+      end = (_endTime.secondsSinceEpoch() / step) * step;
+    }
+    end += step;
+
+    SeriesKey exactKey;
+    exactKey.m_Step = step;
+    exactKey.m_Type = _type;
+    exactKey.m_EnergyInWh = _energyInWh;
+    exactKey.m_Start = start;
+    exactKey.m_End = end;
+    foreach (boost::shared_ptr<DSMeter> pMeter, _meters) {
+      if (pMeter->getCapability_HasMetering()) {
+        exactKey.m_Meters.push_back(pMeter->getDSID());
+      }
+    }
+    std::sort(exactKey.m_Meters.begin(), exactKey.m_Meters.end(), dsuidLess);
+
+    // entries cover whole blocks of rows, so a rolling window keeps hitting
+    // the same entry until it moves into the next block
+    SeriesKey key = exactKey;
+    const time_t block = step * SERIES_CACHE_BLOCK_ROWS;
+    key.m_Start = (start / block) * block;
+    key.m_End = ((end + block - 1) / block) * block;
+
+    const time_t lastRow = end - step;
+    boost::shared_ptr<const Series> series = lookupSeries(key, lastRow);
+    if (series == NULL) {
+      series = lookupSeries(exactKey, lastRow);
+    }
+    if (series == NULL) {
+      // stamps first: a sample arriving meanwhile makes the entry stale, not wrong
+      std::vector<MeteringRingBuffer::Stamp> stamps;
+      getStamps(key.m_Meters, stamps);
+      boost::shared_ptr<Series> computed = boost::make_shared<Series>();
+      if (getRecentSeries(key, *computed)) {
+        storeSeries(key, computed, stamps);
+      } else if (getRecentSeries(exactKey, *computed)) {
+        // the recent samples don't reach back to the start of the block
+        storeSeries(exactKey, computed, stamps);
+      } else {
+        // not in memory (anymore), ask the database for exactly the requested
+        // rows, a block aligned window would change its step and row count
+        *computed = Series();
+        if (!getStoredSeries(_meters, exactKey, *computed)) {
+          return returnVector;
+        }
+        storeSeries(exactKey, computed, stamps);
+      }
+      series = computed;
+    }
+
+    // cut the entry to the requested rows
+    std::vector<time_t>::const_iterator first =
+      std::upper_bound(series->m_Timestamps.begin(), series->m_Timestamps.end(), start);
+    std::vector<time_t>::const_iterator last =
+      std::upper_bound(first, series->m_Timestamps.end(), lastRow);
+    for (std::vector<time_t>::const_iterator it = first; it != last; ++it) {
+      size_t row = it - series->m_Timestamps.begin();
+      returnVector->push_back(Value(series->m_Values[row], DateTime(*it)));
+    }
+    start = std::max(start, series->m_Start);
+    end = std::min(end, series->m_End);
+    step = series->m_Step;
     bool lastValueEmpty = false;
     if ((returnVector->size() > 0) && (returnVector->back().getValue() == 0)) {
       lastValueEmpty = true;
@@ -663,7 +1067,6 @@ static const int DISK_FLUSH_INTERVAL = 10*60; // ten minutes
       // delete the last value, if it is Unknown (zero)
       returnVector->pop_back();
     }
-    rrd_freemem(data);
     _resolution = step;
     _startTime = DateTime(start);
     _endTime = DateTime(end);
@@ -26,11 +26,18 @@
 
 #include "src/subsystem.h"
 #include "src/datetools.h"
+#include "src/ds485types.h"
 
 #include <string>
 #include <vector>
 #include <deque>
+#include <algorithm>
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/ptr_container/ptr_map.hpp>
 #include <boost/thread/mutex.hpp>
@@ -77,8 +84,60 @@ namespace dss {
     std::string m_RrdFile;
   }; // RRDLookup
 
+  /** Most recent metering samples of one dSMeter, kept in memory in front
+    * of the RRD. There is a single writer, readers never lock: every slot
+    * carries a sequence number that is odd while the slot is rewritten, so a
+    * reader that raced with the writer notices it and stops there. */
+  class MeteringRingBuffer : boost::noncopyable {
+  public:
+    struct Sample {
+      time_t m_Timestamp;
+      unsigned int m_Power;
+      unsigned long long m_Energy;
+    }; // Sample
+
+    /** Identifies the contents of the buffer at one point in time. */
+    struct Stamp {
+      unsigned long long m_Written;
+      unsigned long long m_First;
+      time_t m_Latest;
+    }; // Stamp
+
+    explicit MeteringRingBuffer(size_t _capacity);
+
+    /** Appends a sample. Like rrd_update, samples that are not newer than
+      * the latest one are dropped. */
+    void push(time_t _timestamp, unsigned int _power, unsigned long long _energy);
+    /** Forgets all samples, e.g. after the clock jumped back. */
+    void reset();
+    /** Timestamp of the latest sample pushed, writer side only. */
+    time_t getLatest() const { return m_Latest; }
+    size_t getCapacity() const { return m_Capacity; }
+    /** Reads the number of samples written together with the timestamp
+      * of the latest one, without locking. */
+    Stamp getStamp() const;
+    /** Copies the samples from the last one at or before \a _from up to
+      * the latest, oldest first. Returns false if the buffer does not
+      * reach back to \a _from. */
+    bool copySince(time_t _from, std::vector<Sample>& _samples) const;
+  private:
+    struct Slot {
+      boost::atomic<unsigned long long> m_Sequence;
+      Sample m_Sample;
+    }; // Slot
+
+    const size_t m_Capacity;
+    boost::scoped_array<Slot> m_Slots;
+    boost::atomic<unsigned long long> m_Written;
+    boost::atomic<unsigned long long> m_First;
+    time_t m_Latest; // writer only
+  }; // MeteringRingBuffer
+
   class Metering : public ThreadedSubsystem {
   private:
+    typedef boost::unordered_map<dsuid_t, boost::shared_ptr<MeteringRingBuffer>,
+                                 DsuidHash, DsuidEqual> RecentSamplesMap;
+
     std::string m_MeteringStorageLocation;
     std::string m_RrdcachedPath;
     boost::shared_ptr<MeteringConfigChain> m_ConfigChain;
@@ -88,6 +147,9 @@ namespace dss {
 
     boost::mutex m_ValuesMutex;
     MeteringBusInterface* m_pMeteringBusInterface;
+    /** Copied on write when a meter is seen for the first time. */
+    boost::shared_ptr<const RecentSamplesMap> m_RecentSamples;
+    size_t m_RecentSampleCount;
   private:
     virtual void initialize();
     virtual void execute();
@@ -100,6 +162,8 @@ namespace dss {
       boost::shared_ptr<DSMeter> _pMeter);
     int createDB(std::string& _filename, boost::shared_ptr<MeteringConfigChain> _pChain);
     void syncCachedDBValues();
+    void recordRecentSample(const dsuid_t& _dsuid, time_t _timestamp,
+                            unsigned int _valuePower, unsigned long long _valueEnergy);
   protected:
     // protected for testing
     bool checkDBReset(DateTime& _sampledAt, std::string& _rrdFileName);
@@ -128,6 +192,69 @@ namespace dss {
                                                     DateTime &_endTime,
                                                     int &_valueCount);
     unsigned long getLastEnergyCounter(boost::shared_ptr<DSMeter> _meter);
+  private:
+    /** Rows of a series, column wise, before the energy counter and the
+      * trailing unknown row are applied. */
+    struct Series {
+      time_t m_Start;
+      time_t m_End;
+      unsigned long m_Step;
+      std::vector<time_t> m_Timestamps;
+      std::vector<double> m_Values;
+    }; // Series
+
+    struct SeriesKey {
+      std::vector<dsuid_t> m_Meters; // sorted, metering capable only
+      unsigned long m_Step;
+      SeriesTypes m_Type;
+      bool m_EnergyInWh;
+      time_t m_Start;
+      time_t m_End;
+
+      bool operator==(const SeriesKey& _other) const {
+        return (m_Step == _other.m_Step) &&
+               (m_Type == _other.m_Type) &&
+               (m_EnergyInWh == _other.m_EnergyInWh) &&
+               (m_Start == _other.m_Start) &&
+               (m_End == _other.m_End) &&
+               (m_Meters.size() == _other.m_Meters.size()) &&
+               std::equal(m_Meters.begin(), m_Meters.end(), _other.m_Meters.begin(), DsuidEqual());
+      }
+
+      friend std::size_t hash_value(const SeriesKey& _key) {
+        std::size_t seed = 0;
+        boost::hash_combine(seed, _key.m_Step);
+        boost::hash_combine(seed, (int)_key.m_Type);
+        boost::hash_combine(seed, _key.m_EnergyInWh);
+        boost::hash_combine(seed, _key.m_Start);
+        boost::hash_combine(seed, _key.m_End);
+        for (std::vector<dsuid_t>::const_iterator it = _key.m_Meters.begin(); it != _key.m_Meters.end(); ++it) {
+          boost::hash_combine(seed, DsuidHash()(*it));
+        }
+        return seed;
+      }
+    }; // SeriesKey
+
+    struct CachedSeries {
+      boost::shared_ptr<const Series> m_Series;
+      std::vector<MeteringRingBuffer::Stamp> m_Stamps; // one per key meter
+      time_t m_Expires; // 0 if the stamps cover every meter
+    }; // CachedSeries
+
+    boost::unordered_map<SeriesKey, CachedSeries> m_SeriesCache;
+    boost::mutex m_SeriesCacheMutex;
+
+    void getStamps(const std::vector<dsuid_t>& _meters,
+                   std::vector<MeteringRingBuffer::Stamp>& _stamps) const;
+    /** Returns the cached series if its rows up to \a _lastRow are final */
+    boost::shared_ptr<const Series> lookupSeries(const SeriesKey& _key, time_t _lastRow);
+    void storeSeries(const SeriesKey& _key,
+                     boost::shared_ptr<const Series> _series,
+                     const std::vector<MeteringRingBuffer::Stamp>& _stamps);
+    void clearSeriesCache();
+    bool getRecentSeries(const SeriesKey& _key, Series& _series);
+    bool getStoredSeries(const std::vector<boost::shared_ptr<DSMeter> >& _meters,
+                         const SeriesKey& _key, Series& _series);
   }; // Metering
 
   struct MeteringConfig {
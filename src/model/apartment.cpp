@@ -27,6 +27,7 @@
 
 #include "apartment.h"
 
+#include <algorithm>
 #include <ds/log.h>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/make_shared.hpp>
@@ -53,17 +54,22 @@
 #include "src/model/modulator.h"
 #include "src/model/state.h"
 #include "src/metering/metering.h"
+#include "src/setbuilder.h"
 
 namespace dss {
 
   //================================================== Apartment
 
+  static boost::atomic<unsigned long long> s_NextGeneration(0);
+
   Apartment::Apartment(DSS* dss)
   : m_dss(dss),
     m_pBusInterface(NULL),
     m_pModelMaintenance(NULL),
     m_pPropertySystem(NULL),
-    m_pMetering(NULL)
+    m_pMetering(NULL),
+    m_Generation(++s_NextGeneration),
+    m_pSetBuilderCache(new SetBuilderCache())
   {
     // create default (broadcast) zone
     boost::shared_ptr<Zone> zoneZero = allocateZone(0);
@@ -71,8 +77,16 @@ namespace dss {
   } // ctor
 
   Apartment::~Apartment() {
+    m_ZoneByID.clear();
     m_Zones.clear();
     m_DSMeters.clear();
+    m_DeviceByDSUID.clear();
+    m_DeviceByName.clear();
+    m_DeviceByBusAddress.clear();
+    m_DeviceBySerial.clear();
+    m_ZoneMembers.clear();
+    m_GroupMembers.clear();
+    m_DevicesBySlot.clear();
     m_Devices.clear();
     m_States.clear();
 
@@ -83,6 +97,10 @@ namespace dss {
     m_pMetering = NULL;
   } // dtor
 
+  void Apartment::bumpGeneration() {
+    m_Generation = ++s_NextGeneration;
+  } // bumpGeneration
+
   void Apartment::addDefaultGroupsToZone(boost::shared_ptr<Zone> _zone) {
     boost::shared_ptr<Group> grp = boost::make_shared<Group>(GroupIDBroadcast, _zone);
     grp->setName("broadcast");
@@ -154,15 +172,198 @@ namespace dss {
     _zone->addGroup(grp);
   } // addDefaultGroupsToZone
 
+  static void setDeviceBit(DeviceBitmap& _bits, const std::size_t _slot, const bool _value) {
+    if (_bits.size() <= _slot) {
+      if (!_value) {
+        return;
+      }
+      _bits.resize(_slot + 1);
+    }
+    _bits[_slot] = _value;
+  } // setDeviceBit
+
+  void Apartment::indexDevice(boost::shared_ptr<Device> _device, const std::size_t _slot) {
+    IndexedDevice entry;
+    entry.device = _device;
+    entry.slot = _slot;
+    entry.name = _device->getName();
+    entry.dsMeterDSID = _device->getDSMeterDSID();
+    entry.shortAddress = _device->getShortAddress();
+    entry.zoneID = _device->getZoneID();
+    entry.groupIds = _device->getGroupIds();
+    m_DeviceByName.insert(std::make_pair(entry.name, _device));
+    m_DeviceByBusAddress.insert(std::make_pair(BusAddress(entry.dsMeterDSID, entry.shortAddress), _device));
+    setDeviceBit(m_ZoneMembers[entry.zoneID], _slot, true);
+    foreach(int groupID, entry.groupIds) {
+      setDeviceBit(m_GroupMembers[groupID], _slot, true);
+    }
+    m_DeviceByDSUID[_device->getDSID()] = entry;
+  } // indexDevice
+
+  template<class Index>
+  static void eraseFromIndex(Index& _index, const typename Index::key_type& _key,
+                             const boost::shared_ptr<Device>& _device) {
+    std::pair<typename Index::iterator, typename Index::iterator> range = _index.equal_range(_key);
+    for (typename Index::iterator it = range.first; it != range.second; ++it) {
+      if (it->second == _device) {
+        _index.erase(it);
+        return;
+      }
+    }
+  } // eraseFromIndex
+
+  void Apartment::unindexDevice(const IndexedDevice& _entry) {
+    eraseFromIndex(m_DeviceByName, _entry.name, _entry.device);
+    eraseFromIndex(m_DeviceByBusAddress, BusAddress(_entry.dsMeterDSID, _entry.shortAddress), _entry.device);
+    setDeviceBit(m_ZoneMembers[_entry.zoneID], _entry.slot, false);
+    foreach(int groupID, _entry.groupIds) {
+      setDeviceBit(m_GroupMembers[groupID], _entry.slot, false);
+    }
+  } // unindexDevice
+
+  void Apartment::reindexDevice(const Device& _device) {
+    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    auto it = m_DeviceByDSUID.find(_device.getDSID());
+    if ((it == m_DeviceByDSUID.end()) || (it->second.device.get() != &_device)) {
+      // not (yet) part of the apartment, allocateDevice will index it
+      return;
+    }
+    boost::shared_ptr<Device> device = it->second.device;
+    std::size_t slot = it->second.slot;
+    unindexDevice(it->second);
+    indexDevice(device, slot);
+    bumpGeneration();
+  } // reindexDevice
+
+  DeviceBitmap Apartment::getDeviceBitmap() const {
+    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    DeviceBitmap result(m_DeviceMembers);
+    result.resize(m_SlotDSUIDs.size());
+    return result;
+  } // getDeviceBitmap
+
+  bool Apartment::tryGetDeviceSlot(const dsuid_t& _dsid, std::size_t& _slot) const {
+    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    auto it = m_DeviceByDSUID.find(_dsid);
+    if (it == m_DeviceByDSUID.end()) {
+      return false;
+    }
+    _slot = it->second.slot;
+    return true;
+  } // tryGetDeviceSlot
+
+  void Apartment::intersectWithZone(DeviceBitmap& _bits, const int _zoneID) const {
+    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    auto it = m_ZoneMembers.find(_zoneID);
+    if (it == m_ZoneMembers.end()) {
+      _bits.reset();
+    } else {
+      intersectDeviceBitmaps(_bits, it->second);
+    }
+  } // intersectWithZone
+
+  void Apartment::intersectWithGroup(DeviceBitmap& _bits, const int _groupID) const {
+    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    auto it = m_GroupMembers.find(_groupID);
+    if (it == m_GroupMembers.end()) {
+      _bits.reset();
+    } else {
+      intersectDeviceBitmaps(_bits, it->second);
+    }
+  } // intersectWithGroup
+
+  std::vector<DeviceReference> Apartment::resolveDeviceBitmap(const DeviceBitmap& _bits) const {
+    std::vector<DeviceReference> result;
+    result.reserve(_bits.count());
+    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    for (std::size_t slot = _bits.find_first(); slot != DeviceBitmap::npos; slot = _bits.find_next(slot)) {
+      // removed devices keep their slot, a reference to them would throw
+      if (m_DevicesBySlot.at(slot)) {
+        result.push_back(DeviceReference(m_SlotDSUIDs[slot], this));
+      }
+    }
+    return result;
+  } // resolveDeviceBitmap
+
+  std::vector<std::pair<std::size_t, boost::shared_ptr<Device> > > Apartment::resolveDevices(const DeviceBitmap& _bits) const {
+    std::vector<std::pair<std::size_t, boost::shared_ptr<Device> > > result;
+    result.reserve(_bits.count());
+    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    for (std::size_t slot = _bits.find_first(); slot != DeviceBitmap::npos; slot = _bits.find_next(slot)) {
+      if (m_DevicesBySlot.at(slot)) {
+        result.push_back(std::make_pair(slot, m_DevicesBySlot[slot]));
+      }
+    }
+    return result;
+  } // resolveDevices
+
+  /** Names and bus addresses are not necessarily unique (e.g. inactive
+    * devices all share the stale short address), in that case the first
+    * matching device in allocation order wins, just as with a linear scan. */
+  template<class Index>
+  boost::shared_ptr<Device> Apartment::firstIndexed(const Index& _index, const typename Index::key_type& _key) const {
+    std::pair<typename Index::const_iterator, typename Index::const_iterator> range = _index.equal_range(_key);
+    if (range.first == range.second) {
+      return boost::shared_ptr<Device>();
+    }
+    typename Index::const_iterator next = range.first;
+    if (++next == range.second) {
+      return range.first->second;
+    }
+    foreach(boost::shared_ptr<Device> dev, m_Devices) {
+      for (typename Index::const_iterator it = range.first; it != range.second; ++it) {
+        if (it->second == dev) {
+          return dev;
+        }
+      }
+    }
+    return boost::shared_ptr<Device>();
+  } // firstIndexed
+
   boost::shared_ptr<Device> Apartment::tryGetDeviceByDSID(const dsuid_t dsid) const {
     boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    auto it = m_DeviceByDSUID.find(dsid);
+    if (it != m_DeviceByDSUID.end()) {
+      return it->second.device;
+    }
+    return boost::shared_ptr<Device>();
+  }
+
+  boost::shared_ptr<Device> Apartment::tryGetDeviceByBusID(const devid_t _busID, const dsuid_t& _dsMeterID) const {
+    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    return firstIndexed(m_DeviceByBusAddress, BusAddress(_dsMeterID, _busID));
+  } // tryGetDeviceByBusID
+
+  boost::shared_ptr<Device> Apartment::getDeviceByBusID(const devid_t _busID, const dsuid_t& _dsMeterID) const {
+    auto device = tryGetDeviceByBusID(_busID, _dsMeterID);
+    if (!device) {
+      throw ItemNotFoundException(std::string("with busid ") + intToString(_busID));
+    }
+    return device;
+  } // getDeviceByBusID
+
+  boost::shared_ptr<Device> Apartment::tryGetDeviceBySerial(const uint32_t _serial) const {
+    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
+    // the serial is derived from the dSUID, but vdc devices only become
+    // known as such after allocation, so filter them here
+    std::pair<DeviceSerialIndex::const_iterator, DeviceSerialIndex::const_iterator> range =
+      m_DeviceBySerial.equal_range(_serial);
+    std::vector<boost::shared_ptr<Device> > candidates;
+    for (DeviceSerialIndex::const_iterator it = range.first; it != range.second; ++it) {
+      if (!it->second->isVdcDevice()) {
+        candidates.push_back(it->second);
+      }
+    }
+    if (candidates.size() <= 1) {
+      return candidates.empty() ? boost::shared_ptr<Device>() : candidates.front();
+    }
     foreach(boost::shared_ptr<Device> dev, m_Devices) {
-      if (dev->getDSID() == dsid) {
+      if (std::find(candidates.begin(), candidates.end(), dev) != candidates.end()) {
         return dev;
       }
     }
     return boost::shared_ptr<Device>();
-  }
+  } // tryGetDeviceBySerial
 
   boost::shared_ptr<Device> Apartment::getDeviceByDSID(const dsuid_t dsid) const {
     auto device = tryGetDeviceByDSID(dsid);
@@ -174,22 +375,15 @@ namespace dss {
 
   boost::shared_ptr<Device> Apartment::getDeviceByName(const std::string& _name) {
     boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
-    foreach(boost::shared_ptr<Device> dev, m_Devices) {
-      if(dev->getName() == _name) {
-        return dev;
-      }
+    boost::shared_ptr<Device> result = firstIndexed(m_DeviceByName, _name);
+    if (result) {
+      return result;
     }
     throw ItemNotFoundException(_name);
   } // getDeviceByName
 
   Set Apartment::getDevices() const {
-    std::vector<DeviceReference> devs;
-    boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
-    foreach(boost::shared_ptr<Device> dev, m_Devices) {
-      devs.push_back(DeviceReference(dev, this));
-    }
-
-    return Set(devs);
+    return Set(this, getDeviceBitmap());
   } // getDevices
 
   boost::shared_ptr<Zone> Apartment::getZone(const std::string& _zoneName) {
@@ -204,10 +398,9 @@ namespace dss {
 
   boost::weak_ptr<Zone> Apartment::tryGetZone(const int id) {
     boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
-    foreach (auto&& zone, m_Zones) {
-      if(zone->getID() == id) {
-        return zone;
-      }
+    auto it = m_ZoneByID.find(id);
+    if (it != m_ZoneByID.end()) {
+      return it->second;
     }
     return boost::weak_ptr<Zone>();
   }
@@ -323,19 +516,24 @@ namespace dss {
 
   boost::shared_ptr<Device> Apartment::allocateDevice(const dsuid_t _dsid) {
     boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
-    boost::shared_ptr<Device> pResult;
     // search for existing device
-    foreach(boost::shared_ptr<Device> device, m_Devices) {
-      if (device->getDSID() == _dsid) {
-        pResult = device;
-        break;
-      }
-    }
+    boost::shared_ptr<Device> pResult = tryGetDeviceByDSID(_dsid);
 
     if(pResult == NULL) {
       pResult.reset(new Device(_dsid, this));
       pResult->setFirstSeen(DateTime());
       m_Devices.push_back(pResult);
+      std::size_t slot = m_SlotDSUIDs.size();
+      m_SlotDSUIDs.push_back(_dsid);
+      m_DevicesBySlot.push_back(pResult);
+      setDeviceBit(m_DeviceMembers, slot, true);
+      indexDevice(pResult, slot);
+      bumpGeneration();
+      uint32_t serial;
+      dsuid_t dsuid = _dsid;
+      if (dsuid_get_serial_number(&dsuid, &serial) == 0) {
+        m_DeviceBySerial.insert(std::make_pair(serial, pResult));
+      }
     }
     DeviceReference devRef(pResult, this);
     getZone(0)->addDevice(devRef);
@@ -359,19 +557,15 @@ namespace dss {
 
   boost::shared_ptr<Zone> Apartment::allocateZone(int _zoneID) {
     boost::recursive_mutex::scoped_lock scoped_lock(m_mutex);
-    boost::shared_ptr<Zone> result;
-    foreach(boost::shared_ptr<Zone> zone, m_Zones) {
-      if(zone->getID() == _zoneID) {
-        result = zone;
-        break;
-      }
-    }
+    boost::shared_ptr<Zone> result = tryGetZone(_zoneID).lock();
 
     if(result == NULL) {
       result.reset(new Zone(_zoneID, this));
       result->publishToPropertyTree();
       addDefaultGroupsToZone(result);
       m_Zones.push_back(result);
+      m_ZoneByID[_zoneID] = result;
+      bumpGeneration();
 
       if (_zoneID == 0) {
         for (int i = GroupIDAppUserMin; i <= GroupIDAppUserMax; ++i) {
@@ -407,7 +601,9 @@ namespace dss {
       boost::shared_ptr<Zone> pZone = *ipZone;
       if(pZone->getID() == _zoneID) {
         pZone->removeFromPropertyTree();
+        m_ZoneByID.erase(_zoneID);
         m_Zones.erase(ipZone);
+        bumpGeneration();
         return;
       }
     }
@@ -451,7 +647,19 @@ namespace dss {
         pDevice->clearStates(); // calls apartment->removeState() from inside
 
         // Erase
+        auto indexed = m_DeviceByDSUID.find(_device);
+        if (indexed != m_DeviceByDSUID.end()) {
+          unindexDevice(indexed->second);
+          setDeviceBit(m_DeviceMembers, indexed->second.slot, false);
+          m_DevicesBySlot[indexed->second.slot].reset();
+          m_DeviceByDSUID.erase(indexed);
+        }
+        uint32_t serial;
+        if (dsuid_get_serial_number(&_device, &serial) == 0) {
+          eraseFromIndex(m_DeviceBySerial, serial, pDevice);
+        }
         m_Devices.erase(ipDevice);
+        bumpGeneration();
         return;
       }
     }
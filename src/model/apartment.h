@@ -26,9 +26,12 @@
 #include <vector>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/atomic.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/unordered_map.hpp>
 #include <regex.h>
 #include <set>
 
@@ -49,6 +52,7 @@ namespace dss {
   class Metering;
   class DeviceBusInterface;
   class ActionRequestInterface;
+  class SetBuilderCache;
 
   typedef struct ApartmentSensorStatus {
     ApartmentSensorStatus() :
@@ -134,13 +138,74 @@ typedef struct {
     PropertySystem* m_pPropertySystem;
     Metering* m_pMetering;
     mutable boost::recursive_mutex m_mutex;
+    boost::atomic<unsigned long long> m_Generation;
+    boost::scoped_ptr<SetBuilderCache> m_pSetBuilderCache;
+
+    /** Keys a device was last indexed with, so that it can be found
+      * again in the secondary indexes once they change */
+    struct IndexedDevice {
+      boost::shared_ptr<Device> device;
+      std::size_t slot;
+      std::string name;
+      dsuid_t dsMeterDSID;
+      devid_t shortAddress;
+      int zoneID;
+      std::vector<int> groupIds;
+    };
+    typedef std::pair<dsuid_t, devid_t> BusAddress;
+    struct BusAddressHash {
+      std::size_t operator()(const BusAddress& _address) const {
+        std::size_t seed = DsuidHash()(_address.first);
+        boost::hash_combine(seed, _address.second);
+        return seed;
+      }
+    };
+    struct BusAddressEqual {
+      bool operator()(const BusAddress& _lhs, const BusAddress& _rhs) const {
+        return (_lhs.second == _rhs.second) && DsuidEqual()(_lhs.first, _rhs.first);
+      }
+    };
+    typedef boost::unordered_multimap<std::string, boost::shared_ptr<Device> > DeviceNameIndex;
+    typedef boost::unordered_multimap<BusAddress, boost::shared_ptr<Device>, BusAddressHash, BusAddressEqual> DeviceBusIndex;
+    typedef boost::unordered_multimap<uint32_t, boost::shared_ptr<Device> > DeviceSerialIndex;
+
+    boost::unordered_map<dsuid_t, IndexedDevice, DsuidHash, DsuidEqual> m_DeviceByDSUID;
+    DeviceNameIndex m_DeviceByName;
+    DeviceBusIndex m_DeviceByBusAddress;
+    DeviceSerialIndex m_DeviceBySerial;
+    boost::unordered_map<int, boost::shared_ptr<Zone> > m_ZoneByID;
+
+    /** Every allocated device gets a slot number, in allocation order.
+      * Slots are not reused so that a bitmap taken earlier never picks up
+      * a device allocated later, removed slots are skipped when a bitmap
+      * gets resolved. Bitmaps therefore grow with the number of devices
+      * allocated since startup rather than with the number of devices
+      * present. Devices only get removed on user request, so that is a
+      * bit per removal and not worth the bookkeeping of reusing slots. */
+    std::vector<dsuid_t> m_SlotDSUIDs;
+    std::vector<boost::shared_ptr<Device> > m_DevicesBySlot;
+    DeviceBitmap m_DeviceMembers;
+    boost::unordered_map<int, DeviceBitmap> m_ZoneMembers;
+    boost::unordered_map<int, DeviceBitmap> m_GroupMembers;
   private:
     void addDefaultGroupsToZone(boost::shared_ptr<Zone> _zone);
+    void indexDevice(boost::shared_ptr<Device> _device, const std::size_t _slot);
+    void unindexDevice(const IndexedDevice& _entry);
+    template<class Index>
+    boost::shared_ptr<Device> firstIndexed(const Index& _index, const typename Index::key_type& _key) const;
   public:
     Apartment(DSS* _pDSS);
     virtual ~Apartment();
 
     boost::recursive_mutex& getMutex() const { return m_mutex; }
+
+    /** Changes whenever the structure of the model might have changed,
+      * e.g. to invalidate cached sets. Values are never reused, not even
+      * by another apartment instance. */
+    unsigned long long getGeneration() const { return m_Generation; }
+    void bumpGeneration();
+    /** Compiled set descriptions and sets, see SetBuilder */
+    SetBuilderCache& getSetBuilderCache() { return *m_pSetBuilderCache; }
     DSS* getDss() { return m_dss; }
 
     /** Returns a set containing all devices of the set */
@@ -152,6 +217,27 @@ typedef struct {
     boost::shared_ptr<Device> getDeviceByDSID(const dsuid_t _dsid) const;
     /** Returns a reference to the device with the name \a _name*/
     boost::shared_ptr<Device> getDeviceByName(const std::string& _name);
+    /// Returns the device at short address \a _busID on the dSM \a _dsMeterID, nullptr if not found.
+    boost::shared_ptr<Device> tryGetDeviceByBusID(const devid_t _busID, const dsuid_t& _dsMeterID) const;
+    /// Returns the device at short address \a _busID on the dSM \a _dsMeterID, throws if not found
+    boost::shared_ptr<Device> getDeviceByBusID(const devid_t _busID, const dsuid_t& _dsMeterID) const;
+    /// Returns the (non vdc) device with serial number \a _serial, nullptr if not found.
+    boost::shared_ptr<Device> tryGetDeviceBySerial(const uint32_t _serial) const;
+    /** Updates the lookup indexes after the name, short address, dSM, zone
+      * or groups of \a _device changed. Called by Device itself. */
+    void reindexDevice(const Device& _device);
+
+    /** Device bitmaps, used by Set to filter without touching devices */
+    DeviceBitmap getDeviceBitmap() const;
+    bool tryGetDeviceSlot(const dsuid_t& _dsid, std::size_t& _slot) const;
+    /** Clears all bits in \a _bits of devices not in zone \a _zoneID */
+    void intersectWithZone(DeviceBitmap& _bits, const int _zoneID) const;
+    /** Clears all bits in \a _bits of devices not in group \a _groupID */
+    void intersectWithGroup(DeviceBitmap& _bits, const int _groupID) const;
+    /** Returns references to the devices in \a _bits, in slot order */
+    std::vector<DeviceReference> resolveDeviceBitmap(const DeviceBitmap& _bits) const;
+    /** Returns the devices in \a _bits, in slot order; removed ones are skipped */
+    std::vector<std::pair<std::size_t, boost::shared_ptr<Device> > > resolveDevices(const DeviceBitmap& _bits) const;
     std::vector<boost::shared_ptr<Device> > getDevicesVector() { return m_Devices; }
 
     /** Returns the Zone by name */
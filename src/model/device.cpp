@@ -616,6 +616,10 @@ namespace dss {
   } // isOn
 
   void Device::setPartiallyFromSpec(const DeviceSpec_t& spec) {
+    if (m_pApartment != NULL) {
+      // function id and output mode are matched by set descriptions
+      m_pApartment->bumpGeneration();
+    }
     m_FunctionID = spec.FunctionID;
     m_ProductID = spec.ProductID;
     m_VendorID = spec.VendorID;
@@ -1243,11 +1247,17 @@ namespace dss {
   void Device::setName(const std::string& _name) {
     if (m_Name != _name) {
       m_Name = _name;
+      if (m_pApartment != NULL) {
+        m_pApartment->reindexDevice(*this);
+      }
       dirty();
     }
   } // setName
 
   void Device::dirty() {
+    if (m_pApartment != NULL) {
+      m_pApartment->bumpGeneration();
+    }
     if ((m_pApartment != NULL) && (m_pApartment->getModelMaintenance() != NULL)) {
       m_pApartment->getModelMaintenance()->addModelEvent(
           new ModelEvent(ModelEvent::etModelDirty)
@@ -1269,6 +1279,9 @@ namespace dss {
   void Device::setShortAddress(const devid_t _shortAddress) {
     m_ShortAddress = _shortAddress;
     m_LastKnownShortAddress = _shortAddress;
+    if (m_pApartment != NULL) {
+      m_pApartment->reindexDevice(*this);
+    }
     publishToPropertyTree();
     m_LastDiscovered = DateTime();
   } // setShortAddress
@@ -1305,6 +1318,9 @@ namespace dss {
     }
     m_DSMeterDSID = _dsMeter->getDSID();
     m_LastKnownMeterDSID = _dsMeter->getDSID();
+    if (m_pApartment != NULL) {
+      m_pApartment->reindexDevice(*this);
+    }
     m_DSMeterDSUIDstr = dsuid2str(_dsMeter->getDSID());
     m_LastKnownMeterDSUIDstr = dsuid2str(_dsMeter->getDSID());
 
@@ -1346,6 +1362,9 @@ namespace dss {
     }
 
     m_ZoneID = _value;
+    if (m_pApartment != NULL) {
+      m_pApartment->reindexDevice(*this);
+    }
     if ((m_pPropertyNode != NULL) && (m_pApartment->getPropertyNode() != NULL)) {
       std::string basePath = "zones/zone" + intToString(m_ZoneID) + "/devices";
       if (m_pAliasNode == NULL) {
@@ -1396,6 +1415,9 @@ namespace dss {
     if (isValidGroup(_groupID)) {
       if (find(m_groupIds.begin(), m_groupIds.end(), _groupID) == m_groupIds.end()) {
         m_groupIds.push_back(_groupID);
+        if (m_pApartment != NULL) {
+          m_pApartment->reindexDevice(*this);
+        }
         updateIconPath();
         if ((m_pPropertyNode != NULL) && (m_pApartment->getPropertyNode() != NULL)) {
           // create alias in group list
@@ -1421,6 +1443,9 @@ namespace dss {
       std::vector<int>::iterator it = find(m_groupIds.begin(), m_groupIds.end(), _groupID);
       if (it != m_groupIds.end()) {
         m_groupIds.erase(it);
+        if (m_pApartment != NULL) {
+          m_pApartment->reindexDevice(*this);
+        }
         updateIconPath();
         if ((m_pPropertyNode != NULL) && (m_pApartment->getPropertyNode() != NULL)) {
           // remove alias in group list
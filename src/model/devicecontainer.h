@@ -25,10 +25,27 @@
 
 #include <string>
 
+#include <boost/dynamic_bitset.hpp>
+
 namespace dss {
 
   class Set;
 
+  /** Device membership indexed by the apartments device slots */
+  typedef boost::dynamic_bitset<unsigned long> DeviceBitmap;
+
+  /** Clears the bits in \a _bits that are not set in \a _mask, the two
+    * may differ in size when devices were allocated in between */
+  inline void intersectDeviceBitmaps(DeviceBitmap& _bits, const DeviceBitmap& _mask) {
+    if (_bits.size() == _mask.size()) {
+      _bits &= _mask;
+    } else {
+      DeviceBitmap mask(_mask);
+      mask.resize(_bits.size());
+      _bits &= mask;
+    }
+  } // intersectDeviceBitmaps
+
   /** A class derived from DeviceContainer can deliver a Set of its Devices */
   class DeviceContainer {
   private:
@@ -68,6 +68,15 @@ __DEFINE_LOG_CHANNEL__(Group, lsNotice);
     return m_IsValid;
   } // isValid
 
+  void Group::setName(const std::string& _name) {
+    std::string oldName = getName();
+    DeviceContainer::setName(_name);
+    // sets are resolved by group name, don't wait for etModelDirty
+    if((m_pApartment != NULL) && (getName() != oldName)) {
+      m_pApartment->bumpGeneration();
+    }
+  } // setName
+
   void Group::setApplicationType(ApplicationType applicationType) {
     // check if we already have proper application type set
     if (m_ApplicationType == applicationType) {
@@ -68,6 +68,7 @@ namespace dss {
     boost::shared_ptr<Group> sharedFromThis() { return boost::static_pointer_cast<Group>(shared_from_this()); }
 
     virtual Set getDevices() const;
+    virtual void setName(const std::string& _name);
 
     /** Returns the id of the group */
     int getID() const { return m_GroupID; }
@@ -26,6 +26,74 @@
 
 #include "modelevent.h"
 
+#include <new>
+
+#include <boost/lockfree/stack.hpp>
+
 namespace dss {
 
+  template <size_t a, size_t b>
+  struct MaxSize {
+    static const size_t value = (a > b) ? a : b;
+  };
+
+  /** Every model event class fits into one block */
+  static const size_t kModelEventBlockSize =
+    MaxSize<MaxSize<sizeof(ModelEvent), sizeof(ModelEventWithDSID)>::value,
+            MaxSize<MaxSize<sizeof(ModelEventWithStrings), sizeof(ModelEventWithSensorEx)>::value,
+                    sizeof(VdceModelEvent)>::value>::value;
+
+  /** Blocks kept for reuse, beyond that they go back to the heap */
+  static const size_t kModelEventPoolSize = 1024;
+
+  /** Lock free, bus callbacks allocate and the model thread releases */
+  class ModelEventPool {
+  public:
+    ~ModelEventPool() {
+      void* block;
+      while (m_FreeBlocks.pop(block)) {
+        ::operator delete(block);
+      }
+    }
+
+    void* allocate() {
+      void* block;
+      if (m_FreeBlocks.pop(block)) {
+        return block;
+      }
+      return ::operator new(kModelEventBlockSize);
+    }
+
+    void release(void* _block) {
+      if (!m_FreeBlocks.bounded_push(_block)) {
+        ::operator delete(_block);
+      }
+    }
+  private:
+    boost::lockfree::stack<void*, boost::lockfree::capacity<kModelEventPoolSize> > m_FreeBlocks;
+  }; // ModelEventPool
+
+  static ModelEventPool& getModelEventPool() {
+    static ModelEventPool pool;
+    return pool;
+  } // getModelEventPool
+
+  void* ModelEvent::operator new(size_t _size) {
+    if (_size > kModelEventBlockSize) {
+      return ::operator new(_size);
+    }
+    return getModelEventPool().allocate();
+  } // operator new
+
+  void ModelEvent::operator delete(void* _p, size_t _size) {
+    if (_p == NULL) {
+      return;
+    }
+    if (_size > kModelEventBlockSize) {
+      ::operator delete(_p);
+      return;
+    }
+    getModelEventPool().release(_p);
+  } // operator delete
+
 } // namespace dss
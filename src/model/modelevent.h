@@ -26,6 +26,7 @@
 
 #include <vector>
 #include <boost/shared_ptr.hpp>
+#include <boost/container/small_vector.hpp>
 
 #include "src/base.h"
 #include "src/ds485types.h"
@@ -34,9 +35,20 @@ namespace dss {
 
   /** A Model event gets processed by the apartment asynchronously.
    * It consists of multiple integer parameter whose meanig is defined by ModelEvent::EventType
+   * Model events of all classes are allocated from a common pool of fixed
+   * size blocks and recycled, the integer parameters are kept inline.
+   * The class of an event is told by getKind(), no RTTI needed.
    */
   class ModelEvent {
   public:
+    typedef enum {
+      ekPlain,
+      ekWithDSID,
+      ekWithStrings,
+      ekWithSensorEx,
+      ekVdce
+    } EventKind;
+
     typedef enum { etCallSceneGroup,  /**< A group has changed the scene. */
                     etUndoSceneGroup,  /**< An undo scene command for a group. */
                     etBlinkGroup,  /**< A group was blinked. */
@@ -84,20 +96,27 @@ namespace dss {
                  } EventType;
   private:
     EventType m_EventType;
-    std::vector<int> m_Parameter;
+    EventKind m_EventKind;
+    boost::container::small_vector<int, 8> m_Parameter;
     boost::shared_ptr<void> m_SingleObjectParameter;
     std::string m_SingleStringParameter; // won't add a vector/list until
                                          // we really need more string
                                          // parameters which is not yet the
                                          // case
+    unsigned m_Sequence;
   public:
     /** Constructs a ModelEvent with the given EventType. */
     ModelEvent(EventType _type)
-    : m_EventType(_type)
+    : m_EventType(_type),
+      m_EventKind(ekPlain),
+      m_Sequence(0)
     {}
 
     virtual ~ModelEvent() { }
 
+    static void* operator new(size_t _size);
+    static void operator delete(void* _p, size_t _size);
+
     /** Adds an integer parameter. */
     void addParameter(const int _param) { m_Parameter.push_back(_param); }
     /** Returns the parameter at _index.
@@ -107,23 +126,42 @@ namespace dss {
     int getParameterCount() const { return m_Parameter.size(); }
     /** Returns the type of the event. */
     EventType getEventType() const { return m_EventType; }
+    /** Returns the class of the event. */
+    EventKind getEventKind() const { return m_EventKind; }
+    /** True for ModelEventWithDSID and its subclasses */
+    bool hasDSID() const { return (m_EventKind == ekWithDSID) || (m_EventKind == ekWithStrings); }
 
     void setSingleStringParameter(const std::string _param) { m_SingleStringParameter = _param; }
     std::string getSingleStringParameter() const { return m_SingleStringParameter; }
 
     void setSingleObjectParameter(const boost::shared_ptr<void> _param) { m_SingleObjectParameter = _param; }
     boost::shared_ptr<void> getSingleObjectParameter() const { return m_SingleObjectParameter; }
+
+    /** Place in the model event queue, set when the event is queued */
+    void setSequence(const unsigned _sequence) { m_Sequence = _sequence; }
+    unsigned getSequence() const { return m_Sequence; }
+  protected:
+    ModelEvent(EventType _type, EventKind _kind)
+    : m_EventType(_type),
+      m_EventKind(_kind),
+      m_Sequence(0)
+    {}
   }; // ModelEvent
 
   // TODO: use boost::any for values and remove this class
   class ModelEventWithDSID : public ModelEvent {
   public:
     ModelEventWithDSID(EventType _type, const dsuid_t& _dsid)
-    : ModelEvent(_type),
+    : ModelEvent(_type, ekWithDSID),
       m_DSID(_dsid)
     { }
 
     const dsuid_t& getDSID() const { return m_DSID; }
+  protected:
+    ModelEventWithDSID(EventType _type, EventKind _kind, const dsuid_t& _dsid)
+    : ModelEvent(_type, _kind),
+      m_DSID(_dsid)
+    { }
   private:
     dsuid_t m_DSID;
   }; // ModelEventWithDSID
@@ -131,7 +169,7 @@ namespace dss {
   class ModelEventWithStrings : public ModelEventWithDSID {
   public:
     ModelEventWithStrings(EventType _type, const dsuid_t& _dsid)
-      : ModelEventWithDSID(_type, _dsid)
+      : ModelEventWithDSID(_type, ekWithStrings, _dsid)
     { }
 
     void addStringParameter(const std::string& _param) { m_StringParameter.push_back(_param); }
@@ -143,7 +181,7 @@ namespace dss {
 
   class ModelEventWithSensorEx : public ModelEvent {
   public:
-    ModelEventWithSensorEx() : ModelEvent(ModelEvent::etDeviceSensorValueEx), m_sensorValue(0) {}
+    ModelEventWithSensorEx() : ModelEvent(ModelEvent::etDeviceSensorValueEx, ekWithSensorEx), m_sensorValue(0) {}
 
     dsuid_t m_deviceDSID;
     double m_sensorValue;
@@ -151,7 +189,7 @@ namespace dss {
 
   class VdceModelEvent : public ModelEvent {
   public:
-    VdceModelEvent() : ModelEvent(ModelEvent::etVdceEvent) {}
+    VdceModelEvent() : ModelEvent(ModelEvent::etVdceEvent, ekVdce) {}
 
     dsuid_t m_deviceDSID;
     Properties m_states;
@@ -0,0 +1,303 @@
+/*
+    Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+
+    This file is part of digitalSTROM Server.
+
+    digitalSTROM Server is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    digitalSTROM Server is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "modeljournal.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+
+#include "src/foreach.h"
+#include "src/base.h"
+#include "src/logger.h"
+
+namespace dss {
+
+  /* Each record is a header line "<op> <key> <length> <crc32>" followed
+   * by <length> bytes of XML, op is '+' for added or changed and '-' for
+   * removed objects. The checksum covers op, key and fragment, so a record
+   * torn by a crash is detected and everything from there on ignored. */
+  static uint32_t recordChecksum(char _op, const std::string& _key,
+                                 const std::string& _fragment) {
+    boost::crc_32_type crc;
+    crc.process_byte(_op);
+    crc.process_bytes(_key.data(), _key.size());
+    crc.process_bytes(_fragment.data(), _fragment.size());
+    return crc.checksum();
+  } // recordChecksum
+
+  static void removeFile(const std::string& _fileName) {
+    boost::system::error_code ec;
+    boost::filesystem::remove(_fileName, ec);
+    if (ec) {
+      Logger::getInstance()->log("ModelJournal: failed to remove '" +
+                                 _fileName + "': " + ec.message(), lsWarning);
+    }
+  } // removeFile
+
+  ModelJournal::ModelJournal(Apartment& _apartment, const std::string& _fileName,
+                             int _compactRecords, int _compactSeconds)
+  : m_Apartment(_apartment),
+    m_FileName(_fileName),
+    m_JournalFileName(getJournalFileName(_fileName)),
+    m_CompactRecords(_compactRecords),
+    m_CompactSeconds(_compactSeconds),
+    m_Synced(false),
+    m_JournalRecords(0)
+  { } // ctor
+
+  std::string ModelJournal::getJournalFileName(const std::string& _fileName) {
+    return _fileName + ".journal";
+  } // getJournalFileName
+
+  void ModelJournal::write() {
+    // the snapshot takes the apartment lock, never do that under m_Mutex
+    ModelFragments current;
+    ModelPersistence persistence(m_Apartment);
+    persistence.snapshotFragments(current);
+
+    boost::mutex::scoped_lock lock(m_Mutex);
+    // nothing known about the files yet, start over from a full rewrite
+    if (!m_Synced) {
+      compact(current);
+      return;
+    }
+
+    std::vector<Record> records;
+    foreach(const ModelFragments::value_type& fragment, current) {
+      const std::string* written = m_Written.find(fragment.first);
+      if ((written == NULL) || (*written != fragment.second)) {
+        Record record;
+        record.m_Key = fragment.first;
+        record.m_Removed = false;
+        record.m_Fragment = fragment.second;
+        records.push_back(record);
+      }
+    }
+    foreach(const ModelFragments::value_type& fragment, m_Written) {
+      if (current.find(fragment.first) == NULL) {
+        Record record;
+        record.m_Key = fragment.first;
+        record.m_Removed = true;
+        records.push_back(record);
+      }
+    }
+
+    if (records.empty()) {
+      if (compactionDue()) {
+        compact(current);
+      }
+      return;
+    }
+
+    // a failed append may have left a torn record behind, which would hide
+    // all records appended after it, so rewrite the file instead
+    if ((m_JournalRecords + (int)records.size() > m_CompactRecords) ||
+        compactionDue() ||
+        !appendRecords(m_JournalFileName, records)) {
+      compact(current);
+      return;
+    }
+
+    if (m_JournalRecords == 0) {
+      m_FirstRecordTS = DateTime();
+    }
+    m_JournalRecords += records.size();
+    m_Written.swap(current);
+    Logger::getInstance()->log("ModelJournal: appended " +
+                               intToString(records.size()) + " records to '" +
+                               m_JournalFileName + "'", lsDebug);
+  } // write
+
+  bool ModelJournal::isCompactionDue() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return compactionDue();
+  } // isCompactionDue
+
+  bool ModelJournal::compactionDue() const {
+    return (m_JournalRecords > 0) &&
+           (DateTime().difference(m_FirstRecordTS) >= m_CompactSeconds);
+  } // compactionDue
+
+  int ModelJournal::getJournalRecords() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_JournalRecords;
+  } // getJournalRecords
+
+  void ModelJournal::compact() {
+    ModelFragments current;
+    ModelPersistence persistence(m_Apartment);
+    persistence.snapshotFragments(current);
+
+    boost::mutex::scoped_lock lock(m_Mutex);
+    compact(current);
+  } // compact
+
+  void ModelJournal::flush() {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    if (!m_Synced || (m_JournalRecords == 0)) {
+      return;
+    }
+
+    // m_Written is exactly what config file and journal hold together, so
+    // folding the journal needs no new snapshot of the model
+    if (!ModelPersistence::writeFragmentsToXML(m_Written, m_FileName)) {
+      m_Synced = false;
+      return;
+    }
+    removeFile(m_JournalFileName);
+    m_JournalRecords = 0;
+  } // flush
+
+  bool ModelJournal::compact(ModelFragments& _fragments) {
+    if (!ModelPersistence::writeFragmentsToXML(_fragments, m_FileName)) {
+      m_Synced = false;
+      return false;
+    }
+
+    // The new file contains everything the journal does, replaying it after
+    // a crash right here is harmless
+    if (boost::filesystem::exists(m_JournalFileName)) {
+      removeFile(m_JournalFileName);
+    }
+
+    m_Written.swap(_fragments);
+    m_JournalRecords = 0;
+    m_Synced = true;
+    return true;
+  } // compact
+
+  bool ModelJournal::appendRecords(const std::string& _journalFileName,
+                                   const std::vector<Record>& _records) {
+    std::ofstream ofs(_journalFileName.c_str(), std::ios::app | std::ios::binary);
+    if (!ofs) {
+      Logger::getInstance()->log("ModelJournal: could not open '" +
+                                 _journalFileName + "'", lsError);
+      return false;
+    }
+
+    foreach(const Record& record, _records) {
+      char op = record.m_Removed ? '-' : '+';
+      ofs << op << " " << record.m_Key << " " << record.m_Fragment.size() << " "
+          << recordChecksum(op, record.m_Key, record.m_Fragment) << "\n"
+          << record.m_Fragment;
+    }
+    ofs.close();
+
+    if (!ofs) {
+      Logger::getInstance()->log("ModelJournal: failed to append to '" +
+                                 _journalFileName + "'", lsError);
+      return false;
+    }
+
+    syncFile(_journalFileName);
+    return true;
+  } // appendRecords
+
+  void ModelJournal::readRecords(const std::string& _journalFileName,
+                                 std::vector<Record>& _records) {
+    std::ifstream ifs(_journalFileName.c_str(), std::ios::binary);
+    std::string header;
+
+    while (std::getline(ifs, header)) {
+      std::istringstream hs(header);
+      char op;
+      std::string key;
+      size_t length;
+      uint32_t checksum;
+      if (!(hs >> op >> key >> length >> checksum) ||
+          ((op != '+') && (op != '-')) ||
+          (length > MODEL_JOURNAL_MAX_RECORD_SIZE)) {
+        Logger::getInstance()->log("ModelJournal: damaged record header in '" +
+                                   _journalFileName + "', ignoring the rest", lsWarning);
+        break;
+      }
+
+      std::string fragment(length, '\0');
+      if ((length > 0) && !ifs.read(&fragment[0], length)) {
+        Logger::getInstance()->log("ModelJournal: truncated record in '" +
+                                   _journalFileName + "', ignoring it", lsWarning);
+        break;
+      }
+      if (recordChecksum(op, key, fragment) != checksum) {
+        Logger::getInstance()->log("ModelJournal: checksum mismatch in '" +
+                                   _journalFileName + "', ignoring the rest", lsWarning);
+        break;
+      }
+
+      Record record;
+      record.m_Key = key;
+      record.m_Removed = (op == '-');
+      record.m_Fragment.swap(fragment);
+      _records.push_back(record);
+    }
+  } // readRecords
+
+  bool ModelJournal::recover(const std::string& _fileName) {
+    std::string journalFileName = getJournalFileName(_fileName);
+    if (!boost::filesystem::exists(journalFileName)) {
+      return true;
+    }
+
+    std::vector<Record> records;
+    readRecords(journalFileName, records);
+
+    bool result = true;
+    if (!records.empty()) {
+      ModelFragments fragments;
+      if (boost::filesystem::exists(_fileName) &&
+          !ModelPersistence::readFragmentsFromXML(_fileName, fragments)) {
+        Logger::getInstance()->log("ModelJournal: unexpected layout of '" +
+                                   _fileName + "', can't apply journal", lsError);
+        result = false;
+      } else {
+        foreach(const Record& record, records) {
+          if (record.m_Removed) {
+            fragments.erase(record.m_Key);
+          } else {
+            fragments.set(record.m_Key, record.m_Fragment);
+          }
+        }
+        result = ModelPersistence::writeFragmentsToXML(fragments, _fileName);
+        Logger::getInstance()->log("ModelJournal: recovered " +
+                                   intToString(records.size()) + " records from '" +
+                                   journalFileName + "'", lsNotice);
+      }
+    }
+
+    if (result) {
+      removeFile(journalFileName);
+    } else {
+      // keep it for inspection, but never apply it to a later file
+      if (rename(journalFileName.c_str(), (journalFileName + ".invalid").c_str()) != 0) {
+        removeFile(journalFileName);
+      }
+    }
+    return result;
+  } // recover
+
+} // namespace dss
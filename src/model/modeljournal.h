@@ -0,0 +1,115 @@
+/*
+    Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+
+    This file is part of digitalSTROM Server.
+
+    digitalSTROM Server is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    digitalSTROM Server is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef MODELJOURNAL_H_
+#define MODELJOURNAL_H_
+
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "src/datetools.h"
+#include "src/model/modelpersistence.h"
+
+#define MODEL_JOURNAL_COMPACT_RECORDS 500
+/** apartment.xml lags behind the journal for at most this long */
+#define MODEL_JOURNAL_COMPACT_SECONDS 600
+/** Upper bound for a single record, guards against damaged headers */
+#define MODEL_JOURNAL_MAX_RECORD_SIZE (1024 * 1024)
+
+namespace dss {
+
+  class Apartment;
+
+  /** Incremental persistence of the apartment configuration.
+    * write() renders every object of the model and appends the fragments
+    * that differ from the last write to a journal next to the config file.
+    * There are no per-object dirty flags, this saves disk writes, not the
+    * cost of rendering. Once the journal holds more than the configured number
+    * of records, or once its first record is older than the configured
+    * number of seconds, it is compacted into a full rewrite of the config
+    * file. Until then the config file alone is out of date, readers of the
+    * file need the journal too. The first write after startup is always a
+    * full rewrite. flush() folds the journal into the config file without
+    * looking at the model, call it before handing the file to anyone.
+    * write() and compact() are meant for a single thread, flush() may be
+    * called from any thread.
+    * recover() folds a journal left behind by a crash into the config file
+    * before it gets loaded, a torn last record is ignored. */
+  class ModelJournal : boost::noncopyable {
+  public:
+    struct Record {
+      std::string m_Key;
+      bool m_Removed;
+      /** Empty for a removed object */
+      std::string m_Fragment;
+    }; // Record
+
+    ModelJournal(Apartment& _apartment, const std::string& _fileName,
+                 int _compactRecords,
+                 int _compactSeconds = MODEL_JOURNAL_COMPACT_SECONDS);
+
+    /** Persists the changes made to the model since the last write */
+    void write();
+    /** Rewrites the config file and drops the journal */
+    void compact();
+    /** Brings the config file up to date with what has been written so
+      * far and drops the journal. Unlike compact() it doesn't snapshot the
+      * model, so it doesn't need the apartment lock */
+    void flush();
+    /** True if the journal holds records older than the compaction interval */
+    bool isCompactionDue() const;
+
+    int getJournalRecords() const;
+
+    static std::string getJournalFileName(const std::string& _fileName);
+    /** Applies a leftover journal to \a _fileName and removes it. A journal
+      * that can't be applied is moved aside, returns false in that case */
+    static bool recover(const std::string& _fileName);
+
+    static bool appendRecords(const std::string& _journalFileName,
+                              const std::vector<Record>& _records);
+    /** Reads all intact records, stops at the first damaged one */
+    static void readRecords(const std::string& _journalFileName,
+                            std::vector<Record>& _records);
+  private:
+    bool compact(ModelFragments& _fragments);
+    bool compactionDue() const;
+
+    Apartment& m_Apartment;
+    const std::string m_FileName;
+    const std::string m_JournalFileName;
+    const int m_CompactRecords;
+    const int m_CompactSeconds;
+    /** Guards the files and the state below, never held while snapshotting */
+    mutable boost::mutex m_Mutex;
+    /** What config file and journal contain, valid if m_Synced is set */
+    ModelFragments m_Written;
+    bool m_Synced;
+    int m_JournalRecords;
+    /** Time of the oldest record in the journal */
+    DateTime m_FirstRecordTS;
+  }; // ModelJournal
+
+} // namespace dss
+
+#endif /* MODELJOURNAL_H_ */
@@ -29,9 +29,11 @@
 #define BOOST_CHRONO_HEADER_ONLY
 #include <boost/make_shared.hpp>
 #include <boost/chrono.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "modelmaintenance.h"
 
+#include <algorithm>
 #include <unistd.h>
 #include <json.h>
 #include <rapidjson/writer.h>
@@ -61,6 +63,7 @@
 #include "modulator.h"
 #include "state.h"
 #include "set.h"
+#include "modeljournal.h"
 #include "modelpersistence.h"
 #include "busscanner.h"
 #include "scenehelper.h"
@@ -479,6 +482,12 @@ namespace dss {
     m_IsDirty(false),
     m_pendingSaveRequest(false),
     m_suppressSaveRequestNotify(m_processedEvents),
+    m_ModelEvents(MODEL_EVENT_QUEUE_NODES),
+    m_ModelEventBatchPos(0),
+    m_queuedEvents(m_processedEvents.load()),
+    m_lastSyncEvent(m_processedEvents.load()),
+    m_handledEvents(m_processedEvents.load()),
+    m_waitingForModelEvents(false),
     m_pApartment(NULL),
     m_pMetering(NULL),
     m_EventTimeoutMS(_eventTimeoutMS),
@@ -489,10 +498,24 @@ namespace dss {
     m_pMeterMaintenance(boost::make_shared<MeterMaintenance>(_pDSS, "MeterMaintenance"))
   { }
 
+  ModelMaintenance::~ModelMaintenance() {
+    for (size_t i = m_ModelEventBatchPos; i < m_ModelEventBatch.size(); i++) {
+      delete m_ModelEventBatch[i];
+    }
+    ModelEvent* event;
+    while (m_ModelEvents.pop(event)) {
+      delete event;
+    }
+  } // dtor
+
   void ModelMaintenance::shutdown() {
     if (m_pendingSaveRequest) {
       writeConfiguration();
     }
+    // leave a complete apartment.xml behind
+    if ((m_pModelJournal != NULL) && (m_pModelJournal->getJournalRecords() > 0)) {
+      m_pModelJournal->compact();
+    }
     m_pMeterMaintenance->shutdown();
     ThreadedSubsystem::shutdown();
   }
@@ -534,6 +557,20 @@ namespace dss {
               getConfigPropertyBasePath() + "invalidbackup",
               getDSS().getDataDirectory() + "invalid-apartment.xml", true, false);
 
+      DSS::getInstance()->getPropertySystem().setIntValue(
+              getConfigPropertyBasePath() + "journalCompactRecords",
+              MODEL_JOURNAL_COMPACT_RECORDS, true, false);
+
+      DSS::getInstance()->getPropertySystem().setIntValue(
+              getConfigPropertyBasePath() + "journalCompactSeconds",
+              MODEL_JOURNAL_COMPACT_SECONDS, true, false);
+
+      PropertySystem &props(DSS::getInstance()->getPropertySystem());
+      m_pModelJournal = boost::make_shared<ModelJournal>(boost::ref(*m_pApartment),
+          props.getStringValue(getConfigPropertyBasePath() + "configfile"),
+          props.getIntValue(getConfigPropertyBasePath() + "journalCompactRecords"),
+          props.getIntValue(getConfigPropertyBasePath() + "journalCompactSeconds"));
+
       boost::filesystem::path filename(
               DSS::getInstance()->getPropertySystem().getStringValue(
                                    getConfigPropertyBasePath() + "configfile"));
@@ -560,10 +597,10 @@ namespace dss {
   bool ModelMaintenance::pendingChangesBarrier(int waitSeconds) {
     boost::mutex::scoped_lock lock(m_rvMut);
 
-    unsigned syncState = indexOfNextSyncState();
-    // rollover: syncState:2, m_processed:UINT_MAX -> 3 (0, 1, 2)
+    unsigned syncState = m_lastSyncEvent;
+    // rollover: syncState:2, m_handled:UINT_MAX -> 3 (0, 1, 2)
     // if delta > INT_MAX, delta is negative
-    while (static_cast<int>(syncState - m_processedEvents) > 0) {
+    while (static_cast<int>(syncState - m_handledEvents) > 0) {
       if (m_rvCond.wait_for(lock, boost::chrono::seconds(waitSeconds)) ==
           boost::cv_status::timeout) {
         // timeout, better throw an exception?
@@ -667,27 +704,40 @@ namespace dss {
 
   void ModelMaintenance::delayedConfigWrite()
   {
-    boost::mutex::scoped_lock lock(m_SaveRequestMutex);
-    if (!m_pendingSaveRequest ||
-        DateTime().difference(m_pendingSaveRequestTS) < 30) {
-      return;
+    bool writeDue;
+    {
+      boost::mutex::scoped_lock lock(m_SaveRequestMutex);
+      writeDue = m_pendingSaveRequest &&
+                 (DateTime().difference(m_pendingSaveRequestTS) >= 30);
+      if (writeDue) {
+        m_pendingSaveRequest = false;
+      }
     }
 
-    writeConfiguration();
-    m_pendingSaveRequest = false;
+    // writing takes the apartment lock, keep scheduleConfigWrite() callers
+    // out of that
+    if (writeDue) {
+      writeConfiguration();
+    } else if ((m_pModelJournal != NULL) && m_pModelJournal->isCompactionDue()) {
+      // don't let apartment.xml lag behind the journal for too long when
+      // no further changes come in
+      m_pModelJournal->compact();
+    }
   }
 
   void ModelMaintenance::writeConfiguration() {
-    if (!DSS::hasInstance()) {
+    if (m_pModelJournal == NULL) {
       return;
     }
-
-    PropertySystem &props(DSS::getInstance()->getPropertySystem());
-    ModelPersistence persistence(*m_pApartment);
-    persistence.writeConfigurationToXML(props.getStringValue(getConfigPropertyBasePath()
-                                                             + "configfile"));
+    m_pModelJournal->write();
   } // writeConfiguration
 
+  void ModelMaintenance::flushConfiguration() {
+    if (m_pModelJournal != NULL) {
+      m_pModelJournal->flush();
+    }
+  } // flushConfiguration
+
   void ModelMaintenance::handleDeferredModelStateChanges(callOrigin_t _origin, int _zoneID, int _groupID, int _sceneID) {
     std::vector<boost::shared_ptr<Zone> > zonesToUpdate;
     if (_zoneID == 0) {
@@ -731,7 +781,7 @@ namespace dss {
           boost::shared_ptr<Group> group = zone->getGroup(groupID);
           dsuid_t originDSUID = mEvent->getSource();
           if ((originDSUID != DSUID_NULL) && (originDeviceID != 0)) {
-            DeviceReference devRef = m_pApartment->getDevices().getByBusID(originDeviceID, mEvent->getSource());
+            DeviceReference devRef(m_pApartment->getDeviceByBusID(originDeviceID, mEvent->getSource()), m_pApartment);
             originDSUID = devRef.getDSID();
           }
 
@@ -781,7 +831,7 @@ namespace dss {
         int clickType = bEvent->getClickType();
 
         try {
-          DeviceReference devRef = m_pApartment->getDevices().getByBusID(deviceID, bEvent->getSource());
+          DeviceReference devRef(m_pApartment->getDeviceByBusID(deviceID, bEvent->getSource()), m_pApartment);
           boost::shared_ptr<DeviceReference> pDevRev = boost::make_shared<DeviceReference>(devRef);
 
           if (bEvent->isDue() || (clickType == ClickTypeHE)) {
@@ -811,34 +861,59 @@ namespace dss {
     return true;
   } // handleDeferredModelEvents
 
-  bool ModelMaintenance::handleModelEvents() {
-    m_ModelEvents_t::auto_type event;
+  bool ModelMaintenance::drainModelEvents() {
+    m_ModelEventBatch.clear();
+    m_ModelEventBatchPos = 0;
+
+    ModelEvent* event;
+    while (m_ModelEvents.pop(event)) {
+      m_ModelEventBatch.push_back(event);
+    }
+    if (!m_ModelEventBatch.empty()) {
+      return true;
+    }
 
     {
       boost::mutex::scoped_lock lock(m_ModelEventsMutex);
-      if (m_ModelEvents.empty() &&
-          (m_NewModelEvent.wait_for(lock, m_EventTimeoutMS) ==
-           boost::cv_status::timeout)) {
+      // addModelEvent either sees the flag and notifies under the mutex,
+      // or queued its event before the check below
+      m_waitingForModelEvents = true;
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+      bool timeout = false;
+      if (m_ModelEvents.empty()) {
+        timeout = (m_NewModelEvent.wait_for(lock, m_EventTimeoutMS) ==
+                   boost::cv_status::timeout);
+      }
+      m_waitingForModelEvents = false;
+      if (timeout) {
         notifyModelConsistent(); // no pending changes
         return false;
       }
+    }
 
-      if (m_ModelEvents.empty()) {
-        // man pthread_cond_wait -> Condition Wait Semantics
-        // condition needs to re-checked, really happens!
-        // observed wait to return without a prior notify call
-        return false;
-      }
+    // man pthread_cond_wait -> Condition Wait Semantics
+    // condition needs to re-checked, really happens!
+    // observed wait to return without a prior notify call
+    while (m_ModelEvents.pop(event)) {
+      m_ModelEventBatch.push_back(event);
+    }
+    return !m_ModelEventBatch.empty();
+  } // drainModelEvents
 
-      assert(!m_ModelEvents.empty());
-      event = m_ModelEvents.pop_front();
-      m_processedEvents++;
+  bool ModelMaintenance::handleModelEvents() {
+    if ((m_ModelEventBatchPos == m_ModelEventBatch.size()) && !drainModelEvents()) {
+      return false;
     }
 
-    ModelEventWithDSID* pEventWithDSID =
-      dynamic_cast<ModelEventWithDSID*>(event.get());
+    boost::scoped_ptr<ModelEvent> event(m_ModelEventBatch[m_ModelEventBatchPos++]);
+    m_processedEvents++;
+    markEventHandled(event->getSequence());
+
+    ModelEventWithDSID* pEventWithDSID = event->hasDSID() ?
+      static_cast<ModelEventWithDSID*>(event.get()) : NULL;
     ModelEventWithStrings* pEventWithStrings =
-      dynamic_cast<ModelEventWithStrings*>(event.get());
+      (event->getEventKind() == ModelEvent::ekWithStrings) ?
+      static_cast<ModelEventWithStrings*>(event.get()) : NULL;
 
     switch (event->getEventType()) {
     case ModelEvent::etNewDevice:
@@ -942,6 +1017,7 @@ namespace dss {
       }
       break;
     case ModelEvent::etModelDirty:
+      m_pApartment->bumpGeneration();
       if (DSS::hasInstance() && DSS::getInstance()->getPropertySystem().getBoolValue(pp_websvc_enabled)) {
         // hack: if difference > INT_MAX, than difference is negative
         if (static_cast<int>(m_processedEvents - m_suppressSaveRequestNotify) > 0) {
@@ -1039,8 +1115,8 @@ namespace dss {
       }
       break;
     case ModelEvent::etDeviceSensorValueEx: {
-      auto evtSensorEx = dynamic_cast<ModelEventWithSensorEx*>(event.get());
-      assert(evtSensorEx != 0);
+      assert(event->getEventKind() == ModelEvent::ekWithSensorEx);
+      auto evtSensorEx = static_cast<ModelEventWithSensorEx*>(event.get());
       onSensorValueEx(evtSensorEx->m_deviceDSID, evtSensorEx->getParameter(0),
           /* sensorIndex */ evtSensorEx->getParameter(1),
           /* sensorValue */ evtSensorEx->m_sensorValue,
@@ -1202,8 +1278,8 @@ namespace dss {
       break;
     case ModelEvent::etVdceEvent:
     {
-      auto vdcModelEvent = dynamic_cast<VdceModelEvent*>(event.get());
-      assert(vdcModelEvent != 0);
+      assert(event->getEventKind() == ModelEvent::ekVdce);
+      auto vdcModelEvent = static_cast<VdceModelEvent*>(event.get());
       onVdceEvent(*vdcModelEvent);
       break;
     }
@@ -1215,18 +1291,35 @@ namespace dss {
     return true;
   } // handleModelEvents
 
-  unsigned ModelMaintenance::indexOfNextSyncState() {
-    boost::mutex::scoped_lock lock(m_ModelEventsMutex);
-    int count = m_processedEvents + m_ModelEvents.size();
+  void ModelMaintenance::markEventHandled(unsigned _sequence) {
+    unsigned handled = m_handledEvents;
+    if (_sequence != handled + 1) {
+      // a producer that took an earlier stamp hasn't queued its event yet
+      m_handledAhead.push_back(_sequence);
+      return;
+    }
+    handled = _sequence;
+    std::vector<unsigned>::iterator it;
+    while ((it = std::find(m_handledAhead.begin(), m_handledAhead.end(),
+                           handled + 1)) != m_handledAhead.end()) {
+      m_handledAhead.erase(it);
+      handled++;
+    }
+    m_handledEvents = handled;
+    if (handled != _sequence) {
+      // the gap closed, a dirty event handled ahead of it may complete
+      // what a barrier waits for
+      notifyModelConsistent();
+    }
+  } // markEventHandled
 
+  unsigned ModelMaintenance::indexOfNextSyncState() {
     // assume etModelDirty as sync states, ignore trailing events
-    foreach_r (ModelEvent evt, m_ModelEvents) {
-      if (evt.getEventType() == ModelEvent::etModelDirty) {
-        break;
-      }
-      count -= 1;
+    unsigned lastSyncEvent = m_lastSyncEvent;
+    if (static_cast<int>(lastSyncEvent - m_handledEvents) > 0) {
+      return lastSyncEvent;
     }
-    return count;
+    return m_processedEvents;
   }
 
   void ModelMaintenance::addModelEvent(ModelEvent* _pEvent) {
@@ -1236,9 +1329,21 @@ namespace dss {
       m_IsDirty = true;
       delete _pEvent;
       // notify_one not necessary, since event not added to m_ModelEvents
-    } else {
+      return;
+    }
+
+    unsigned sequence = m_queuedEvents.fetch_add(1) + 1;
+    _pEvent->setSequence(sequence);
+    if (_pEvent->getEventType() == ModelEvent::etModelDirty) {
+      unsigned lastSyncEvent = m_lastSyncEvent;
+      while ((static_cast<int>(sequence - lastSyncEvent) > 0) &&
+             !m_lastSyncEvent.compare_exchange_weak(lastSyncEvent, sequence)) {
+      }
+    }
+    m_ModelEvents.push(_pEvent);
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if (m_waitingForModelEvents) {
       boost::mutex::scoped_lock lock(m_ModelEventsMutex);
-      m_ModelEvents.push_back(_pEvent);
       m_NewModelEvent.notify_one(); // trigger m_NewModelEvent.wait_for
     }
   } // addModelEvent
@@ -1248,6 +1353,8 @@ namespace dss {
       std::string configFileName = DSS::getInstance()->getPropertySystem().getStringValue(getConfigPropertyBasePath() + "configfile");
       std::string backupFileName = DSS::getInstance()->getPropertySystem().getStringValue(getConfigPropertyBasePath() + "invalidbackup");
       ModelPersistence persistence(*m_pApartment);
+      // changes journaled before an unclean shutdown
+      ModelJournal::recover(configFileName);
       if (boost::filesystem::exists(configFileName)) {
         persistence.readConfigurationFromXML(configFileName, backupFileName);
       } else {
@@ -1341,7 +1448,7 @@ namespace dss {
         pEvent->setProperty("zoneID", intToString(_zoneID));
         dsuid_t originDSUID = _source;
         if ((_source != DSUID_NULL) && (_originDeviceID != 0)) {
-          DeviceReference devRef = m_pApartment->getDevices().getByBusID(_originDeviceID, _source);
+          DeviceReference devRef(m_pApartment->getDeviceByBusID(_originDeviceID, _source), m_pApartment);
           originDSUID = devRef.getDSID();
         }
         if (_forced) {
@@ -1404,8 +1511,7 @@ namespace dss {
 
         dsuid_t originDSUID = _source;
         if ((_source != DSUID_NULL) && (_originDeviceID != 0)) {
-          DeviceReference devRef = m_pApartment->getDevices().
-            getByBusID(_originDeviceID, _source);
+          DeviceReference devRef(m_pApartment->getDeviceByBusID(_originDeviceID, _source), m_pApartment);
           originDSUID = devRef.getDSID();
         }
         raiseEvent(createGroupUndoSceneEvent(group, _sceneID, _groupID,
@@ -1588,7 +1694,7 @@ namespace dss {
         pEvent->setProperty("zoneID", intToString(_zoneID));
         dsuid_t originDSUID = _source;
         if ((_source != DSUID_NULL) && (_originDeviceID != 0)) {
-          DeviceReference devRef = m_pApartment->getDevices().getByBusID(_originDeviceID, _source);
+          DeviceReference devRef(m_pApartment->getDeviceByBusID(_originDeviceID, _source), m_pApartment);
           originDSUID = devRef.getDSID();
         }
         pEvent->setProperty("callOrigin", intToString(_origin));
@@ -1971,7 +2077,7 @@ namespace dss {
   void ModelMaintenance::onDeviceConfigChanged(const dsuid_t& _dsMeterID, int _deviceID,
                                                int _configClass, int _configIndex, int _value) {
     try {
-      DeviceReference devRef = m_pApartment->getDevices().getByBusID(_deviceID, _dsMeterID);
+      DeviceReference devRef(m_pApartment->getDeviceByBusID(_deviceID, _dsMeterID), m_pApartment);
       boost::shared_ptr<Device> device = devRef.getDevice();
       if(_configClass == CfgClassFunction) {
         if (_configIndex == CfgFunction_Mode) {
@@ -2178,13 +2284,12 @@ namespace dss {
         // the dsm sends a type "0" dsuid but with the serial number only,
         // need to replace with the real sgtin, #10887
         if (dsuidType == 0) {
-          try {
-            uint32_t serialNumber;
-            if (dsuid_get_serial_number(&devdsuid, &serialNumber) == 0) {
-              DeviceReference devRef = m_pApartment->getDevices().getBySerial(serialNumber);
-              devdsuid = devRef.getDSID();
+          uint32_t serialNumber;
+          if (dsuid_get_serial_number(&devdsuid, &serialNumber) == 0) {
+            if (boost::shared_ptr<Device> device = m_pApartment->tryGetDeviceBySerial(serialNumber)) {
+              devdsuid = device->getDSID();
             }
-          } catch (ItemNotFoundException& e) {}
+          }
         }
       }
       raiseEvent(createZoneSensorValueEvent(group, _sensorType, _sensorValue, devdsuid));
@@ -2205,7 +2310,7 @@ namespace dss {
                                         const int _pairedDevices,
                                         const bool _isVisible) {
     try {
-      DeviceReference devRef = m_pApartment->getDevices().getByBusID(_deviceID, _dsMeterID);
+      DeviceReference devRef(m_pApartment->getDeviceByBusID(_deviceID, _dsMeterID), m_pApartment);
       if (_state == DEVICE_OEM_VALID) {
         devRef.getDevice()->setOemInfo(_eanNumber, _serialNumber, _partNumber, _iNetState, _isIndependent);
         if ((_iNetState == DEVICE_OEM_EAN_INTERNET_ACCESS_OPTIONAL) ||
@@ -2959,11 +3064,60 @@ namespace dss {
       m_event(_event)
   {}
 
+  /** Zone, group and dSUID of the event origin, for the websocket filters */
+  static WebSocketEventSource getWebSocketEventSource(const Event& _event) {
+    WebSocketEventSource source;
+    try {
+      EventRaiseLocation raiseLocation = _event.getRaiseLocation();
+      if ((raiseLocation == erlGroup) || (raiseLocation == erlApartment)) {
+        boost::shared_ptr<const Group> group =
+            _event.getRaisedAtGroup(DSS::getInstance()->getApartment());
+        source.m_GroupID = group->getID();
+        source.m_ZoneID = group->getZoneID();
+      } else if (raiseLocation == erlDevice) {
+        boost::shared_ptr<const DeviceReference> device = _event.getRaisedAtDevice();
+        source.m_HasDSUID = true;
+        source.m_DSUID = device->getDSID();
+        source.m_ZoneID = device->getDevice()->getZoneID();
+      } else if (raiseLocation == erlState) {
+        boost::shared_ptr<const State> state = _event.getRaisedAtState();
+        if (state->getType() == StateType_Device) {
+          boost::shared_ptr<Device> device = state->getProviderDevice();
+          source.m_HasDSUID = true;
+          source.m_DSUID = device->getDSID();
+          source.m_ZoneID = device->getZoneID();
+        } else if (state->getType() == StateType_Group) {
+          boost::shared_ptr<Group> group = state->getProviderGroup();
+          source.m_GroupID = group->getID();
+          source.m_ZoneID = group->getZoneID();
+        } else if (state->getType() == StateType_Circuit) {
+          source.m_HasDSUID = true;
+          source.m_DSUID = state->getProviderDsm()->getDSID();
+        }
+      }
+    } catch (ItemNotFoundException& e) {
+    }
+    return source;
+  } // getWebSocketEventSource
+
   void ModelMaintenance::WebSocketEvent::run() {
     if (m_event == NULL) {
       return;
     }
 
+    // nothing gets serialized unless some client wants the event
+    WebServer& webserver = DSS::getInstance()->getWebServer();
+    boost::shared_ptr<const WebSocketFilterIndex> filters = webserver.getWebSocketFilters();
+    WebSocketEventSource source;
+    if (filters->needsSource(m_event->getName())) {
+      source = getWebSocketEventSource(*m_event);
+    }
+    std::vector<int> recipients;
+    filters->match(m_event->getName(), source, recipients);
+    if (recipients.empty()) {
+      return;
+    }
+
     rapidjson::StringBuffer s;
     rapidjson::Writer<rapidjson::StringBuffer> json(s);
 
@@ -2975,9 +3129,9 @@ namespace dss {
     json.String("properties");
     json.StartObject();
 
-    foreach (auto&& param, m_event->getProperties().getContainer()) {
-      json.String((param.first).c_str());
-      json.String((param.second).c_str());
+    foreach (auto&& param, m_event->getProperties().getEntries()) {
+      json.String((param.getKey()).c_str());
+      json.String((param.getValue()).c_str());
     }
     json.EndObject();
 
@@ -3131,8 +3285,7 @@ namespace dss {
     json.EndObject();
     json.EndObject();
 
-    WebServer& webserver = DSS::getInstance()->getWebServer();
-    webserver.sendToWebSockets(s.GetString());
+    webserver.sendToWebSockets(s.GetString(), recipients);
   }
 
   const std::string ModelMaintenance::kWebUpdateEventName = "ModelMaintenace_updateWebData";
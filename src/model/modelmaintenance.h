@@ -23,9 +23,12 @@
 #ifndef MODELMAINTENANCE_H_
 #define MODELMAINTENANCE_H_
 
+#include <vector>
+
 #include <boost/shared_ptr.hpp>
-#include <boost/ptr_container/ptr_deque.hpp>
+#include <boost/atomic.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/lockfree/queue.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 
@@ -37,12 +40,17 @@
 #include "device.h"
 #include "../webservice_connection.h"
 
+/** Nodes the model event queue starts with, it grows on demand */
+#define MODEL_EVENT_QUEUE_NODES 1024
+
 namespace dss {
   class Apartment;
   class Event;
   class Metering;
   class StructureQueryBusInterface;
 
+  class ModelJournal;
+
   class ModelDeferredEvent {
   public:
     static const int kModelSceneTimeout = 2;
@@ -213,7 +221,7 @@ namespace dss {
     };
 
     ModelMaintenance(DSS* _pDSS, const int _eventTimeoutMS = 1000);
-    virtual ~ModelMaintenance() {}
+    virtual ~ModelMaintenance();
 
     virtual void shutdown();
 
@@ -252,13 +260,17 @@ namespace dss {
      * immediately to update its view. If we answer that request too early,
      * e.g. before automatic clusters have been regrouped, the UI will not see
      * the effect of its changes.u
-     * This call will scan the event queue for dirty events, as these mark
-     * the end of a set of changes. It will then block until that event has
-     * been processed.
+     * Dirty events mark the end of a set of changes. This call blocks until
+     * the last dirty event queued so far, and every event queued before it,
+     * has been processed.
      * TODO the apartment model might still be inconsistent, since new changes
      * might be scheduled, from another UI, app or ds485 event.
      */
     bool pendingChangesBarrier(int waitSeconds = 60);
+
+    /** Folds the journal into apartment.xml, so the file holds everything
+     * saved so far. Call before serving or copying the file. */
+    void flushConfiguration();
   protected:
     virtual void doStart();
     bool handleModelEvents(); //< access from unit test
@@ -337,7 +349,7 @@ namespace dss {
 
   protected:
     bool m_IsInitializing; //< allow to clear from unit test
-    unsigned m_processedEvents; //< actually dequeued, increased before processing
+    boost::atomic<unsigned> m_processedEvents; //< actually dequeued, increased before processing
 
   private:
     bool m_IsDirty;
@@ -345,9 +357,33 @@ namespace dss {
     DateTime m_pendingSaveRequestTS;
     unsigned m_suppressSaveRequestNotify;
     boost::mutex m_SaveRequestMutex;
-
-    typedef boost::ptr_deque<ModelEvent> m_ModelEvents_t;
-    boost::ptr_deque<ModelEvent> m_ModelEvents;
+    boost::shared_ptr<ModelJournal> m_pModelJournal;
+
+    /** Takes everything queued by now, waits up to m_EventTimeoutMS if
+      * nothing is. Returns false if there still is nothing to handle. */
+    bool drainModelEvents();
+    /** Advances m_handledEvents once all events stamped before
+      * \a _sequence have been handled too */
+    void markEventHandled(unsigned _sequence);
+
+    /** Queued from any thread, only the model thread takes events out */
+    boost::lockfree::queue<ModelEvent*> m_ModelEvents;
+    /** Taken out of m_ModelEvents but not yet handled */
+    std::vector<ModelEvent*> m_ModelEventBatch;
+    size_t m_ModelEventBatchPos;
+    /** Same count as m_processedEvents, for events queued. Every event
+      * is stamped with its value, concurrent producers may queue their
+      * events out of stamp order */
+    boost::atomic<unsigned> m_queuedEvents;
+    /** Highest stamp of any queued etModelDirty */
+    boost::atomic<unsigned> m_lastSyncEvent;
+    /** Every event stamped up to here has been handled, what
+      * pendingChangesBarrier waits on */
+    boost::atomic<unsigned> m_handledEvents;
+    /** Handled stamps above a gap in m_handledEvents, model thread only */
+    std::vector<unsigned> m_handledAhead;
+    /** Set while the model thread sleeps on m_NewModelEvent */
+    boost::atomic<bool> m_waitingForModelEvents;
     boost::mutex m_ModelEventsMutex;
     boost::condition_variable m_NewModelEvent;
 
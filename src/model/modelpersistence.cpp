@@ -29,6 +29,7 @@
 #include "modelpersistence.h"
 
 #include <stdexcept>
+#include <fstream>
 
 #include <digitalSTROM/dsuid.h>
 
@@ -1028,7 +1029,7 @@ namespace dss {
 
     m_propParser.reset(new PropertyParserProxy());
 
-    if (!parseFile(_fileName)) {
+    if (!parseFileWithSnapshot(_fileName)) {
       Logger::getInstance()->log("apartment.xml is invalid, will backup up to "
                                  + _backup, lsError);
       int ret = rename(_fileName.c_str(), _backup.c_str());
@@ -1055,10 +1056,10 @@ namespace dss {
   }
 
   std::ostream& addElementSimple(std::ostream &_ofs, int _indent, const std::string &_name, const std::string &_value) {
-    return _ofs << doIndent(_indent) << "<" << _name << ">" << XMLStringEscape(_value) << "</" << _name << ">" << std::endl;
+    return _ofs << doIndent(_indent) << "<" << _name << ">" << XMLStringEscape(_value) << "</" << _name << ">" << "\n";
   }
 
-  void deviceToXML(boost::shared_ptr<const Device> _pDevice, std::ofstream& _ofs, const int _indent) {
+  void deviceToXML(boost::shared_ptr<const Device> _pDevice, std::ostream& _ofs, const int _indent) {
     _ofs << doIndent(_indent) << "<device dsuid=\""
          << dsuid2str(_pDevice->getDSID()) << "\""
          << " isPresent=\"" << (_pDevice->isPresent() ? "1" : "0") << "\""
@@ -1127,28 +1128,28 @@ namespace dss {
         _ofs << " valveType=\"" << _pDevice->getValveTypeAsString() <<"\"";
     }
 
-    _ofs << ">" << std::endl;
+    _ofs << ">" << "\n";
 
     if(!_pDevice->getName().empty()) {
-      _ofs << doIndent(_indent + 1) << "<name>" << XMLStringEscape(_pDevice->getName()) << "</name>" << std::endl;
+      _ofs << doIndent(_indent + 1) << "<name>" << XMLStringEscape(_pDevice->getName()) << "</name>" << "\n";
     }
     if(_pDevice->getPropertyNode() != NULL) {
-      _ofs << doIndent(_indent + 1) << "<properties>" << std::endl;
+      _ofs << doIndent(_indent + 1) << "<properties>" << "\n";
       _pDevice->getPropertyNode()->saveChildrenAsXML(_ofs, _indent + 2, PropertyNode::Archive);
-      _ofs << doIndent(_indent + 1) << "</properties>" << std::endl;
+      _ofs << doIndent(_indent + 1) << "</properties>" << "\n";
     }
 
-    _ofs << doIndent(_indent) + "</device>" << std::endl;
+    _ofs << doIndent(_indent) + "</device>" << "\n";
   } // deviceToXML
 
-  void groupToXML(boost::shared_ptr<Group> _pGroup, std::ofstream& _ofs, const int _indent) {
+  void groupToXML(boost::shared_ptr<Group> _pGroup, std::ostream& _ofs, const int _indent) {
     bool headerWritten = false;
     bool sceneTagWritten = false;
 
     // in case of GA we always need to serialize the group even if it do not have custom scenes
     if (isGlobalAppGroup(_pGroup->getID())) {
       headerWritten = true;
-      _ofs << doIndent(_indent) << "<group id=\"" << intToString(_pGroup->getID()) << "\">" << std::endl;
+      _ofs << doIndent(_indent) << "<group id=\"" << intToString(_pGroup->getID()) << "\">" << "\n";
       if (!_pGroup->getName().empty()) {
         addElementSimple(_ofs, _indent + 1, "name", _pGroup->getName());
       }
@@ -1164,7 +1165,7 @@ namespace dss {
       if (!name.empty()) {
         if (!headerWritten) {
           headerWritten = true;
-          _ofs << doIndent(_indent) << "<group id=\"" << intToString(_pGroup->getID()) << "\">" << std::endl;
+          _ofs << doIndent(_indent) << "<group id=\"" << intToString(_pGroup->getID()) << "\">" << "\n";
           if (!_pGroup->getName().empty()) {
             addElementSimple(_ofs, _indent + 1, "name", _pGroup->getName());
           }
@@ -1177,26 +1178,26 @@ namespace dss {
 
         if (!sceneTagWritten) {
           sceneTagWritten = true;
-          _ofs << doIndent(_indent + 1) << "<scenes>" << std::endl;
+          _ofs << doIndent(_indent + 1) << "<scenes>" << "\n";
         }
 
-        _ofs << doIndent(_indent + 2) << "<scene id=\"" << intToString(iScene) << "\">" << std::endl;
-        _ofs << doIndent(_indent + 3) << "<name>" << XMLStringEscape(name) << "</name>" << std::endl;
-        _ofs << doIndent(_indent + 2) << "</scene>" << std::endl;
+        _ofs << doIndent(_indent + 2) << "<scene id=\"" << intToString(iScene) << "\">" << "\n";
+        _ofs << doIndent(_indent + 3) << "<name>" << XMLStringEscape(name) << "</name>" << "\n";
+        _ofs << doIndent(_indent + 2) << "</scene>" << "\n";
       }
     }
 
     if (sceneTagWritten) {
-      _ofs << doIndent(_indent + 1) << "</scenes>" << std::endl;
+      _ofs << doIndent(_indent + 1) << "</scenes>" << "\n";
     }
 
     if (headerWritten) {
-      _ofs << doIndent(_indent) << "</group>" << std::endl;
+      _ofs << doIndent(_indent) << "</group>" << "\n";
     }
   } // groupToXML
 
-  void clusterToXML(boost::shared_ptr<Cluster> _pCluster, std::ofstream& _ofs, const int _indent) {
-    _ofs << doIndent(_indent) << "<cluster id=\"" << intToString(_pCluster->getID()) << "\">" << std::endl;
+  void clusterToXML(boost::shared_ptr<Cluster> _pCluster, std::ostream& _ofs, const int _indent) {
+    _ofs << doIndent(_indent) << "<cluster id=\"" << intToString(_pCluster->getID()) << "\">" << "\n";
 
     if (!_pCluster->getName().empty()) {
       addElementSimple(_ofs, _indent + 1, "name", _pCluster->getName());
@@ -1211,26 +1212,26 @@ namespace dss {
     addElementSimple(_ofs, _indent + 1, "configurationLocked", (_pCluster->isConfigurationLocked() ? "1" : "0"));
     addElementSimple(_ofs, _indent + 1, "automatic", (_pCluster->isAutomatic() ? "1" : "0"));
     addElementSimple(_ofs, _indent + 1, "configuration", uintToString(_pCluster->getApplicationConfiguration(), true));
-    _ofs << doIndent(_indent + 1) << "<lockedScenes>" << std::endl;
+    _ofs << doIndent(_indent + 1) << "<lockedScenes>" << "\n";
     const std::vector<int> lockedScenes = _pCluster->getLockedScenes();
     for (unsigned int iScene = 0; iScene < lockedScenes.size(); iScene++) {
-      _ofs << doIndent(_indent + 2) << "<lockedScene id=\"" << intToString(lockedScenes[iScene]) << "\" />" << std::endl;
+      _ofs << doIndent(_indent + 2) << "<lockedScene id=\"" << intToString(lockedScenes[iScene]) << "\" />" << "\n";
     }
-    _ofs << doIndent(_indent + 1) << "</lockedScenes>" << std::endl;
+    _ofs << doIndent(_indent + 1) << "</lockedScenes>" << "\n";
 
-    _ofs << doIndent(_indent) << "</cluster>" << std::endl;
+    _ofs << doIndent(_indent) << "</cluster>" << "\n";
   } // clusterToXML
 
-  void zoneSensorToXML(const MainZoneSensor_t &_zoneSensor, std::ofstream& _ofs, const int _indent)
+  void zoneSensorToXML(const MainZoneSensor_t &_zoneSensor, std::ostream& _ofs, const int _indent)
   {
     _ofs << doIndent(_indent) << "<sensor dsuid=\""
          << dsuid2str(_zoneSensor.m_DSUID) << "\""
          << " sensorType=\"" << intToString(static_cast<int>(_zoneSensor.m_sensorType)) << "\""
          << " sensorIndex=\"" << intToString(_zoneSensor.m_sensorIndex)  << "\"/>"
-         << std::endl;
+         << "\n";
   } // zoneSensorToXML
 
-  void heatingConfigToXML(const ZoneHeatingProperties_t& heatingConfig, std::ofstream& _ofs, const int _indent)
+  void heatingConfigToXML(const ZoneHeatingProperties_t& heatingConfig, std::ostream& _ofs, const int _indent)
   {
     _ofs << doIndent(_indent) << "<heatingConfig";
     addAttribute(_ofs, "Mode", uintToString(static_cast<uint8_t>(heatingConfig.m_mode)));
@@ -1249,30 +1250,30 @@ namespace dss {
     addAttribute(_ofs, "Offset",  intToString(heatingConfig.m_CtrlOffset));
     addAttribute(_ofs, "EmergencyVal", uintToString(heatingConfig.m_EmergencyValue));
     addAttribute(_ofs, "ManualVal", uintToString(heatingConfig.m_ManualValue));
-    _ofs << ">" << std::endl;
+    _ofs << ">" << "\n";
 
     _ofs << doIndent(_indent+1) << "<temperatureSetpoints";
     for (int i = 0; i <= HeatingOperationModeIDMax; ++i) {
       addAttribute(_ofs, ds::str("val", i), ds::str(heatingConfig.m_TeperatureSetpoints[i]));
     }
-    _ofs << "/>" << std::endl;
+    _ofs << "/>" << "\n";
 
     _ofs << doIndent(_indent+1) << "<controlValues";
     for (int i = 0; i <= HeatingOperationModeIDMax; ++i) {
       addAttribute(_ofs, ds::str("val", i), ds::str(heatingConfig.m_FixedControlValues[i]));
     }
-    _ofs << "/>" << std::endl;
+    _ofs << "/>" << "\n";
 
-    _ofs << doIndent(_indent) << "</heatingConfig>" << std::endl;
+    _ofs << doIndent(_indent) << "</heatingConfig>" << "\n";
   } // heatingConfigToXML
 
-  void zoneToXML(boost::shared_ptr<Zone> _pZone, std::ofstream& _ofs, const int _indent) {
-    _ofs << doIndent(_indent) << "<zone id=\"" << intToString(_pZone->getID()) << "\">" << std::endl;
+  void zoneToXML(boost::shared_ptr<Zone> _pZone, std::ostream& _ofs, const int _indent) {
+    _ofs << doIndent(_indent) << "<zone id=\"" << intToString(_pZone->getID()) << "\">" << "\n";
     if(!_pZone->getName().empty()) {
-      _ofs << doIndent(_indent + 1) << "<name>" << XMLStringEscape(_pZone->getName()) << "</name>" << std::endl;
+      _ofs << doIndent(_indent + 1) << "<name>" << XMLStringEscape(_pZone->getName()) << "</name>" << "\n";
     }
 
-    _ofs << doIndent(_indent + 1) << "<groups>" << std::endl;
+    _ofs << doIndent(_indent + 1) << "<groups>" << "\n";
     // store real user-groups per zone
     foreach(boost::shared_ptr<Group> pGroup, _pZone->getGroups()) {
       if (_pZone->getID() == 0 && isAppUserGroup(pGroup->getID())) {
@@ -1280,16 +1281,16 @@ namespace dss {
       }
       groupToXML(pGroup, _ofs, _indent + 2);
     }
-    _ofs << doIndent(_indent + 1) << "</groups>" << std::endl;
+    _ofs << doIndent(_indent + 1) << "</groups>" << "\n";
 
     // Zone sensors
     auto&& slist = _pZone->getAssignedSensors();
     if ( !slist.empty() ) {
-      _ofs << doIndent(_indent + 1) << "<sensors>" << std::endl;
+      _ofs << doIndent(_indent + 1) << "<sensors>" << "\n";
       foreach (auto&& devSensor,  slist) {
         zoneSensorToXML(devSensor, _ofs, _indent+2);
       }
-      _ofs << doIndent(_indent + 1) << "</sensors>" << std::endl;
+      _ofs << doIndent(_indent + 1) << "</sensors>" << "\n";
     }
 
     // heating controller
@@ -1300,90 +1301,268 @@ namespace dss {
       }
     }
 
-    _ofs << doIndent(_indent) << "</zone>" << std::endl;
+    _ofs << doIndent(_indent) << "</zone>" << "\n";
   } // zoneToXML
 
-  void dsMeterToXML(const boost::shared_ptr<DSMeter> _pDSMeter, std::ofstream& _ofs, const int _indent) {
-    _ofs <<  doIndent(_indent) << "<dsMeter id=\"" + dsuid2str(_pDSMeter->getDSID()) << "\">" << std::endl;
+  void dsMeterToXML(const boost::shared_ptr<DSMeter> _pDSMeter, std::ostream& _ofs, const int _indent) {
+    _ofs <<  doIndent(_indent) << "<dsMeter id=\"" + dsuid2str(_pDSMeter->getDSID()) << "\">" << "\n";
     if(!_pDSMeter->getName().empty()) {
-      _ofs << doIndent(_indent + 1) << "<name>" + XMLStringEscape(_pDSMeter->getName()) << "</name>" << std::endl;
+      _ofs << doIndent(_indent + 1) << "<name>" + XMLStringEscape(_pDSMeter->getName()) << "</name>" << "\n";
     }
 
     _ofs << doIndent(_indent + 1) << "<datamodelHash>" <<
                                         intToString(_pDSMeter->getDatamodelHash()) <<
-                                     "</datamodelHash>" << std::endl;
+                                     "</datamodelHash>" << "\n";
 
     _ofs << doIndent(_indent + 1) << "<datamodelModification>" <<
                                         intToString(_pDSMeter->getDatamodelModificationCount()) <<
-                                     "</datamodelModification>" << std::endl;
+                                     "</datamodelModification>" << "\n";
 
     _ofs << doIndent(_indent + 1) << "<deviceType>" <<
                                         intToString(_pDSMeter->getBusMemberType()) <<
-                                     "</deviceType>" << std::endl;
+                                     "</deviceType>" << "\n";
 
-    _ofs << doIndent(_indent) << "</dsMeter>" << std::endl;
+    _ofs << doIndent(_indent) << "</dsMeter>" << "\n";
   } // dsMeterToXML
 
-  void ModelPersistence::writeConfigurationToXML(const std::string& _fileName) {
-    // The correct lock order is: apartment -> property
-    boost::recursive_mutex::scoped_lock apartment_lock(m_Apartment.getMutex());
-    boost::recursive_mutex::scoped_lock lock(PropertyNode::m_GlobalMutex);
+  // sections of the config file in the order they are written, fragment
+  // keys are prefixed with the section name
+  static const char* FragmentSections[] = {
+    "apartment", "devices", "zones", "clusters", "dsMeters"
+  };
+  static const int FragmentSectionCount =
+    sizeof(FragmentSections) / sizeof(FragmentSections[0]);
+  // attribute identifying a fragment within its section, NULL means the
+  // element name itself
+  static const char* FragmentIDAttributes[] = {
+    NULL, "dsuid", "id", "id", "id"
+  };
+  static const int FragmentIndent = 2;
+
+  void ModelFragments::set(const std::string& _key, const std::string& _fragment) {
+    std::map<std::string, size_t>::iterator it = m_Index.find(_key);
+    if (it != m_Index.end()) {
+      m_Fragments[it->second].second = _fragment;
+    } else {
+      m_Index[_key] = m_Fragments.size();
+      m_Fragments.push_back(std::make_pair(_key, _fragment));
+    }
+  } // set
 
-    Logger::getInstance()->log("Writing apartment config to '" + _fileName + "'", lsInfo);
+  void ModelFragments::erase(const std::string& _key) {
+    std::map<std::string, size_t>::iterator it = m_Index.find(_key);
+    if (it == m_Index.end()) {
+      return;
+    }
+    size_t pos = it->second;
+    m_Index.erase(it);
+    m_Fragments.erase(m_Fragments.begin() + pos);
+    for (size_t i = pos; i < m_Fragments.size(); i++) {
+      m_Index[m_Fragments[i].first] = i;
+    }
+  } // erase
 
-    std::string tmpOut = _fileName + ".tmp";
-    std::ofstream ofs(tmpOut.c_str());
+  const std::string* ModelFragments::find(const std::string& _key) const {
+    std::map<std::string, size_t>::const_iterator it = m_Index.find(_key);
+    return (it != m_Index.end()) ? &m_Fragments[it->second].second : NULL;
+  } // find
 
-    if(ofs) {
-      ofs << "<?xml version=\"1.0\" encoding=\"utf-8\"?>" << std::endl;
-      int indent = 0;
+  void ModelFragments::clear() {
+    m_Fragments.clear();
+    m_Index.clear();
+  } // clear
 
-      ofs << doIndent(indent) << "<config version=\"1\">" << std::endl;
-      indent++;
+  void ModelFragments::swap(ModelFragments& _other) {
+    m_Fragments.swap(_other.m_Fragments);
+    m_Index.swap(_other.m_Index);
+  } // swap
 
-      // apartment
-      ofs << doIndent(indent) << "<apartment>" << std::endl;
-      ofs << doIndent(indent + 1) << "<name>" + XMLStringEscape(m_Apartment.getName()) << "</name>" << std::endl;
-      ofs << doIndent(indent) << "</apartment>" << std::endl;
+  void ModelPersistence::snapshotFragments(ModelFragments& _fragments) {
+    std::vector<boost::shared_ptr<Device> > devices;
+    std::vector<boost::shared_ptr<Zone> > zones;
+    std::vector<boost::shared_ptr<Cluster> > clusters;
+    std::vector<boost::shared_ptr<DSMeter> > dsMeters;
 
-      // devices
-      ofs << doIndent(indent) << "<devices>" << std::endl;
-      foreach(boost::shared_ptr<Device> pDevice, m_Apartment.getDevicesVector()) {
-        deviceToXML(pDevice, ofs, indent + 1);
-      }
-      ofs << doIndent(indent) << "</devices>" << std::endl;
+    _fragments.clear();
+    {
+      boost::recursive_mutex::scoped_lock apartment_lock(m_Apartment.getMutex());
+      std::ostringstream ofs;
+      addElementSimple(ofs, FragmentIndent, "name", m_Apartment.getName());
+      _fragments.set("apartment/name", ofs.str());
+
+      devices = m_Apartment.getDevicesVector();
+      zones = m_Apartment.getZones();
+      // store unique "apartment user-groups" in zone 0
+      clusters = m_Apartment.getClusters();
+      dsMeters = m_Apartment.getDSMetersAll();
+    }
 
-      // zones
-      ofs << doIndent(indent) << "<zones>" << std::endl;
-      foreach(boost::shared_ptr<Zone> pZone, m_Apartment.getZones()) {
-        zoneToXML(pZone, ofs, indent + 1);
+    foreach(boost::shared_ptr<Device> pDevice, devices) {
+      std::ostringstream ofs;
+      {
+        // The correct lock order is: apartment -> property
+        boost::recursive_mutex::scoped_lock apartment_lock(m_Apartment.getMutex());
+        boost::recursive_mutex::scoped_lock lock(PropertyNode::m_GlobalMutex);
+        deviceToXML(pDevice, ofs, FragmentIndent);
       }
-      ofs << doIndent(indent) << "</zones>" << std::endl;
+      _fragments.set("devices/" + dsuid2str(pDevice->getDSID()), ofs.str());
+    }
 
-      // clusters
-      ofs << doIndent(indent) << "<clusters>" << std::endl;
-      // store unique "apartment user-groups" in zone 0
-      foreach(boost::shared_ptr<Cluster> pCluster, m_Apartment.getClusters()) {
-        clusterToXML(pCluster, ofs, indent + 1);
+    foreach(boost::shared_ptr<Zone> pZone, zones) {
+      std::ostringstream ofs;
+      {
+        boost::recursive_mutex::scoped_lock apartment_lock(m_Apartment.getMutex());
+        zoneToXML(pZone, ofs, FragmentIndent);
       }
-      ofs << doIndent(indent) << "</clusters>" << std::endl;
+      _fragments.set("zones/" + intToString(pZone->getID()), ofs.str());
+    }
 
-      // dsMeters
-      ofs << doIndent(indent) << "<dsMeters>" << std::endl;
-      foreach(boost::shared_ptr<DSMeter> pDSMeter, m_Apartment.getDSMetersAll()) {
-        dsMeterToXML(pDSMeter, ofs, indent + 1);
+    foreach(boost::shared_ptr<Cluster> pCluster, clusters) {
+      std::ostringstream ofs;
+      {
+        boost::recursive_mutex::scoped_lock apartment_lock(m_Apartment.getMutex());
+        clusterToXML(pCluster, ofs, FragmentIndent);
       }
-      ofs << doIndent(indent) << "</dsMeters>" << std::endl;
+      _fragments.set("clusters/" + intToString(pCluster->getID()), ofs.str());
+    }
 
-      indent--;
-      ofs << doIndent(indent) << "</config>" << std::endl;
+    foreach(boost::shared_ptr<DSMeter> pDSMeter, dsMeters) {
+      std::ostringstream ofs;
+      {
+        boost::recursive_mutex::scoped_lock apartment_lock(m_Apartment.getMutex());
+        dsMeterToXML(pDSMeter, ofs, FragmentIndent);
+      }
+      _fragments.set("dsMeters/" + dsuid2str(pDSMeter->getDSID()), ofs.str());
+    }
+  } // snapshotFragments
 
-      ofs.close();
+  bool ModelPersistence::writeFragmentsToXML(const ModelFragments& _fragments,
+                                             const std::string& _fileName) {
+    Logger::getInstance()->log("Writing apartment config to '" + _fileName + "'", lsInfo);
 
-      syncFile(tmpOut);
+    std::string tmpOut = _fileName + ".tmp";
+    std::ofstream ofs(tmpOut.c_str());
+    if (!ofs) {
+      Logger::getInstance()->log("Could not open '" + tmpOut + "' for writing", lsError);
+      return false;
+    }
+
+    ofs << "<?xml version=\"1.0\" encoding=\"utf-8\"?>" << "\n";
+    ofs << "<config version=\"1\">" << "\n";
+    for (int iSection = 0; iSection < FragmentSectionCount; iSection++) {
+      std::string prefix = std::string(FragmentSections[iSection]) + "/";
+      ofs << doIndent(1) << "<" << FragmentSections[iSection] << ">" << "\n";
+      foreach(const ModelFragments::value_type& fragment, _fragments) {
+        if (beginsWith(fragment.first, prefix)) {
+          ofs << fragment.second;
+        }
+      }
+      ofs << doIndent(1) << "</" << FragmentSections[iSection] << ">" << "\n";
+    }
+    ofs << "</config>" << "\n";
+    ofs.close();
 
-      saveValidatedXML(tmpOut, _fileName);
+    if (!ofs) {
+      Logger::getInstance()->log("Failed to write '" + tmpOut + "'", lsError);
+      return false;
     }
+
+    syncFile(tmpOut);
+
+    bool result = saveValidatedXML(tmpOut, _fileName);
     Logger::getInstance()->log("Finished writing apartment config to '" + _fileName + "'", lsDebug);
+    return result;
+  } // writeFragmentsToXML
+
+  bool ModelPersistence::readFragmentsFromXML(const std::string& _fileName,
+                                              ModelFragments& _fragments) {
+    std::ifstream ifs(_fileName.c_str());
+    if (!ifs) {
+      return false;
+    }
+
+    const std::string sectionIndent = doIndent(1);
+    const std::string fragmentIndent = doIndent(FragmentIndent);
+    int section = -1;
+    std::string line;
+    std::string key;
+    std::string fragment;
+    std::string closing;
+
+    while (std::getline(ifs, line)) {
+      // inside a multi line fragment, only its closing tag is of interest
+      if (!closing.empty()) {
+        fragment += line + "\n";
+        if (line == closing) {
+          _fragments.set(key, fragment);
+          closing.clear();
+        }
+        continue;
+      }
+
+      if (section == -1) {
+        if (beginsWith(line, "<?xml") || beginsWith(line, "<config ") ||
+            (line == "</config>")) {
+          continue;
+        }
+        for (int iSection = 0; iSection < FragmentSectionCount; iSection++) {
+          if (line == sectionIndent + "<" + FragmentSections[iSection] + ">") {
+            section = iSection;
+            break;
+          }
+        }
+        if (section == -1) {
+          return false;
+        }
+        continue;
+      }
+
+      if (line == sectionIndent + "</" + FragmentSections[section] + ">") {
+        section = -1;
+        continue;
+      }
+
+      if (!beginsWith(line, fragmentIndent + "<") ||
+          beginsWith(line, fragmentIndent + "</")) {
+        return false;
+      }
+      size_t nameStart = fragmentIndent.size() + 1;
+      size_t nameEnd = line.find_first_of(" />", nameStart);
+      if (nameEnd == std::string::npos) {
+        return false;
+      }
+      std::string element = line.substr(nameStart, nameEnd - nameStart);
+
+      std::string id = element;
+      if (FragmentIDAttributes[section] != NULL) {
+        std::string attribute = std::string(" ") + FragmentIDAttributes[section] + "=\"";
+        size_t idStart = line.find(attribute);
+        if (idStart == std::string::npos) {
+          return false;
+        }
+        idStart += attribute.size();
+        size_t idEnd = line.find('"', idStart);
+        if (idEnd == std::string::npos) {
+          return false;
+        }
+        id = line.substr(idStart, idEnd - idStart);
+      }
+
+      key = std::string(FragmentSections[section]) + "/" + id;
+      fragment = line + "\n";
+      if (endsWith(line, "/>") || endsWith(line, "</" + element + ">")) {
+        _fragments.set(key, fragment);
+      } else {
+        closing = fragmentIndent + "</" + element + ">";
+      }
+    }
+
+    return closing.empty() && (section == -1);
+  } // readFragmentsFromXML
+
+  void ModelPersistence::writeConfigurationToXML(const std::string& _fileName) {
+    ModelFragments fragments;
+    snapshotFragments(fragments);
+    writeFragmentsToXML(fragments, _fileName);
   } // writeConfigurationToXML
 }
@@ -26,6 +26,8 @@
 #define MODELPERSISTENCE_H_
 
 #include <iosfwd>
+#include <map>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <sstream>
 
@@ -41,6 +43,34 @@ namespace dss {
   class DSMeter;
   class PropertyParserProxy;
 
+  /** Serialized apartment model, one XML fragment per device, zone,
+    * cluster and dSM plus the apartment name. Keys are
+    * "<section>/<id>", e.g. "devices/<dsuid>" or "zones/3".
+    * Fragments keep the order they were added in, which is the order of
+    * the model, so a rewritten file lists the objects like before. */
+  class ModelFragments {
+  public:
+    typedef std::pair<std::string, std::string> value_type;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+    // fragments are only changed through set() and erase()
+    typedef const_iterator iterator;
+
+    /** Replaces the fragment \a _key, new keys are appended */
+    void set(const std::string& _key, const std::string& _fragment);
+    void erase(const std::string& _key);
+    /** Returns NULL if there is no fragment \a _key */
+    const std::string* find(const std::string& _key) const;
+
+    const_iterator begin() const { return m_Fragments.begin(); }
+    const_iterator end() const { return m_Fragments.end(); }
+    size_t size() const { return m_Fragments.size(); }
+    void clear();
+    void swap(ModelFragments& _other);
+  private:
+    std::vector<value_type> m_Fragments;
+    std::map<std::string, size_t> m_Index;
+  }; // ModelFragments
+
   class ModelPersistence : public ExpatParser
   {
   public:
@@ -50,6 +80,19 @@ namespace dss {
     void readConfigurationFromXML(const std::string& _fileName,
                                   const std::string& _backup);
     void writeConfigurationToXML(const std::string& _fileName);
+
+    /** Serializes the model object by object. Each object is rendered
+      * under its own short apartment/property lock, so readers are not
+      * blocked for the whole duration of a save. */
+    void snapshotFragments(ModelFragments& _fragments);
+    /** Writes a complete configuration file from \a _fragments, no model
+      * locks are taken. Returns false if the file could not be written */
+    static bool writeFragmentsToXML(const ModelFragments& _fragments,
+                                    const std::string& _fileName);
+    /** Splits a configuration file written by writeFragmentsToXML back into
+      * its fragments. Returns false if the file has an unexpected layout */
+    static bool readFragmentsFromXML(const std::string& _fileName,
+                                     ModelFragments& _fragments);
   private:
     Apartment& m_Apartment;
   protected:
@@ -45,20 +45,58 @@ namespace dss {
 
     //================================================== Set
 
-  Set::Set() {
-  } // ctor
-
-  Set::Set(boost::shared_ptr<const Device> _device) {
+  Set::Set()
+  : m_pApartment(NULL),
+    m_Materialized(false)
+  { } // ctor
+
+  Set::Set(boost::shared_ptr<const Device> _device)
+  : m_pApartment(NULL),
+    m_Materialized(false)
+  {
     m_ContainedDevices.push_back(DeviceReference(_device, &_device->getApartment()));
   } // ctor(Device)
 
-  Set::Set(std::vector<DeviceReference> _devices) {
-    m_ContainedDevices = _devices;
-  }
+  Set::Set(std::vector<DeviceReference> _devices)
+  : m_ContainedDevices(_devices),
+    m_pApartment(NULL),
+    m_Materialized(false)
+  { }
+
+  Set::Set(const Apartment* _apartment, const DeviceBitmap& _members)
+  : m_pApartment(_apartment),
+    m_Members(_members),
+    m_Materialized(false)
+  { } // ctor(bitmap)
+
+  Set::Set(const Set& _copy)
+  : m_ContainedDevices(_copy.m_ContainedDevices),
+    m_pApartment(_copy.m_pApartment),
+    m_Members(_copy.m_Members),
+    m_Materialized(_copy.m_Materialized)
+  { }
+
+  bool Set::sharesBitmapWith(const Set& _other) const {
+    return isBitmap() && (m_pApartment == _other.m_pApartment);
+  } // sharesBitmapWith
+
+  void Set::materialize() const {
+    if (isBitmap() && !m_Materialized) {
+      m_ContainedDevices = m_pApartment->resolveDeviceBitmap(m_Members);
+      m_Materialized = true;
+    }
+  } // materialize
 
-  Set::Set(const Set& _copy) {
-    m_ContainedDevices = _copy.m_ContainedDevices;
-  }
+  void Set::dropBitmap() {
+    materialize();
+    m_pApartment = NULL;
+    m_Members.clear();
+    m_Materialized = false;
+  } // dropBitmap
+
+  Set Set::withMembers(const DeviceBitmap& _members) const {
+    return Set(m_pApartment, _members);
+  } // withMembers
 
   void Set::nextScene(const callOrigin_t _origin, const SceneAccessCategory _category) {
     throw std::runtime_error("Not yet implemented");
@@ -69,12 +107,24 @@ namespace dss {
   } // previousScene
 
   void Set::perform(IDeviceAction& _deviceAction) {
+    materialize();
     for(auto iDevice = m_ContainedDevices.begin(); iDevice != m_ContainedDevices.end(); ++iDevice) {
       _deviceAction.perform(iDevice->getDevice());
     }
   } // perform
 
+  typedef std::pair<std::size_t, boost::shared_ptr<Device> > SlotDevice;
+
   Set Set::getSubset(const IDeviceSelector& _selector) const {
+    if (isBitmap()) {
+      DeviceBitmap members(m_Members.size());
+      foreach(const SlotDevice& dev, m_pApartment->resolveDevices(m_Members)) {
+        if (_selector.selectDevice(dev.second)) {
+          members.set(dev.first);
+        }
+      }
+      return withMembers(members);
+    }
     Set result;
     foreach(DeviceReference iDevice, m_ContainedDevices) {
       if(_selector.selectDevice(iDevice.getDevice())) {
@@ -100,7 +150,11 @@ namespace dss {
   };
 
   Set Set::getByGroup(int _groupNr) const {
-    if(_groupNr != GroupIDBroadcast) {
+    if((_groupNr != GroupIDBroadcast) && isBitmap()) {
+      DeviceBitmap members(m_Members);
+      m_pApartment->intersectWithGroup(members, _groupNr);
+      return withMembers(members);
+    } else if(_groupNr != GroupIDBroadcast) {
       return getSubset(ByGroupSelector(_groupNr));
     } else {
       return *this;
@@ -138,7 +192,11 @@ namespace dss {
   }
 
   Set Set::getByZone(int _zoneID) const {
-    if(_zoneID != 0) {
+    if((_zoneID != 0) && isBitmap()) {
+      DeviceBitmap members(m_Members);
+      m_pApartment->intersectWithZone(members, _zoneID);
+      return withMembers(members);
+    } else if(_zoneID != 0) {
       Set result;
       foreach(const DeviceReference& dev, m_ContainedDevices) {
         if(dev.getDevice()->getZoneID() == _zoneID) {
@@ -166,54 +224,78 @@ namespace dss {
     return getByDSMeter(_dsMeter->getDSID());
   } // getByDSMeter
 
-  Set Set::getByDSMeter(const dsuid_t& _dsMeterDSID) const {
-    Set result;
-    foreach(const DeviceReference& dev, m_ContainedDevices) {
-      if (dev.getDevice()->getDSMeterDSID() == _dsMeterDSID) {
-        result.addDevice(dev);
+  class ByDSMeterSelector : public IDeviceSelector {
+  private:
+    const dsuid_t m_DSMeterDSID;
+    const bool m_LastKnown;
+  public:
+    ByDSMeterSelector(const dsuid_t& _dsMeterDSID, const bool _lastKnown)
+    : m_DSMeterDSID(_dsMeterDSID), m_LastKnown(_lastKnown)
+    {}
+    virtual ~ByDSMeterSelector() {};
+
+    virtual bool selectDevice(boost::shared_ptr<const Device> _device) const {
+      if (m_LastKnown) {
+        return _device->getLastKnownDSMeterDSID() == m_DSMeterDSID;
       }
+      return _device->getDSMeterDSID() == m_DSMeterDSID;
     }
-    return result;
+  };
+
+  Set Set::getByDSMeter(const dsuid_t& _dsMeterDSID) const {
+    return getSubset(ByDSMeterSelector(_dsMeterDSID, false));
   } // getByDSMeter
 
   Set Set::getByLastKnownDSMeter(const dsuid_t& _dsMeterDSID) const {
-    Set result;
-    foreach(const DeviceReference& dev, m_ContainedDevices) {
-      if (dev.getDevice()->getLastKnownDSMeterDSID() == _dsMeterDSID) {
-        result.addDevice(dev);
-      }
-    }
-    return result;
+    return getSubset(ByDSMeterSelector(_dsMeterDSID, true));
   } // getByLastKnownDSMeter
 
-  Set Set::getByFunctionID(const int _functionID) const {
-    Set result;
-    foreach(const DeviceReference& dev, m_ContainedDevices) {
-      if(dev.getDevice()->getFunctionID() == _functionID) {
-        result.addDevice(dev);
-      }
+  class ByFunctionIDSelector : public IDeviceSelector {
+  private:
+    const int m_FunctionID;
+  public:
+    ByFunctionIDSelector(const int _functionID) : m_FunctionID(_functionID) {}
+    virtual ~ByFunctionIDSelector() {};
+
+    virtual bool selectDevice(boost::shared_ptr<const Device> _device) const {
+      return _device->getFunctionID() == m_FunctionID;
     }
-    return result;
+  };
+
+  Set Set::getByFunctionID(const int _functionID) const {
+    return getSubset(ByFunctionIDSelector(_functionID));
   } // getByFunctionID
 
-  Set Set::getByPresence(const bool _presence) const {
-    Set result;
-    foreach(const DeviceReference& dev, m_ContainedDevices) {
-      if(dev.getDevice()->isPresent()== _presence) {
-        result.addDevice(dev);
-      }
+  class ByPresenceSelector : public IDeviceSelector {
+  private:
+    const bool m_Present;
+  public:
+    ByPresenceSelector(const bool _present) : m_Present(_present) {}
+    virtual ~ByPresenceSelector() {};
+
+    virtual bool selectDevice(boost::shared_ptr<const Device> _device) const {
+      return _device->isPresent() == m_Present;
     }
-    return result;
+  };
+
+  Set Set::getByPresence(const bool _presence) const {
+    return getSubset(ByPresenceSelector(_presence));
   } // getByPresence
 
-  Set Set::getByTag(const std::string& _tagName) const {
-    Set result;
-    foreach(const DeviceReference& dev, m_ContainedDevices) {
-      if(dev.getDevice()->hasTag(_tagName)) {
-        result.addDevice(dev);
-      }
+  class ByTagSelector : public IDeviceSelector {
+  private:
+    const std::string m_TagName;
+  public:
+    ByTagSelector(const std::string& _tagName) : m_TagName(_tagName) {}
+    virtual ~ByTagSelector() {};
+
+    virtual bool selectDevice(boost::shared_ptr<const Device> _device) const {
+      return _device->hasTag(m_TagName);
     }
-    return result;
+  };
+
+  Set Set::getByTag(const std::string& _tagName) const {
+    return getSubset(ByTagSelector(_tagName));
   } // getByTag
 
   class ByNameSelector : public IDeviceSelector {
@@ -233,7 +315,7 @@ namespace dss {
     if(resultSet.length() == 0) {
       throw ItemNotFoundException(_name);
     }
-    return resultSet.m_ContainedDevices.front();
+    return resultSet.get(0);
   } // getByName
 
 
@@ -258,7 +340,7 @@ namespace dss {
     if(resultSet.length() == 0) {
       throw ItemNotFoundException(std::string("with busid ") + intToString(_id));
     }
-    return resultSet.m_ContainedDevices.front();
+    return resultSet.get(0);
   } // getByBusID
 
   DeviceReference Set::getByBusID(const devid_t _busid, boost::shared_ptr<const DSMeter> _meter) const {
@@ -278,11 +360,19 @@ namespace dss {
   };
 
   DeviceReference Set::getByDSID(const dsuid_t _dsid) const {
+    if (isBitmap()) {
+      std::size_t slot;
+      if (m_pApartment->tryGetDeviceSlot(_dsid, slot) &&
+          (slot < m_Members.size()) && m_Members.test(slot)) {
+        return DeviceReference(_dsid, m_pApartment);
+      }
+      throw ItemNotFoundException("with dsid " + dsuid2str(_dsid));
+    }
     Set resultSet = getSubset(ByDSIDSelector(_dsid));
     if(resultSet.length() == 0) {
       throw ItemNotFoundException("with dsid " + dsuid2str(_dsid));
     }
-    return resultSet.m_ContainedDevices.front();
+    return resultSet.get(0);
   } // getByDSID
 
   class BySerialSelector : public IDeviceSelector {
@@ -309,10 +399,13 @@ namespace dss {
     if(resultSet.length() == 0) {
       throw ItemNotFoundException("with serial " + uintToString(_serial, true));
     }
-    return resultSet.m_ContainedDevices.front();
+    return resultSet.get(0);
   } // getBySerial
 
   int Set::length() const {
+    // the bitmap may still have bits of removed devices, count what get()
+    // hands out
+    materialize();
     return m_ContainedDevices.size();
   } // length
 
@@ -321,6 +414,16 @@ namespace dss {
   } // isEmpty
 
   Set Set::combine(Set& _other) const {
+    if (sharesBitmapWith(_other)) {
+      DeviceBitmap members(m_Members);
+      DeviceBitmap other(_other.m_Members);
+      std::size_t size = std::max(members.size(), other.size());
+      members.resize(size);
+      other.resize(size);
+      members |= other;
+      return withMembers(members);
+    }
+    materialize();
     Set resultSet(_other);
     foreach(const DeviceReference& iDevice, m_ContainedDevices) {
       if(!resultSet.contains(iDevice)) {
@@ -331,6 +434,14 @@ namespace dss {
   } // combine
 
   Set Set::remove(const Set& _other) const {
+    if (sharesBitmapWith(_other)) {
+      DeviceBitmap members(m_Members);
+      DeviceBitmap other(_other.m_Members);
+      other.resize(members.size());
+      members -= other;
+      return withMembers(members);
+    }
+    _other.materialize();
     Set resultSet(*this);
     foreach(const DeviceReference& iDevice, _other.m_ContainedDevices) {
       resultSet.removeDevice(iDevice);
@@ -339,6 +450,11 @@ namespace dss {
   } // remove
 
   bool Set::contains(const DeviceReference& _device) const {
+    if (isBitmap()) {
+      std::size_t slot;
+      return m_pApartment->tryGetDeviceSlot(_device.getDSID(), slot) &&
+             (slot < m_Members.size()) && m_Members.test(slot);
+    }
     auto pos = find(m_ContainedDevices.begin(), m_ContainedDevices.end(), _device);
     return pos != m_ContainedDevices.end();
   } // contains
@@ -348,6 +464,18 @@ namespace dss {
   } // contains
 
   void Set::addDevice(const DeviceReference& _device) {
+    if (isBitmap()) {
+      std::size_t slot;
+      if (m_pApartment->tryGetDeviceSlot(_device.getDSID(), slot)) {
+        if (slot >= m_Members.size()) {
+          m_Members.resize(slot + 1);
+        }
+        m_Members.set(slot);
+        m_Materialized = false;
+        return;
+      }
+      dropBitmap();
+    }
     if(!contains(_device)) {
       m_ContainedDevices.push_back(_device);
     }
@@ -358,6 +486,14 @@ namespace dss {
   } // addDevice
 
   void Set::removeDevice(const DeviceReference& _device) {
+    if (isBitmap()) {
+      std::size_t slot;
+      if (m_pApartment->tryGetDeviceSlot(_device.getDSID(), slot) && (slot < m_Members.size())) {
+        m_Members.reset(slot);
+        m_Materialized = false;
+      }
+      return;
+    }
     auto pos = find(m_ContainedDevices.begin(), m_ContainedDevices.end(), _device);
     if(pos != m_ContainedDevices.end()) {
       m_ContainedDevices.erase(pos);
@@ -369,6 +505,7 @@ namespace dss {
   } // removeDevice
 
   const DeviceReference& Set::get(int _index) const {
+    materialize();
     return m_ContainedDevices.at(_index);
   } // get
 
@@ -377,6 +514,8 @@ namespace dss {
   } // operator[]
 
   DeviceReference& Set::get(int _index) {
+    // the reference handed out may be modified, keep the list only
+    dropBitmap();
     return m_ContainedDevices.at(_index);
   } // get
 
@@ -386,6 +525,7 @@ namespace dss {
 
   unsigned long Set::getPowerConsumption() {
     unsigned long result = 0;
+    materialize();
     foreach(DeviceReference& iDevice, m_ContainedDevices) {
       result += iDevice.getPowerConsumption();
     }
@@ -26,11 +26,13 @@
 #include <boost/shared_ptr.hpp>
 
 #include "nonaddressablemodelitem.h"
+#include "devicecontainer.h"
 
 #include "device.h"
 
 namespace dss {
 
+  class Apartment;
   class Group;
   class DSMeter;
 
@@ -55,10 +57,24 @@ namespace dss {
     * A Command sent to an instance of this class will replicate the command to all
     * contained devices.
     * Only references to devices will be stored.
+    * Sets derived from Apartment::getDevices() are kept as bitmap over the
+    * apartments device slots, so that filtering by zone or group and
+    * combining sets are plain bit operations. The list of references is
+    * only built once the devices are accessed individually.
    */
   class Set : public NonAddressableModelItem {
   private:
-    std::vector<DeviceReference> m_ContainedDevices;
+    /** Contained devices; a cache of m_Members while m_pApartment is set */
+    mutable std::vector<DeviceReference> m_ContainedDevices;
+    const Apartment* m_pApartment;
+    DeviceBitmap m_Members;
+    mutable bool m_Materialized;
+
+    bool isBitmap() const { return m_pApartment != NULL; }
+    bool sharesBitmapWith(const Set& _other) const;
+    void materialize() const;
+    void dropBitmap();
+    Set withMembers(const DeviceBitmap& _members) const;
   public:
     /** Constructor for an empty Set.*/
     Set();
@@ -70,6 +86,8 @@ namespace dss {
     Set(DeviceReference& _reference);
     /** Constructor for a set containing \a _devices. */
     Set(std::vector<DeviceReference> _devices);
+    /** Constructor for a set containing the devices of \a _apartment in \a _members */
+    Set(const Apartment* _apartment, const DeviceBitmap& _members);
     virtual ~Set() {};
 
     /** Performs the given action on all contained devices */
@@ -40,6 +40,12 @@
 #include "model/modelconst.h"
 #include "model/modulator.h"
 #include "modelmaintenance.h"
+#include "model/statestore.h"
+#include "systemcondition.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
 
 #include <boost/shared_ptr.hpp>
 
@@ -251,57 +257,65 @@ namespace dss {
     }
   } // removeFromPropertyTree
 
-  std::string State::getStorageName() {
-    std::string dirname;
+  std::string State::getStorageDirectory() {
     if (!DSS::hasInstance()) {
-      dirname = "/tmp";
-    } else {
-      dirname = DSS::getInstance()->getSavedPropsDirectory();
+      return "/tmp";
     }
-    std::string filename = "state." + getName();
-    return dirname + "/" + filename;
+    return DSS::getInstance()->getSavedPropsDirectory();
+  } // getStorageDirectory
+
+  std::string State::getStorageName() {
+    return getStorageDirectory() + "/state." + getName();
   }
 
   void State::save() {
-    FILE *fout = fopen(getStorageName().c_str(), "w");
-    if (NULL == fout) {
-      Logger::getInstance()->log("State " + m_name + " could not be written", lsError);
-      return;
-    }
-    fputc((int) m_state, fout);
-    fputc(static_cast<int>(m_callOrigin), fout);
-    for (int i = 0; i < DSUID_SIZE; i++) {
-      fputc(static_cast<int>(m_originDeviceDSUID.id[i]), fout);
-    }
-    fclose(fout);
+    std::string data;
+    data.push_back(static_cast<char>(m_state));
+    data.push_back(static_cast<char>(m_callOrigin));
+    data.append(reinterpret_cast<const char*>(m_originDeviceDSUID.id), DSUID_SIZE);
+    StateStore::getInstance(getStorageDirectory())->save(getName(), data);
   } // save
 
   void State::load() {
-    FILE *fin = fopen(getStorageName().c_str(), "r");
-    if (NULL == fin) {
-      return;
+    boost::shared_ptr<StateStore> store = StateStore::getInstance(getStorageDirectory());
+    std::string data;
+    if (!store->load(getName(), data)) {
+      // state files written before the state store existed
+      std::ifstream ifs(getStorageName().c_str(), std::ios::binary);
+      if (!ifs) {
+        return;
+      }
+      data.assign((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+      store->save(getName(), data);
     }
-    int value = fgetc(fin);
-    if (value != EOF) {
-      m_state = (eState) value;
+    if (data.size() > 0) {
+      m_state = (eState) static_cast<unsigned char>(data[0]);
+      invalidateConditions();
     }
-    value = fgetc(fin);
-    if (value != EOF) {
-      m_callOrigin = static_cast<callOrigin_t>(value);
+    if (data.size() > 1) {
+      m_callOrigin = static_cast<callOrigin_t>(static_cast<unsigned char>(data[1]));
     }
-    for (int i = 0; i < DSUID_SIZE; i++) {
-      value = fgetc(fin);
-      if (value != EOF) {
-        m_originDeviceDSUID.id[i] = static_cast<char>(value);
-      } else {
-        m_originDeviceDSUID = DSUID_NULL;
-        break;
-      }
+    if (data.size() >= 2 + DSUID_SIZE) {
+      memcpy(m_originDeviceDSUID.id, data.data() + 2, DSUID_SIZE);
+    } else {
+      m_originDeviceDSUID = DSUID_NULL;
     }
-    fclose(fin);
-    return;
   } // load
 
+  void State::invalidateConditions() {
+    // the value node is a proxy, changing it doesn't notify listeners
+    switch (m_type) {
+      case StateType_Script:
+      case StateType_SensorDevice:
+      case StateType_SensorZone:
+        SystemCondition::stateChanged(m_serviceName + "/" + m_name);
+        break;
+      default:
+        SystemCondition::stateChanged(m_name);
+        break;
+    }
+  } // invalidateConditions
+
   bool State::getPersistence() const {
     return m_persistency == StatePersistency::persistent;
   } // getPersistence
@@ -314,6 +328,9 @@ namespace dss {
   } // setPersistence
 
   bool State::hasPersistentData() {
+    if (StateStore::getInstance(getStorageDirectory())->contains(getName())) {
+      return true;
+    }
     std::string fname(getStorageName());
     if (access(fname.c_str(), F_OK) == 0) {
       return true;
@@ -379,6 +396,7 @@ namespace dss {
       int oldstate = m_state;
       m_state = _state;
       m_callOrigin = _origin;
+      invalidateConditions();
 
       if (m_pPropertyNode != NULL && DSS::hasInstance() && (m_callOrigin != coUnknown)) {
         m_pPropertyNode->createProperty("callOrigin")
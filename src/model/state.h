@@ -74,6 +74,10 @@ namespace dss {
   protected:
     void save();
     void load();
+    /** Drops cached system condition results depending on this state */
+    void invalidateConditions();
+    std::string getStorageDirectory();
+    /** File of the state before the state store existed */
     std::string getStorageName();
 
     /// used by derived classes to construct base class
@@ -0,0 +1,398 @@
+/*
+    Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+
+    This file is part of digitalSTROM Server.
+
+    digitalSTROM Server is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    digitalSTROM Server is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "statestore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/crc.hpp>
+#include <boost/make_shared.hpp>
+
+#include "src/foreach.h"
+#include "src/base.h"
+#include "src/logger.h"
+
+namespace dss {
+
+  static const char kJournalMagic[8] = { 'D', 'S', 'S', 'S', 'T', 'A', 'T', '1' };
+  /** Upper bound for names and values, guards against damaged records */
+  static const size_t kMaxFieldSize = 0xffff;
+
+  /* Each record is <name length:2> <data length:2> <name> <data> <crc32:4>,
+   * integers little endian, the checksum covers name and data. */
+  static uint32_t recordChecksum(const std::string& _name, const std::string& _data) {
+    boost::crc_32_type crc;
+    crc.process_bytes(_name.data(), _name.size());
+    crc.process_bytes(_data.data(), _data.size());
+    return crc.checksum();
+  } // recordChecksum
+
+  static void putInt(std::string& _out, uint32_t _value, int _bytes) {
+    for (int i = 0; i < _bytes; i++) {
+      _out.push_back(static_cast<char>((_value >> (8 * i)) & 0xff));
+    }
+  } // putInt
+
+  static uint32_t getInt(const std::string& _in, size_t _offset, int _bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < _bytes; i++) {
+      value |= static_cast<uint32_t>(static_cast<unsigned char>(_in[_offset + i])) << (8 * i);
+    }
+    return value;
+  } // getInt
+
+  static void encodeRecord(std::string& _out, const std::string& _name,
+                           const std::string& _data) {
+    putInt(_out, _name.size(), 2);
+    putInt(_out, _data.size(), 2);
+    _out.append(_name);
+    _out.append(_data);
+    putInt(_out, recordChecksum(_name, _data), 4);
+  } // encodeRecord
+
+  static bool writeAll(int _fd, const std::string& _data) {
+    size_t written = 0;
+    while (written < _data.size()) {
+      ssize_t n = ::write(_fd, _data.data() + written, _data.size() - written);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      written += n;
+    }
+    return true;
+  } // writeAll
+
+  //================================================== StateStore
+
+  StateStore::StateStore(const std::string& _fileName, int _commitDelayMS,
+                         int _compactRecords)
+  : m_FileName(_fileName),
+    m_CommitDelay(_commitDelayMS),
+    m_CompactRecords(_compactRecords),
+    m_FD(-1),
+    m_PendingRecords(0),
+    m_Queued(0),
+    m_Committed(0),
+    m_JournalRecords(0),
+    m_NeedsCompaction(false),
+    m_CommitFailed(false),
+    m_Stopping(false),
+    m_Commits(0)
+  {
+    readJournal();
+    m_Writer = boost::make_shared<boost::thread>(boost::bind(&StateStore::writerThread, this));
+  } // ctor
+
+  StateStore::~StateStore() {
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Stopping = true;
+    }
+    m_PendingCondition.notify_all();
+    m_Writer->join();
+    closeJournal();
+  } // dtor
+
+  typedef std::map<std::string, boost::shared_ptr<StateStore> > StateStores;
+  static boost::mutex g_StoresMutex;
+  static StateStores g_Stores;
+
+  boost::shared_ptr<StateStore> StateStore::getInstance(const std::string& _directory) {
+    boost::mutex::scoped_lock lock(g_StoresMutex);
+    boost::shared_ptr<StateStore>& store = g_Stores[_directory];
+    if (store == NULL) {
+      store = boost::make_shared<StateStore>(getFileName(_directory),
+                                             STATE_STORE_COMMIT_DELAY_MS,
+                                             STATE_STORE_COMPACT_RECORDS);
+    }
+    return store;
+  } // getInstance
+
+  bool StateStore::flushAll() {
+    StateStores stores;
+    {
+      boost::mutex::scoped_lock lock(g_StoresMutex);
+      stores = g_Stores;
+    }
+    bool result = true;
+    foreach(StateStores::value_type& store, stores) {
+      if (!store.second->flush()) {
+        result = false;
+      }
+    }
+    return result;
+  } // flushAll
+
+  std::string StateStore::getFileName(const std::string& _directory) {
+    return _directory + "/states.journal";
+  } // getFileName
+
+  void StateStore::readJournal() {
+    std::ifstream ifs(m_FileName.c_str(), std::ios::binary);
+    if (!ifs) {
+      // the first commit writes the file header
+      m_NeedsCompaction = true;
+      return;
+    }
+    std::string content((std::istreambuf_iterator<char>(ifs)),
+                        std::istreambuf_iterator<char>());
+
+    if ((content.size() < sizeof(kJournalMagic)) ||
+        (memcmp(content.data(), kJournalMagic, sizeof(kJournalMagic)) != 0)) {
+      Logger::getInstance()->log("StateStore: '" + m_FileName +
+                                 "' is not a state journal, ignoring it", lsWarning);
+      m_NeedsCompaction = true;
+      return;
+    }
+
+    size_t offset = sizeof(kJournalMagic);
+    while (offset < content.size()) {
+      if (content.size() - offset < 4) {
+        break;
+      }
+      size_t nameLength = getInt(content, offset, 2);
+      size_t dataLength = getInt(content, offset + 2, 2);
+      if (content.size() - offset < 4 + nameLength + dataLength + 4) {
+        break;
+      }
+      std::string name = content.substr(offset + 4, nameLength);
+      std::string data = content.substr(offset + 4 + nameLength, dataLength);
+      if (getInt(content, offset + 4 + nameLength + dataLength, 4) !=
+          recordChecksum(name, data)) {
+        break;
+      }
+      m_Values[name].swap(data);
+      m_JournalRecords++;
+      offset += 4 + nameLength + dataLength + 4;
+    }
+
+    if (offset < content.size()) {
+      Logger::getInstance()->log("StateStore: damaged record in '" + m_FileName +
+                                 "', ignoring the rest", lsWarning);
+      m_NeedsCompaction = true;
+    }
+    Logger::getInstance()->log("StateStore: read " + intToString(m_Values.size()) +
+                               " states from " + intToString(m_JournalRecords) +
+                               " records in '" + m_FileName + "'", lsDebug);
+  } // readJournal
+
+  bool StateStore::load(const std::string& _name, std::string& _data) const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    Values::const_iterator it = m_Values.find(_name);
+    if (it == m_Values.end()) {
+      return false;
+    }
+    _data = it->second;
+    return true;
+  } // load
+
+  bool StateStore::contains(const std::string& _name) const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Values.find(_name) != m_Values.end();
+  } // contains
+
+  void StateStore::save(const std::string& _name, const std::string& _data) {
+    if ((_name.size() > kMaxFieldSize) || (_data.size() > kMaxFieldSize)) {
+      Logger::getInstance()->log("StateStore: value of '" + _name +
+                                 "' too large, not saved", lsError);
+      return;
+    }
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Values[_name] = _data;
+      encodeRecord(m_Pending, _name, _data);
+      m_PendingRecords++;
+      m_Queued++;
+    }
+    m_PendingCondition.notify_one();
+  } // save
+
+  bool StateStore::flush() {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    unsigned long long target = m_Queued;
+    while (m_Committed < target) {
+      if (m_CommitFailed) {
+        return false;
+      }
+      m_CommittedCondition.wait(lock);
+    }
+    return true;
+  } // flush
+
+  void StateStore::writerThread() {
+    int retryDelayMS = STATE_STORE_RETRY_DELAY_MS;
+    for (;;) {
+      std::string records;
+      Values values;
+      unsigned long long sequence;
+      int count;
+      bool compacting;
+      {
+        boost::mutex::scoped_lock lock(m_Mutex);
+        while (m_Pending.empty() && !m_CommitFailed && !m_Stopping) {
+          m_PendingCondition.wait(lock);
+        }
+        if (m_Pending.empty() && !m_CommitFailed) {
+          return;
+        }
+        if (m_CommitFailed && !m_Stopping) {
+          // don't hammer a failing disk, new saves join the retry
+          boost::system_time retryAt = boost::get_system_time() +
+                                       boost::posix_time::milliseconds(retryDelayMS);
+          while (!m_Stopping && m_PendingCondition.timed_wait(lock, retryAt)) {
+          }
+          retryDelayMS = std::min(2 * retryDelayMS, STATE_STORE_MAX_RETRY_DELAY_MS);
+        } else if (!m_Stopping) {
+          // let the changes of the next few milliseconds join this commit
+          lock.unlock();
+          boost::this_thread::sleep(m_CommitDelay);
+          lock.lock();
+        }
+        records.swap(m_Pending);
+        count = m_PendingRecords;
+        m_PendingRecords = 0;
+        sequence = m_Queued;
+        // the records of a failed commit are gone from m_Pending, only a
+        // compaction brings them to disk
+        compacting = m_NeedsCompaction || m_CommitFailed ||
+                     (m_JournalRecords > (int)m_Values.size() + m_CompactRecords);
+        if (compacting) {
+          values = m_Values;
+        }
+      }
+
+      bool ok = compacting ? compact(values) : append(records);
+
+      bool stopping;
+      {
+        boost::mutex::scoped_lock lock(m_Mutex);
+        stopping = m_Stopping;
+        if (ok) {
+          m_JournalRecords = compacting ? values.size() : m_JournalRecords + count;
+          m_NeedsCompaction = false;
+          m_CommitFailed = false;
+          m_Committed = sequence;
+          m_Commits++;
+          retryDelayMS = STATE_STORE_RETRY_DELAY_MS;
+        } else {
+          // a failed append may have left a torn record behind, which would
+          // hide everything appended after it
+          m_NeedsCompaction = true;
+          m_CommitFailed = true;
+        }
+      }
+      m_CommittedCondition.notify_all();
+
+      if (!ok && stopping) {
+        Logger::getInstance()->log("StateStore: giving up on '" + m_FileName +
+                                   "', the latest states are lost", lsError);
+        return;
+      }
+    }
+  } // writerThread
+
+  bool StateStore::openJournal() {
+    if (m_FD >= 0) {
+      return true;
+    }
+    m_FD = ::open(m_FileName.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (m_FD < 0) {
+      Logger::getInstance()->log("StateStore: could not open '" + m_FileName +
+                                 "': " + strerror(errno), lsError);
+      return false;
+    }
+    return true;
+  } // openJournal
+
+  void StateStore::closeJournal() {
+    if (m_FD >= 0) {
+      ::close(m_FD);
+      m_FD = -1;
+    }
+  } // closeJournal
+
+  bool StateStore::append(const std::string& _records) {
+    if (!openJournal()) {
+      return false;
+    }
+    if (!writeAll(m_FD, _records) || (fdatasync(m_FD) != 0)) {
+      Logger::getInstance()->log("StateStore: failed to append to '" + m_FileName +
+                                 "': " + strerror(errno), lsError);
+      closeJournal();
+      return false;
+    }
+    return true;
+  } // append
+
+  bool StateStore::compact(const Values& _values) {
+    std::string content(kJournalMagic, sizeof(kJournalMagic));
+    foreach(const Values::value_type& value, _values) {
+      encodeRecord(content, value.first, value.second);
+    }
+
+    std::string tmpOut = m_FileName + ".tmp";
+    int fd = ::open(tmpOut.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      Logger::getInstance()->log("StateStore: could not open '" + tmpOut +
+                                 "': " + strerror(errno), lsError);
+      return false;
+    }
+    bool ok = writeAll(fd, content) && (fsync(fd) == 0);
+    ::close(fd);
+    if (!ok || (rename(tmpOut.c_str(), m_FileName.c_str()) != 0)) {
+      Logger::getInstance()->log("StateStore: failed to write '" + m_FileName +
+                                 "': " + strerror(errno), lsError);
+      unlink(tmpOut.c_str());
+      return false;
+    }
+
+    // further records go to the new file
+    closeJournal();
+    Logger::getInstance()->log("StateStore: compacted '" + m_FileName + "' to " +
+                               intToString(_values.size()) + " records", lsDebug);
+    return true;
+  } // compact
+
+  int StateStore::getCommits() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Commits;
+  } // getCommits
+
+  int StateStore::getJournalRecords() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_JournalRecords;
+  } // getJournalRecords
+
+} // namespace dss
@@ -0,0 +1,116 @@
+/*
+    Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+
+    This file is part of digitalSTROM Server.
+
+    digitalSTROM Server is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    digitalSTROM Server is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef STATESTORE_H_
+#define STATESTORE_H_
+
+#include <string>
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/** How long the writer waits for more changes to join a commit */
+#define STATE_STORE_COMMIT_DELAY_MS 5
+/** Records the journal may hold beyond the number of states before it
+  * gets compacted */
+#define STATE_STORE_COMPACT_RECORDS 1000
+/** First and longest pause before a failed commit is retried */
+#define STATE_STORE_RETRY_DELAY_MS 100
+#define STATE_STORE_MAX_RETRY_DELAY_MS 10000
+
+namespace dss {
+
+  /** Persistent values of all states in one append-only journal.
+    * save() updates the in-memory copy and queues a record, a writer thread
+    * collects whatever got queued within a few milliseconds and appends it
+    * with a single write and fsync (group commit). Once the journal holds
+    * many more records than there are states it is rewritten with one record
+    * per state. On open the journal is read up to the first damaged record,
+    * a damaged tail is dropped by compacting before the next append.
+    * A failed commit is retried as a compaction with growing pauses until
+    * it succeeds, flush() reports the failure meanwhile. */
+  class StateStore : boost::noncopyable {
+  public:
+    StateStore(const std::string& _fileName, int _commitDelayMS,
+               int _compactRecords);
+    /** Commits pending records and joins the writer */
+    ~StateStore();
+
+    /** The store of \a _directory, opened on first use */
+    static boost::shared_ptr<StateStore> getInstance(const std::string& _directory);
+    /** Waits until the records of all open stores are on disk, returns
+      * false if one of them failed to commit */
+    static bool flushAll();
+
+    static std::string getFileName(const std::string& _directory);
+
+    bool load(const std::string& _name, std::string& _data) const;
+    bool contains(const std::string& _name) const;
+    /** Queues \a _data for \a _name, returns without waiting for the disk */
+    void save(const std::string& _name, const std::string& _data);
+    /** Waits until everything saved so far is on disk. Returns false
+      * without waiting any longer once a commit failed, the writer keeps
+      * retrying in the background */
+    bool flush();
+
+    /** Number of fsyncs done by the writer */
+    int getCommits() const;
+    int getJournalRecords() const;
+  private:
+    typedef std::map<std::string, std::string> Values;
+
+    void readJournal();
+    void writerThread();
+    bool append(const std::string& _records);
+    bool compact(const Values& _values);
+    bool openJournal();
+    void closeJournal();
+
+    const std::string m_FileName;
+    const boost::posix_time::milliseconds m_CommitDelay;
+    const int m_CompactRecords;
+    int m_FD;
+
+    mutable boost::mutex m_Mutex;
+    boost::condition_variable m_PendingCondition;
+    boost::condition_variable m_CommittedCondition;
+    Values m_Values;
+    /** Encoded records not yet handed to the writer */
+    std::string m_Pending;
+    int m_PendingRecords;
+    /** Sequence numbers of the last queued and the last committed save */
+    unsigned long long m_Queued;
+    unsigned long long m_Committed;
+    int m_JournalRecords;
+    bool m_NeedsCompaction;
+    /** The last commit failed, the writer retries until one succeeds */
+    bool m_CommitFailed;
+    bool m_Stopping;
+    int m_Commits;
+    boost::shared_ptr<boost::thread> m_Writer;
+  }; // StateStore
+
+} // namespace dss
+
+#endif /* STATESTORE_H_ */
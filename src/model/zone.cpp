@@ -77,6 +77,15 @@ namespace dss {
     return Set(m_Devices);
   } // getDevices
 
+  void Zone::setName(const std::string& _name) {
+    std::string oldName = getName();
+    DeviceContainer::setName(_name);
+    // sets are resolved by zone name, don't wait for etModelDirty
+    if((m_pApartment != NULL) && (getName() != oldName)) {
+      m_pApartment->bumpGeneration();
+    }
+  } // setName
+
   void Zone::addDevice(DeviceReference& _device) {
     boost::shared_ptr<const Device> dev = _device.getDevice();
     int oldZoneID = dev->getZoneID();
@@ -108,6 +117,9 @@ namespace dss {
       throw std::runtime_error("Zone::addGroup: ZoneID of _group does not match own");
     }
     m_Groups.push_back(_group);
+    if(m_pApartment != NULL) {
+      m_pApartment->bumpGeneration();
+    }
     if(m_pPropertyNode != NULL) {
       _group->publishToPropertyTree();
     }
@@ -118,6 +130,9 @@ namespace dss {
     std::vector<boost::shared_ptr<Group> >::iterator it = find(m_Groups.begin(), m_Groups.end(), _group);
     if(it != m_Groups.end()) {
       m_Groups.erase(it);
+      if(m_pApartment != NULL) {
+        m_pApartment->bumpGeneration();
+      }
     }
     if(m_pPropertyNode != NULL) {
       PropertyNodePtr groupNode = m_pPropertyNode->getProperty("groups/group" + intToString(_group->getID()));
@@ -141,6 +156,9 @@ namespace dss {
         }
       }
       m_Devices.erase(pos);
+      if(m_pApartment != NULL) {
+        m_pApartment->bumpGeneration();
+      }
     }
   } // removeDevice
 
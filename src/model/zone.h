@@ -134,6 +134,7 @@ namespace dss {
     Zone(const int _id, Apartment* _pApartment);
     ~Zone() DS_OVERRIDE;
     Set getDevices() const DS_OVERRIDE;
+    void setName(const std::string& _name) DS_OVERRIDE;
 
     Apartment& getApartment() { return *m_pApartment; }
     ModelMaintenance* tryGetModelMaintenance();
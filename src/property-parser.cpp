@@ -33,6 +33,7 @@
 #include <boost/thread/recursive_mutex.hpp>
 
 #include "src/base.h"
+#include "src/foreach.h"
 
 namespace dss {
 
@@ -43,7 +44,8 @@ PropertyParser::PropertyParser() : ExpatParser(), m_level(0),
     m_ignoreVersion(false),
     m_expectValue(false),
     m_ignore(false),
-    m_currentValueType(vTypeNone)
+    m_currentValueType(vTypeNone),
+    m_deferAttach(false)
 {};
 
 // this callback is triggered on each <tag>
@@ -205,10 +207,17 @@ void PropertyParser::elementStart(const char *_name, const char **_attrs)
                     path = m_currentNode;
                 } else {
                     path = temp->getPropertyByName(part);
+                    if ((path == NULL) && m_deferAttach) {
+                        path = getPendingChild(temp, part);
+                    }
                 }
                 if (path == NULL) {
                     path = PropertyNodePtr(new PropertyNode(part.c_str()));
-                    temp->addChild(path);
+                    if (m_deferAttach) {
+                        addPendingChild(temp, path);
+                    } else {
+                        temp->addChild(path);
+                    }
                 }
                 temp = path;
             } while (start != NULL);
@@ -278,6 +287,10 @@ void PropertyParser::elementEnd(const char *_name) {
         return;
     }
 
+    if (m_level == 0) {
+        attachPendingChildren();
+    }
+
     // we can't have several value tags one after the other, so if we
     // got into a <value> then we do not expect any further <value> tags
     m_expectValue = false;
@@ -369,8 +382,45 @@ void PropertyParser::characterData(const XML_Char *_s, int _len) {
     }
 }
 
+PropertyNodePtr PropertyParser::getPendingChild(PropertyNodePtr _parent,
+                                               const std::string& _name) {
+    std::map<PropertyNode*, size_t>::iterator it = m_pendingIndex.find(_parent.get());
+    if (it == m_pendingIndex.end()) {
+        return PropertyNodePtr();
+    }
+    PendingChildren& pending = m_pending[it->second];
+    std::map<std::string, PropertyNodePtr>::iterator child = pending.m_byName.find(_name);
+    return (child != pending.m_byName.end()) ? child->second : PropertyNodePtr();
+}
+
+void PropertyParser::addPendingChild(PropertyNodePtr _parent,
+                                     PropertyNodePtr _child) {
+    std::map<PropertyNode*, size_t>::iterator it = m_pendingIndex.find(_parent.get());
+    if (it == m_pendingIndex.end()) {
+        it = m_pendingIndex.insert(std::make_pair(_parent.get(), m_pending.size())).first;
+        m_pending.push_back(PendingChildren());
+        m_pending.back().m_parent = _parent;
+    }
+    PendingChildren& pending = m_pending[it->second];
+    pending.m_children.push_back(_child);
+    pending.m_byName[_child->getName()] = _child;
+}
+
+void PropertyParser::attachPendingChildren() {
+    // parents were registered before their own children, attaching in that
+    // order adds every node to the tree before its children show up
+    foreach (PendingChildren& pending, m_pending) {
+        foreach (PropertyNodePtr& child, pending.m_children) {
+            pending.m_parent->addChild(child);
+        }
+    }
+    m_pending.clear();
+    m_pendingIndex.clear();
+}
+
 void PropertyParser::reinitMembers(PropertyNodePtr _node,
                                    bool _ignoreVersion) {
+    attachPendingChildren();
     // the propety parser class instance can be reused, so we will reset
     // the internals on each call of the loadFromXML function
     m_level = 0;
@@ -384,17 +434,23 @@ void PropertyParser::reinitMembers(PropertyNodePtr _node,
 
     m_nodes.push_back(_node);
     m_currentNode = _node;
+    m_deferAttach = false;
 }
 
 bool PropertyParser::loadFromXML(const std::string& _fileName,
-                                 PropertyNodePtr _node, bool _ignoreVersion) {
+                                 PropertyNodePtr _node, bool _ignoreVersion,
+                                 bool _useSnapshot) {
     if (_node == NULL) {
         return false;
     }
 
     reinitMembers(_node, _ignoreVersion);
+    m_deferAttach = _useSnapshot;
 
-    bool ret = parseFile(_fileName);
+    bool ret = _useSnapshot ? parseFileWithSnapshot(_fileName) : parseFile(_fileName);
+    // an aborted document keeps what was parsed up to the error
+    attachPendingChildren();
+    m_deferAttach = false;
     m_nodes.clear();
     return ret;
 } // loadFromXML
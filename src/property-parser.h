@@ -23,6 +23,9 @@
 */
 #pragma once
 
+#include <map>
+#include <vector>
+
 #include "propertysystem.h"
 #include "expatparser.h"
 
@@ -32,8 +35,10 @@ class PropertyParser : public ExpatParser
 {
 public:
     PropertyParser();
+    /** \a _useSnapshot replays and records a binary snapshot of the file,
+      * meant for the files loaded on startup */
     bool loadFromXML(const std::string& _fileName, PropertyNodePtr _node,
-                     bool _ignoreVersion = false);
+                     bool _ignoreVersion = false, bool _useSnapshot = false);
 
 private:
     int m_level;
@@ -45,6 +50,23 @@ private:
     PropertyNodePtr m_currentNode;
     std::string m_temporaryValue;
 
+    // while loading a startup snapshot, nodes created by the parser are
+    // attached to their parent in one go once the document is done, adding
+    // them one by one copies the child list of the parent for every single
+    // node. Other loads attach right away, their trees may be in use.
+    bool m_deferAttach;
+    struct PendingChildren {
+      PropertyNodePtr m_parent;
+      PropertyList m_children;
+      std::map<std::string, PropertyNodePtr> m_byName;
+    };
+    std::vector<PendingChildren> m_pending;
+    std::map<PropertyNode*, size_t> m_pendingIndex;
+
+    PropertyNodePtr getPendingChild(PropertyNodePtr _parent, const std::string& _name);
+    void addPendingChild(PropertyNodePtr _parent, PropertyNodePtr _child);
+    void attachPendingChildren();
+
 protected:
     void reinitMembers(PropertyNodePtr _node, bool ignoreVersion = false);
     virtual void elementStart(const char *_name, const char **_attrs);
@@ -38,6 +38,7 @@
 #include <cstring>
 #include <fstream>
 #include <boost/make_shared.hpp>
+#include <boost/scoped_array.hpp>
 #include <boost/atomic.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 #include <ds/log.h>
@@ -57,10 +58,11 @@ namespace dss {
 
   //=============================================== Util
 
-  bool loadFromXML(const std::string& _fileName, PropertyNodePtr _rootNode) {
+  bool loadFromXML(const std::string& _fileName, PropertyNodePtr _rootNode,
+                   bool _useSnapshot) {
     assert(_rootNode != NULL);
     boost::shared_ptr<PropertyParser> pp = boost::make_shared<PropertyParser>();
-    return pp->loadFromXML(_fileName, _rootNode);
+    return pp->loadFromXML(_fileName, _rootNode, false, _useSnapshot);
   } // loadFromXML
 
   bool saveToXML(const std::string& _fileName, PropertyNodePtr root, const int _flagsMask) {
@@ -110,6 +112,14 @@ namespace dss {
     return m_RootNode->getProperty(propPath);
   } // getProperty
 
+  PropertyNodePtr PropertySystem::getProperty(const PropertyPath& _propPath) const {
+    return _propPath.resolve(*m_RootNode);
+  } // getProperty
+
+  PropertyNodePtr PropertySystem::createProperty(const PropertyPath& _propPath) {
+    return _propPath.create(*m_RootNode);
+  } // createProperty
+
   PropertyNodePtr PropertySystem::createProperty(const std::string& _propPath) {
     if (_propPath[ 0 ] != '/') {
       return PropertyNodePtr();
@@ -198,19 +208,233 @@ namespace dss {
   } // setStringValue
 
 
+  //=============================================== PropertyListSnapshot
+
+  const PropertyNodePtr& PropertyListSnapshot::at(size_t _index) const {
+    if (_index >= m_Size) {
+      throw std::out_of_range("PropertyListSnapshot::at");
+    }
+    return m_Nodes[_index];
+  } // at
+
   //=============================================== PropertyNode
 
   __DEFINE_LOG_CHANNEL__(PropertyNode, lsInfo);
 
   static boost::atomic<int> sm_NodeCounter;
 
-  std::vector<PropertyNodePtr> PropertyNode::sm_EmptyChildNodes;
+  /** Append-only storage shared by successive child lists of a node.
+   * Slots below m_Used are never written again, so writers append behind
+   * the last published list while readers keep working on it. The store is
+   * only copied once its capacity is used up or a child gets removed, which
+   * keeps adding children amortized constant.
+   * Stores with many slots carry an insert-only open addressing hash index
+   * from the name to the slot, it is updated along with the slots. Names
+   * are interned, the index hashes and compares their address and never
+   * looks at the characters. */
+  struct PropertyNode::ChildStore {
+    /** Stores with fewer slots are scanned linearly */
+    static const size_t kIndexThreshold = 16;
+    static const size_t kMinCapacity = 4;
+
+    explicit ChildStore(size_t _capacity)
+    : m_Slots(new PropertyNodePtr[_capacity]),
+      m_Capacity(_capacity),
+      m_Used(0),
+      m_IndexMask(0)
+    {
+      if (_capacity >= kIndexThreshold) {
+        // at most half full, every probe ends at a free bucket
+        size_t buckets = 1;
+        while (buckets < 2 * _capacity) {
+          buckets <<= 1;
+        }
+        m_Index.reset(new boost::atomic<uint32_t>[buckets]);
+        for (size_t i = 0; i < buckets; i++) {
+          m_Index[i].store(0, boost::memory_order_relaxed);
+        }
+        m_IndexMask = buckets - 1;
+      }
+    }
+
+    boost::scoped_array<PropertyNodePtr> m_Slots;
+    const size_t m_Capacity;
+    /** Slots written so far, only accessed with m_GlobalMutex held */
+    size_t m_Used;
+    /** Slot + 1 per bucket, 0 marks a free bucket */
+    boost::scoped_array<boost::atomic<uint32_t> > m_Index;
+    size_t m_IndexMask;
+
+    bool isIndexed() const { return m_IndexMask != 0; }
+
+    static size_t hash(const PropertyName& _name) {
+      // mixes the address, its low bits are always zero
+      uint64_t h = reinterpret_cast<uintptr_t>(&_name.get());
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      return static_cast<size_t>(h);
+    }
+
+    /** m_GlobalMutex has to be held and a slot has to be free */
+    void append(const PropertyNodePtr& _node) {
+      assert(m_Used < m_Capacity);
+      m_Slots[m_Used] = _node;
+      if (isIndexed()) {
+        size_t bucket = hash(_node->m_Name) & m_IndexMask;
+        while (m_Index[bucket].load(boost::memory_order_relaxed) != 0) {
+          bucket = (bucket + 1) & m_IndexMask;
+        }
+        m_Index[bucket].store(m_Used + 1, boost::memory_order_release);
+      }
+      m_Used++;
+    }
+
+    /** Returns the next slot below \a _size holding a child named \a _name,
+     * probing on from \a _bucket, or -1 */
+    int probe(const PropertyName& _name, size_t _size, size_t& _bucket) const {
+      for (;;) {
+        uint32_t entry = m_Index[_bucket].load(boost::memory_order_acquire);
+        if (entry == 0) {
+          return -1;
+        }
+        _bucket = (_bucket + 1) & m_IndexMask;
+        // higher slots belong to lists published after the one asked for
+        if ((entry <= _size) && (m_Slots[entry - 1]->m_Name == _name)) {
+          return entry - 1;
+        }
+      }
+    }
+
+    /** Copies \a _nodes except for \a _skip, leaving room to grow */
+    static boost::shared_ptr<ChildStore> copy(const PropertyNodePtr* _nodes,
+                                              size_t _size, int _skip = -1) {
+      boost::shared_ptr<ChildStore> store =
+          boost::make_shared<ChildStore>(std::max(kMinCapacity, 2 * _size));
+      for (size_t i = 0; i < _size; i++) {
+        if (static_cast<int>(i) != _skip) {
+          store->append(_nodes[i]);
+        }
+      }
+      return store;
+    }
+  }; // ChildStore
+
+  const size_t PropertyNode::ChildStore::kIndexThreshold;
+  const size_t PropertyNode::ChildStore::kMinCapacity;
+
+  /** Immutable list of child nodes, see PropertyListSnapshot.
+   * The first m_Size slots of m_Store. */
+  struct PropertyNode::ChildList {
+    ChildList() : m_Size(0) {}
+    ChildList(const boost::shared_ptr<ChildStore>& _store, size_t _size)
+    : m_Store(_store), m_Size(_size) {}
+
+    boost::shared_ptr<ChildStore> m_Store;
+    size_t m_Size;
+
+    const PropertyNodePtr* nodes() const {
+      return m_Store ? m_Store->m_Slots.get() : NULL;
+    }
+
+    bool isIndexed() const { return m_Store && m_Store->isIndexed(); }
+
+    static const PropertyName& intern(const PropertyName& _name) { return _name; }
+    static PropertyName intern(const std::string& _name) { return PropertyName(_name); }
+
+    /** @return the child \a _name[_index], -1 returns the last one.
+     * \a _name is either a string or an interned name, strings get
+     * interned only if the list is large enough to be indexed. */
+    template <class Name>
+    PropertyNodePtr find(const Name& _name, int _index) const {
+      if (isIndexed()) {
+        return findIndexed(intern(_name), _index);
+      }
+      const PropertyNodePtr* pNodes = nodes();
+      int lastMatch = -1;
+      for (size_t i = 0; i < m_Size; i++) {
+        if (pNodes[i]->m_Name == _name) {
+          if (pNodes[i]->m_Index == _index) {
+            return pNodes[i];
+          }
+          lastMatch = i;
+        }
+      }
+      if ((_index == -1) && (lastMatch != -1)) {
+        return pNodes[lastMatch];
+      }
+      return PropertyNodePtr();
+    }
+
+    PropertyNodePtr findIndexed(const PropertyName& _name, int _index) const {
+      const PropertyNodePtr* pNodes = nodes();
+      int lastMatch = -1;
+      size_t bucket = ChildStore::hash(_name) & m_Store->m_IndexMask;
+      int slot;
+      while ((slot = m_Store->probe(_name, m_Size, bucket)) != -1) {
+        if (pNodes[slot]->m_Index == _index) {
+          return pNodes[slot];
+        }
+        lastMatch = std::max(lastMatch, slot);
+      }
+      if ((_index == -1) && (lastMatch != -1)) {
+        return pNodes[lastMatch];
+      }
+      return PropertyNodePtr();
+    }
+
+    template <class Name>
+    int count(const Name& _name) const {
+      int result = 0;
+      if (isIndexed()) {
+        const PropertyName& name = intern(_name);
+        size_t bucket = ChildStore::hash(name) & m_Store->m_IndexMask;
+        while (m_Store->probe(name, m_Size, bucket) != -1) {
+          result++;
+        }
+      } else {
+        const PropertyNodePtr* pNodes = nodes();
+        for (size_t i = 0; i < m_Size; i++) {
+          if (pNodes[i]->m_Name == _name) {
+            result++;
+          }
+        }
+      }
+      return result;
+    }
+
+    int maxIndex(const PropertyName& _name) const {
+      int result = -1;
+      const PropertyNodePtr* pNodes = nodes();
+      if (isIndexed()) {
+        size_t bucket = ChildStore::hash(_name) & m_Store->m_IndexMask;
+        int slot;
+        while ((slot = m_Store->probe(_name, m_Size, bucket)) != -1) {
+          result = std::max(pNodes[slot]->m_Index, result);
+        }
+      } else {
+        for (size_t i = 0; i < m_Size; i++) {
+          if (pNodes[i]->m_Name == _name) {
+            result = std::max(pNodes[i]->m_Index, result);
+          }
+        }
+      }
+      return result;
+    }
+  }; // ChildList
+
+  // shared by all leaf nodes, function local to be safe from static
+  // initialization order issues
+  const boost::shared_ptr<const PropertyNode::ChildList>& PropertyNode::emptyChildList() {
+    static const boost::shared_ptr<const ChildList> empty = boost::make_shared<ChildList>();
+    return empty;
+  } // emptyChildList
 
   int PropertyNode::getNodeCount() { return sm_NodeCounter; }
 
   PropertyNode::PropertyNode(const char* _name, int _index)
     : m_Name(_name),
-      m_ChildNodes(NULL),
+      m_ChildNodes(emptyChildList()),
       m_AliasedBy(NULL),
       m_Listeners(NULL),
       m_ParentNode(NULL),
@@ -289,35 +513,51 @@ namespace dss {
     }
 
     // remove all child nodes
-    if (m_ChildNodes) {
-      for (std::vector<PropertyNodePtr>::iterator it = m_ChildNodes->begin(); it != m_ChildNodes->end();) {
-        childRemoved(*it);
-        (*it)->m_ParentNode = NULL; // prevent the child-node from calling removeChild
-        it = m_ChildNodes->erase(it);
-      }
-      delete m_ChildNodes;
-      m_ChildNodes = NULL;
+    PropertyListSnapshot children = loadChildNodes();
+    storeChildNodes(emptyChildList());
+    foreach (PropertyNodePtr pChild, *children) {
+      childRemoved(pChild);
+      pChild->m_ParentNode = NULL; // prevent the child-node from calling removeChild
     }
 
     clearValue();
     sm_NodeCounter--;
   } // dtor
 
-  const std::vector<PropertyNodePtr>& PropertyNode::getChildNodes() const {
-    const std::vector<PropertyNodePtr>* pOut = m_AliasTarget ? m_AliasTarget->m_ChildNodes : m_ChildNodes;
-    return pOut ? *pOut : sm_EmptyChildNodes;
+  boost::shared_ptr<const PropertyNode::ChildList> PropertyNode::loadChildList() const {
+    return boost::atomic_load(&m_ChildNodes);
+  } // loadChildList
+
+  PropertyListSnapshot PropertyNode::loadChildNodes() const {
+    boost::shared_ptr<const ChildList> children = loadChildList();
+    return PropertyListSnapshot(children, children->nodes(), children->m_Size);
+  } // loadChildNodes
+
+  void PropertyNode::storeChildNodes(const boost::shared_ptr<const ChildList>& _children) {
+    boost::atomic_store(&m_ChildNodes, _children);
+  } // storeChildNodes
+
+  PropertyListSnapshot PropertyNode::getChildNodes() const {
+    return m_AliasTarget ? m_AliasTarget->loadChildNodes() : loadChildNodes();
   }
 
   PropertyNodePtr PropertyNode::removeChild(PropertyNodePtr _childNode) {
     if (m_AliasTarget) {
       return m_AliasTarget->removeChild(_childNode);
-    } else if (NULL == m_ChildNodes) {
-      return PropertyNodePtr();
     } else {
       boost::recursive_mutex::scoped_lock lock(m_GlobalMutex);
-      PropertyList::iterator it = std::find(m_ChildNodes->begin(), m_ChildNodes->end(), _childNode);
-      if (it != m_ChildNodes->end()) {
-        m_ChildNodes->erase(it);
+      boost::shared_ptr<const ChildList> children = loadChildList();
+      const PropertyNodePtr* pNodes = children->nodes();
+      const PropertyNodePtr* it = std::find(pNodes, pNodes + children->m_Size, _childNode);
+      if (it != pNodes + children->m_Size) {
+        if (children->m_Size == 1) {
+          storeChildNodes(emptyChildList());
+        } else {
+          // older snapshots still hand out the removed node, so this copies
+          boost::shared_ptr<ChildStore> store =
+              ChildStore::copy(pNodes, children->m_Size, it - pNodes);
+          storeChildNodes(boost::make_shared<ChildList>(store, children->m_Size - 1));
+        }
       }
       lock.unlock();
       _childNode->m_ParentNode = NULL;
@@ -340,18 +580,16 @@ namespace dss {
         _childNode->m_ParentNode->removeChild(_childNode);
       }
       boost::recursive_mutex::scoped_lock lock(m_GlobalMutex);
-      if (NULL == m_ChildNodes) {
-        m_ChildNodes = new (std::vector<PropertyNodePtr>);
-      }
+      boost::shared_ptr<const ChildList> children = loadChildList();
       _childNode->m_ParentNode = this;
-      int maxIndex = -1;
-      for (unsigned int iChild = 0; iChild < m_ChildNodes->size(); iChild++) {
-        if (m_ChildNodes->at(iChild)->getName() == _childNode->getName()) {
-          maxIndex = std::max(m_ChildNodes->at(iChild)->m_Index, maxIndex);
-        }
+      _childNode->m_Index = children->maxIndex(_childNode->m_Name) + 1;
+      boost::shared_ptr<ChildStore> store = children->m_Store;
+      if (!store || (store->m_Used != children->m_Size) ||
+          (store->m_Used == store->m_Capacity)) {
+        store = ChildStore::copy(children->nodes(), children->m_Size);
       }
-      _childNode->m_Index = maxIndex + 1;
-      m_ChildNodes->push_back(_childNode);
+      store->append(_childNode);
+      storeChildNodes(boost::make_shared<ChildList>(store, children->m_Size + 1));
       lock.unlock();
       childAdded(_childNode);
     }
@@ -388,80 +626,66 @@ namespace dss {
     }
   } // getProperty
 
-  int PropertyNode::getAndRemoveIndexFromPropertyName(std::string& _propName) {
-    if (m_AliasTarget) {
-      return m_AliasTarget->getAndRemoveIndexFromPropertyName(_propName);
-    } else {
-      int result = 0;
-      std::string::size_type pos = _propName.find('[');
-      if(pos != std::string::npos) {
-        std::string::size_type end = _propName.find(']');
-        std::string indexAsString = _propName.substr(pos + 1, end - pos - 1);
-        _propName.erase(pos, end);
-        if (trim(indexAsString) == "last") {
-          result = -1;
-        } else {
-          result = atoi(indexAsString.c_str());
-        }
+  static int splitIndexFromPropertyName(std::string& _propName) {
+    int result = 0;
+    std::string::size_type pos = _propName.find('[');
+    if(pos != std::string::npos) {
+      std::string::size_type end = _propName.find(']');
+      std::string indexAsString = _propName.substr(pos + 1, end - pos - 1);
+      _propName.erase(pos, end);
+      if (trim(indexAsString) == "last") {
+        result = -1;
+      } else {
+        result = atoi(indexAsString.c_str());
       }
-      return result;
     }
+    return result;
+  } // splitIndexFromPropertyName
+
+  int PropertyNode::getAndRemoveIndexFromPropertyName(std::string& _propName) {
+    return splitIndexFromPropertyName(_propName);
   } // getAndRemoveIndexFromPropertyName
 
+  PropertyNodePtr PropertyNode::getProperty(const PropertyPath& _propPath) {
+    return _propPath.resolve(*this);
+  } // getProperty
+
   PropertyNodePtr PropertyNode::getPropertyByName(const std::string& _name) {
     if (m_AliasTarget) {
       return m_AliasTarget->getPropertyByName(_name);
-    } else if (NULL == m_ChildNodes ) {
+    } else if (loadChildList()->m_Size == 0) {
       return PropertyNodePtr();
     } else {
-      int index = 0;
       std::string propName = _name;
-      index = getAndRemoveIndexFromPropertyName(propName);
-
-      int lastMatch = -1;
-      int numItem = 0;
-      boost::recursive_mutex::scoped_lock lock(m_GlobalMutex);
-      PropertyList::iterator it = m_ChildNodes->begin();
-      PropertyList::iterator end = m_ChildNodes->end();
-      for (; it != end; it++) {
-        numItem++;
-        if ((*it)->m_Name == propName) {
-          if ((*it)->m_Index == index) {
-            return (*it);
-          }
-          lastMatch = numItem - 1;
-        }
-      }
-      if (index == -1) {
-        if (lastMatch != -1) {
-          return m_ChildNodes->at(lastMatch);
-        }
-      }
-      return PropertyNodePtr();
+      int index = getAndRemoveIndexFromPropertyName(propName);
+      return getChildByNameAndIndex(propName, index);
     }
   } // getPropertyName
 
+  PropertyNodePtr PropertyNode::getChildByNameAndIndex(const std::string& _name, int _index) {
+    if (m_AliasTarget) {
+      return m_AliasTarget->getChildByNameAndIndex(_name, _index);
+    }
+    return loadChildList()->find(_name, _index);
+  } // getChildByNameAndIndex
+
+  PropertyNodePtr PropertyNode::getChildByInternedName(const PropertyName& _name, int _index) {
+    if (m_AliasTarget) {
+      return m_AliasTarget->getChildByInternedName(_name, _index);
+    }
+    return loadChildList()->find(_name, _index);
+  } // getChildByInternedName
+
   int PropertyNode::count(const std::string& _propertyName) {
     if (m_AliasTarget) {
       return m_AliasTarget->count(_propertyName);
-    } else if (NULL == m_ChildNodes ) {
-      return 0;
     } else {
-      int result = 0;
-      boost::recursive_mutex::scoped_lock lock(m_GlobalMutex);
-      for (PropertyList::iterator it = m_ChildNodes->begin();
-           it != m_ChildNodes->end(); it++) {
-        PropertyNodePtr cur = *it;
-        if (cur->m_Name == _propertyName) {
-          result++;
-        }
-      }
-      return result;
+      return loadChildList()->count(_propertyName);
     }
   } // count
 
   int PropertyNode::size() {
-    return m_ChildNodes ? m_ChildNodes->size() : 0;
+    return loadChildNodes()->size();
   } // size
 
   void PropertyNode::clearValue() {
@@ -663,7 +887,7 @@ namespace dss {
   } // getBoolValue
 
   void PropertyNode::alias(PropertyNodePtr _target) {
-    if (m_ChildNodes && m_ChildNodes->size() > 0) {
+    if (!loadChildNodes()->empty()) {
       throw std::runtime_error("Cannot alias node if it has children");
     }
     if (IsLinkedToProxy()) {
@@ -739,9 +963,10 @@ namespace dss {
 
   bool PropertyNode::unlinkProxy(bool _recurse) {
     boost::recursive_mutex::scoped_lock lock(m_GlobalMutex);
-    if (_recurse && m_ChildNodes) {
-      for (std::vector<PropertyNodePtr>::iterator it = m_ChildNodes->begin(); it != m_ChildNodes->end(); it++) {
-        (*it)->unlinkProxy(_recurse);
+    if (_recurse) {
+      PropertyListSnapshot children = loadChildNodes();
+      foreach (const PropertyNodePtr& pChild, *children) {
+        pChild->unlinkProxy(_recurse);
       }
     }
     if (IsLinkedToProxy()) {
@@ -864,6 +1089,10 @@ namespace dss {
     }
   } // createProperty
 
+  PropertyNodePtr PropertyNode::createProperty(const PropertyPath& _propPath) {
+    return _propPath.create(*this);
+  } // createProperty
+
   bool PropertyNode::saveAsXML(std::ostream& _ofs, const int _indent, const int _flagsMask) {
     _ofs << doIndent(_indent) << "<property type=\"" << getValueTypeAsString(getValueType()) << "\"" <<
                                           " name=\"" << XMLStringEscape(getDisplayName()) << "\"";
@@ -877,7 +1106,8 @@ namespace dss {
     if (hasFlag(Writeable)) {
       _ofs << " writeable=\"true\"";
     }
-    if ((m_ChildNodes && m_ChildNodes->empty()) && (getValueType() == vTypeNone)) {
+    PropertyListSnapshot children = loadChildNodes();
+    if (children->empty() && (getValueType() == vTypeNone)) {
       _ofs << "/>" << std::endl;
       return true;
     }
@@ -889,7 +1119,7 @@ namespace dss {
     }
 
     bool result = true;
-    if (m_ChildNodes && !m_ChildNodes->empty()) {
+    if (!children->empty()) {
       result = saveChildrenAsXML(_ofs, _indent + 1, _flagsMask);
     }
     _ofs << doIndent(_indent) << "</property>" << std::endl;
@@ -898,12 +1128,11 @@ namespace dss {
   } // saveAsXML
 
   bool PropertyNode::saveChildrenAsXML(std::ostream& _ofs, const int _indent, const int _flagsMask) {
-    if (m_ChildNodes) {
-      foreach (PropertyNodePtr pChild, *m_ChildNodes) {
-        if ((_flagsMask == Flag(0)) || pChild->searchForFlag(Flag(_flagsMask))) {
-          if (!pChild->saveAsXML(_ofs, _indent, _flagsMask)) {
-            return false;
-          }
+    PropertyListSnapshot children = loadChildNodes();
+    foreach (const PropertyNodePtr& pChild, *children) {
+      if ((_flagsMask == Flag(0)) || pChild->searchForFlag(Flag(_flagsMask))) {
+        if (!pChild->saveAsXML(_ofs, _indent, _flagsMask)) {
+          return false;
         }
       }
     }
@@ -912,11 +1141,10 @@ namespace dss {
 
   bool PropertyNode::searchForFlag(Flag _flag) {
     if (!hasFlag(_flag)) {
-      if (m_ChildNodes) {
-        foreach (PropertyNodePtr pChild, *m_ChildNodes) {
-          if (pChild->searchForFlag(_flag)) {
-            return true;
-          }
+      PropertyListSnapshot children = loadChildNodes();
+      foreach (const PropertyNodePtr& pChild, *children) {
+        if (pChild->searchForFlag(_flag)) {
+          return true;
         }
       }
       return false;
@@ -961,6 +1189,63 @@ namespace dss {
 
   boost::recursive_mutex PropertyNode::m_GlobalMutex;
 
+  //=============================================== PropertyPath
+
+  PropertyPath::PropertyPath(const std::string& _path)
+  : m_Path(_path)
+  {
+    std::string tail = _path;
+    if (!tail.empty() && (tail[0] == '/')) {
+      tail.erase(0, 1);
+    }
+    // mimics the recursion of PropertyNode::getProperty/createProperty
+    while (!tail.empty() && (tail != "/")) {
+      Component comp;
+      std::string lookupName = carCdrPath(tail);
+      comp.createName = lookupName;
+      comp.lookupIndex = splitIndexFromPropertyName(lookupName);
+      comp.lookupName = PropertyName(lookupName);
+      if (!comp.createName.empty() && comp.createName[comp.createName.length() - 1] == '+') {
+        comp.createName.erase(comp.createName.length() - 1, 1);
+      }
+      splitIndexFromPropertyName(comp.createName);
+      m_Components.push_back(comp);
+    }
+  } // ctor
+
+  PropertyNodePtr PropertyPath::resolve(PropertyNode& _base) const {
+    if (m_Components.empty()) {
+      return _base.shared_from_this();
+    }
+    PropertyNodePtr node;
+    PropertyNode* cur = &_base;
+    foreach (const Component& comp, m_Components) {
+      node = cur->getChildByInternedName(comp.lookupName, comp.lookupIndex);
+      if (node == NULL) {
+        return PropertyNodePtr();
+      }
+      cur = node.get();
+    }
+    return node;
+  } // resolve
+
+  PropertyNodePtr PropertyPath::create(PropertyNode& _base) const {
+    if (m_Components.empty()) {
+      return _base.shared_from_this();
+    }
+    PropertyNodePtr node = _base.shared_from_this();
+    foreach (const Component& comp, m_Components) {
+      PropertyNodePtr next = node->getChildByInternedName(comp.lookupName, comp.lookupIndex);
+      if (next == NULL) {
+        DS_REQUIRE(!comp.createName.empty(), "Cannot create property with empty name.", m_Path);
+        next = boost::make_shared<PropertyNode>(comp.createName.c_str());
+        node->addChild(next);
+      }
+      node = next;
+    }
+    return node;
+  } // create
+
   //=============================================== PropertyListener
 
   PropertyListener::~PropertyListener() {
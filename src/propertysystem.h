@@ -42,6 +42,9 @@ namespace dss {
 
   class PropertyNode;
   typedef boost::shared_ptr<PropertyNode> PropertyNodePtr;
+  class PropertyPath;
+  /** Node names are interned, equal names share one string */
+  typedef boost::flyweight<std::string> PropertyName;
 
   typedef enum {
     vTypeNone = 0, vTypeInteger, vTypeString, vTypeBoolean, vTypeFloating,
@@ -70,8 +73,10 @@ namespace dss {
                  const int _flagsMask = 0);
   /**
    * Loads a subtree from XML.
-   * @param _rootNode -- content of the XML is appended to the _rootNode. */
-  bool loadFromXML(const std::string& _fileName, PropertyNodePtr _rootNode);
+   * @param _rootNode -- content of the XML is appended to the _rootNode.
+   * @param _useSnapshot -- use a binary snapshot, see ExpatParser */
+  bool loadFromXML(const std::string& _fileName, PropertyNodePtr _rootNode,
+                   bool _useSnapshot = false);
 
   /** A tree tree consisting of different value nodes.
    * The tree can by serialized to and from XML. Nodes can either
@@ -90,6 +95,8 @@ namespace dss {
     /** Searches a property by path.
      * @return The node, or NULL if not found. */
     PropertyNodePtr getProperty(const std::string& _propPath) const;
+    /** @copydoc getProperty */
+    PropertyNodePtr getProperty(const PropertyPath& _propPath) const;
 
     /** Returns the root node. */
     PropertyNodePtr getRootNode() const {
@@ -98,6 +105,8 @@ namespace dss {
 
     /** Creates a property and the path to it. */
     PropertyNodePtr createProperty(const std::string& _propPath);
+    /** @copydoc createProperty */
+    PropertyNodePtr createProperty(const PropertyPath& _propPath);
 
     // fast access to property values
     /** Returns the value of a property as an int.
@@ -350,12 +359,45 @@ namespace dss {
 
 
   typedef std::vector<PropertyNodePtr> PropertyList;
+  /** Immutable view of a nodes children.
+   * Child lists are copy-on-write: writers publish a new list under
+   * PropertyNode::m_GlobalMutex atomically, readers grab the current
+   * snapshot without taking any lock. A snapshot stays valid for as
+   * long as it is referenced, even if the node is modified concurrently.
+   * It is used like the shared pointer to a list it used to be. */
+  class PropertyListSnapshot {
+  public:
+    typedef PropertyNodePtr value_type;
+    typedef const PropertyNodePtr* const_iterator;
+    typedef const_iterator iterator;
+    typedef size_t size_type;
+
+    PropertyListSnapshot() : m_Nodes(NULL), m_Size(0) {}
+    PropertyListSnapshot(const boost::shared_ptr<const void>& _owner,
+                         const PropertyNodePtr* _nodes, size_t _size)
+    : m_Owner(_owner), m_Nodes(_nodes), m_Size(_size) {}
+
+    const_iterator begin() const { return m_Nodes; }
+    const_iterator end() const { return m_Nodes + m_Size; }
+    size_t size() const { return m_Size; }
+    bool empty() const { return m_Size == 0; }
+    const PropertyNodePtr& operator[](size_t _index) const { return m_Nodes[_index]; }
+    const PropertyNodePtr& at(size_t _index) const;
+
+    const PropertyListSnapshot* operator->() const { return this; }
+    const PropertyListSnapshot& operator*() const { return *this; }
+  private:
+    boost::shared_ptr<const void> m_Owner;
+    const PropertyNodePtr* m_Nodes;
+    size_t m_Size;
+  }; // PropertyListSnapshot
   class NodePrivileges;
   class Privilege;
 
   /** The heart of the PropertySystem. */
   class PropertyNode : boost::noncopyable, public boost::enable_shared_from_this<PropertyNode> {
     __DECL_LOG_CHANNEL__
+    friend class PropertyPath;
 
   public:
     enum Flag {
@@ -364,6 +406,9 @@ namespace dss {
       Archive = 1 << 2 /**< Node will get written to XML (hint only) */
     };
 
+    /** Serializes structural modifications of the tree (adding, removing,
+     * aliasing nodes, listener registration). Readers walking the tree do
+     * not need to take it. */
     static boost::recursive_mutex m_GlobalMutex;
 
   private:                                  /* Size: 32 64 bit */
@@ -376,9 +421,11 @@ namespace dss {
       PropertyProxy<double>* floatingProxy;
       int iValue;
     } m_Proxy;                                    /*  4  8 */
-    boost::flyweight<std::string> m_Name;         /*  4  8 */
+    PropertyName m_Name;                          /*  4  8 */
     mutable std::string m_DisplayName;            /*  4  8 */
-    std::vector<PropertyNodePtr>* m_ChildNodes;   /*  4  8 */
+    struct ChildStore;
+    struct ChildList;
+    boost::shared_ptr<const ChildList> m_ChildNodes; /*  8 16 */
     std::vector<PropertyNode*>* m_AliasedBy;      /*  4  8 */
     std::vector<PropertyListener*>* m_Listeners;  /*  4  8 */
     PropertyNode* m_ParentNode;                   /*  4  8 */
@@ -389,11 +436,22 @@ namespace dss {
     uint8_t m_Flags;                              /*  1  1 */
     /* vtable */                                  /*  4  8 */
 
-    static std::vector<PropertyNodePtr> sm_EmptyChildNodes;
-
   private:
     void clearValue();
 
+    static const boost::shared_ptr<const ChildList>& emptyChildList();
+    /** Returns the current child list, never NULL. Lock free. */
+    boost::shared_ptr<const ChildList> loadChildList() const;
+    /** Returns the nodes of the current child list, never NULL. Lock free. */
+    PropertyListSnapshot loadChildNodes() const;
+    /** Publishes a new child list, m_GlobalMutex has to be held. */
+    void storeChildNodes(const boost::shared_ptr<const ChildList>& _children);
+
+    /** Returns the child \a _name with index \a _index, -1 being the last one. */
+    PropertyNodePtr getChildByNameAndIndex(const std::string& _name, int _index);
+    /** @copydoc getChildByNameAndIndex, looks the name up by its address */
+    PropertyNodePtr getChildByInternedName(const PropertyName& _name, int _index);
+
     int getAndRemoveIndexFromPropertyName(std::string& _propName);
 
     void childAdded(PropertyNodePtr _child);
@@ -417,6 +475,8 @@ namespace dss {
     /** Returns a child node by path.
      * @return The child or NULL if not found */
     PropertyNodePtr getProperty(const std::string& _propPath);
+    /** @copydoc getProperty */
+    PropertyNodePtr getProperty(const PropertyPath& _propPath);
     int count(const std::string& _propertyName);
     int size();
 
@@ -462,6 +522,8 @@ namespace dss {
 
     /** Recursively adds a child-node. */
     PropertyNodePtr createProperty(const std::string& _propPath);
+    /** @copydoc createProperty */
+    PropertyNodePtr createProperty(const PropertyPath& _propPath);
 
     /** Returns a child node by name.
      * Or NULL if not found.*/
@@ -501,19 +563,22 @@ namespace dss {
     /** Returns the count of the nodes children. */
     int getChildCount() const {
       if (m_AliasTarget) {
-        return m_AliasTarget->m_ChildNodes ? m_AliasTarget->m_ChildNodes->size() : 0;
+        return m_AliasTarget->getChildCount();
       }
-      return m_ChildNodes ? m_ChildNodes->size() : 0;
+      return loadChildNodes()->size();
     }
     /** Returns a child node by index. */
     PropertyNodePtr getChild(const int _index) {
       if (m_AliasTarget) {
-        return m_AliasTarget->m_ChildNodes ? m_AliasTarget->m_ChildNodes->at(_index) : PropertyNodePtr();
+        return m_AliasTarget->getChild(_index);
       }
-      return m_ChildNodes ? m_ChildNodes->at(_index) : PropertyNodePtr();
+      PropertyListSnapshot children = loadChildNodes();
+      return children->empty() ? PropertyNodePtr() : children->at(_index);
     }
 
-    const std::vector<PropertyNodePtr>& getChildNodes() const;
+    /** Returns a snapshot of the child nodes.
+     * The snapshot is not affected by later modifications of this node. */
+    PropertyListSnapshot getChildNodes() const;
 
     /** Adds \a _childNode as a child to this node.
         If the node already has a parent, the node will be moved here. */
@@ -535,9 +600,10 @@ namespace dss {
     void foreachChildOf(void(*_callback)(PropertyNode&)) {
       if (m_AliasTarget) {
         m_AliasTarget->foreachChildOf(_callback);
-      } else if (NULL != m_ChildNodes) {
-        for (PropertyList::iterator it = m_ChildNodes->begin(); it
-            != m_ChildNodes->end(); ++it)
+      } else {
+        PropertyListSnapshot children = loadChildNodes();
+        for (PropertyListSnapshot::const_iterator it = children->begin(); it
+            != children->end(); ++it)
         {
           (*_callback)(**it);
         }
@@ -550,9 +616,10 @@ namespace dss {
     void foreachChildOf(Cls& _objRef, void(Cls::*_callback)(PropertyNode&)) {
       if (m_AliasTarget) {
         m_AliasTarget->foreachChildOf(_objRef, _callback);
-      } else if (NULL != m_ChildNodes) {
-        for (PropertyList::iterator it = m_ChildNodes->begin(); it
-            != m_ChildNodes->end(); ++it)
+      } else {
+        PropertyListSnapshot children = loadChildNodes();
+        for (PropertyListSnapshot::const_iterator it = children->begin(); it
+            != children->end(); ++it)
         {
           (_objRef.*_callback)(**it);
         }
@@ -587,6 +654,32 @@ namespace dss {
 
   }; // PropertyNode
 
+  /** Precompiled relative property path.
+   * The path is split, its indices are parsed and its names are interned
+   * once on construction, so hot paths that are resolved over and over
+   * again skip the string handling and only walk the tree.
+   * A leading slash is ignored, paths are always resolved relative to
+   * the node they are applied to. */
+  class PropertyPath {
+  public:
+    explicit PropertyPath(const std::string& _path);
+
+    const std::string& str() const { return m_Path; }
+
+    /** @return The node below \a _base or NULL if not found */
+    PropertyNodePtr resolve(PropertyNode& _base) const;
+    /** Resolves the path below \a _base creating missing nodes */
+    PropertyNodePtr create(PropertyNode& _base) const;
+  private:
+    struct Component {
+      PropertyName lookupName;
+      int lookupIndex;
+      std::string createName;
+    };
+    std::string m_Path;
+    std::vector<Component> m_Components;
+  }; // PropertyPath
+
   template <>
   inline void PropertyNode::setValue<std::string>(const std::string& value) { setStringValue(value); }
   template <>
@@ -33,6 +33,7 @@
 #include <fstream>
 #include <iostream>
 #include <climits>
+#include <sys/stat.h>
 
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
@@ -73,6 +74,7 @@ namespace dss {
     m_cxOptionSet(0),
     m_cxOptionClear(0),
     m_TimingEnabled(false),
+    m_ContextPoolSize(0),
     m_pContext(NULL)
   {
   } // ctor
@@ -90,6 +92,7 @@ namespace dss {
     m_StackSize = 8192;
     m_cxOptionClear = m_cxOptionSet = 0;
     m_TimingEnabled = false;
+    m_ContextPoolSize = 16;
 
     try {
       if (DSS::hasInstance()) {
@@ -113,6 +116,10 @@ namespace dss {
         if (pPtr && (pPtr->getValueType() == vTypeBoolean)) {
           m_TimingEnabled = pPtr->getBoolValue();
         }
+        pPtr = DSS::getInstance()->getPropertySystem().getProperty("/config/spidermonkey/contextpool");
+        if (pPtr && (pPtr->getValueType() == vTypeInteger)) {
+          m_ContextPoolSize = pPtr->getIntegerValue();
+        }
 
         m_pPropertyNode = DSS::getInstance()->getPropertySystem().createProperty("/system/js/");
         m_pPropertyNode->createProperty("timings");
@@ -143,12 +150,16 @@ namespace dss {
     JSContextThread ct(context);
 
     ScriptContext* pResult = new ScriptContext(*this, context);
-    for(boost::ptr_vector<ScriptExtension>::iterator ipExtension = m_Extensions.begin(); ipExtension != m_Extensions.end(); ++ipExtension) {
-      ipExtension->extendContext(*pResult);
-    }
+    extendContext(*pResult);
     return pResult;
   } // getContext
 
+  void ScriptEnvironment::extendContext(ScriptContext& _context) {
+    for(boost::ptr_vector<ScriptExtension>::iterator ipExtension = m_Extensions.begin(); ipExtension != m_Extensions.end(); ++ipExtension) {
+      ipExtension->extendContext(_context);
+    }
+  } // extendContext
+
   ScriptExtension* ScriptEnvironment::getExtension(const std::string& _name) {
     for(boost::ptr_vector<ScriptExtension>::iterator ipExtension = m_Extensions.begin(); ipExtension != m_Extensions.end(); ++ipExtension) {
       if(ipExtension->getName() == _name) {
@@ -168,6 +179,67 @@ namespace dss {
   } // getExtension
 
 
+  //============================================= ScriptContextPool
+
+  ScriptContextPool::ScriptContextPool(ScriptEnvironment& _env, size_t _maxIdle)
+  : m_Environment(_env),
+    m_MaxIdle(_maxIdle)
+  { } // ctor
+
+  ScriptContextPool::~ScriptContextPool() {
+    clear();
+  } // dtor
+
+  boost::shared_ptr<ScriptContext> ScriptContextPool::acquire(const std::string& _key, bool& _pooled) {
+    boost::shared_ptr<ScriptContext> result;
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      for (IdleList::iterator it = m_Idle.begin(); it != m_Idle.end(); ++it) {
+        if (it->first == _key) {
+          result = it->second;
+          m_Idle.erase(it);
+          break;
+        }
+      }
+    }
+    _pooled = (result != NULL);
+    if (!_pooled) {
+      return boost::shared_ptr<ScriptContext>(m_Environment.getContext());
+    }
+    // globals of the previous run must not leak into this one
+    JSContextThread th(result.get());
+    result->resetRootObject();
+    return result;
+  } // acquire
+
+  void ScriptContextPool::release(const std::string& _key, boost::shared_ptr<ScriptContext> _context) {
+    if (m_MaxIdle == 0) {
+      return;
+    }
+    IdleList evicted;
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Idle.push_front(std::make_pair(_key, _context));
+      while (m_Idle.size() > m_MaxIdle) {
+        evicted.splice(evicted.end(), m_Idle, --m_Idle.end());
+      }
+    }
+    // evicted contexts are destroyed here, outside the lock
+  } // release
+
+  void ScriptContextPool::clear() {
+    IdleList evicted;
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      evicted.swap(m_Idle);
+    }
+  } // clear
+
+  int ScriptContextPool::getIdleCount() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Idle.size();
+  } // getIdleCount
+
   //============================================= ScriptContext
 
   template<>
@@ -507,8 +579,8 @@ namespace dss {
     PropertyNodePtr matchedNode;
     PropertyNodePtr baseNode = propertySystem.createProperty("/usr/triggers");
     int maxId = 0;
-    const auto& baseChildNodes = baseNode->getChildNodes();
-    for (auto it = baseChildNodes.begin(); it != baseChildNodes.end(); it++) {
+    PropertyListSnapshot baseChildNodes = baseNode->getChildNodes();
+    for (auto it = baseChildNodes->begin(); it != baseChildNodes->end(); it++) {
       const auto& baseChildNode = *it;
       maxId = std::max(maxId, strToIntDef(baseChildNode->getName(), 0));
       const auto& triggerPathNode = baseChildNode->getPropertyByName("triggerPath");
@@ -573,8 +645,8 @@ namespace dss {
         return JS_TRUE;
     }
     PropertyNodePtr matchedNode;
-    const auto& baseChildNodes = baseNode->getChildNodes();
-    for (auto it = baseChildNodes.begin(); it != baseChildNodes.end(); it++) {
+    PropertyListSnapshot baseChildNodes = baseNode->getChildNodes();
+    for (auto it = baseChildNodes->begin(); it != baseChildNodes->end(); it++) {
       const auto& baseChildNode = *it;
       const auto& triggerPathNode = baseChildNode->getPropertyByName("triggerPath");
       if (!triggerPathNode) {
@@ -604,7 +676,8 @@ namespace dss {
   : m_Environment(_env),
     m_pContext(_pContext),
     m_Locked(false),
-    m_LockedBy(0)
+    m_LockedBy(0),
+    m_LastScriptCached(false)
   {
     uint32 cxOptions = _env.getContextFlags((JS_GetOptions(m_pContext) |
         (JSOPTION_VAROBJFIX | JSOPTION_STRICT | JSOPTION_JIT | JSOPTION_METHODJIT)));
@@ -616,12 +689,25 @@ namespace dss {
 
     JS_SetErrorReporter(m_pContext, jsErrorHandler);
 
+    createRootObject(true);
+
+    JS_SetContextPrivate(m_pContext, this);
+  } // ctor
+
+  void ScriptContext::createRootObject(bool _newCompartment) {
     /* Create the global object. */
-    m_pRootObject = JS_NewCompartmentAndGlobalObject(m_pContext, &global_class, NULL);
+    if (_newCompartment) {
+      m_pRootObject = JS_NewCompartmentAndGlobalObject(m_pContext, &global_class, NULL);
+    } else {
+      // stays in the compartment of the current global, where the compiled
+      // scripts live, the old global becomes garbage
+      m_pRootObject = JS_NewGlobalObject(m_pContext, &global_class);
+    }
     if (m_pRootObject == NULL) {
       throw ScriptException("Could not create root-object");
     }
     m_RootObject.reset(new ScriptObject(m_pRootObject, *this));
+    JS_SetGlobalObject(m_pContext, m_pRootObject);
 
     JS_DefineFunctions(m_pContext, m_pRootObject, global_methods);
 
@@ -630,9 +716,21 @@ namespace dss {
     if (!JS_InitStandardClasses(m_pContext, m_pRootObject)) {
       throw ScriptException("InitStandardClasses failed");
     }
-
-    JS_SetContextPrivate(m_pContext, this);
-  } // ctor
+  } // createRootObject
+
+  void ScriptContext::resetRootObject() {
+    assert(m_AttachedObjects.empty());
+    createRootObject(false);
+    m_Environment.extendContext(*this);
+  } // resetRootObject
+
+  void ScriptContext::dropCompiledScripts() {
+    for (std::map<std::string, CompiledScript>::iterator it = m_CompiledScripts.begin();
+         it != m_CompiledScripts.end(); ++it) {
+      JS_RemoveObjectRoot(m_pContext, &it->second.m_pScript);
+    }
+    m_CompiledScripts.clear();
+  } // dropCompiledScripts
 
   ScriptContext::~ScriptContext() {
     ScriptLock lock(this);
@@ -645,6 +743,8 @@ namespace dss {
     }
     scrubVector(m_AttachedObjects);
 
+    dropCompiledScripts();
+
     JS_SetContextPrivate(m_pContext, NULL);
     JS_DestroyContext(m_pContext);
     m_pContext = NULL;
@@ -704,17 +804,65 @@ namespace dss {
     return false;
   } // raisePendingExceptions
 
+  bool ScriptContext::FileStamp::operator==(const FileStamp& _other) const {
+    return (m_Device == _other.m_Device) && (m_Inode == _other.m_Inode) &&
+           (m_Size == _other.m_Size) &&
+           (m_ModTime.tv_sec == _other.m_ModTime.tv_sec) &&
+           (m_ModTime.tv_nsec == _other.m_ModTime.tv_nsec);
+  } // operator==
+
+  JSObject* ScriptContext::getCompiledScript(const std::string& _fileName) {
+    // mtime alone has a coarse resolution, a file replaced or rewritten
+    // within the same tick still differs in inode or size most of the time
+    struct stat st;
+    bool known = (stat(_fileName.c_str(), &st) == 0);
+    FileStamp stamp;
+    memset(&stamp, 0, sizeof(stamp));
+    if (known) {
+      stamp.m_Device = st.st_dev;
+      stamp.m_Inode = st.st_ino;
+      stamp.m_Size = st.st_size;
+      stamp.m_ModTime = st.st_mtim;
+    }
+
+    std::map<std::string, CompiledScript>::iterator it = m_CompiledScripts.find(_fileName);
+    if (it != m_CompiledScripts.end()) {
+      if (known && (it->second.m_Stamp == stamp)) {
+        m_LastScriptCached = true;
+        return it->second.m_pScript;
+      }
+      JS_RemoveObjectRoot(m_pContext, &it->second.m_pScript);
+      m_CompiledScripts.erase(it);
+    }
+
+    m_LastScriptCached = false;
+    // a compile-and-go script is bound to the current global and could not
+    // run again once resetRootObject() replaced it
+    uint32 options = JS_GetOptions(m_pContext);
+    JS_SetOptions(m_pContext, options & ~JSOPTION_COMPILE_N_GO);
+    JSObject* scriptObj = JS_CompileFile(m_pContext, m_pRootObject, _fileName.c_str());
+    JS_SetOptions(m_pContext, options);
+    if (!scriptObj) {
+      throw ScriptException("Error compiling script: " + _fileName);
+    }
+    if (!known) {
+      // can't tell when it changes, don't keep it
+      return scriptObj;
+    }
+    CompiledScript& compiled = m_CompiledScripts[_fileName];
+    compiled.m_Stamp = stamp;
+    compiled.m_pScript = scriptObj;
+    JS_AddObjectRoot(m_pContext, &compiled.m_pScript);
+    return compiled.m_pScript;
+  } // getCompiledScript
+
   jsval ScriptContext::doEvaluateScript(const std::string& _fileName) {
     ScriptLock lock(this);
     JSBool ok = JS_FALSE;
     jsval rval;
     JSContextThread req(m_pContext);
-    // multiple hanging scriptObj's may exist per context which
-    // are all freed with the context destruction
-    JSObject* scriptObj = JS_CompileFile(m_pContext, m_pRootObject, _fileName.c_str());
-    if (!scriptObj) {
-      throw ScriptException("Error compiling script: " + _fileName);
-    }
+    // uncached scriptObj's may hang around until the context is destroyed
+    JSObject* scriptObj = getCompiledScript(_fileName);
     ok = JS_ExecuteScript(m_pContext, m_pRootObject, scriptObj, &rval);
     if(ok) {
       return rval;
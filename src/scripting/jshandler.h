@@ -30,6 +30,10 @@
 
 #include <iostream>
 #include <cassert>
+#include <ctime>
+#include <list>
+#include <map>
+#include <sys/types.h>
 
 #include <boost/thread/mutex.hpp>
 #include <jsapi.h>
@@ -65,6 +69,7 @@ namespace dss {
     uint32 m_cxOptionSet;
     uint32 m_cxOptionClear;
     bool m_TimingEnabled;
+    int m_ContextPoolSize;
   public:
     ScriptContext* m_pContext;
 
@@ -83,6 +88,8 @@ namespace dss {
 
     /** Creates a new ScriptContext with all registered extensions present */
     ScriptContext* getContext();
+    /** Adds all registered extensions to the global object of \a _context */
+    void extendContext(ScriptContext& _context);
     Security* getSecurity() { return m_pSecurity; }
 
     /** Get configuration flags for JSContext */
@@ -92,8 +99,38 @@ namespace dss {
 
     bool isInitialized();
     bool isTimingEnabled() { return m_TimingEnabled; }
+    /** Number of idle contexts a ScriptContextPool may keep */
+    int getContextPoolSize() const { return m_ContextPoolSize; }
   };
 
+  /** Keeps the contexts of finished event handler runs for the next run
+    * of the same subscription. A pooled context gets a fresh global object
+    * before it is handed out again, so no script state of the previous run
+    * is visible; what is saved is setting up the JSContext and compiling
+    * the handler's script again. */
+  class ScriptContextPool {
+  public:
+    ScriptContextPool(ScriptEnvironment& _env, size_t _maxIdle);
+    ~ScriptContextPool();
+
+    /** Returns the idle context of \a _key with a reset global object or a
+      * new one, \a _pooled tells which */
+    boost::shared_ptr<ScriptContext> acquire(const std::string& _key, bool& _pooled);
+    /** Hands back a context without attached objects, the least recently
+      * used context gets destroyed if the pool is full */
+    void release(const std::string& _key, boost::shared_ptr<ScriptContext> _context);
+    void clear();
+    int getIdleCount() const;
+  private:
+    typedef std::list<std::pair<std::string, boost::shared_ptr<ScriptContext> > > IdleList;
+
+    ScriptEnvironment& m_Environment;
+    const size_t m_MaxIdle;
+    mutable boost::mutex m_Mutex;
+    /** most recently released first */
+    IdleList m_Idle;
+  }; // ScriptContextPool
+
   /** ScriptContext is a wrapper for a scripts execution context.
     * A script can either be loaded from a file or from
     * a std::string contained in memory. */
@@ -112,6 +149,26 @@ namespace dss {
     mutable boost::mutex m_LockDataMutex;
     bool m_Locked;
     pthread_t m_LockedBy;
+
+    /** Identifies the file version a script was compiled from */
+    struct FileStamp {
+      dev_t m_Device;
+      ino_t m_Inode;
+      off_t m_Size;
+      struct timespec m_ModTime;
+      bool operator==(const FileStamp& _other) const;
+    }; // FileStamp
+    struct CompiledScript {
+      FileStamp m_Stamp;
+      JSObject* m_pScript;
+    }; // CompiledScript
+    /** Compiled script objects by file name, rooted until the context dies.
+      * They outlive resetRootObject(), which keeps the compartment. */
+    std::map<std::string, CompiledScript> m_CompiledScripts;
+    bool m_LastScriptCached;
+    JSObject* getCompiledScript(const std::string& _fileName);
+    void createRootObject(bool _newCompartment);
+    void dropCompiledScripts();
   public:
     ScriptContext(ScriptEnvironment& _env, JSContext* _pContext);
     virtual ~ScriptContext();
@@ -122,11 +179,15 @@ namespace dss {
     // FIXME: Workaround a compiler issue that interprets typeof jsval == typeof int
     jsval doEvaluate(const std::string& _script);
 
-    /** Evaluates the given file */
+    /** Evaluates the given file. The compiled script is kept in the
+      * context and executed again until the file's inode, size or
+      * mtime changes. */
     template <class t>
     t evaluateScript(const std::string& _fileName);
     // FIXME: Workaround a compiler issue that interprets typeof jsval == typeof int
     jsval doEvaluateScript(const std::string& _fileName);
+    /** True if the last evaluateScript didn't need to compile */
+    bool wasLastScriptCached() const { return m_LastScriptCached; }
 
     /** Returns a pointer to the JSContext */
     JSContext* getJSContext() { return m_pContext; }
@@ -142,6 +203,10 @@ namespace dss {
     void detachWrapper() { m_pWrapper.reset(); }
 
     ScriptObject& getRootObject() { return *m_RootObject; }
+    /** Replaces the global object by a fresh one in the same compartment,
+      * extensions are added again and compiled scripts kept. Must not be
+      * called with attached objects present. */
+    void resetRootObject();
     bool raisePendingExceptions();
 
     void attachObject(ScriptContextAttachedObject* _pObject);
@@ -86,6 +86,7 @@ namespace dss {
     SensorDataUploadMsHubPlugin(EventInterpreter* _pInterpreter);
     virtual ~SensorDataUploadMsHubPlugin();
     virtual void handleEvent(Event& _event, const EventSubscription& _subscription);
+    virtual std::string getDispatchLane() const { return getName(); }
   private:
     void doSubscribe();
     void doUnsubscribe();
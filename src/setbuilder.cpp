@@ -30,9 +30,12 @@
 #include <stdexcept>
 #include <cassert>
 
+#include <boost/make_shared.hpp>
+
 #include <digitalSTROM/dsuid.h>
 
 #include "base.h"
+#include "foreach.h"
 #include "src/model/set.h"
 #include "src/model/zone.h"
 #include "src/model/apartment.h"
@@ -98,63 +101,53 @@ namespace dss {
     throw std::runtime_error("String should be enclosed by \"'\"");
   } // readString
 
-  Set SetBuilder::restrictByFunction(const std::string& _functionName, unsigned int& _index, const Set& _set, boost::shared_ptr<const Group> _group) {
+  void SetBuilder::compileFunction(const std::string& _functionName, unsigned int& _index, Program& _program) {
     if(_index >= m_SetDescription.size()) {
       throw std::range_error("_index is out of bounds");
     }
     assert(m_SetDescription[_index-1] == '(');
 
-    Set result;
+    Step step;
+    step.kind = Step::skFunction;
+    step.name = _functionName;
+    Argument arg;
 
-    if(_functionName == "dsid") {
-      dsuid_t dsuid = readDSID(_index);
-      result.addDevice(_set.getByDSID(dsuid));
-    } else if (_functionName == "dsuid") {
-      dsuid_t dsuid = readDSID(_index);
-      result.addDevice(_set.getByDSID(dsuid));
-    } else if(_functionName == "zone") {
-      if(m_SetDescription[_index] == '\'') {
-        std::string zoneName = readString(_index);
-        result = _set.getByZone(zoneName);
-      } else {
-        int zoneID = readInt(_index);
-        result = _set.getByZone(zoneID);
-      }
-    } else if(_functionName == "group") {
+    if((_functionName == "dsid") || (_functionName == "dsuid")) {
+      arg.type = Argument::atDSID;
+      arg.dsuid = readDSID(_index);
+      step.arguments.push_back(arg);
+    } else if((_functionName == "zone") || (_functionName == "group")) {
       if(m_SetDescription[_index] == '\'') {
-        std::string groupName = readString(_index);
-        result = _set.getByGroup(groupName);
+        arg.type = Argument::atString;
+        arg.text = readString(_index);
       } else {
-        int groupID = readInt(_index);
-        result = _set.getByGroup(groupID);
+        arg.type = Argument::atInt;
+        arg.number = readInt(_index);
       }
+      step.arguments.push_back(arg);
     } else if(_functionName == "fid") {
-      int fid = readInt(_index);
-      result = _set.getByFunctionID(fid);
+      arg.type = Argument::atInt;
+      arg.number = readInt(_index);
+      step.arguments.push_back(arg);
     } else if(_functionName == "tag") {
-      std::string tagName = readString(_index);
-      result = _set.getByTag(tagName);
-    } else if(_functionName == "add") {
-      Set inner = parseSet(_index, _group->getDevices(), _group);
-      result = _set.combine(inner);
-    } else if(_functionName == "remove") {
-      Set inner = parseSet(_index, _group->getDevices(), _group);
-      result = _set.remove(inner);
-    } else if(_functionName == "empty") {
-      // nop
+      arg.type = Argument::atString;
+      arg.text = readString(_index);
+      step.arguments.push_back(arg);
+    } else if((_functionName == "add") || (_functionName == "remove")) {
+      compileSet(_index, step.inner);
     } else if(_functionName == "addDevices") {
-      result = _set;
       do {
         if(m_SetDescription[_index] == ',') {
           _index++;
         }
         if(m_SetDescription[_index] == '\'') {
-          std::string name = readString(_index);
-          result.addDevice(m_Apartment.getDeviceByName(name));
+          arg.type = Argument::atString;
+          arg.text = readString(_index);
         } else {
-          dsuid_t dsuid = readDSID(_index);
-          result.addDevice(m_Apartment.getDeviceByDSID(dsuid));
+          arg.type = Argument::atDSID;
+          arg.dsuid = readDSID(_index);
         }
+        step.arguments.push_back(arg);
       } while(m_SetDescription[_index] == ',');
     }
     assert(m_SetDescription[_index] == ')' || m_SetDescription[_index] == ',');
@@ -163,8 +156,53 @@ namespace dss {
     }
     _index++; // skip over closing bracket
 
+    _program.push_back(step);
+  } // compileFunction
+
+  Set SetBuilder::applyFunction(const Step& _step, const Set& _set, boost::shared_ptr<const Group> _group) {
+    Set result;
+    const std::string& name = _step.name;
+
+    if((name == "dsid") || (name == "dsuid")) {
+      result.addDevice(_set.getByDSID(_step.arguments.front().dsuid));
+    } else if(name == "zone") {
+      const Argument& arg = _step.arguments.front();
+      if(arg.type == Argument::atString) {
+        result = _set.getByZone(arg.text);
+      } else {
+        result = _set.getByZone(arg.number);
+      }
+    } else if(name == "group") {
+      const Argument& arg = _step.arguments.front();
+      if(arg.type == Argument::atString) {
+        result = _set.getByGroup(arg.text);
+      } else {
+        result = _set.getByGroup(arg.number);
+      }
+    } else if(name == "fid") {
+      result = _set.getByFunctionID(_step.arguments.front().number);
+    } else if(name == "tag") {
+      result = _set.getByTag(_step.arguments.front().text);
+    } else if(name == "add") {
+      Set inner = evaluate(_step.inner, _group->getDevices(), _group);
+      result = _set.combine(inner);
+    } else if(name == "remove") {
+      Set inner = evaluate(_step.inner, _group->getDevices(), _group);
+      result = _set.remove(inner);
+    } else if(name == "addDevices") {
+      result = _set;
+      foreach(const Argument& arg, _step.arguments) {
+        if(arg.type == Argument::atString) {
+          result.addDevice(m_Apartment.getDeviceByName(arg.text));
+        } else {
+          result.addDevice(m_Apartment.getDeviceByDSID(arg.dsuid));
+        }
+      }
+    }
+    // "empty" and unknown functions yield an empty set
+
     return result;
-  }
+  } // applyFunction
 
   Set SetBuilder::restrictBy(const std::string& _identifier, const Set& _set, boost::shared_ptr<const Group> _group) {
 
@@ -194,10 +232,10 @@ namespace dss {
   } // restrictBy
 
 
-  Set SetBuilder::parseSet(unsigned int& _index, const Set& _set, boost::shared_ptr<const Group> _context) {
+  void SetBuilder::compileSet(unsigned int& _index, Program& _program) {
     skipWhitespace(_index);
     if(_index >= m_SetDescription.size()) {
-      return _set;
+      return;
     }
     // scan forward to a delimiter
     std::string::size_type pos = m_SetDescription.find_first_of(".(),", _index);
@@ -211,18 +249,18 @@ namespace dss {
     std::string entry = m_SetDescription.substr(_index, pos + 1 - _index );
     if(entry == ".") {
       _index = pos + 1;
-      Set newRoot = m_Apartment.getDevices();
-      return parseSet(_index, newRoot, _context);
+      Step step;
+      step.kind = Step::skRoot;
+      _program.push_back(step);
+      compileSet(_index, _program);
     } else if(m_SetDescription[pos] == '(') {
       _index = pos + 1;
-      Set tmp = restrictByFunction(entry.erase(entry.size()-1), _index, _set, _context);
+      compileFunction(entry.erase(entry.size()-1), _index, _program);
       skipWhitespace(_index);
       // don't recurse if we're at the end or we were parsing a parameter
       if((_index < m_SetDescription.size()) && (m_SetDescription[_index] != ',') && (m_SetDescription[_index] != ')')) {
         _index++;
-        return parseSet(_index, tmp, _context);
-      } else {
-        return tmp;
+        compileSet(_index, _program);
       }
     } else {
       std::string item = entry;
@@ -230,19 +268,65 @@ namespace dss {
       if(!end || parsingParam) {
         item.erase(item.size()-1);
       }
-      Set tmp = restrictBy(trim(item), _set, _context);
+      Step step;
+      step.kind = Step::skRestrict;
+      step.name = trim(item);
+      _program.push_back(step);
       _index = pos + 1;
 
       if(!end && !parsingParam) {
-        return parseSet(_index, tmp, _context);
-      }
-      if(parsingParam) {
+        compileSet(_index, _program);
+      } else if(parsingParam) {
         _index--; // make sure we're positioned on the closing token
       }
-      return tmp;
     }
-    return _set;
-  }
+  } // compileSet
+
+  Set SetBuilder::evaluate(const Program& _program, const Set& _set, boost::shared_ptr<const Group> _context) {
+    Set result = _set;
+    foreach(const Step& step, _program) {
+      switch(step.kind) {
+      case Step::skRoot:
+        result = m_Apartment.getDevices();
+        break;
+      case Step::skRestrict:
+        result = restrictBy(step.name, result, _context);
+        break;
+      case Step::skFunction:
+        result = applyFunction(step, result, _context);
+        break;
+      }
+    }
+    return result;
+  } // evaluate
+
+  namespace {
+
+    // bounds for the caches of SetBuilderCache
+    const size_t kMaxCachedPrograms = 256;
+    const size_t kMaxCachedSets = 256;
+
+  } // anonymous namespace
+
+  SetBuilder::ProgramPtr SetBuilder::compile(const std::string& _setDescription, unsigned int _index) {
+    SetBuilderCache& cache = m_Apartment.getSetBuilderCache();
+    {
+      boost::mutex::scoped_lock lock(cache.m_ProgramsMutex);
+      auto it = cache.m_Programs.find(_setDescription);
+      if(it != cache.m_Programs.end()) {
+        return it->second;
+      }
+    }
+    boost::shared_ptr<Program> program = boost::make_shared<Program>();
+    compileSet(_index, *program);
+
+    boost::mutex::scoped_lock lock(cache.m_ProgramsMutex);
+    if(cache.m_Programs.size() >= kMaxCachedPrograms) {
+      cache.m_Programs.clear();
+    }
+    cache.m_Programs[_setDescription] = program;
+    return program;
+  } // compile
 
   Set SetBuilder::buildSet(const std::string& _setDescription, boost::shared_ptr<const Zone> _context) {
     if(_context != NULL) {
@@ -253,6 +337,21 @@ namespace dss {
   }
 
   Set SetBuilder::buildSet(const std::string& _setDescription, boost::shared_ptr<const Group> _context) {
+    SetBuilderCache& cache = m_Apartment.getSetBuilderCache();
+    SetBuilderCache::SetKey key;
+    key.description = _setDescription;
+    key.zoneID = (_context != NULL) ? _context->getZoneID() : -1;
+    key.groupID = (_context != NULL) ? _context->getID() : -1;
+    // read before evaluating, a change in between makes the result stale
+    unsigned long long generation = m_Apartment.getGeneration();
+    {
+      boost::mutex::scoped_lock lock(cache.m_SetsMutex);
+      auto it = cache.m_Sets.find(key);
+      if((it != cache.m_Sets.end()) && (it->second.generation == generation)) {
+        return *it->second.set;
+      }
+    }
+
     Set result;
     m_SetDescription = _setDescription;
     boost::shared_ptr<const Group> context = _context;
@@ -266,12 +365,36 @@ namespace dss {
     } else {
       context = m_Apartment.getZone(0)->getGroup(GroupIDBroadcast);
     }
-    result = parseSet(index, result, context);
+    result = evaluate(*compile(_setDescription, index), result, context);
 
+    boost::shared_ptr<const Set> cached = boost::make_shared<Set>(result);
+    boost::mutex::scoped_lock lock(cache.m_SetsMutex);
+    if(cache.m_Sets.size() >= kMaxCachedSets) {
+      cache.m_Sets.clear();
+    }
+    SetBuilderCache::CachedSet& entry = cache.m_Sets[key];
+    entry.generation = generation;
+    entry.set = cached;
     return result;
   } // buildSet
 
 
+  //================================================== SetBuilderCache
+
+  bool SetBuilderCache::SetKey::operator==(const SetKey& _other) const {
+    return (zoneID == _other.zoneID) &&
+           (groupID == _other.groupID) &&
+           (description == _other.description);
+  } // operator==
+
+  std::size_t SetBuilderCache::SetKeyHash::operator()(const SetKey& _key) const {
+    std::size_t seed = boost::hash_value(_key.description);
+    boost::hash_combine(seed, _key.zoneID);
+    boost::hash_combine(seed, _key.groupID);
+    return seed;
+  } // operator()
+
+
   //================================================== MeterSetBuilder
 
   MeterSetBuilder::MeterSetBuilder(Apartment& _apartment)
@@ -27,6 +27,9 @@
 #include <vector>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "src/ds485types.h"
 
@@ -38,19 +41,51 @@ namespace dss {
   class Set;
   class DSMeter;
 
+  /** Builds sets from textual descriptions such as ".zone(3).yellow".
+    * Descriptions are compiled once into a list of steps which is cached by
+    * the description string, the resulting sets are memoized until the
+    * generation of the apartment changes. Both caches live in the
+    * SetBuilderCache of the apartment. */
   class SetBuilder {
+  public:
+    /** Parameter of a set function, either a quoted string, a number or a dSUID */
+    struct Argument {
+      enum Type { atString, atInt, atDSID };
+      Type type;
+      std::string text;
+      int number;
+      dsuid_t dsuid;
+    };
+    struct Step;
+    typedef std::vector<Step> Program;
+    /** One restriction applied to the set built so far */
+    struct Step {
+      enum Kind {
+        skRoot,      ///< restart with all devices of the apartment
+        skRestrict,  ///< restrict by device, group or zone name
+        skFunction   ///< apply function \a name with \a arguments
+      };
+      Kind kind;
+      std::string name;
+      std::vector<Argument> arguments;
+      Program inner;
+    };
+    typedef boost::shared_ptr<const Program> ProgramPtr;
   private:
     std::string m_SetDescription;
     Apartment& m_Apartment;
   protected:
     Set restrictBy(const std::string& _identifier, const Set& _set, boost::shared_ptr<const Group> _group);
-    Set restrictByFunction(const std::string& _functionName, unsigned int& _index, const Set& _set, boost::shared_ptr<const Group> _group);
+    Set applyFunction(const Step& _step, const Set& _set, boost::shared_ptr<const Group> _group);
+    Set evaluate(const Program& _program, const Set& _set, boost::shared_ptr<const Group> _context);
     void skipWhitespace(unsigned int& _index);
     std::string readParameter(unsigned int& _index);
     int readInt(unsigned int& _index);
     dsuid_t readDSID(unsigned int& _index);
     std::string readString(unsigned int& _index);
-    Set parseSet(unsigned int& _index, const Set& _set, boost::shared_ptr<const Group> _context);
+    void compileFunction(const std::string& _functionName, unsigned int& _index, Program& _program);
+    void compileSet(unsigned int& _index, Program& _program);
+    ProgramPtr compile(const std::string& _setDescription, unsigned int _index);
   public:
     SetBuilder(Apartment& _apartment);
 
@@ -58,6 +93,32 @@ namespace dss {
     Set buildSet(const std::string& _setDescription, boost::shared_ptr<const Zone> _context);
   }; // SetBuilder
 
+  /** Compiled programs and memoized sets of one apartment. Owned by the
+    * Apartment, as SetBuilder instances are short lived. The caches are
+    * bounded and simply flushed when full. */
+  class SetBuilderCache : boost::noncopyable {
+  private:
+    friend class SetBuilder;
+    struct SetKey {
+      std::string description;
+      int zoneID;
+      int groupID;
+      bool operator==(const SetKey& _other) const;
+    };
+    struct SetKeyHash {
+      std::size_t operator()(const SetKey& _key) const;
+    };
+    struct CachedSet {
+      unsigned long long generation;
+      boost::shared_ptr<const Set> set;
+    };
+
+    boost::mutex m_ProgramsMutex;
+    boost::unordered_map<std::string, SetBuilder::ProgramPtr> m_Programs;
+    boost::mutex m_SetsMutex;
+    boost::unordered_map<SetKey, CachedSet, SetKeyHash> m_Sets;
+  }; // SetBuilderCache
+
   class MeterSetBuilder {
   public:
     MeterSetBuilder(Apartment& _apartment);
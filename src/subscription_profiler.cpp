@@ -53,6 +53,8 @@ namespace dss {
 
   StopWatch::StopWatch(const std::string &eventName) : m_cancelled(false) {
     m_thisRun.m_eventName = eventName;
+    m_thisRun.count = 0;
+    m_thisRun.pooled = 0;
   }
 
   void StopWatch::startSubscription() {
@@ -79,6 +81,14 @@ namespace dss {
     m_script.name = name;
   }
 
+  void StopWatch::setContextPooled(bool _pooled) {
+    m_thisRun.pooled = _pooled ? 1 : 0;
+  }
+
+  void StopWatch::setScriptCached(bool _cached) {
+    m_script.cached = _cached ? 1 : 0;
+  }
+
   void StopWatch::stopScript() {
     m_script.totalTime = calcInterval();
     m_thisRun.scripts.push_back(m_script);
@@ -124,6 +134,7 @@ namespace dss {
     elt->m_init += newTiming.m_init;
     elt->m_end += newTiming.m_end;
     elt->count++;
+    elt->pooled += newTiming.pooled;
 
     if (elt->scripts.size() != newTiming.scripts.size()) {
       log(std::string("Number of sub-scripts do not match ") + newTiming.m_subscriptionName +
@@ -141,13 +152,14 @@ namespace dss {
 
     /* iterate over sub scripts of the subscription */
     SubscriptionTime::scripts_t::const_iterator cur_script = newTiming.scripts.begin();
-    foreach(ScriptTime accum, elt->scripts) {
+    foreach(ScriptTime& accum, elt->scripts) {
       if (accum.name != cur_script->name) {
         log(std::string("Script name mismatch ") + accum.name + " " + cur_script->name,
             lsWarning);
         break;
       }
       accum.totalTime += cur_script->totalTime;
+      accum.cached += cur_script->cached;
       cur_script++;
     }
   }
@@ -192,6 +204,7 @@ namespace dss {
         myProp->createProperty("total")->setIntegerValue(subs.total().toMicroSec());
         myProp->createProperty("pre")->setIntegerValue(subs.m_init.toMicroSec());
         myProp->createProperty("post")->setIntegerValue(subs.m_end.toMicroSec());
+        myProp->createProperty("pooled")->setIntegerValue(subs.pooled);
     } catch(PropertyTypeMismatch& ex) {
       log(std::string("Subscription: ") + expSubsName + " Datatype error " +
           ex.what(), lsWarning);
@@ -209,6 +222,7 @@ namespace dss {
 
       try {
         myScriptProp->createProperty("totalTime")->setIntegerValue(script.totalTime.toMicroSec());
+        myScriptProp->createProperty("cached")->setIntegerValue(script.cached);
       } catch(PropertyTypeMismatch& ex) {
         log(std::string("Script : ") + expSubsName + "/" + expScriptName +
             " Datatype error " + ex.what(), lsWarning);
@@ -25,6 +25,8 @@ namespace dss {
     TimeStamp executionTime;
 #endif
     TimeStamp totalTime;
+    /** runs that executed an already compiled script */
+    unsigned cached;
   };
 
   struct SubscriptionTime {
@@ -32,6 +34,8 @@ namespace dss {
     std::string m_subscriptionName;
     TimeStamp m_init, m_end;
     unsigned count;
+    /** runs that got a context from the pool */
+    unsigned pooled;
 
     bool operator==(const SubscriptionTime &other) const;
     bool operator<(const SubscriptionTime &other) const;
@@ -62,6 +66,8 @@ namespace dss {
     void startScript();
     void setScriptName(const std::string &name);
     void stopScript();
+    void setContextPooled(bool _pooled);
+    void setScriptCached(bool _cached);
     void stopSubscription();
     void stopEvent();
 
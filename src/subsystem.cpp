@@ -95,6 +95,13 @@ namespace dss {
     }
   }
 
+  bool Subsystem::maylog(aLogSeverity _severity) const {
+    if(m_pLogChannel != NULL) {
+      return m_pLogChannel->maylog(_severity);
+    }
+    return Logger::getInstance()->getLogChannel()->maylog(_severity);
+  } // maylog
+
   int Subsystem::getLogSeverity() const {
     if(m_pLogChannel == NULL) {
       return 0;
@@ -65,6 +65,9 @@ namespace dss {
     virtual void shutdown() {}
 
     void log(const std::string& _message, aLogSeverity _severity = lsDebug);
+    /** Returns true if a message of _severity would be logged, check this
+     * before assembling expensive messages */
+    bool maylog(aLogSeverity _severity) const;
 
     std::string getName() { return m_Name; }
     bool isEnabled() const { return m_Enabled; }
@@ -29,11 +29,19 @@
 #endif
 
 #include "systemcondition.h"
+
+#include <algorithm>
+#include <ctime>
+#include <unordered_map>
+
+#include <boost/make_shared.hpp>
+
 #include "dss.h"
 #include "propertysystem.h"
 #include "logger.h"
 #include "datetools.h"
 #include "base.h"
+#include "foreach.h"
 
 namespace dss {
 
@@ -59,6 +67,22 @@ bool secondsFromHMS(unsigned *ts, std::string string)
     return true;
 }
 
+  static bool isInTimeWindow(unsigned startSinceMidnight, unsigned endSinceMidnight,
+                             unsigned int secNow) {
+    if (startSinceMidnight < endSinceMidnight) {
+      // 1. 10:00:00 - 12:00:00
+      if ((secNow < startSinceMidnight) || (secNow > endSinceMidnight)) {
+        return false;
+      }
+    } else {
+      // 2. 22:00:00 - 04:00:00
+      if ((secNow < startSinceMidnight) && (secNow > endSinceMidnight)) {
+        return false;
+      }
+    }
+    return true;
+  } // isInTimeWindow
+
   bool checkTimeCondition(PropertyNodePtr timeStartNode, PropertyNodePtr timeEndNode,
                           unsigned int secNow) {
     unsigned startSinceMidnight = 0;
@@ -77,303 +101,596 @@ bool secondsFromHMS(unsigned *ts, std::string string)
         "end: " + intToString(endSinceMidnight) + ", "
         "now: " + intToString(secNow), lsDebug);
 
-    if (startSinceMidnight < endSinceMidnight) {
-      // 1. 10:00:00 - 12:00:00
-      if ((secNow < startSinceMidnight) || (secNow > endSinceMidnight)) {
-        return false;
+    return isInTimeWindow(startSinceMidnight, endSinceMidnight, secNow);
+  } // checkTimeCondition
+
+  namespace {
+    const int kSecondsPerDay = 24 * 60 * 60;
+
+    /** Change counters by state, see SystemCondition::stateChanged */
+    boost::mutex g_GenerationMutex;
+    std::unordered_map<std::string, unsigned> g_StateGenerations;
+    /** Bumped for changes that can't be told apart by state */
+    unsigned g_TreeGeneration = 0;
+
+    void parseStateValues(PropertyNodePtr _node,
+                          std::vector<std::pair<std::string, std::string> >& _values) {
+      for (int i = 0; i < _node->getChildCount(); i++) {
+        PropertyNodePtr child = _node->getChild(i);
+        _values.push_back(std::make_pair(child->getName(), child->getAsString()));
       }
-    } else {
-      // 2. 22:00:00 - 04:00:00
-      if ((secNow < startSinceMidnight) && (secNow > endSinceMidnight)) {
-        return false;
+    } // parseStateValues
+
+    bool isAttached(PropertyNode* _node, PropertyNode* _root) {
+      while (_node->getParentNode() != NULL) {
+        _node = _node->getParentNode();
       }
+      return _node == _root;
+    } // isAttached
+  }
+
+  //================================================== SystemCondition
+
+  SystemCondition::SystemCondition(PropertyNodePtr _conditions)
+  : m_Enabled(true),
+    m_HasStates(false),
+    m_HasOrAddonStates(false),
+    m_StateResultTreeGeneration(0),
+    m_StateResultValid(false),
+    m_StateResult(false),
+    m_HasWeekdays(false),
+    m_HasTime(false),
+    m_TimeStart(0),
+    m_TimeEnd(kSecondsPerDay),
+    m_TimeResultYear(-1),
+    m_TimeResultDay(-1),
+    m_TimeResultFrom(0),
+    m_TimeResultTo(0),
+    m_TimeResult(false),
+    m_HasZoneStates(false),
+    m_ZoneStatesBroken(false),
+    m_HasDates(false)
+  {
+    if (_conditions == NULL) {
+      return;
     }
-    return true;
-  } // checkTimeCondition
 
-  bool checkSystemCondition(std::string _path) {
-    PropertyNodePtr oBaseConditionNode =
-        DSS::getInstance()->getPropertySystem().getProperty(
-                _path + "/conditions");
-    if (oBaseConditionNode != NULL) {
-      PropertyNodePtr oEnabledNode = oBaseConditionNode->getPropertyByName("enabled");
-      if (oEnabledNode != NULL) {
-        if (oEnabledNode->getBoolValue() == false) {
-          return false;
+    PropertyNodePtr oEnabledNode = _conditions->getPropertyByName("enabled");
+    if (oEnabledNode != NULL) {
+      m_Enabled = oEnabledNode->getBoolValue();
+    }
+
+    PropertyNodePtr oStateNode = _conditions->getPropertyByName("states");
+    if (oStateNode != NULL) {
+      m_HasStates = true;
+      parseStateValues(oStateNode, m_States);
+      foreach (const StateValues::value_type& state, m_States) {
+        addStateKey(state.first);
+      }
+    }
+
+    PropertyNodePtr oAddonStateNode = _conditions->getPropertyByName("addon-states");
+    if (oAddonStateNode != NULL) {
+      for (int j = 0; j < oAddonStateNode->getChildCount(); j++) {
+        AddonStates addonStates;
+        addonStates.m_AddonID = oAddonStateNode->getChild(j)->getName();
+        parseStateValues(oAddonStateNode->getChild(j), addonStates.m_States);
+        foreach (const StateValues::value_type& state, addonStates.m_States) {
+          addStateKey(addonStates.m_AddonID + "/" + state.first);
         }
+        m_AddonStates.push_back(addonStates);
       }
+    }
 
-      // all system states must match
-      PropertyNodePtr oStateNode = oBaseConditionNode->getPropertyByName("states");
-      PropertyNodePtr oSystemStates =
-          DSS::getInstance()->getPropertySystem().getProperty("/usr/states");
+    PropertyNodePtr oOrAddonStateNode = _conditions->getPropertyByName("or-addon-states");
+    if (oOrAddonStateNode != NULL) {
+      m_HasOrAddonStates = true;
+      for (int j = 0; j < oOrAddonStateNode->getChildCount(); j++) {
+        AddonStates addonStates;
+        addonStates.m_AddonID = oOrAddonStateNode->getChild(j)->getName();
+        parseStateValues(oOrAddonStateNode->getChild(j), addonStates.m_States);
+        foreach (const StateValues::value_type& state, addonStates.m_States) {
+          addStateKey(addonStates.m_AddonID + "/" + state.first);
+        }
+        m_OrAddonStates.push_back(addonStates);
+      }
+    }
 
-      if ((oStateNode != NULL) && (oSystemStates != NULL)) {
+    PropertyNodePtr oZoneNode = _conditions->getPropertyByName("zone-states");
+    if (oZoneNode != NULL) {
+      m_HasZoneStates = true;
+      for (int i = 0; i < oZoneNode->getChildCount(); i++) {
+        PropertyNodePtr testZoneIdNode =
+            oZoneNode->getChild(i)->getPropertyByName("zone");
+        PropertyNodePtr testGroupIdNode =
+            oZoneNode->getChild(i)->getPropertyByName("group");
+        PropertyNodePtr testSceneIdNode =
+            oZoneNode->getChild(i)->getPropertyByName("scene");
+
+        if ((testZoneIdNode == NULL) || (testGroupIdNode == NULL)) {
+          // fails the check unless one of the zone states before matches
+          m_ZoneStatesBroken = true;
+          break;
+        }
+        if (testSceneIdNode != NULL) {
+          m_ZoneStates.push_back(ZoneState(
+              "/apartment/zones/zone" + testZoneIdNode->getAsString() +
+              "/groups/group" + testGroupIdNode->getAsString(),
+              testSceneIdNode->getAsString()));
+        }
+      }
+    }
 
-        for (int j = 0; j < oStateNode->getChildCount(); j++) {
-          bool fFound = false;
-          std::string sName = oStateNode->getChild(j)->getName();
-          std::string sValue = oStateNode->getChild(j)->getAsString();
+    PropertyNodePtr oWeekdayNode = _conditions->getPropertyByName("weekdays");
+    if (oWeekdayNode != NULL) {
+      std::string sWeekdayString = oWeekdayNode->getAsString();
+      if (!sWeekdayString.empty()) {
+        m_HasWeekdays = true;
+        std::vector<std::string> oWeekDayArray = splitString(sWeekdayString, ',');
+        for (size_t i = 0; i < oWeekDayArray.size(); i++) {
+          m_Weekdays.insert(strToIntDef(oWeekDayArray.at(i), -1));
+        }
+      }
+    }
 
-          for (int i = 0; i < oSystemStates->getChildCount(); i++) {
-            PropertyNodePtr nameNode =
-                oSystemStates->getChild(i)->getPropertyByName("name");
-            PropertyNodePtr valueNode =
-                oSystemStates->getChild(i)->getPropertyByName("value");
-            auto stateDescNode = oSystemStates->getChild(i)->getPropertyByName("state");
+    PropertyNodePtr timeStartNode = _conditions->getPropertyByName("time-start");
+    PropertyNodePtr timeEndNode = _conditions->getPropertyByName("time-end");
+    if (timeStartNode != NULL || timeEndNode != NULL) {
+      m_HasTime = true;
+      if (timeStartNode != NULL) {
+        secondsFromHMS(&m_TimeStart, timeStartNode->getAsString());
+      }
+      if (timeEndNode != NULL) {
+        secondsFromHMS(&m_TimeEnd, timeEndNode->getAsString());
+      }
+    }
 
-            if (!nameNode) {
-              Logger::getInstance()->log("checkSystemCondition: missing dedicated node for name of system state: " + oStateNode->getName(), lsWarning);
-              continue;
-            }
+    PropertyNodePtr oDateNode = _conditions->getPropertyByName("date");
+    if (oDateNode != NULL) {
+      m_HasDates = true;
+      for (int i = 0; i < oDateNode->getChildCount(); i++) {
+        PropertyNodePtr dateStartNode = oDateNode->getChild(i)->getPropertyByName("start");
+        PropertyNodePtr dateEndNode = oDateNode->getChild(i)->getPropertyByName("end");
+        PropertyNodePtr dateRruleNode = oDateNode->getChild(i)->getPropertyByName("rrule");
+        if (dateStartNode != NULL && dateEndNode != NULL && dateRruleNode != NULL) {
+          m_Dates.push_back(boost::make_shared<ICalEvent>(dateRruleNode->getAsString(),
+                                                          dateStartNode->getAsString(),
+                                                          dateEndNode->getAsString()));
+        }
+      }
+    }
+  } // ctor
+
+  SystemCondition::~SystemCondition() {
+  } // dtor
+
+  void SystemCondition::addStateKey(const std::string& _key) {
+    boost::mutex::scoped_lock lock(g_GenerationMutex);
+    // nodes of an unordered_map never move, the counters are never erased
+    m_StateGenerations.push_back(&g_StateGenerations[_key]);
+  } // addStateKey
+
+  void SystemCondition::stateChanged(const std::string& _key) {
+    boost::mutex::scoped_lock lock(g_GenerationMutex);
+    std::unordered_map<std::string, unsigned>::iterator it = g_StateGenerations.find(_key);
+    if (it != g_StateGenerations.end()) {
+      it->second++;
+    }
+  } // stateChanged
 
-            if (sName != nameNode->getValue<std::string>()) {
-              continue;
-            }
+  void SystemCondition::statesChanged() {
+    boost::mutex::scoped_lock lock(g_GenerationMutex);
+    g_TreeGeneration++;
+  } // statesChanged
 
-            // state found ...
-            fFound = true;
+  bool SystemCondition::check(PropertySystem& _propSystem) {
+    if (!m_Enabled) {
+      return false;
+    }
 
-            if (!valueNode && !stateDescNode) {
-              Logger::getInstance()->log("checkSystemCondition: missing state value and description can not check state: " + oStateNode->getName(), lsWarning);
-              continue;
-            }
+    boost::mutex::scoped_lock lock(m_Mutex);
+    if (m_HasStates || !m_AddonStates.empty() || m_HasOrAddonStates) {
+      bool valid;
+      {
+        boost::mutex::scoped_lock generationLock(g_GenerationMutex);
+        valid = m_StateResultValid && (m_StateResultTreeGeneration == g_TreeGeneration);
+        for (size_t i = 0; valid && (i < m_StateGenerations.size()); i++) {
+          valid = (*m_StateGenerations[i] == m_StateResultGenerations[i]);
+        }
+        if (!valid) {
+          // changes from now on show up on the next check
+          m_StateResultTreeGeneration = g_TreeGeneration;
+          m_StateResultGenerations.clear();
+          foreach (const unsigned* generation, m_StateGenerations) {
+            m_StateResultGenerations.push_back(*generation);
+          }
+        }
+      }
+      if (!valid) {
+        m_StateResultValid = false;
+        m_StateResult = checkStates(_propSystem);
+        m_StateResultValid = true;
+      }
+      if (!m_StateResult) {
+        return false;
+      }
+    }
 
-            if ((valueNode && (sValue == valueNode->getAsString())) ||
-                (stateDescNode && (sValue == stateDescNode->getValue<std::string>()))) {
-              // continue with outer loop, next filter state
-              break;
-            }
-            std::string value_desc;
-            if (valueNode) {
-              value_desc += "index:" + valueNode->getAsString();
-            }
-            if (stateDescNode) {
-              value_desc += " desc:" + stateDescNode->getValue<std::string>();
-            }
-            Logger::getInstance()->log("checkSystemCondition: match failed for state:" + sName + "/value:" + sValue + " current system state:<" + value_desc + ">", lsDebug);
+    if (m_HasZoneStates && !checkZoneStates(_propSystem)) {
+      return false;
+    }
 
-            return false;
+    if (m_HasWeekdays || m_HasTime) {
+      time_t now = DateTime().secondsSinceEpoch();
+      struct tm tm;
+      localtime_r(&now, &tm);
+      unsigned secNow = (tm.tm_hour * 60 + tm.tm_min) * 60 + tm.tm_sec;
+      if ((tm.tm_year != m_TimeResultYear) || (tm.tm_yday != m_TimeResultDay) ||
+          (secNow < m_TimeResultFrom) || (secNow >= m_TimeResultTo)) {
+        m_TimeResult = checkTime(tm.tm_wday, secNow, m_TimeResultFrom, m_TimeResultTo);
+        m_TimeResultYear = tm.tm_year;
+        m_TimeResultDay = tm.tm_yday;
+      }
+      if (!m_TimeResult) {
+        return false;
+      }
+    }
 
-          } // oSystemStates loop
-          // state was requested as active - but not found in /usr/states
-          if (fFound == false) {
-            Logger::getInstance()->log("checkSystemCondition: " +
-              sName + " requested but not found in system states!", lsError);
-            return false;
+    if (m_HasDates && !checkDates()) {
+      return false;
+    }
+    return true;
+  } // check
+
+  bool SystemCondition::checkStates(PropertySystem& _propSystem) {
+    // all system states must match
+    PropertyNodePtr oSystemStates = _propSystem.getProperty("/usr/states");
+    if (m_HasStates && (oSystemStates != NULL)) {
+      foreach (const StateValues::value_type& state, m_States) {
+        bool fFound = false;
+        const std::string& sName = state.first;
+        const std::string& sValue = state.second;
+
+        for (int i = 0; i < oSystemStates->getChildCount(); i++) {
+          PropertyNodePtr nameNode =
+              oSystemStates->getChild(i)->getPropertyByName("name");
+          PropertyNodePtr valueNode =
+              oSystemStates->getChild(i)->getPropertyByName("value");
+          auto stateDescNode = oSystemStates->getChild(i)->getPropertyByName("state");
+
+          if (!nameNode) {
+            Logger::getInstance()->log("checkSystemCondition: missing dedicated node for name of system state: " + oSystemStates->getChild(i)->getName(), lsWarning);
+            continue;
           }
-        } // oStateNode loop
-      } // nodes NULL check
-
-      PropertyNodePtr oAddonStateNode = oBaseConditionNode->getPropertyByName("addon-states");
-
-      if ((oAddonStateNode != NULL)) {
-        for (int j = 0; j < oAddonStateNode->getChildCount(); j++) {
-          //assuming condi = /addon-states/<scriptID>/myFire=true
-          std::string sAddonID = oAddonStateNode->getChild(j)->getName();
-          PropertyNodePtr oAddonStateSubnode=oAddonStateNode->getChild(j);
-          // searching for a specific addon subpath in /usr/addon-states/<scriptid>
-          PropertyNodePtr oSystemAddonStates =
-              DSS::getInstance()->getPropertySystem().getProperty("/usr/addon-states/" + sAddonID);
-
-          if (oSystemAddonStates != NULL) {
-            for (int k = 0; k < oAddonStateSubnode->getChildCount(); k++) {
-              bool fFound = false;
-              std::string sName = oAddonStateSubnode->getChild(k)->getName();
-              std::string sValue = oAddonStateSubnode->getChild(k)->getAsString();
-              for (int i = 0; i < oSystemAddonStates->getChildCount(); i++) {
-                PropertyNodePtr nameNode =
-                    oSystemAddonStates->getChild(i)->getPropertyByName("name");
-
-                PropertyNodePtr valueNode =
-                    oSystemAddonStates->getChild(i)->getPropertyByName("value");
-
-                if ((nameNode == NULL) || (valueNode == NULL)) {
-                  Logger::getInstance()->log("checkSystemAddonCondition: can not check"
-                          " addon condition, missing name or value node!", lsError);
-                  continue;
-                }
-
-                // search for a requested state
-                if (sName == nameNode->getAsString()) {
-                  fFound = true;
-                  // state found ...
-                  if (sValue != valueNode->getAsString()) {
-                    Logger::getInstance()->log("checkSystemAddonCondition: " +
-                            sName + " failed: value is " + valueNode->getAsString() +
-                            ", requested is " + sValue, lsDebug);
-                    return false;
-                  }
-                  break;
-                }
-              }
-              // state was requested as active - but not found in /usr/states
 
-              if (fFound == false) {
-                Logger::getInstance()->log("checkSystemCondition: " +
-                        sName + " requested but not found in system states!", lsError);
-                return false;
-              }
-            }
-          } else {
-              // addon states for required addon generally not found
-              Logger::getInstance()->log("checkSystemCondition: " +
-                      sAddonID + " addon states for required addon generally not found!", lsError);
-              return false;
+          if (sName != nameNode->getValue<std::string>()) {
+            continue;
           }
-        } // oSystemAddonStates loop
-      } // nodes NULL check
 
-      PropertyNodePtr oOrAddonStateNode = oBaseConditionNode->getPropertyByName("or-addon-states");
+          // state found ...
+          fFound = true;
 
-      if ((oOrAddonStateNode != NULL)) {
-        bool fFound = false;
-        for (int j = 0; !fFound && j < oOrAddonStateNode->getChildCount(); j++) {
-          //assuming condi = /or-addon-states/<scriptID>/myFire=true
-          std::string sAddonID = oOrAddonStateNode->getChild(j)->getName();
-          PropertyNodePtr oOrAddonStateSubnode=oOrAddonStateNode->getChild(j);
-          // searching for a specific addon subpath in /usr/addon-states/<scriptid>
-          PropertyNodePtr oSystemAddonStates =
-              DSS::getInstance()->getPropertySystem().getProperty("/usr/addon-states/" + sAddonID);
-
-          if (oSystemAddonStates != NULL) {
-            for (int k = 0; !fFound && k < oOrAddonStateSubnode->getChildCount(); k++) {
-              std::string sName = oOrAddonStateSubnode->getChild(k)->getName();
-              std::string sValue = oOrAddonStateSubnode->getChild(k)->getAsString();
-              for (int i = 0; !fFound && i < oSystemAddonStates->getChildCount(); i++) {
-                PropertyNodePtr nameNode =
-                    oSystemAddonStates->getChild(i)->getPropertyByName("name");
-
-                PropertyNodePtr valueNode =
-                    oSystemAddonStates->getChild(i)->getPropertyByName("value");
-
-                if ((nameNode == NULL) || (valueNode == NULL)) {
-                  Logger::getInstance()->log("checkSystemAddonCondition: can not check"
-                          " addon condition, missing name or value node!", lsError);
-                  continue;
-                }
-
-                // search for a requested state
-                if (sName == nameNode->getAsString()) {
-                  // state found ...
-                  if (sValue == valueNode->getAsString()) {
-                    fFound = true;
-                  }
-                }
-              }
-            }
+          if (!valueNode && !stateDescNode) {
+            Logger::getInstance()->log("checkSystemCondition: missing state value and description can not check state: " + sName, lsWarning);
+            continue;
           }
-        } // oOrSystemAddonStates loop
 
+          if ((valueNode && (sValue == valueNode->getAsString())) ||
+              (stateDescNode && (sValue == stateDescNode->getValue<std::string>()))) {
+            // continue with outer loop, next filter state
+            break;
+          }
+          std::string value_desc;
+          if (valueNode) {
+            value_desc += "index:" + valueNode->getAsString();
+          }
+          if (stateDescNode) {
+            value_desc += " desc:" + stateDescNode->getValue<std::string>();
+          }
+          Logger::getInstance()->log("checkSystemCondition: match failed for state:" + sName + "/value:" + sValue + " current system state:<" + value_desc + ">", lsDebug);
+
+          return false;
+
+        } // oSystemStates loop
+        // state was requested as active - but not found in /usr/states
         if (fFound == false) {
-          Logger::getInstance()->log("checkSystemCondition: "
-                  "or-addon-states: no states are matching", lsDebug);
+          Logger::getInstance()->log("checkSystemCondition: " +
+            sName + " requested but not found in system states!", lsError);
           return false;
         }
-      } // nodes NULL check
-
-      // at least one of the zone states must match
-      PropertyNodePtr oZoneNode =
-          oBaseConditionNode->getPropertyByName("zone-states");
-      if (oZoneNode != NULL) {
-        bool fMatch = false;
-        for (int i = 0; i < oZoneNode->getChildCount(); i++) {
-          PropertyNodePtr testZoneIdNode =
-              oZoneNode->getChild(i)->getPropertyByName("zone");
-          PropertyNodePtr testGroupIdNode =
-              oZoneNode->getChild(i)->getPropertyByName("group");
-          PropertyNodePtr testSceneIdNode =
-              oZoneNode->getChild(i)->getPropertyByName("scene");
-
-          if ((testZoneIdNode == NULL) || (testGroupIdNode == NULL)) {
-            Logger::getInstance()->log("checkSystemCondition: can not check "
-                "condition, zone or group id node!", lsError);
-            return false;
-          }
+      } // m_States loop
+    }
 
-          if (testSceneIdNode != NULL) {
-            PropertyNodePtr groupNode =
-                DSS::getInstance()->getPropertySystem().getProperty(
-                      "/apartment/zones/zone" +
-                      testZoneIdNode->getAsString() + "/groups/group" +
-                      testGroupIdNode->getAsString());
-
-            if (groupNode != NULL) {
-              PropertyNodePtr lastCalledScene = groupNode->getPropertyByName("lastCalledBasicScene");
-              if (lastCalledScene == NULL) {
-                lastCalledScene = groupNode->getPropertyByName("lastCalledScene");
-              }
+    foreach (const AddonStates& addonStates, m_AddonStates) {
+      // searching for a specific addon subpath in /usr/addon-states/<scriptid>
+      PropertyNodePtr oSystemAddonStates =
+          _propSystem.getProperty("/usr/addon-states/" + addonStates.m_AddonID);
+      if (oSystemAddonStates == NULL) {
+        // addon states for required addon generally not found
+        Logger::getInstance()->log("checkSystemCondition: " +
+                addonStates.m_AddonID + " addon states for required addon generally not found!", lsError);
+        return false;
+      }
 
-              if (lastCalledScene != NULL) {
-                if (lastCalledScene->getAsString() ==
-                        testSceneIdNode->getAsString()) {
-                    fMatch = true;
-                    break;
-                }
-              }
+      foreach (const StateValues::value_type& state, addonStates.m_States) {
+        bool fFound = false;
+        const std::string& sName = state.first;
+        const std::string& sValue = state.second;
+        for (int i = 0; i < oSystemAddonStates->getChildCount(); i++) {
+          PropertyNodePtr nameNode =
+              oSystemAddonStates->getChild(i)->getPropertyByName("name");
+
+          PropertyNodePtr valueNode =
+              oSystemAddonStates->getChild(i)->getPropertyByName("value");
+
+          if ((nameNode == NULL) || (valueNode == NULL)) {
+            Logger::getInstance()->log("checkSystemAddonCondition: can not check"
+                    " addon condition, missing name or value node!", lsError);
+            continue;
+          }
+
+          // search for a requested state
+          if (sName == nameNode->getAsString()) {
+            fFound = true;
+            // state found ...
+            if (sValue != valueNode->getAsString()) {
+              Logger::getInstance()->log("checkSystemAddonCondition: " +
+                      sName + " failed: value is " + valueNode->getAsString() +
+                      ", requested is " + sValue, lsDebug);
+              return false;
             }
-          } // testSceneIdNode != NULL
+            break;
+          }
         }
-        if (!fMatch) {
+        // state was requested as active - but not found in /usr/states
+        if (fFound == false) {
+          Logger::getInstance()->log("checkSystemCondition: " +
+                  sName + " requested but not found in system states!", lsError);
           return false;
         }
-      } // oZoneNode != NULL
-
-      PropertyNodePtr oWeekdayNode =
-          oBaseConditionNode->getPropertyByName("weekdays");
-      if (oWeekdayNode != NULL) {
-        std::string sWeekdayString = oWeekdayNode->getAsString();
-        if (!sWeekdayString.empty()) {
-          DateTime oNow = DateTime();
-          std::vector<std::string> oWeekDayArray =
-              splitString(sWeekdayString, ',');
-          bool fFound = false;
-          for (size_t i = 0; i < oWeekDayArray.size(); i++) {
-            if (strToInt(oWeekDayArray.at(i)) == oNow.getWeekday()) {
-              fFound = true;
-              break;
+      }
+    } // m_AddonStates loop
+
+    if (m_HasOrAddonStates) {
+      bool fFound = false;
+      for (size_t j = 0; !fFound && j < m_OrAddonStates.size(); j++) {
+        const AddonStates& addonStates = m_OrAddonStates[j];
+        // searching for a specific addon subpath in /usr/addon-states/<scriptid>
+        PropertyNodePtr oSystemAddonStates =
+            _propSystem.getProperty("/usr/addon-states/" + addonStates.m_AddonID);
+        if (oSystemAddonStates == NULL) {
+          continue;
+        }
+
+        for (size_t k = 0; !fFound && k < addonStates.m_States.size(); k++) {
+          const std::string& sName = addonStates.m_States[k].first;
+          const std::string& sValue = addonStates.m_States[k].second;
+          for (int i = 0; !fFound && i < oSystemAddonStates->getChildCount(); i++) {
+            PropertyNodePtr nameNode =
+                oSystemAddonStates->getChild(i)->getPropertyByName("name");
+
+            PropertyNodePtr valueNode =
+                oSystemAddonStates->getChild(i)->getPropertyByName("value");
+
+            if ((nameNode == NULL) || (valueNode == NULL)) {
+              Logger::getInstance()->log("checkSystemAddonCondition: can not check"
+                      " addon condition, missing name or value node!", lsError);
+              continue;
+            }
+
+            // search for a requested state
+            if (sName == nameNode->getAsString()) {
+              // state found ...
+              if (sValue == valueNode->getAsString()) {
+                fFound = true;
+              }
             }
           }
-          if (fFound == false) {
-            return false;
+        }
+      } // m_OrAddonStates loop
+
+      if (fFound == false) {
+        Logger::getInstance()->log("checkSystemCondition: "
+                "or-addon-states: no states are matching", lsDebug);
+        return false;
+      }
+    }
+    return true;
+  } // checkStates
+
+  bool SystemCondition::checkZoneStates(PropertySystem& _propSystem) {
+    // at least one of the zone states must match
+    PropertyNodePtr root = _propSystem.getRootNode();
+    foreach (const ZoneState& zoneState, m_ZoneStates) {
+      PropertyNodePtr groupNode = zoneState.m_GroupPath.resolve(*root);
+      if (groupNode == NULL) {
+        continue;
+      }
+      PropertyNodePtr lastCalledScene = groupNode->getPropertyByName("lastCalledBasicScene");
+      if (lastCalledScene == NULL) {
+        lastCalledScene = groupNode->getPropertyByName("lastCalledScene");
+      }
+      if ((lastCalledScene != NULL) &&
+          (lastCalledScene->getAsString() == zoneState.m_Scene)) {
+        return true;
+      }
+    }
+    if (m_ZoneStatesBroken) {
+      Logger::getInstance()->log("checkSystemCondition: can not check "
+          "condition, zone or group id node!", lsError);
+    }
+    return false;
+  } // checkZoneStates
+
+  bool SystemCondition::checkTime(int _weekday, unsigned _secNow,
+                                  unsigned& _validFrom, unsigned& _validTo) {
+    // the result holds until the next start or end of the time window
+    _validFrom = 0;
+    _validTo = kSecondsPerDay;
+
+    if (m_HasWeekdays && (m_Weekdays.find(_weekday) == m_Weekdays.end())) {
+      return false;
+    }
+    if (!m_HasTime) {
+      return true;
+    }
+
+    const unsigned boundaries[] = { m_TimeStart, m_TimeEnd + 1 };
+    foreach (unsigned boundary, boundaries) {
+      if (boundary <= _secNow) {
+        _validFrom = std::max(_validFrom, boundary);
+      } else {
+        _validTo = std::min(_validTo, boundary);
+      }
+    }
+
+    Logger::getInstance()->log("checkTimeCondition: "
+        "start: " + intToString(m_TimeStart) + ", "
+        "end: " + intToString(m_TimeEnd) + ", "
+        "now: " + intToString(_secNow), lsDebug);
+    return isInTimeWindow(m_TimeStart, m_TimeEnd, _secNow);
+  } // checkTime
+
+  bool SystemCondition::checkDates() {
+    DateTime nTime = DateTime();
+    foreach (const boost::shared_ptr<ICalEvent>& date, m_Dates) {
+      if (date->isDateInside(nTime)) {
+        return true;
+      }
+    }
+    return false;
+  } // checkDates
+
+  //================================================== SystemConditionCache
+
+  SystemConditionCache::SystemConditionCache()
+  : m_CompileCount(0),
+    m_UsrNode(NULL)
+  { } // ctor
+
+  SystemConditionCache::~SystemConditionCache() {
+    unsubscribe();
+  } // dtor
+
+  SystemConditionCache& SystemConditionCache::getInstance() {
+    static SystemConditionCache instance;
+    return instance;
+  } // getInstance
+
+  void SystemConditionCache::reset(PropertySystem& _propSystem) {
+    unsubscribe();
+    m_Subscribed.clear();
+    m_Entries.clear();
+
+    m_Root = _propSystem.getRootNode();
+    m_Usr = _propSystem.createProperty("/usr");
+    m_Usr->addListener(this);
+    {
+      boost::mutex::scoped_lock lock(m_StaleMutex);
+      m_UsrNode = m_Usr.get();
+      m_StaleNodes.clear();
+    }
+    // states of the previous tree are gone
+    SystemCondition::statesChanged();
+  } // reset
+
+  bool SystemConditionCache::check(PropertySystem& _propSystem, const std::string& _path) {
+    boost::shared_ptr<SystemCondition> condition;
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+
+      std::set<PropertyNode*> staleNodes;
+      {
+        boost::mutex::scoped_lock staleLock(m_StaleMutex);
+        staleNodes.swap(m_StaleNodes);
+      }
+
+      PropertyNodePtr root = _propSystem.getRootNode();
+      if (m_Root.lock() != root) {
+        reset(_propSystem);
+      } else if (!staleNodes.empty()) {
+        for (Entries::iterator it = m_Entries.begin(); it != m_Entries.end(); ) {
+          if (staleNodes.count(it->second.m_Node.get()) > 0) {
+            m_Entries.erase(it++);
+          } else {
+            ++it;
           }
         }
-      } // oWeekdayNode != NULL
-
-      PropertyNodePtr timeStartNode = oBaseConditionNode->getPropertyByName("time-start");
-      PropertyNodePtr timeEndNode = oBaseConditionNode->getPropertyByName("time-end");
-      if (timeStartNode != NULL || timeEndNode != NULL) {
-        DateTime nTime = DateTime();
-        int secNow = (nTime.getHour() * 60 + nTime.getMinute()) * 60 +
-          nTime.getSecond();
-        if (!checkTimeCondition(timeStartNode, timeEndNode, secNow)) {
-          return false;
+      }
+
+      Entries::iterator it = m_Entries.find(_path);
+      if ((it != m_Entries.end()) && !isAttached(it->second.m_Node.get(), root.get())) {
+        // removed from the tree, possibly replaced by another node
+        if (m_Subscribed.erase(it->second.m_Node.get()) > 0) {
+          it->second.m_Node->removeListener(this);
         }
+        m_Entries.erase(it);
+        it = m_Entries.end();
       }
 
-      PropertyNodePtr oDateNode = oBaseConditionNode->getPropertyByName("date");
-      if (oDateNode != NULL) {
-        bool fMatch = false;
-        for (int i = 0; i < oDateNode->getChildCount(); i++) {
-          PropertyNodePtr dateStartNode = oDateNode->getChild(i)->getPropertyByName("start");
-          PropertyNodePtr dateEndNode = oDateNode->getChild(i)->getPropertyByName("end");
-          PropertyNodePtr dateRruleNode = oDateNode->getChild(i)->getPropertyByName("rrule");
-          if (dateStartNode != NULL && dateEndNode != NULL && dateEndNode != NULL) {
-            DateTime nTime = DateTime();
-            ICalEvent icalEvent(dateRruleNode->getAsString(), dateStartNode->getAsString(), dateEndNode->getAsString());
-            if (icalEvent.isDateInside(nTime)) {
-              fMatch = true;
-              break;
-            }
-          }
+      if (it == m_Entries.end()) {
+        PropertyNodePtr node = _propSystem.getProperty(_path);
+        if (node == NULL) {
+          // not cached, the node might get created later
+          return true;
         }
-        if (!fMatch) {
-          return false;
+        if (m_Subscribed.insert(node.get()).second) {
+          node->addListener(this);
         }
+        Entry entry;
+        entry.m_Node = node;
+        entry.m_Condition =
+          boost::make_shared<SystemCondition>(node->getPropertyByName("conditions"));
+        m_CompileCount++;
+        it = m_Entries.insert(std::make_pair(_path, entry)).first;
       }
+      condition = it->second.m_Condition;
+    }
+    return condition->check(_propSystem);
+  } // check
+
+  int SystemConditionCache::getCompileCount() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_CompileCount;
+  } // getCompileCount
+
+  void SystemConditionCache::invalidate(PropertyNodePtr _caller, PropertyNodePtr _node) {
+    boost::mutex::scoped_lock lock(m_StaleMutex);
+
+    // find the child of the listened to node the change is below, removed
+    // nodes are already detached and end up as NULL
+    PropertyNode* node = _node.get();
+    while ((node != NULL) && (node->getParentNode() != _caller.get())) {
+      node = node->getParentNode();
+    }
 
-    } // (oBaseConditionNode != NULL)
-    return true;
+    if (_caller.get() == m_UsrNode) {
+      if ((node == NULL) || (node->getName() == "states") ||
+          (node->getName() == "addon-states")) {
+        SystemCondition::statesChanged();
+      }
+      return;
+    }
+    if ((node == NULL) || (node->getName() == "conditions")) {
+      m_StaleNodes.insert(_caller.get());
+    }
+  } // invalidate
+
+  void SystemConditionCache::propertyChanged(PropertyNodePtr _caller, PropertyNodePtr _changedNode) {
+    invalidate(_caller, _changedNode);
+  } // propertyChanged
+
+  void SystemConditionCache::propertyRemoved(PropertyNodePtr _parent, PropertyNodePtr _child) {
+    invalidate(_parent, _child);
+  } // propertyRemoved
+
+  void SystemConditionCache::propertyAdded(PropertyNodePtr _parent, PropertyNodePtr _child) {
+    invalidate(_parent, _child);
+  } // propertyAdded
+
+  bool checkSystemCondition(std::string _path) {
+    return SystemConditionCache::getInstance().check(
+        DSS::getInstance()->getPropertySystem(), _path);
   } // checkSystemCondition
 
 }; // namespace
@@ -27,16 +27,151 @@
 #ifndef __SYSTEM_CONDITIONS_H__
 #define __SYSTEM_CONDITIONS_H__
 
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include "dss.h"
 #include "propertysystem.h"
 
 namespace dss {
 
+  class ICalEvent;
+
   bool checkTimeCondition(PropertyNodePtr timeStartNode, PropertyNodePtr timeEndNode,
                           unsigned int secNow);
+  /** Evaluates <_path>/conditions, true if there are none.
+    * Uses the compiled conditions of SystemConditionCache. */
   bool checkSystemCondition(std::string _path);
 
+  /** The conditions of a trigger or user defined action, parsed once.
+   * The result of the states, addon-states and or-addon-states parts is
+   * kept until one of the referenced states changes, the result of the
+   * weekdays and time parts until the next time window boundary passes.
+   * Zone states and dates are looked up on every check. */
+  class SystemCondition : boost::noncopyable {
+  public:
+    /** @_conditions the <path>/conditions node, NULL for none */
+    explicit SystemCondition(PropertyNodePtr _conditions);
+    ~SystemCondition();
+
+    bool check(PropertySystem& _propSystem);
+
+    /** To be called when the value of a State changes, \a _key is the
+      * state name, prefixed with "<service>/" for addon states */
+    static void stateChanged(const std::string& _key);
+    /** To be called when anything below /usr/states or /usr/addon-states
+      * changed, invalidates the state results of all conditions */
+    static void statesChanged();
+  private:
+    typedef std::vector<std::pair<std::string, std::string> > StateValues;
+    struct AddonStates {
+      std::string m_AddonID;
+      StateValues m_States;
+    };
+    struct ZoneState {
+      ZoneState(const std::string& _groupPath, const std::string& _scene)
+      : m_GroupPath(_groupPath), m_Scene(_scene) {}
+      PropertyPath m_GroupPath;
+      std::string m_Scene;
+    };
+
+    bool checkStates(PropertySystem& _propSystem);
+    bool checkTime(int _weekday, unsigned _secNow, unsigned& _validFrom,
+                   unsigned& _validTo);
+    bool checkZoneStates(PropertySystem& _propSystem);
+    bool checkDates();
+
+    void addStateKey(const std::string& _key);
+
+    bool m_Enabled;
+
+    bool m_HasStates;
+    StateValues m_States;
+    std::vector<AddonStates> m_AddonStates;
+    bool m_HasOrAddonStates;
+    std::vector<AddonStates> m_OrAddonStates;
+    /** Change counters of the referenced states, and their value when the
+      * cached result was computed */
+    std::vector<const unsigned*> m_StateGenerations;
+    std::vector<unsigned> m_StateResultGenerations;
+    unsigned m_StateResultTreeGeneration;
+    bool m_StateResultValid;
+    bool m_StateResult;
+
+    bool m_HasWeekdays;
+    std::set<int> m_Weekdays;
+    bool m_HasTime;
+    unsigned m_TimeStart;
+    unsigned m_TimeEnd;
+    /** Day and seconds since midnight the cached time result holds for */
+    int m_TimeResultYear;
+    int m_TimeResultDay;
+    unsigned m_TimeResultFrom;
+    unsigned m_TimeResultTo;
+    bool m_TimeResult;
+
+    bool m_HasZoneStates;
+    bool m_ZoneStatesBroken;
+    std::vector<ZoneState> m_ZoneStates;
+
+    bool m_HasDates;
+    std::vector<boost::shared_ptr<ICalEvent> > m_Dates;
+
+    boost::mutex m_Mutex;
+  }; // SystemCondition
+
+  /** Compiled conditions by path, shared by system triggers and user
+   * defined actions. Changes below <path>/conditions recompile the
+   * condition on its next check, changes below /usr/states and
+   * /usr/addon-states drop the cached state results. */
+  class SystemConditionCache : public PropertyListener, boost::noncopyable {
+  public:
+    SystemConditionCache();
+    virtual ~SystemConditionCache();
+
+    static SystemConditionCache& getInstance();
+
+    bool check(PropertySystem& _propSystem, const std::string& _path);
+
+    /** Number of conditions compiled so far, for testing */
+    int getCompileCount() const;
+  protected:
+    virtual void propertyChanged(PropertyNodePtr _caller, PropertyNodePtr _changedNode);
+    virtual void propertyRemoved(PropertyNodePtr _parent, PropertyNodePtr _child);
+    virtual void propertyAdded(PropertyNodePtr _parent, PropertyNodePtr _child);
+  private:
+    struct Entry {
+      PropertyNodePtr m_Node;
+      boost::shared_ptr<SystemCondition> m_Condition;
+    };
+    typedef std::map<std::string, Entry> Entries;
+
+    void reset(PropertySystem& _propSystem);
+    void invalidate(PropertyNodePtr _caller, PropertyNodePtr _node);
+
+    /** Held while looking up and compiling */
+    mutable boost::mutex m_Mutex;
+    /** Weak, the cache outlives the property system in tests */
+    boost::weak_ptr<PropertyNode> m_Root;
+    PropertyNodePtr m_Usr;
+    Entries m_Entries;
+    std::set<PropertyNode*> m_Subscribed;
+    int m_CompileCount;
+
+    /** Guards what the listener callbacks record, these run on the thread
+      * modifying the tree, possibly while it holds the property lock */
+    boost::mutex m_StaleMutex;
+    PropertyNode* m_UsrNode;
+    std::set<PropertyNode*> m_StaleNodes;
+  }; // SystemConditionCache
+
 };
 
 #endif//__SYSTEM_CONDITIONS_H__
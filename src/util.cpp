@@ -220,14 +220,14 @@ static OutputChannelInfo kOutputChannels[] = {
 
   bool saveValidatedXML(const std::string& _fileName, const std::string& _targetFile) {
     boost::shared_ptr<XMLFileValidator> v = boost::make_shared<XMLFileValidator>();
-    int ret = v->validateFile(_fileName);
+    bool ret = v->validateFile(_fileName);
     if (ret) {
       // move it to the desired location
-      ret = rename(_fileName.c_str(), _targetFile.c_str());
-      if (ret != 0) {
+      if (rename(_fileName.c_str(), _targetFile.c_str()) != 0) {
         Logger::getInstance()->log("Copying to final destination (" +
             _targetFile + ") failed: " +
             std::string(strerror(errno)), lsFatal);
+        ret = false;
       }
     } else {
       Logger::getInstance()->log("XML not saved! Generated file '" +
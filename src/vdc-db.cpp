@@ -20,7 +20,13 @@
 #include "config.h"
 #include "src/vdc-db.h"
 
+#include <cstring>
+#include <list>
+#include <map>
+#include <sys/stat.h>
+
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "src/base.h"
 #include "src/dss.h"
@@ -33,14 +39,208 @@ namespace dss {
 
 __DEFINE_LOG_CHANNEL__(VdcDb, lsInfo);
 
+const size_t VdcDb::kPoolSize;
+const size_t VdcDb::kCacheSize;
+
 // Parallel readers and writers would introduce errors returned by sqlite.
-// It is possible to recover from these errors, but we don't aim for parallelism here.
-// We avoid concurrency errors by locking this static mutex in each VdcDb instance.
-std::mutex VdcDb::s_mutex;
+// It is possible to recover from these errors, but we don't aim for parallelism
+// with writers. Read-only instances share this lock, read-write ones take it
+// exclusively. update() writes a new file and renames it, readers still
+// working on the old one are not affected.
+boost::shared_mutex VdcDb::s_mutex;
+
+struct VdcDb::Connection {
+  Connection(const std::string &path, SQLite3::Mode mode, unsigned generation) :
+      db(path, mode),
+      readOnly(mode == SQLite3::Mode::ReadOnly),
+      generation(generation) {
+  }
+
+  SQLite3 db;
+  bool readOnly;
+  unsigned generation; //< of the cache when opened
+  // declared after db, statements have to be finalized first
+  std::map<std::string, std::unique_ptr<SqlStatement> > statements;
+};
+
+struct VdcDb::Results {
+  boost::optional<std::vector<SpecDesc> > spec;
+  boost::optional<std::vector<StateDesc> > states;
+  boost::optional<std::vector<EventDesc> > events;
+  boost::optional<std::vector<PropertyDesc> > properties;
+  boost::optional<std::vector<SensorDesc> > sensors;
+  boost::optional<std::vector<ActionDesc> > actions;
+  boost::optional<std::vector<StandardActionDesc> > standardActions;
+  boost::optional<bool> actionInterface;
+};
+
+struct VdcDb::Cache {
+  typedef std::pair<std::string, std::string> Key; //< gtin, langCode
+  typedef std::list<std::pair<Key, Results> > Lru;
+
+  Cache() : ino(0), size(0), generation(0) {
+    memset(&mtime, 0, sizeof(mtime));
+  }
+
+  boost::mutex mutex;
+  // the file the pooled connections and the results belong to
+  std::string path;
+  ino_t ino;
+  struct timespec mtime; //< with nanoseconds, rewrites within a second count
+  off_t size;
+  unsigned generation;
+  std::vector<std::unique_ptr<Connection> > idle;
+  Lru results; //< most recently used first
+  std::map<Key, Lru::iterator> index;
+
+  void invalidate() {
+    generation++;
+    idle.clear();
+    results.clear();
+    index.clear();
+  }
+
+  void checkFile(const std::string &filePath) {
+    struct stat st;
+    if (::stat(filePath.c_str(), &st) != 0) {
+      memset(&st, 0, sizeof(st));
+    }
+    if ((filePath != path) || (st.st_ino != ino) ||
+        (st.st_mtim.tv_sec != mtime.tv_sec) ||
+        (st.st_mtim.tv_nsec != mtime.tv_nsec) || (st.st_size != size)) {
+      invalidate();
+      path = filePath;
+      ino = st.st_ino;
+      mtime = st.st_mtim;
+      size = st.st_size;
+    }
+  }
+
+  Results *find(const Key &key, unsigned resultGeneration) {
+    if (resultGeneration != generation) {
+      return NULL;
+    }
+    auto it = index.find(key);
+    if (it == index.end()) {
+      return NULL;
+    }
+    results.splice(results.begin(), results, it->second);
+    return &it->second->second;
+  }
+
+  Results *insert(const Key &key, unsigned resultGeneration) {
+    if (resultGeneration != generation) {
+      // queried from a database that is gone by now
+      return NULL;
+    }
+    if (Results *entry = find(key, resultGeneration)) {
+      return entry;
+    }
+    results.push_front(std::make_pair(key, Results()));
+    index[key] = results.begin();
+    while (results.size() > kCacheSize) {
+      index.erase(results.back().first);
+      results.pop_back();
+    }
+    return &results.front().second;
+  }
+};
+
+VdcDb::Cache& VdcDb::getCache() {
+  static Cache cache;
+  return cache;
+}
+
+VdcDb::VdcDb(DSS &dss, SQLite3::Mode mode) {
+  std::string path = VdcDb::getFilePath(dss);
+  if (mode == SQLite3::Mode::ReadWrite) {
+    m_writeLock = boost::unique_lock<boost::shared_mutex>(s_mutex);
+    m_connection.reset(new Connection(path, mode, 0));
+    return;
+  }
+
+  m_readLock = boost::shared_lock<boost::shared_mutex>(s_mutex);
+  Cache &cache = getCache();
+  unsigned generation;
+  {
+    boost::mutex::scoped_lock lock(cache.mutex);
+    cache.checkFile(path);
+    if (!cache.idle.empty()) {
+      m_connection = std::move(cache.idle.back());
+      cache.idle.pop_back();
+    }
+    generation = cache.generation;
+  }
+  if (!m_connection) {
+    m_connection.reset(new Connection(path, mode, generation));
+  }
+}
+
+VdcDb::~VdcDb() {
+  Cache &cache = getCache();
+  if (!m_connection->readOnly) {
+    m_connection.reset();
+    boost::mutex::scoped_lock lock(cache.mutex);
+    cache.invalidate();
+    return;
+  }
 
-VdcDb::VdcDb(DSS &dss, SQLite3::Mode mode):
-    m_db(VdcDb::getFilePath(dss), mode),
-    m_lock(s_mutex) {
+  // don't keep a read transaction open while idle
+  foreach (auto &statement, m_connection->statements) {
+    sqlite3_reset(*statement.second);
+  }
+  boost::mutex::scoped_lock lock(cache.mutex);
+  if ((m_connection->generation == cache.generation) &&
+      (cache.idle.size() < kPoolSize)) {
+    cache.idle.push_back(std::move(m_connection));
+  }
+}
+
+SQLite3& VdcDb::getDb() {
+  return m_connection->db;
+}
+
+SqlStatement& VdcDb::prepare(const std::string &sql) {
+  std::unique_ptr<SqlStatement> &statement = m_connection->statements[sql];
+  if (!statement) {
+    try {
+      statement.reset(new SqlStatement(m_connection->db, sql));
+    } catch (...) {
+      m_connection->statements.erase(sql);
+      throw;
+    }
+  } else {
+    // a previous user may have left early, its error was reported back then
+    sqlite3_reset(*statement);
+  }
+  return *statement;
+}
+
+template <typename T>
+std::vector<T> VdcDb::cached(const std::string &gtin, const std::string &langCode,
+                             boost::optional<std::vector<T> > Results::*member,
+                             std::vector<T> (VdcDb::*query)(const std::string &, const std::string &)) {
+  if (!m_connection->readOnly) {
+    return (this->*query)(gtin, langCode);
+  }
+
+  Cache &cache = getCache();
+  Cache::Key key(gtin, langCode);
+  {
+    boost::mutex::scoped_lock lock(cache.mutex);
+    Results *results = cache.find(key, m_connection->generation);
+    if (results && (results->*member)) {
+      return *(results->*member);
+    }
+  }
+
+  std::vector<T> result = (this->*query)(gtin, langCode);
+
+  boost::mutex::scoped_lock lock(cache.mutex);
+  if (Results *results = cache.insert(key, m_connection->generation)) {
+    results->*member = result;
+  }
+  return result;
 }
 
 std::string VdcDb::getFilePath(DSS &dss) {
@@ -72,14 +272,21 @@ void VdcDb::recreate(DSS &dss) {
 
 void VdcDb::update(DSS &dss, const std::string &newDb) {
   std::string tmpDb = dss.getDatabaseDirectory() + "/vdc.db.tmp";
-  SQLite3 db3(tmpDb, SQLite3::Mode::ReadWrite);
-  db3.exec(newDb);
+  {
+    SQLite3 db3(tmpDb, SQLite3::Mode::ReadWrite);
+    db3.exec(newDb);
+  }
 
+  Cache &cache = getCache();
+  boost::mutex::scoped_lock lock(cache.mutex);
   int ret = ::rename(tmpDb.c_str(), getFilePath(dss).c_str());
   if (ret != 0) {
     throw std::runtime_error(std::string() + "Database update failed: " +
         std::string(strerror(errno)));
   }
+  // together with the rename, readers of the old file can't store their
+  // results anymore
+  cache.invalidate();
   log(std::string("Database update done"), lsInfo);
 }
 
@@ -113,12 +320,64 @@ std::vector<DeviceStateSpec_t> VdcDb::getStatesLegacy(const std::string &gtin) {
 }
 
 std::vector<VdcDb::SpecDesc> VdcDb::getSpec(const std::string &gtin, const std::string &langCode) {
+  return cached(gtin, langCode, &Results::spec, &VdcDb::querySpec);
+}
+
+std::vector<VdcDb::StateDesc> VdcDb::getStates(const std::string &gtin, const std::string &langCode) {
+  return cached(gtin, langCode, &Results::states, &VdcDb::queryStates);
+}
+
+std::vector<VdcDb::EventDesc> VdcDb::getEvents(const std::string &gtin, const std::string &langCode) {
+  return cached(gtin, langCode, &Results::events, &VdcDb::queryEvents);
+}
+
+std::vector<VdcDb::PropertyDesc> VdcDb::getProperties(const std::string &gtin, const std::string &langCode) {
+  return cached(gtin, langCode, &Results::properties, &VdcDb::queryProperties);
+}
+
+std::vector<VdcDb::SensorDesc> VdcDb::getSensors(const std::string &gtin, const std::string &langCode) {
+  return cached(gtin, langCode, &Results::sensors, &VdcDb::querySensors);
+}
+
+std::vector<VdcDb::ActionDesc> VdcDb::getActions(const std::string &gtin, const std::string &langCode) {
+  return cached(gtin, langCode, &Results::actions, &VdcDb::queryActions);
+}
+
+std::vector<VdcDb::StandardActionDesc> VdcDb::getStandardActions(const std::string &gtin, const std::string &langCode) {
+  return cached(gtin, langCode, &Results::standardActions, &VdcDb::queryStandardActions);
+}
+
+bool VdcDb::hasActionInterface(const std::string &gtin) {
+  if (!m_connection->readOnly) {
+    return queryActionInterface(gtin);
+  }
+
+  Cache &cache = getCache();
+  Cache::Key key(gtin, std::string());
+  {
+    boost::mutex::scoped_lock lock(cache.mutex);
+    Results *results = cache.find(key, m_connection->generation);
+    if (results && results->actionInterface) {
+      return *results->actionInterface;
+    }
+  }
+
+  bool result = queryActionInterface(gtin);
+
+  boost::mutex::scoped_lock lock(cache.mutex);
+  if (Results *results = cache.insert(key, m_connection->generation)) {
+    results->actionInterface = result;
+  }
+  return result;
+}
+
+std::vector<VdcDb::SpecDesc> VdcDb::querySpec(const std::string &gtin, const std::string &langCode) {
   std::string lang, country;
   extractLangAndCountry(langCode, lang, country);
 
   // name, tags, gtin
   std::string sql0("select * from callGetSpecBase where (gtin=? or gtin='')");
-  SqlStatement query0 = m_db.prepare(sql0);
+  SqlStatement &query0 = prepare(sql0);
   SqlStatement::BindScope scope0 = query0.bind(gtin);
 
   std::vector<SpecDesc> specs;
@@ -133,7 +392,7 @@ std::vector<VdcDb::SpecDesc> VdcDb::getSpec(const std::string &gtin, const std::
   // name, title, tags, value, lang_code, gtin
   std::string sql = R"sqlquery(select name, title, tags, value, gtin from callGetSpec "
                                "where (gtin=? or gtin='') and (lang=?) and (country=? or country="ZZ"))sqlquery";
-  SqlStatement query = m_db.prepare(sql);
+  SqlStatement &query = prepare(sql);
   SqlStatement::BindScope scope = query.bind(gtin, lang);
   while (query.step() != SqlStatement::StepResult::DONE) {
     std::string name = query.getColumn<std::string>(0);
@@ -148,13 +407,13 @@ std::vector<VdcDb::SpecDesc> VdcDb::getSpec(const std::string &gtin, const std::
   return specs;
 }
 
-std::vector<VdcDb::StateDesc> VdcDb::getStates(const std::string &gtin, const std::string &langCode) {
+std::vector<VdcDb::StateDesc> VdcDb::queryStates(const std::string &gtin, const std::string &langCode) {
   std::string lang, country;
   extractLangAndCountry(langCode, lang, country);
 
   // name, value, tags, gtin
   std::string sql0("select * from callGetStatesBase where gtin=?");
-  SqlStatement query0 = m_db.prepare(sql0);
+  SqlStatement &query0 = prepare(sql0);
   SqlStatement::BindScope scope0 = query0.bind(gtin);
 
   std::vector<StateDesc> states;
@@ -174,7 +433,7 @@ std::vector<VdcDb::StateDesc> VdcDb::getStates(const std::string &gtin, const st
   // name, name:1, value, name:2, tags, gtin, lang_code
   std::string sql = R"sqlquery(select distinct name,displayName,value,enumName,tags,gtin from callGetStates "
                               "where gtin=? and (lang=?) and (country=? or country="ZZ"))sqlquery";
-  SqlStatement query = m_db.prepare(sql);
+  SqlStatement &query = prepare(sql);
   SqlStatement::BindScope scope = query.bind(gtin, lang, country);
   while (query.step() == SqlStatement::StepResult::ROW) {
     std::string name = query.getColumn<std::string>(0);
@@ -194,13 +453,13 @@ std::vector<VdcDb::StateDesc> VdcDb::getStates(const std::string &gtin, const st
   return states;
 }
 
-std::vector<VdcDb::EventDesc> VdcDb::getEvents(const std::string &gtin, const std::string &langCode) {
+std::vector<VdcDb::EventDesc> VdcDb::queryEvents(const std::string &gtin, const std::string &langCode) {
   std::string lang, country;
   extractLangAndCountry(langCode, lang, country);
 
   // name, gtin
   std::string sql0("select * from callGetEventsBase where gtin=?");
-  SqlStatement query0 = m_db.prepare(sql0);
+  SqlStatement &query0 = prepare(sql0);
   SqlStatement::BindScope scope0 = query0.bind(gtin);
 
   std::vector<EventDesc> events;
@@ -213,7 +472,7 @@ std::vector<VdcDb::EventDesc> VdcDb::getEvents(const std::string &gtin, const st
   // name, displayName, gtin, lang_code
   std::string sql = R"sqlquery(select distinct name,displayName,gtin,lang,country from callGetEvents "
                               "where gtin=? and (lang=?) and (country=? or country="ZZ"))sqlquery";
-  SqlStatement query = m_db.prepare(sql);
+  SqlStatement &query = prepare(sql);
   SqlStatement::BindScope scope = query.bind(gtin, lang, country);
   while (query.step() != SqlStatement::StepResult::DONE) {
     std::string name = query.getColumn<std::string>(0);
@@ -227,13 +486,13 @@ std::vector<VdcDb::EventDesc> VdcDb::getEvents(const std::string &gtin, const st
   return events;
 }
 
-std::vector<VdcDb::PropertyDesc> VdcDb::getProperties(const std::string &gtin, const std::string &langCode) {
+std::vector<VdcDb::PropertyDesc> VdcDb::queryProperties(const std::string &gtin, const std::string &langCode) {
   std::string lang, country;
   extractLangAndCountry(langCode, lang, country);
 
   // name, base_type, default_value, min_value, max_value, resolution, si_unit, tags, gtin, type_name, prop_id, enum_reference
   std::string sql0("select * from callGetPropertiesBase where gtin=?");
-  SqlStatement query0 = m_db.prepare(sql0);
+  SqlStatement &query0 = prepare(sql0);
   SqlStatement::BindScope scope0 = query0.bind(gtin);
 
   std::vector<PropertyDesc> props;
@@ -270,7 +529,7 @@ std::vector<VdcDb::PropertyDesc> VdcDb::getProperties(const std::string &gtin, c
       if ((props.back().typeId == propertyTypeId::enumeration) && (typeId != 0)) {
         std::string sql1 = R"sqlquery(select typeId,enumId,propId,propName,displayName from callGetEnumValues "
             "where typeId=? and (lang=?) and (country=? or country="ZZ"))sqlquery";
-        SqlStatement query1 = m_db.prepare(sql1);
+        SqlStatement &query1 = prepare(sql1);
         SqlStatement::BindScope scope1 = query1.bind(typeId, lang, country);
         while (query1.step() != SqlStatement::StepResult::DONE) {
           auto value = std::make_pair(query1.getColumn<std::string>(3), query1.getColumn<std::string>(4));
@@ -283,7 +542,7 @@ std::vector<VdcDb::PropertyDesc> VdcDb::getProperties(const std::string &gtin, c
   // name, alt_label, base_type, default_value, min_value, max_value, resolution, si_unit, tags, gtin, lang_code
   std::string sql = R"sqlquery(select distinct name, alt_label, base_type, default_value, min_value, max_value, resolution, si_unit from callGetProperties "
                               "where gtin=? and (lang=?) and (country=? or country="ZZ"))sqlquery";
-  SqlStatement query = m_db.prepare(sql);
+  SqlStatement &query = prepare(sql);
   SqlStatement::BindScope scope = query.bind(gtin, lang, country);
   while (query.step() != SqlStatement::StepResult::DONE) {
     std::string name = query.getColumn<std::string>(0);
@@ -297,7 +556,7 @@ std::vector<VdcDb::PropertyDesc> VdcDb::getProperties(const std::string &gtin, c
   return props;
 }
 
-std::vector<VdcDb::SensorDesc> VdcDb::getSensors(const std::string &gtin, const std::string &langCode) {
+std::vector<VdcDb::SensorDesc> VdcDb::querySensors(const std::string &gtin, const std::string &langCode) {
   std::vector<SensorDesc> sensors;
   std::string lang, country;
   extractLangAndCountry(langCode, lang, country);
@@ -305,7 +564,7 @@ std::vector<VdcDb::SensorDesc> VdcDb::getSensors(const std::string &gtin, const
   try {
     // 0 name, 1 base_type, 2 default_value, 3 min_value, 4 max_value, 5 resolution, 6 si_unit, 7 tags, 8 gtin, 9 type_name, 10 sensorIndex
     std::string sql0("select * from callGetSensorsBase where gtin=?");
-    SqlStatement query0 = m_db.prepare(sql0);
+    SqlStatement &query0 = prepare(sql0);
     SqlStatement::BindScope scope0 = query0.bind(gtin);
 
     while (query0.step() != SqlStatement::StepResult::DONE) {
@@ -345,7 +604,7 @@ std::vector<VdcDb::SensorDesc> VdcDb::getSensors(const std::string &gtin, const
   // name, alt_label, base_type, default_value, min_value, max_value, resolution, si_unit, tags, gtin, lang_code
   std::string sql = R"sqlquery(select distinct name, alt_label, base_type from callGetSensors "
                               "where gtin=? and (lang=?) and (country=? or country="ZZ"))sqlquery";
-  SqlStatement query = m_db.prepare(sql);
+  SqlStatement &query = prepare(sql);
   SqlStatement::BindScope scope = query.bind(gtin, lang, country);
   while (query.step() != SqlStatement::StepResult::DONE) {
     std::string name = query.getColumn<std::string>(0);
@@ -359,13 +618,13 @@ std::vector<VdcDb::SensorDesc> VdcDb::getSensors(const std::string &gtin, const
   return sensors;
 }
 
-std::vector<VdcDb::ActionDesc> VdcDb::getActions(const std::string &gtin, const std::string &langCode) {
+std::vector<VdcDb::ActionDesc> VdcDb::queryActions(const std::string &gtin, const std::string &langCode) {
   std::string lang, country;
   extractLangAndCountry(langCode, lang, country);
 
   // command, parameterName, type_id, default_value, min_value, max_value, resolution, si_unit, tags, gtin, name, enum_reference
   std::string sql0("select * from callGetActionsBase where gtin=?");
-  SqlStatement query0 = m_db.prepare(sql0);
+  SqlStatement &query0 = prepare(sql0);
   SqlStatement::BindScope scope0 = query0.bind(gtin);
 
   std::vector<ActionDesc> actions;
@@ -410,7 +669,7 @@ std::vector<VdcDb::ActionDesc> VdcDb::getActions(const std::string &gtin, const
         if ((actions.back().params.back().typeId == propertyTypeId::enumeration) && (typeId != 0)) {
           std::string sql1 = R"sqlquery(select typeId,enumId,propId,propName,displayName from callGetEnumValues "
               "where typeId=? and (lang=?) and (country=? or country="ZZ"))sqlquery";
-          SqlStatement query1 = m_db.prepare(sql1);
+          SqlStatement &query1 = prepare(sql1);
           SqlStatement::BindScope scope1 = query1.bind(typeId, lang, country);
           while (query1.step() != SqlStatement::StepResult::DONE) {
             auto value = std::make_pair(query1.getColumn<std::string>(3), query1.getColumn<std::string>(4));
@@ -424,7 +683,7 @@ std::vector<VdcDb::ActionDesc> VdcDb::getActions(const std::string &gtin, const
   // command, actionName, parameterName, parameterDisplayName, type_id, default_value, min_value, max_value, resolution, si_unit, tags, paramexists, gtin, lang_code
   std::string sql = R"sqlquery(select distinct command, actionName, parameterName, parameterDisplayName, type_id, default_value, min_value, max_value, resolution, si_unit, tags, paramexists from callGetActions "
                               "where gtin=? and (lang=?) and (country=? or country="ZZ"))sqlquery";
-  SqlStatement query = m_db.prepare(sql);
+  SqlStatement &query = prepare(sql);
   SqlStatement::BindScope scope = query.bind(gtin, lang, country);
   while (query.step() != SqlStatement::StepResult::DONE) {
     std::string name = query.getColumn<std::string>(0);
@@ -447,13 +706,13 @@ std::vector<VdcDb::ActionDesc> VdcDb::getActions(const std::string &gtin, const
   return actions;
 }
 
-std::vector<VdcDb::StandardActionDesc> VdcDb::getStandardActions(const std::string &gtin, const std::string &langCode) {
+std::vector<VdcDb::StandardActionDesc> VdcDb::queryStandardActions(const std::string &gtin, const std::string &langCode) {
   std::string lang, country;
   extractLangAndCountry(langCode, lang, country);
 
   // predefName, command, name:1, value, gint
   std::string sql0("select * from callGetStandardActionsBase where gtin=?");
-  SqlStatement query0 = m_db.prepare(sql0);
+  SqlStatement &query0 = prepare(sql0);
   SqlStatement::BindScope scope0 = query0.bind(gtin);
 
   std::vector<StandardActionDesc> desc;
@@ -475,7 +734,7 @@ std::vector<VdcDb::StandardActionDesc> VdcDb::getStandardActions(const std::stri
   // predefName, displayPredefname, command, name:2, value, paramexists, gtin, lang_code
   std::string sql = R"sqlquery(select distinct predefName, displayPredefName, command, paramName,gtin from callGetStandardActions "
                               "where gtin=? and (lang=?) and (country=? or country="ZZ"))sqlquery";
-  SqlStatement query = m_db.prepare(sql);
+  SqlStatement &query = prepare(sql);
   SqlStatement::BindScope scope = query.bind(gtin, lang, country);
   while (query.step() != SqlStatement::StepResult::DONE) {
     std::string name = query.getColumn<std::string>(0);
@@ -489,12 +748,12 @@ std::vector<VdcDb::StandardActionDesc> VdcDb::getStandardActions(const std::stri
   return desc;
 }
 
-bool VdcDb::hasActionInterface(const std::string &gtin) {
+bool VdcDb::queryActionInterface(const std::string &gtin) {
   Logger::getInstance()->log(std::string(__func__) + "check action interface for GTIN " + gtin);
 
   bool result = false;
   std::string sql = "SELECT name FROM device WHERE gtin=?";
-  SqlStatement find = m_db.prepare(sql);
+  SqlStatement &find = prepare(sql);
   SqlStatement::BindScope scope = find.bind(gtin);
 
   while (find.step() == SqlStatement::StepResult::ROW) {
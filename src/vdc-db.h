@@ -22,7 +22,10 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <mutex>
+
+#include <boost/optional.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 #include "logger.h"
 #include "src/businterface.h"
@@ -32,15 +35,26 @@ namespace dss {
 
 class DSS;
 
+/// Read-only instances borrow a connection from a pool shared by all
+/// instances and hand it back when destroyed, together with the prepared
+/// statements it has cached. Query results are kept in a LRU cache keyed by
+/// GTIN and language. update(), recreate() and any read-write instance
+/// drop both the pool and the results, as does replacing the database file.
 class VdcDb {
 public:
+  /// Idle read-only connections kept open for the next VdcDb
+  static const size_t kPoolSize = 4;
+  /// (GTIN, language) pairs whose query results are kept in memory
+  static const size_t kCacheSize = 128;
+
   VdcDb(DSS &dss, SQLite3::Mode mode = SQLite3::Mode::ReadOnly);
+  ~VdcDb();
 
   static std::string getFilePath(DSS &dss);
   static void recreate(DSS &dss);
   static void update(DSS &dss, const std::string &newDb);
 
-  SQLite3& getDb() { return m_db; }
+  SQLite3& getDb();
 
   struct SpecDesc {
     std::string name;
@@ -116,9 +130,33 @@ public:
 
 private:
   __DECL_LOG_CHANNEL__;
-  SQLite3 m_db;
-  static std::mutex s_mutex;
-  std::lock_guard<std::mutex> m_lock;
+  struct Connection;
+  struct Results;
+  struct Cache;
+  static Cache& getCache();
+
+  // Readers share the file, a read-write instance locks out everybody else.
+  static boost::shared_mutex s_mutex;
+  boost::shared_lock<boost::shared_mutex> m_readLock;
+  boost::unique_lock<boost::shared_mutex> m_writeLock;
+  std::unique_ptr<Connection> m_connection;
+
+  /// Cached prepared statement for sql, reset and ready to bind
+  SqlStatement& prepare(const std::string &sql);
+
+  template <typename T>
+  std::vector<T> cached(const std::string &gtin, const std::string &langCode,
+                        boost::optional<std::vector<T> > Results::*member,
+                        std::vector<T> (VdcDb::*query)(const std::string &, const std::string &));
+
+  std::vector<SpecDesc> querySpec(const std::string &gtin, const std::string &langCode);
+  std::vector<StateDesc> queryStates(const std::string &gtin, const std::string &langCode);
+  std::vector<EventDesc> queryEvents(const std::string &gtin, const std::string &langCode);
+  std::vector<PropertyDesc> queryProperties(const std::string &gtin, const std::string &langCode);
+  std::vector<SensorDesc> querySensors(const std::string &gtin, const std::string &langCode);
+  std::vector<ActionDesc> queryActions(const std::string &gtin, const std::string &langCode);
+  std::vector<StandardActionDesc> queryStandardActions(const std::string &gtin, const std::string &langCode);
+  bool queryActionInterface(const std::string &gtin);
 
   void extractLangAndCountry(const std::string &langCode, std::string &lang, std::string &country);
 };
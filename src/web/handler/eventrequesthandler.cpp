@@ -27,6 +27,7 @@
 
 #include "eventrequesthandler.h"
 
+#include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
 
 #include "src/base.h"
@@ -138,18 +139,25 @@ namespace dss {
 
 
   std::string EventRequestHandler::buildEventResponse(boost::shared_ptr<EventSubscriptionSession> _subscriptionSession) {
+    std::vector<boost::shared_ptr<const Event> > events;
+    int missed = _subscriptionSession->popAll(events);
+
     JSONWriter json;
+    if (missed > 0) {
+      // the client fell behind, tell it that events were lost
+      json.add("missedEvents", missed);
+    }
     json.startArray("events");
 
-    while (_subscriptionSession->hasEvent()) {
-      Event evt = _subscriptionSession->popEvent();
+    foreach (const boost::shared_ptr<const Event>& pEvent, events) {
+      const Event& evt = *pEvent;
       json.startObject();
 
       json.add("name", evt.getName());
       json.startObject("properties");
 
-      foreach (auto&& param, evt.getProperties().getContainer()) {
-        json.add(param.first, param.second);
+      foreach (auto&& param, evt.getProperties().getEntries()) {
+        json.add(param.getKey(), param.getValue());
       }
       json.endObject();
 
@@ -237,8 +245,54 @@ namespace dss {
     return json.successJSON();
   } // buildEventResponse
 
+  /** Long-poll on an event subscription, answered by the WebServer's
+    * ParkedRequests once events arrived or the timeout expired. */
+  class DeferredEventResponse : public DeferredResponse {
+  public:
+    DeferredEventResponse(boost::shared_ptr<Session> _session,
+                          boost::shared_ptr<EventSubscriptionSession> _subscriptionSession,
+                          int _timeoutMS,
+                          boost::function<std::string ()> _build)
+    : m_Session(_session),
+      m_SubscriptionSession(_subscriptionSession),
+      m_TimeoutMS(_timeoutMS),
+      m_Build(_build),
+      m_CallbackToken(0)
+    { }
+
+    virtual void start(boost::function<void()> _wakeup) {
+      m_CallbackToken = m_SubscriptionSession->setEventArrivedCallback(_wakeup);
+    }
+
+    virtual bool isReady() {
+      return m_SubscriptionSession->hasEvent();
+    }
+
+    virtual int getTimeoutMS() const {
+      return m_TimeoutMS;
+    }
+
+    virtual std::string finish(bool _aborted) {
+      // another request polling the same subscription may have replaced it
+      m_SubscriptionSession->clearEventArrivedCallback(m_CallbackToken);
+      m_Session->unuse();
+      if (_aborted) {
+        Logger::getInstance()->log("EventRequestHandler::get: connection dropped");
+        return "";
+      }
+      return m_Build();
+    }
+  private:
+    boost::shared_ptr<Session> m_Session;
+    boost::shared_ptr<EventSubscriptionSession> m_SubscriptionSession;
+    int m_TimeoutMS;
+    boost::function<std::string ()> m_Build;
+    unsigned m_CallbackToken;
+  }; // DeferredEventResponse
+
   // sid=SubscriptionID&timeout=0
-  std::string EventRequestHandler::get(const RestfulRequest& _request, boost::shared_ptr<Session> _session) {
+  WebServerResponse EventRequestHandler::get(const RestfulRequest& _request, boost::shared_ptr<Session> _session,
+                                             const struct mg_connection* _connection) {
     std::string tokenStr = _request.getParameter("subscriptionID");
     std::string timeoutStr = _request.getParameter("timeout");
     int timeout = 0;
@@ -266,6 +320,14 @@ namespace dss {
 
     _session->use();
 
+    // with a real connection the request is parked instead of blocking
+    // the worker thread
+    if ((_connection != NULL) && (timeout != -1) && !subscriptionSession->hasEvent()) {
+      return WebServerResponse(boost::make_shared<DeferredEventResponse>(
+          _session, subscriptionSession, timeout,
+          boost::bind(&EventRequestHandler::buildEventResponse, this, subscriptionSession)));
+    }
+
     bool haveEvents = false;
     bool timedOut = false;
     const int kSocketDisconnectTimeoutMS = 200;
@@ -306,7 +368,7 @@ namespace dss {
     } else if (_request.getMethod() == "unsubscribe") {
       return unsubscribe(_request, _session);
     } else if (_request.getMethod() == "get") {
-      return get(_request, _session);
+      return get(_request, _session, _connection);
     }
     throw std::runtime_error("Unhandled function");
   } // handleRequest
@@ -48,7 +48,8 @@ namespace dss {
     std::string raise(const RestfulRequest& _request);
     std::string subscribe(const RestfulRequest& _request, boost::shared_ptr<Session> _session);
     std::string unsubscribe(const RestfulRequest& _request, boost::shared_ptr<Session> _session);
-    std::string get(const RestfulRequest& _request, boost::shared_ptr<Session> _session);
+    WebServerResponse get(const RestfulRequest& _request, boost::shared_ptr<Session> _session,
+                          const struct mg_connection* _connection);
     std::string buildEventResponse(boost::shared_ptr<EventSubscriptionSession> _subscriptionSession);
   }; // StructureRequestHandler
 
@@ -0,0 +1,187 @@
+/*
+    Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+
+    This file is part of digitalSTROM Server.
+
+    digitalSTROM Server is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    digitalSTROM Server is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "parkedrequests.h"
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include "src/foreach.h"
+#include "src/web/webrequests.h"
+
+namespace dss {
+
+  //================================================== ParkedRequests
+
+  ParkedRequests::ParkedRequests(int _sweepIntervalMS)
+  : m_SweepInterval(boost::chrono::milliseconds(_sweepIntervalMS)),
+    m_NextID(0),
+    m_Stopping(false)
+  { } // ctor
+
+  ParkedRequests::~ParkedRequests() {
+    stop();
+  } // dtor
+
+  void ParkedRequests::start() {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    if (m_Thread == NULL) {
+      m_Stopping = false;
+      m_Thread = boost::make_shared<boost::thread>(boost::bind(&ParkedRequests::run, this));
+    }
+  } // start
+
+  void ParkedRequests::stop() {
+    boost::shared_ptr<boost::thread> thread;
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Stopping = true;
+      thread.swap(m_Thread);
+    }
+    m_Condition.notify_all();
+    if (thread != NULL) {
+      thread->join();
+    }
+  } // stop
+
+  void ParkedRequests::park(boost::shared_ptr<DeferredResponse> _response,
+                            ReplyFunction _reply, ConnectedFunction _connected) {
+    Parked parked;
+    parked.m_Response = _response;
+    parked.m_Reply = _reply;
+    parked.m_Connected = _connected;
+    parked.m_WaitForever = (_response->getTimeoutMS() <= 0);
+    parked.m_Deadline = Clock::now() + boost::chrono::milliseconds(_response->getTimeoutMS());
+
+    int id;
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      id = m_NextID++;
+    }
+    // armed before the request is visible to run(), so finish() always
+    // comes after start()
+    _response->start(boost::bind(&ParkedRequests::wakeup, this, id));
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      if (m_Stopping || (m_Thread == NULL)) {
+        lock.unlock();
+        finish(parked, true);
+        return;
+      }
+      m_Parked[id] = parked;
+    }
+    // whatever arrived before the request was parked
+    if (_response->isReady()) {
+      wakeup(id);
+    }
+  } // park
+
+  void ParkedRequests::wakeup(int _id) {
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      if (m_Parked.find(_id) == m_Parked.end()) {
+        return;
+      }
+      m_Ready.insert(_id);
+    }
+    m_Condition.notify_one();
+  } // wakeup
+
+  void ParkedRequests::finish(Parked& _parked, bool _aborted) {
+    std::string response = _parked.m_Response->finish(_aborted);
+    _parked.m_Reply(response, _aborted);
+  } // finish
+
+  void ParkedRequests::run() {
+    typedef std::pair<Parked, bool> Finished;
+    std::vector<Finished> finished;
+    Clock::time_point nextSweep = Clock::now() + m_SweepInterval;
+
+    boost::mutex::scoped_lock lock(m_Mutex);
+    while (!m_Stopping) {
+      if (m_Ready.empty()) {
+        Clock::time_point wakeAt = nextSweep;
+        for (std::map<int, Parked>::const_iterator it = m_Parked.begin(); it != m_Parked.end(); ++it) {
+          if (!it->second.m_WaitForever && (it->second.m_Deadline < wakeAt)) {
+            wakeAt = it->second.m_Deadline;
+          }
+        }
+        m_Condition.wait_until(lock, wakeAt);
+        if (m_Stopping) {
+          break;
+        }
+      }
+
+      Clock::time_point now = Clock::now();
+      bool sweep = (now >= nextSweep);
+      if (sweep) {
+        nextSweep = now + m_SweepInterval;
+      }
+      for (std::map<int, Parked>::iterator it = m_Parked.begin(); it != m_Parked.end(); ) {
+        Parked& parked = it->second;
+        // the sweep also catches wakeups lost to a newer poll on the same source
+        bool done = (m_Ready.count(it->first) > 0) ||
+                    (!parked.m_WaitForever && (now >= parked.m_Deadline)) ||
+                    (sweep && parked.m_Response->isReady());
+        if (done) {
+          finished.push_back(Finished(parked, false));
+          m_Parked.erase(it++);
+        } else if (sweep && !parked.m_Connected()) {
+          finished.push_back(Finished(parked, true));
+          m_Parked.erase(it++);
+        } else {
+          ++it;
+        }
+      }
+      m_Ready.clear();
+
+      if (!finished.empty()) {
+        lock.unlock();
+        foreach (Finished& entry, finished) {
+          finish(entry.first, entry.second);
+        }
+        finished.clear();
+        lock.lock();
+      }
+    }
+
+    for (std::map<int, Parked>::iterator it = m_Parked.begin(); it != m_Parked.end(); ++it) {
+      finished.push_back(Finished(it->second, true));
+    }
+    m_Parked.clear();
+    m_Ready.clear();
+    lock.unlock();
+    foreach (Finished& entry, finished) {
+      finish(entry.first, entry.second);
+    }
+  } // run
+
+  int ParkedRequests::getParkedCount() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Parked.size();
+  } // getParkedCount
+
+} // namespace dss
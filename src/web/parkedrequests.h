@@ -0,0 +1,90 @@
+/*
+    Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+
+    This file is part of digitalSTROM Server.
+
+    digitalSTROM Server is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    digitalSTROM Server is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef PARKEDREQUESTS_H_
+#define PARKEDREQUESTS_H_
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace dss {
+
+  class DeferredResponse;
+
+  /** Holds requests whose response is deferred, e.g. long-polls on
+    * /json/event/get. A single thread answers them once their response is
+    * ready or timed out, and drops them when the client disconnects, so a
+    * waiting client doesn't occupy a web server worker thread. */
+  class ParkedRequests : boost::noncopyable {
+  public:
+    /** Sends the response, or only closes the connection if \a _aborted */
+    typedef boost::function<void (const std::string& _response, bool _aborted)> ReplyFunction;
+    typedef boost::function<bool ()> ConnectedFunction;
+
+    /** \a _sweepIntervalMS is how often disconnected clients are looked for */
+    ParkedRequests(int _sweepIntervalMS);
+    ~ParkedRequests();
+
+    void start();
+    /** Aborts all parked requests and joins the thread */
+    void stop();
+    /** Parks \a _response until it gets ready, \a _reply is always called
+      * exactly once, on the thread of ParkedRequests */
+    void park(boost::shared_ptr<DeferredResponse> _response,
+              ReplyFunction _reply, ConnectedFunction _connected);
+
+    int getParkedCount() const;
+  private:
+    typedef boost::chrono::steady_clock Clock;
+
+    struct Parked {
+      boost::shared_ptr<DeferredResponse> m_Response;
+      ReplyFunction m_Reply;
+      ConnectedFunction m_Connected;
+      bool m_WaitForever;
+      Clock::time_point m_Deadline;
+    }; // Parked
+
+    void wakeup(int _id);
+    void run();
+    static void finish(Parked& _parked, bool _aborted);
+
+    const Clock::duration m_SweepInterval;
+    mutable boost::mutex m_Mutex;
+    boost::condition_variable m_Condition;
+    std::map<int, Parked> m_Parked;
+    std::set<int> m_Ready;
+    int m_NextID;
+    bool m_Stopping;
+    boost::shared_ptr<boost::thread> m_Thread;
+  }; // ParkedRequests
+
+} // namespace dss
+
+#endif /* PARKEDREQUESTS_H_ */
@@ -27,6 +27,7 @@
 
 #include <string>
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
 
 #define RAPIDJSON_HAS_STDSTRING 1
 #include <rapidjson/stringbuffer.h>
@@ -49,11 +50,31 @@ namespace dss {
   class RestfulRequest;
   class Session;
   
+  /** A response that is not known yet when the handler returns, e.g. a
+    * long-poll waiting for events. The WebServer parks the connection
+    * instead of blocking a worker thread and answers it once the response
+    * is ready, timed out or the client went away. */
+  class DeferredResponse {
+  public:
+    virtual ~DeferredResponse() {}
+    /** Arms \a _wakeup, to be called whenever the response might be ready */
+    virtual void start(boost::function<void()> _wakeup) = 0;
+    virtual bool isReady() = 0;
+    /** Maximum time to wait in milliseconds, 0 waits forever */
+    virtual int getTimeoutMS() const = 0;
+    /** Called exactly once, builds the response. If \a _aborted is set the
+      * client is gone and only resources have to be released. */
+    virtual std::string finish(bool _aborted) = 0;
+  }; // DeferredResponse
+
   class WebServerResponse {
   public:
     WebServerResponse(std::string _response)
     : m_response(_response), m_revokeCookie(false)
     { }
+    WebServerResponse(boost::shared_ptr<DeferredResponse> _deferred)
+    : m_revokeCookie(false), m_deferred(_deferred)
+    { }
     std::string getResponse() const {
       return m_response;
     }
@@ -73,10 +94,17 @@ namespace dss {
     const std::string &getNewSessionToken() const {
       return m_newSessionToken;
     }
+    bool isDeferred() const {
+      return m_deferred != NULL;
+    }
+    boost::shared_ptr<DeferredResponse> getDeferred() const {
+      return m_deferred;
+    }
   private:
     std::string m_response;
     std::string m_newSessionToken;
     bool m_revokeCookie;
+    boost::shared_ptr<DeferredResponse> m_deferred;
   };
 
   class JSONWriter {
@@ -27,6 +27,7 @@
 
 #include "webserver.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <sys/types.h>
@@ -35,6 +36,7 @@
 #include <dirent.h>
 #include <string.h>
 
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/tuple/tuple.hpp>
@@ -52,6 +54,7 @@
 
 #include "src/web/restful.h"
 #include "src/web/webrequests.h"
+#include "src/web/websocketclient.h"
 
 #include "src/web/handler/databaserequesthandler.h"
 #include "src/web/handler/systemrequesthandler.h"
@@ -71,6 +74,7 @@
 
 #include "src/model/device.h"
 #include "src/model/apartment.h"
+#include "src/model/modelmaintenance.h"
 
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -144,11 +148,19 @@ namespace dss {
 
   WebServer::WebServer(DSS* _pDSS)
     : Subsystem(_pDSS, "WebServer"), m_mgContext(0),
-      m_TrustedPort(0), m_max_ws_clients(5)
+      m_TrustedPort(0), m_max_ws_clients(5),
+      m_ws_queue_size(WEB_SOCKET_QUEUE_SIZE),
+      m_ws_max_lag_ms(WEB_SOCKET_MAX_LAG_S * 1000),
+      m_ws_next_id(0),
+      m_websocket_filters(boost::make_shared<WebSocketFilterIndex>()),
+      m_parked_requests(boost::make_shared<ParkedRequests>(WEB_PARKED_SWEEP_MS)),
+      m_parked_limit(WEB_PARKED_REQUEST_LIMIT)
   {
   } // ctor
 
   WebServer::~WebServer() {
+    // parked connections have to be closed while the context still exists
+    m_parked_requests->stop();
     if (m_mgContext) {
       mg_stop(m_mgContext);
     }
@@ -164,6 +176,11 @@ namespace dss {
     getDSS().getPropertySystem().setIntValue(getConfigPropertyBasePath() + "announcedport", 8080, true, false);
     getDSS().getPropertySystem().setIntValue(getConfigPropertyBasePath() + "webSocketTimeoutSeconds", WEB_SOCKET_TIMEOUT_S, true, false);
     getDSS().getPropertySystem().setStringValue(getConfigPropertyBasePath() + "files/apartment.xml", getDSS().getDataDirectory() + "apartment.xml", true, false);
+    // apartment.xml alone lags behind the model journal, whoever looks up
+    // the file to serve or back it up gets it brought up to date first
+    m_ApartmentFile = getDSS().getPropertySystem().getStringValue(getConfigPropertyBasePath() + "files/apartment.xml");
+    getDSS().getPropertySystem().getProperty(getConfigPropertyBasePath() + "files/apartment.xml")
+      ->linkToProxy(PropertyProxyMemberFunction<WebServer, std::string>(*this, &WebServer::getApartmentFile));
     getDSS().getPropertySystem().setStringValue(getConfigPropertyBasePath() + "sslcert", getDSS().getPropertySystem().getStringValue("/config/configdirectory") + "dsscert.pem" , true, false);
 
     std::vector<std::string> portList = splitString(DSS::getInstance()->getPropertySystem().getStringValue(getConfigPropertyBasePath() + "listen"), ',', true);
@@ -211,6 +228,17 @@ namespace dss {
 
     int wsTimeout = DSS::getInstance()->getPropertySystem().getIntValue(getConfigPropertyBasePath() + "webSocketTimeoutSeconds");
 
+    getDSS().getPropertySystem().setIntValue(getConfigPropertyBasePath() + "webSocketQueueSize", WEB_SOCKET_QUEUE_SIZE, true, false);
+    getDSS().getPropertySystem().setIntValue(getConfigPropertyBasePath() + "webSocketMaxLagSeconds", WEB_SOCKET_MAX_LAG_S, true, false);
+    m_ws_queue_size = getDSS().getPropertySystem().getIntValue(getConfigPropertyBasePath() + "webSocketQueueSize");
+    m_ws_max_lag_ms = getDSS().getPropertySystem().getIntValue(getConfigPropertyBasePath() + "webSocketMaxLagSeconds") * 1000;
+
+    getDSS().getPropertySystem().setIntValue(getConfigPropertyBasePath() + "parkedRequestLimit", WEB_PARKED_REQUEST_LIMIT, true, false);
+    m_parked_limit = getDSS().getPropertySystem().getIntValue(getConfigPropertyBasePath() + "parkedRequestLimit");
+    getDSS().getPropertySystem().createProperty(getPropertyBasePath() + "parkedRequests")
+      ->linkToProxy(PropertyProxyMemberFunction<ParkedRequests, int>(*m_parked_requests, &ParkedRequests::getParkedCount));
+    m_parked_requests->start();
+
     publishJSLogfiles();
     instantiateHandlers();
 
@@ -234,7 +262,7 @@ namespace dss {
     mg_set_websocket_handler(m_mgContext, "/websocket",
                              &WebSocketConnectCallback,
                              &WebSocketReadyCallback,
-                             NULL,
+                             &WebSocketDataCallback,
                              &WebSocketCloseCallback, NULL);
 
     mg_set_request_handler(m_mgContext, "**", &httpRequestCallback, 0);
@@ -242,6 +270,11 @@ namespace dss {
     log("Webserver started", lsInfo);
   } // initialize
 
+  const std::string& WebServer::getApartmentFile() const {
+    DSS::getInstance()->getModelMaintenance().flushConfiguration();
+    return m_ApartmentFile;
+  } // getApartmentFile
+
   void WebServer::setSessionManager(boost::shared_ptr<SessionManager> _pSessionManager) {
     m_SessionManager = _pSessionManager;
   } // setSessionManager
@@ -388,6 +421,20 @@ namespace dss {
     return header_s.substr(start, end - start);
   }
 
+  static void replyParkedRequest(struct mg_connection* _connection,
+                                 const std::string& _setCookie,
+                                 const std::string& _callback,
+                                 const std::string& _response, bool _aborted) {
+    if (!_aborted) {
+      if (_callback.empty()) {
+        emitHTTPJsonPacket(_connection, 200, _setCookie, _response);
+      } else {
+        emitHTTPJsonPacket(_connection, 200, _setCookie, _callback + "(" + _response + ")");
+      }
+    }
+    mg_close_connection(_connection);
+  } // replyParkedRequest
+
   int WebServer::jsonHandler(struct mg_connection* _connection,
                              RestfulRequest &request,
                              const std::string &trustedSetCookie,
@@ -404,6 +451,21 @@ namespace dss {
         WebServerResponse response =
           m_Handlers[request.getClass()]->jsonHandleRequest(request, _session, _connection);
         std::string callback = request.getParameter("callback");
+        if (response.isDeferred()) {
+          struct mg_connection* detached = NULL;
+          if (m_parked_requests->getParkedCount() < m_parked_limit) {
+            detached = mg_detach_connection(_connection);
+          }
+          if (detached != NULL) {
+            log("JSON request parked: " + request.getUrlPath(), lsDebug);
+            m_parked_requests->park(response.getDeferred(),
+                                    boost::bind(&replyParkedRequest, detached, setCookieHeader, callback, _1, _2),
+                                    boost::bind(&mg_connection_active, detached));
+            return 200;
+          }
+          // no room to park it, answer with what is there right now
+          response = WebServerResponse(response.getDeferred()->finish(false));
+        }
         if (callback.empty()) {
           result = response.getResponse();
         } else {
@@ -815,6 +877,8 @@ namespace dss {
 
     ws->connection = (struct mg_connection *)_connection;
     ws->state = ws_connected;
+    ws->id = m_ws_next_id++;
+    ws->filtered = false;
     mg_set_user_connection_data(_connection, (void *)ws.get());
     m_websockets.push_back(ws);
     mg_unlock_context(ctx);
@@ -822,64 +886,204 @@ namespace dss {
     return 0;
   }
 
+  static int writeWebSocketText(boost::shared_ptr<websocket_target_t> _target, const std::string& _data) {
+    boost::mutex::scoped_lock lock(_target->mutex);
+    if (_target->connection == NULL) {
+      return -1;
+    }
+    return mg_websocket_write(_target->connection, WEBSOCKET_OPCODE_TEXT, _data.c_str(), _data.size());
+  }
+
+  static void closeWebSocket(boost::shared_ptr<websocket_target_t> _target) {
+    boost::mutex::scoped_lock lock(_target->mutex);
+    if (_target->connection != NULL) {
+      mg_websocket_write(_target->connection, WEBSOCKET_OPCODE_CONNECTION_CLOSE, NULL, 0);
+    }
+  }
+
   void WebServer::WebSocketReadyHandler(struct mg_connection* _connection, void* cbdata)
   {
     const char *text = "{ \"ok\": true }";
 
-    websocket_connection_t *client =
+    websocket_connection_t *ws =
         (websocket_connection_t *)mg_get_user_connection_data(_connection);
-    if (client == NULL) {
+    if (ws == NULL) {
       return;
     }
 
     mg_websocket_write(_connection, WEBSOCKET_OPCODE_TEXT, text, strlen(text));
-    client->state = ws_ready;
+
+    // from now on only the client's writer thread talks to the connection
+    boost::shared_ptr<websocket_target_t> target = boost::make_shared<websocket_target_t>();
+    target->connection = _connection;
+    boost::shared_ptr<WebSocketClient> client =
+        boost::make_shared<WebSocketClient>(boost::bind(&writeWebSocketText, target, _1),
+                                            boost::bind(&closeWebSocket, target),
+                                            m_ws_queue_size, m_ws_max_lag_ms);
+    client->publishCounters(getDSS().getPropertySystem().createProperty(
+        getPropertyBasePath() + "websockets/client" + intToString(ws->id)));
+    client->start();
+
+    boost::mutex::scoped_lock lock(m_websocket_mutex);
+    ws->target = target;
+    ws->client = client;
+    ws->state = ws_ready;
+    publishWebSocketFilters();
+  }
+
+  int WebServer::WebSocketDataHandler(struct mg_connection* _connection, int _bits,
+                                      char* _data, size_t _length, void* cbdata)
+  {
+    if ((_bits & 0x0f) != WEBSOCKET_OPCODE_TEXT) {
+      return 1;
+    }
+    websocket_connection_t *ws =
+        (websocket_connection_t *)mg_get_user_connection_data(_connection);
+    if (ws == NULL) {
+      return 1;
+    }
+
+    std::string reply = "{ \"ok\": true }";
+    bool filtered = false;
+    std::vector<WebSocketFilter> filters;
+    try {
+      parseWebSocketFilters(std::string(_data, _length), filtered, filters);
+      boost::mutex::scoped_lock lock(m_websocket_mutex);
+      ws->filtered = filtered;
+      ws->filters.swap(filters);
+      publishWebSocketFilters();
+    } catch (std::runtime_error& e) {
+      log(std::string("Websocket filter request rejected: ") + e.what(), lsInfo);
+      reply = "{ \"ok\": false }";
+    }
+
+    boost::shared_ptr<WebSocketClient> client;
+    {
+      boost::mutex::scoped_lock lock(m_websocket_mutex);
+      client = ws->client;
+    }
+    if (client != NULL) {
+      client->post(boost::make_shared<const std::string>(reply));
+    }
+    return 1;
   }
 
+  void WebServer::publishWebSocketFilters() {
+    boost::shared_ptr<WebSocketFilterIndex> index = boost::make_shared<WebSocketFilterIndex>();
+    foreach (const boost::shared_ptr<websocket_connection_t>& ws, m_websockets) {
+      if (ws->state == ws_ready) {
+        index->addClient(ws->id, ws->filtered, ws->filters);
+      }
+    }
+    boost::atomic_store(&m_websocket_filters, boost::shared_ptr<const WebSocketFilterIndex>(index));
+  } // publishWebSocketFilters
+
+  boost::shared_ptr<const WebSocketFilterIndex> WebServer::getWebSocketFilters() const {
+    return boost::atomic_load(&m_websocket_filters);
+  } // getWebSocketFilters
+
   void WebServer::WebSocketCloseHandler(const struct mg_connection* _connection, void* cbdata)
   {
     struct mg_context *ctx = mg_get_context(_connection);
     websocket_connection_t *client = (websocket_connection_t *)mg_get_user_connection_data(_connection);
 
-    boost::mutex::scoped_lock lock(m_websocket_mutex);
+    boost::shared_ptr<websocket_connection_t> ws;
+    {
+      boost::mutex::scoped_lock lock(m_websocket_mutex);
+
+      std::list<boost::shared_ptr<websocket_connection_t> >::iterator i =
+          m_websockets.begin();
+      while (i != m_websockets.end()) {
+        if ((*i).get() == client) {
+          ws = *i;
+          mg_lock_context(ctx);
+          mg_set_user_connection_data(_connection, NULL);
+          m_websockets.erase(i);
+          mg_unlock_context(ctx);
+          publishWebSocketFilters();
+          break;
+        }
+        i++;
+      }
+    }
 
-    std::list<boost::shared_ptr<websocket_connection_t> >::iterator i =
-        m_websockets.begin();
-    while (i != m_websockets.end()) {
-      if ((*i).get() == client) {
-        mg_lock_context(ctx);
-        mg_set_user_connection_data(_connection, NULL);
-        m_websockets.erase(i);
-        mg_unlock_context(ctx);
-        return;
+    // the connection is gone once we return, the writer must be done with it.
+    // Joining could take as long as the peer doesn't read: let the writer run
+    // out on its own, break off a write in progress and wait just for that
+    if ((ws != NULL) && (ws->client != NULL)) {
+      ws->client->detach();
+      mg_shutdown_connection(_connection);
+      {
+        boost::mutex::scoped_lock lock(ws->target->mutex);
+        ws->target->connection = NULL;
+      }
+      PropertyNodePtr node = getDSS().getPropertySystem().getProperty(
+          getPropertyBasePath() + "websockets/client" + intToString(ws->id));
+      ws->client.reset();
+      if ((node != NULL) && (node->getParentNode() != NULL)) {
+        node->getParentNode()->removeChild(node);
       }
     }
   }
 
-  void WebServer::sendToWebSockets(std::string data)
+  void WebServer::sendToWebSockets(const std::string& data)
   {
     if (data.empty()) {
       return;
     }
 
-    boost::mutex::scoped_lock lock(m_websocket_mutex);
+    // one copy of the payload, shared by all queues
+    boost::shared_ptr<const std::string> message;
 
-    if (m_websockets.empty()) {
-      return;
-    }
+    boost::mutex::scoped_lock lock(m_websocket_mutex);
 
-    mg_lock_context(m_mgContext);
+    bool givenUp = false;
     std::list<boost::shared_ptr<websocket_connection_t> >::iterator i =
                 m_websockets.begin();
     while (i != m_websockets.end()) {
-      boost::shared_ptr<websocket_connection_t> client = *i;
-      if (client->state == ws_ready) {
-        mg_websocket_write(client->connection, WEBSOCKET_OPCODE_TEXT,
-                           data.c_str(), data.size());
+      boost::shared_ptr<websocket_connection_t> ws = *i;
+      if ((ws->state == ws_ready) && (ws->client != NULL)) {
+        if (message == NULL) {
+          message = boost::make_shared<const std::string>(data);
+        }
+        if (!ws->client->post(message)) {
+          log("Websocket client " + intToString(ws->id) + " is too slow, closing connection", lsWarning);
+          ws->state = ws_disconnected;
+          givenUp = true;
+        }
       }
       i++;
     }
-    mg_unlock_context(m_mgContext);
+    if (givenUp) {
+      publishWebSocketFilters();
+    }
+  }
+
+  void WebServer::sendToWebSockets(const std::string& data, const std::vector<int>& _clients)
+  {
+    if (data.empty() || _clients.empty()) {
+      return;
+    }
+
+    boost::shared_ptr<const std::string> message = boost::make_shared<const std::string>(data);
+
+    boost::mutex::scoped_lock lock(m_websocket_mutex);
+
+    bool givenUp = false;
+    foreach (const boost::shared_ptr<websocket_connection_t>& ws, m_websockets) {
+      if ((ws->state != ws_ready) || (ws->client == NULL) ||
+          !std::binary_search(_clients.begin(), _clients.end(), ws->id)) {
+        continue;
+      }
+      if (!ws->client->post(message)) {
+        log("Websocket client " + intToString(ws->id) + " is too slow, closing connection", lsWarning);
+        ws->state = ws_disconnected;
+        givenUp = true;
+      }
+    }
+    if (givenUp) {
+      publishWebSocketFilters();
+    }
   }
 
   int WebServer::WebSocketConnectCallback(const struct mg_connection* _connection,
@@ -901,6 +1105,13 @@ namespace dss {
     self.WebSocketCloseHandler(_connection, cbdata);
   }
 
+  int WebServer::WebSocketDataCallback(struct mg_connection* _connection, int _bits,
+                                       char* _data, size_t _length, void* cbdata)
+  {
+    WebServer& self = DSS::getInstance()->getWebServer();
+    return self.WebSocketDataHandler(_connection, _bits, _data, _length, cbdata);
+  }
+
   size_t WebServer::WebSocketClientCount()
   {
     boost::mutex::scoped_lock lock(m_websocket_mutex);
@@ -31,10 +31,16 @@
 #include <external/civetweb/civetweb.h>
 
 #include "src/subsystem.h"
+#include "src/web/websocketclient.h"
+#include "src/web/parkedrequests.h"
 
 #define WEB_SESSION_TIMEOUT_MINUTES 3
 #define WEB_SESSION_LIMIT 30
 #define WEB_SOCKET_TIMEOUT_S 300 // 5min
+#define WEB_SOCKET_QUEUE_SIZE 256
+#define WEB_SOCKET_MAX_LAG_S 30
+#define WEB_PARKED_REQUEST_LIMIT 500
+#define WEB_PARKED_SWEEP_MS 1000
 namespace dss {
 
   class IDeviceInterface;
@@ -51,9 +57,21 @@ namespace dss {
       ws_ready
   };
 
+  /** The connection as seen by a client's writer, the close handler
+    * takes it away before civetweb reuses it */
+  typedef struct {
+      boost::mutex mutex;
+      struct mg_connection *connection;
+  } websocket_target_t;
+
   typedef struct {
       struct mg_connection *connection;
       uint8_t state;
+      int id;
+      boost::shared_ptr<websocket_target_t> target;
+      boost::shared_ptr<WebSocketClient> client;
+      bool filtered;
+      std::vector<WebSocketFilter> filters;
   } websocket_connection_t;
 
 
@@ -70,13 +88,23 @@ namespace dss {
     boost::shared_ptr<RestfulAPI> m_pAPI;
     boost::shared_ptr<SessionManager> m_SessionManager;
     size_t m_max_ws_clients;
+    size_t m_ws_queue_size;
+    int m_ws_max_lag_ms;
+    int m_ws_next_id;
     std::list<boost::shared_ptr<websocket_connection_t> > m_websockets;
     boost::mutex m_websocket_mutex;
+    boost::shared_ptr<const WebSocketFilterIndex> m_websocket_filters;
+    boost::shared_ptr<ParkedRequests> m_parked_requests;
+    int m_parked_limit;
+    std::string m_ApartmentFile;
 
   private:
     void setupAPI();
     void instantiateHandlers();
     void publishJSLogfiles();
+    const std::string& getApartmentFile() const;
+    /** Rebuilds m_websocket_filters, m_websocket_mutex has to be held */
+    void publishWebSocketFilters();
     static RestfulRequest extractRequest (struct mg_connection* _connection,
                                           std::string _sublevel,
                                           const struct mg_request_info *_info);
@@ -103,6 +131,8 @@ namespace dss {
                               void *cbdata);
     void WebSocketCloseHandler(const struct mg_connection* _connection,
                                        void *cbdata);
+    int WebSocketDataHandler(struct mg_connection* _connection, int _bits,
+                             char* _data, size_t _length, void *cbdata);
 
     static int httpRequestCallback(struct mg_connection* _connection,
                                    void *cbdata);
@@ -112,6 +142,8 @@ namespace dss {
                                      void *cbdata);
     static void WebSocketCloseCallback(const struct mg_connection* _connection,
                                        void *cbdata);
+    static int WebSocketDataCallback(struct mg_connection* _connection, int _bits,
+                                     char* _data, size_t _length, void *cbdata);
 
   protected:
     virtual void doStart();
@@ -121,8 +153,15 @@ namespace dss {
 
     virtual void initialize();
     void setSessionManager(boost::shared_ptr<SessionManager> _pSessionManager);
-    void sendToWebSockets(std::string data);
+    /** Queues \a data for every ready websocket client, returns
+      * without waiting for any of them. */
+    void sendToWebSockets(const std::string& data);
+    /** Like above, but only for the clients in \a _clients (sorted ids
+      * as returned by WebSocketFilterIndex::match) */
+    void sendToWebSockets(const std::string& data, const std::vector<int>& _clients);
     size_t WebSocketClientCount();
+    /** Filters of the ready websocket clients, lock free */
+    boost::shared_ptr<const WebSocketFilterIndex> getWebSocketFilters() const;
   }; // WebServer
 
 }
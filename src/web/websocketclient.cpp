@@ -0,0 +1,345 @@
+/*
+    Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+
+    This file is part of digitalSTROM Server.
+
+    digitalSTROM Server is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    digitalSTROM Server is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "websocketclient.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include <rapidjson/document.h>
+
+#include "src/foreach.h"
+
+namespace dss {
+
+  //================================================== WebSocketClient
+
+  WebSocketClient::WebSocketClient(WriteFunction _write, CloseFunction _close,
+                                   size_t _maxQueued, int _maxLagMS)
+  : m_Write(_write),
+    m_Close(_close),
+    m_MaxQueued(std::max(_maxQueued, (size_t)1)),
+    m_MaxLag(boost::chrono::milliseconds(_maxLagMS)),
+    m_Stopping(false),
+    m_Slow(false),
+    m_Dropped(0),
+    m_Sent(0)
+  { } // ctor
+
+  WebSocketClient::~WebSocketClient() {
+    stop();
+    if (m_pCountersNode != NULL) {
+      m_pCountersNode->unlinkProxy(true);
+    }
+  } // dtor
+
+  void WebSocketClient::start() {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    if (m_Writer == NULL) {
+      m_Stopping = false;
+      m_Writer = boost::make_shared<boost::thread>(boost::bind(&WebSocketClient::writerThread,
+                                                               shared_from_this()));
+    }
+  } // start
+
+  boost::shared_ptr<boost::thread> WebSocketClient::signalStop() {
+    boost::shared_ptr<boost::thread> writer;
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Stopping = true;
+      m_Queue.clear();
+      writer.swap(m_Writer);
+    }
+    m_PendingCondition.notify_all();
+    return writer;
+  } // signalStop
+
+  void WebSocketClient::stop() {
+    boost::shared_ptr<boost::thread> writer = signalStop();
+    if (writer != NULL) {
+      if (writer->get_id() != boost::this_thread::get_id()) {
+        writer->join();
+      } else {
+        writer->detach();
+      }
+    }
+  } // stop
+
+  void WebSocketClient::detach() {
+    boost::shared_ptr<boost::thread> writer = signalStop();
+    if (writer != NULL) {
+      writer->detach();
+    }
+  } // detach
+
+  bool WebSocketClient::post(boost::shared_ptr<const std::string> _message) {
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      if (m_Slow || m_Stopping) {
+        return false;
+      }
+      if (m_Queue.size() >= m_MaxQueued) {
+        m_Queue.pop_front();
+        m_Dropped++;
+      }
+      Pending pending;
+      pending.m_Message = _message;
+      pending.m_Queued = Clock::now();
+      m_Queue.push_back(pending);
+    }
+    m_PendingCondition.notify_one();
+    return true;
+  } // post
+
+  void WebSocketClient::writerThread() {
+    for (;;) {
+      Pending pending;
+      {
+        boost::mutex::scoped_lock lock(m_Mutex);
+        while (m_Queue.empty() && !m_Stopping) {
+          m_PendingCondition.wait(lock);
+        }
+        if (m_Stopping) {
+          break;
+        }
+        pending = m_Queue.front();
+        m_Queue.pop_front();
+      }
+
+      int written = m_Write(*pending.m_Message);
+
+      bool giveUp = false;
+      {
+        boost::mutex::scoped_lock lock(m_Mutex);
+        if (written > 0) {
+          m_Sent++;
+        }
+        if ((written <= 0) || (Clock::now() - pending.m_Queued > m_MaxLag)) {
+          m_Slow = true;
+          m_Dropped += m_Queue.size();
+          m_Queue.clear();
+          giveUp = !m_Stopping;
+        }
+      }
+      if (giveUp) {
+        if (m_Close) {
+          m_Close();
+        }
+        break;
+      }
+    }
+
+    // nobody may be left to join us, the handle would keep the client alive
+    boost::shared_ptr<boost::thread> self;
+    {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      if ((m_Writer != NULL) && (m_Writer->get_id() == boost::this_thread::get_id())) {
+        self.swap(m_Writer);
+      }
+    }
+    if (self != NULL) {
+      self->detach();
+    }
+  } // writerThread
+
+  int WebSocketClient::getQueued() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Queue.size();
+  } // getQueued
+
+  int WebSocketClient::getLagMS() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    if (m_Queue.empty()) {
+      return 0;
+    }
+    return boost::chrono::duration_cast<boost::chrono::milliseconds>(
+        Clock::now() - m_Queue.front().m_Queued).count();
+  } // getLagMS
+
+  int WebSocketClient::getDropped() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Dropped;
+  } // getDropped
+
+  int WebSocketClient::getSent() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Sent;
+  } // getSent
+
+  bool WebSocketClient::isSlow() const {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Slow;
+  } // isSlow
+
+  void WebSocketClient::publishCounters(PropertyNodePtr _node) {
+    if (m_pCountersNode != NULL) {
+      m_pCountersNode->unlinkProxy(true);
+    }
+    m_pCountersNode = _node;
+    m_pCountersNode->createProperty("queued")
+      ->linkToProxy(PropertyProxyMemberFunction<WebSocketClient, int>(*this, &WebSocketClient::getQueued));
+    m_pCountersNode->createProperty("lagMS")
+      ->linkToProxy(PropertyProxyMemberFunction<WebSocketClient, int>(*this, &WebSocketClient::getLagMS));
+    m_pCountersNode->createProperty("dropped")
+      ->linkToProxy(PropertyProxyMemberFunction<WebSocketClient, int>(*this, &WebSocketClient::getDropped));
+    m_pCountersNode->createProperty("sent")
+      ->linkToProxy(PropertyProxyMemberFunction<WebSocketClient, int>(*this, &WebSocketClient::getSent));
+    m_pCountersNode->createProperty("slow")
+      ->linkToProxy(PropertyProxyMemberFunction<WebSocketClient, bool>(*this, &WebSocketClient::isSlow));
+  } // publishCounters
+
+  //================================================== WebSocketFilter
+
+  bool WebSocketFilter::matches(const WebSocketEventSource& _source) const {
+    if ((m_ZoneID != -1) && (m_ZoneID != _source.m_ZoneID)) {
+      return false;
+    }
+    if ((m_GroupID != -1) && (m_GroupID != _source.m_GroupID)) {
+      return false;
+    }
+    if (m_HasDSUID && (!_source.m_HasDSUID || (m_DSUID != _source.m_DSUID))) {
+      return false;
+    }
+    return true;
+  } // matches
+
+  void parseWebSocketFilters(const std::string& _request, bool& _filtered,
+                             std::vector<WebSocketFilter>& _filters) {
+    rapidjson::Document d;
+    d.Parse(_request.c_str());
+    if (d.HasParseError() || !d.IsObject() || !d.HasMember("filter")) {
+      throw std::runtime_error("Expected {\"filter\": [...]}");
+    }
+    const rapidjson::Value& list = d["filter"];
+    _filters.clear();
+    if (list.IsNull()) {
+      _filtered = false;
+      return;
+    }
+    if (!list.IsArray()) {
+      throw std::runtime_error("Parameter 'filter' must be an array or null");
+    }
+    _filtered = true;
+    for (rapidjson::SizeType i = 0; i < list.Size(); ++i) {
+      const rapidjson::Value& item = list[i];
+      if (!item.IsObject()) {
+        throw std::runtime_error("Filter entries must be objects");
+      }
+      WebSocketFilter filter;
+      if (item.HasMember("name")) {
+        if (!item["name"].IsString()) {
+          throw std::runtime_error("Filter 'name' must be a string");
+        }
+        filter.m_EventName = item["name"].GetString();
+      }
+      if (item.HasMember("zoneID")) {
+        if (!item["zoneID"].IsInt()) {
+          throw std::runtime_error("Filter 'zoneID' must be an integer");
+        }
+        filter.m_ZoneID = item["zoneID"].GetInt();
+      }
+      if (item.HasMember("groupID")) {
+        if (!item["groupID"].IsInt()) {
+          throw std::runtime_error("Filter 'groupID' must be an integer");
+        }
+        filter.m_GroupID = item["groupID"].GetInt();
+      }
+      if (item.HasMember("dSUID")) {
+        if (!item["dSUID"].IsString()) {
+          throw std::runtime_error("Filter 'dSUID' must be a string");
+        }
+        filter.m_DSUID = str2dsuid(item["dSUID"].GetString());
+        filter.m_HasDSUID = true;
+      }
+      _filters.push_back(filter);
+    }
+  } // parseWebSocketFilters
+
+  //================================================== WebSocketFilterIndex
+
+  void WebSocketFilterIndex::addClient(int _clientID, bool _filtered,
+                                       const std::vector<WebSocketFilter>& _filters) {
+    if (!_filtered) {
+      m_Unfiltered.push_back(_clientID);
+      return;
+    }
+    foreach (const WebSocketFilter& filter, _filters) {
+      Entry entry;
+      entry.m_ClientID = _clientID;
+      entry.m_Filter = filter;
+      if (filter.m_EventName.empty()) {
+        m_AnyName.push_back(entry);
+      } else {
+        m_ByEventName[filter.m_EventName].push_back(entry);
+      }
+    }
+  } // addClient
+
+  bool WebSocketFilterIndex::wantsEvent(const std::string& _eventName) const {
+    return !m_Unfiltered.empty() || !m_AnyName.empty() ||
+           (m_ByEventName.find(_eventName) != m_ByEventName.end());
+  } // wantsEvent
+
+  bool WebSocketFilterIndex::needsSource(const std::string& _eventName) const {
+    foreach (const Entry& entry, m_AnyName) {
+      if (entry.m_Filter.needsSource()) {
+        return true;
+      }
+    }
+    ByEventName::const_iterator it = m_ByEventName.find(_eventName);
+    if (it != m_ByEventName.end()) {
+      foreach (const Entry& entry, it->second) {
+        if (entry.m_Filter.needsSource()) {
+          return true;
+        }
+      }
+    }
+    return false;
+  } // needsSource
+
+  void WebSocketFilterIndex::match(const std::string& _eventName,
+                                   const WebSocketEventSource& _source,
+                                   std::vector<int>& _clients) const {
+    _clients = m_Unfiltered;
+    foreach (const Entry& entry, m_AnyName) {
+      if (entry.m_Filter.matches(_source)) {
+        _clients.push_back(entry.m_ClientID);
+      }
+    }
+    ByEventName::const_iterator it = m_ByEventName.find(_eventName);
+    if (it != m_ByEventName.end()) {
+      foreach (const Entry& entry, it->second) {
+        if (entry.m_Filter.matches(_source)) {
+          _clients.push_back(entry.m_ClientID);
+        }
+      }
+    }
+    std::sort(_clients.begin(), _clients.end());
+    _clients.erase(std::unique(_clients.begin(), _clients.end()), _clients.end());
+  } // match
+
+} // namespace dss
@@ -0,0 +1,172 @@
+/*
+    Copyright (c) 2016 digitalSTROM AG, Zurich, Switzerland
+
+    This file is part of digitalSTROM Server.
+
+    digitalSTROM Server is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    digitalSTROM Server is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with digitalSTROM Server. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef WEBSOCKETCLIENT_H_
+#define WEBSOCKETCLIENT_H_
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "src/propertysystem.h"
+#include "src/ds485types.h"
+
+namespace dss {
+
+  /** Outbound side of one websocket connection.
+    * Messages are queued by the publisher and written by a thread of the
+    * client's own, so a stalled client only delays itself. The queue is
+    * bounded, the oldest message gets dropped when it overflows. A client
+    * whose messages are older than the allowed lag by the time they get
+    * written is given up and asked to close the connection.
+    * Clients have to be owned by a shared_ptr, the writer keeps its client
+    * alive until it returns. */
+  class WebSocketClient : boost::noncopyable,
+                          public boost::enable_shared_from_this<WebSocketClient> {
+  public:
+    /** Writes one message, returns a value <= 0 on failure */
+    typedef boost::function<int (const std::string&)> WriteFunction;
+    typedef boost::function<void ()> CloseFunction;
+
+    WebSocketClient(WriteFunction _write, CloseFunction _close,
+                    size_t _maxQueued, int _maxLagMS);
+    ~WebSocketClient();
+
+    void start();
+    /** Stops and joins the writer, queued messages are discarded */
+    void stop();
+    /** Like stop(), but doesn't wait for a write in progress to return */
+    void detach();
+    /** Queues \a _message, returns false if the client was given up */
+    bool post(boost::shared_ptr<const std::string> _message);
+
+    int getQueued() const;
+    /** Age of the oldest queued message in milliseconds */
+    int getLagMS() const;
+    int getDropped() const;
+    int getSent() const;
+    bool isSlow() const;
+
+    void publishCounters(PropertyNodePtr _node);
+  private:
+    typedef boost::chrono::steady_clock Clock;
+
+    struct Pending {
+      boost::shared_ptr<const std::string> m_Message;
+      Clock::time_point m_Queued;
+    }; // Pending
+
+    boost::shared_ptr<boost::thread> signalStop();
+    void writerThread();
+
+    WriteFunction m_Write;
+    CloseFunction m_Close;
+    const size_t m_MaxQueued;
+    const Clock::duration m_MaxLag;
+
+    mutable boost::mutex m_Mutex;
+    boost::condition_variable m_PendingCondition;
+    std::deque<Pending> m_Queue;
+    bool m_Stopping;
+    bool m_Slow;
+    int m_Dropped;
+    int m_Sent;
+    boost::shared_ptr<boost::thread> m_Writer;
+    PropertyNodePtr m_pCountersNode;
+  }; // WebSocketClient
+
+  /** Where an event was raised, as far as websocket filters care.
+    * Unknown parts are -1 resp. have m_HasDSUID unset. */
+  struct WebSocketEventSource {
+    int m_ZoneID;
+    int m_GroupID;
+    bool m_HasDSUID;
+    dsuid_t m_DSUID;
+
+    WebSocketEventSource()
+    : m_ZoneID(-1), m_GroupID(-1), m_HasDSUID(false), m_DSUID(DSUID_NULL)
+    { }
+  }; // WebSocketEventSource
+
+  /** One filter registered by a websocket client, empty/-1 fields match
+    * anything. An event is sent if any of the client's filters matches. */
+  struct WebSocketFilter {
+    std::string m_EventName;
+    int m_ZoneID;
+    int m_GroupID;
+    bool m_HasDSUID;
+    dsuid_t m_DSUID;
+
+    WebSocketFilter()
+    : m_ZoneID(-1), m_GroupID(-1), m_HasDSUID(false), m_DSUID(DSUID_NULL)
+    { }
+
+    /** True if the filter looks at more than the event name */
+    bool needsSource() const { return (m_ZoneID != -1) || (m_GroupID != -1) || m_HasDSUID; }
+    bool matches(const WebSocketEventSource& _source) const;
+  }; // WebSocketFilter
+
+  /** Parses a filter request sent by a client:
+    * {"filter": [{"name": "callScene", "zoneID": 1, "groupID": 1, "dSUID": "..."}, ...]}
+    * sets the filters, {"filter": null} removes them again, the client then
+    * receives all events. Throws std::runtime_error on malformed input. */
+  void parseWebSocketFilters(const std::string& _request, bool& _filtered,
+                             std::vector<WebSocketFilter>& _filters);
+
+  /** Immutable view on the filters of all clients, indexed by event name.
+    * Rebuilt whenever a client connects, disconnects or changes its
+    * filters, and published atomically by the WebServer. */
+  class WebSocketFilterIndex {
+  public:
+    /** Adds a client, an unfiltered client receives all events */
+    void addClient(int _clientID, bool _filtered, const std::vector<WebSocketFilter>& _filters);
+
+    /** Cheap check by name only, used before an event gets queued for the websockets */
+    bool wantsEvent(const std::string& _eventName) const;
+    /** True if matching \a _eventName needs its WebSocketEventSource */
+    bool needsSource(const std::string& _eventName) const;
+    /** Collects the ids of the clients to send the event to, sorted */
+    void match(const std::string& _eventName, const WebSocketEventSource& _source,
+               std::vector<int>& _clients) const;
+  private:
+    struct Entry {
+      int m_ClientID;
+      WebSocketFilter m_Filter;
+    }; // Entry
+    typedef std::unordered_map<std::string, std::vector<Entry> > ByEventName;
+
+    std::vector<int> m_Unfiltered;
+    std::vector<Entry> m_AnyName;
+    ByEventName m_ByEventName;
+  }; // WebSocketFilterIndex
+
+} // namespace dss
+
+#endif /* WEBSOCKETCLIENT_H_ */
@@ -195,20 +195,20 @@ void toJson(const boost::shared_ptr<Event> &event, JSONWriter& json) {
     } else if (event->getName() == EventName::HeatingControllerSetup) {
       appendCommon(json, evtGroup_ApartmentAndDevice,
                    evtCategory_HeatingControllerSetup, event.get());
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        json.add(param.first, param.second);
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        json.add(param.getKey(), param.getValue());
       }
     } else if (event->getName() == EventName::HeatingControllerValue) {
       appendCommon(json, evtGroup_ApartmentAndDevice,
                    evtCategory_HeatingControllerValue, event.get());
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        json.add(param.first, param.second);
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        json.add(param.getKey(), param.getValue());
       }
     } else if (event->getName() == EventName::HeatingControllerState) {
       appendCommon(json, evtGroup_ApartmentAndDevice,
                    evtCategory_HeatingControllerState, event.get());
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        json.add(param.first, param.second);
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        json.add(param.getKey(), param.getValue());
       }
     } else if (event->getName() == EventName::HeatingEnabled) {
       appendCommon(json, evtGroup_ApartmentAndDevice,
@@ -224,8 +224,8 @@ void toJson(const boost::shared_ptr<Event> &event, JSONWriter& json) {
       appendCommon(json, evtGroup_Activity, evtCategory_AddonToCloud, event.get());
       json.add("EventName", event->getPropertyByName("EventName"));
       json.startObject("parameter");
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        json.add(param.first, param.second);
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        json.add(param.getKey(), param.getValue());
       }
       json.endObject();
 
@@ -894,11 +894,11 @@ void toJson(const boost::shared_ptr<Event> &event, JSONWriter& json) {
       json.add("ActionId", event->getPropertyByName("actionId"));
       json.add("DeviceID", pDeviceRef->getDSID());
       json.startArray("Parameter");
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        if (beginsWith(param.first, "params.")) {
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        if (beginsWith(param.getKey(), "params.")) {
           json.startObject();
-          json.add("Name", param.first.substr(7));
-          json.add("Value", param.second);
+          json.add("Name", param.getKey().substr(7));
+          json.add("Value", param.getValue());
           json.endObject();
         }
       }
@@ -928,11 +928,11 @@ void toJson(const boost::shared_ptr<Event> &event, JSONWriter& json) {
       json.add("CustomActionTitle", event->getPropertyByName("customActionTitle"));
       json.add("DeviceID", pDeviceRef->getDSID());
       json.startArray("Parameter");
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        if (beginsWith(param.first, "params.")) {
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        if (beginsWith(param.getKey(), "params.")) {
           json.startObject();
-          json.add("Name", param.first.substr(7));
-          json.add("Value", param.second);
+          json.add("Name", param.getKey().substr(7));
+          json.add("Value", param.getValue());
           json.endObject();
         }
       }
@@ -943,22 +943,22 @@ void toJson(const boost::shared_ptr<Event> &event, JSONWriter& json) {
     } else if (event->getName() == EventName::HeatingControllerSetup) {
       createHeader(json, evtGroup_ApartmentAndDevice, evtCategory_HeatingControllerSetup, event.get());
       json.startObject("EventBody");
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        json.add(param.first, param.second);
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        json.add(param.getKey(), param.getValue());
       }
       json.endObject();
     } else if (event->getName() == EventName::HeatingControllerValueDsHub) {
       createHeader(json, evtGroup_ApartmentAndDevice, evtCategory_HeatingControllerValue, event.get());
       json.startObject("EventBody");
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        json.add(param.first, param.second);
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        json.add(param.getKey(), param.getValue());
       }
       json.endObject();
     } else if (event->getName() == EventName::HeatingControllerState) {
       createHeader(json, evtGroup_ApartmentAndDevice, evtCategory_HeatingControllerState, event.get());
       json.startObject("EventBody");
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        json.add(param.first, param.second);
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        json.add(param.getKey(), param.getValue());
       }
       json.endObject();
     } else if (event->getName() == EventName::HeatingEnabled) {
@@ -980,8 +980,8 @@ void toJson(const boost::shared_ptr<Event> &event, JSONWriter& json) {
       json.startObject("EventBody");
       json.add("EventName", event->getPropertyByName("EventName"));
       json.startObject("Parameter");
-      foreach (auto&& param, event->getProperties().getContainer()) {
-        json.add(param.first, param.second);
+      foreach (auto&& param, event->getProperties().getEntries()) {
+        json.add(param.getKey(), param.getValue());
       }
       json.endObject();
       json.endObject();
@@ -25,9 +25,12 @@
 #include <boost/test/unit_test.hpp>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/chrono.hpp>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
+#include "src/foreach.h"
 #include "src/ds485types.h"
 #include "src/model/device.h"
 #include "src/model/apartment.h"
@@ -38,6 +41,8 @@
 #include "src/model/cluster.h"
 #include "src/model/set.h"
 #include "src/model/modelpersistence.h"
+#include "src/model/modeljournal.h"
+#include "src/expatparser.h"
 #include "src/setbuilder.h"
 #include "src/dss.h"
 #include "src/model/modelconst.h"
@@ -335,4 +340,285 @@ BOOST_AUTO_TEST_CASE(testCluster) {
   rmdir(dirname);
 }
 
+BOOST_AUTO_TEST_CASE(testModelJournal) {
+  char *dirname, tmpl[] = "/tmp/dss‐persistence-test_journal_XXXXXX";
+  std::string filename;
+  std::string journal;
+
+  dirname = mkdtemp(tmpl);
+  if (dirname == NULL) {
+    BOOST_TEST_MESSAGE("Failed to create temporary folder\n");
+  }
+  filename = std::string(dirname) + "/journal.xml";
+  journal = ModelJournal::getJournalFileName(filename);
+
+  {
+    Apartment apt1(NULL);
+    boost::shared_ptr<Device> dev1 = apt1.allocateDevice(dsuid1);
+    dev1->setFloor(1);
+    boost::shared_ptr<Device> dev2 = apt1.allocateDevice(dsuid2);
+
+    ModelJournal journal1(apt1, filename, 100);
+    // first write is a full one
+    journal1.write();
+    BOOST_CHECK_EQUAL(journal1.getJournalRecords(), 0);
+    BOOST_CHECK(!boost::filesystem::exists(journal));
+
+    // unchanged model, nothing to append
+    journal1.write();
+    BOOST_CHECK(!boost::filesystem::exists(journal));
+
+    dev1->setFloor(2);
+    apt1.removeDevice(dsuid2);
+    journal1.write();
+    BOOST_CHECK_EQUAL(journal1.getJournalRecords(), 2);
+    BOOST_CHECK(boost::filesystem::exists(journal));
+
+    // the config file itself is untouched until the journal gets compacted
+    Apartment apt2(NULL);
+    ModelPersistence persist2(apt2);
+    persist2.readConfigurationFromXML(filename, "");
+    BOOST_CHECK_EQUAL(apt2.getDeviceByDSID(dsuid1)->getFloor(), 1);
+    BOOST_CHECK_NO_THROW(apt2.getDeviceByDSID(dsuid2));
+  }
+
+  // simulate a crash in the middle of appending a record
+  {
+    std::ofstream ofs(journal.c_str(), std::ios::app);
+    ofs << "+ devices/" << dsuid2str(dsuid2) << " 200 12345\n        <device";
+  }
+
+  BOOST_CHECK(ModelJournal::recover(filename));
+  BOOST_CHECK(!boost::filesystem::exists(journal));
+
+  Apartment apt3(NULL);
+  ModelPersistence persist3(apt3);
+  persist3.readConfigurationFromXML(filename, "");
+  BOOST_CHECK_EQUAL(apt3.getDeviceByDSID(dsuid1)->getFloor(), 2);
+  BOOST_CHECK_THROW(apt3.getDeviceByDSID(dsuid2), ItemNotFoundException);
+
+  unlink(filename.c_str());
+  rmdir(dirname);
+}
+
+BOOST_AUTO_TEST_CASE(testModelJournalCompaction) {
+  char *dirname, tmpl[] = "/tmp/dss‐persistence-test_journal_XXXXXX";
+  std::string filename;
+
+  dirname = mkdtemp(tmpl);
+  if (dirname == NULL) {
+    BOOST_TEST_MESSAGE("Failed to create temporary folder\n");
+  }
+  filename = std::string(dirname) + "/journal.xml";
+
+  Apartment apt1(NULL);
+  boost::shared_ptr<Device> dev1 = apt1.allocateDevice(dsuid1);
+  ModelJournal journal1(apt1, filename, 2);
+  journal1.write();
+
+  dev1->setFloor(1);
+  journal1.write();
+  dev1->setFloor(2);
+  journal1.write();
+  BOOST_CHECK_EQUAL(journal1.getJournalRecords(), 2);
+
+  // exceeds the limit, folded into the config file
+  dev1->setFloor(3);
+  journal1.write();
+  BOOST_CHECK_EQUAL(journal1.getJournalRecords(), 0);
+  BOOST_CHECK(!boost::filesystem::exists(ModelJournal::getJournalFileName(filename)));
+
+  Apartment apt2(NULL);
+  ModelPersistence persist2(apt2);
+  persist2.readConfigurationFromXML(filename, "");
+  BOOST_CHECK_EQUAL(apt2.getDeviceByDSID(dsuid1)->getFloor(), 3);
+
+  unlink(filename.c_str());
+  rmdir(dirname);
+}
+
+BOOST_AUTO_TEST_CASE(testModelJournalCompactionInterval) {
+  char *dirname, tmpl[] = "/tmp/dss‐persistence-test_journal_XXXXXX";
+  std::string filename;
+
+  dirname = mkdtemp(tmpl);
+  if (dirname == NULL) {
+    BOOST_TEST_MESSAGE("Failed to create temporary folder\n");
+  }
+  filename = std::string(dirname) + "/journal.xml";
+
+  Apartment apt1(NULL);
+  boost::shared_ptr<Device> dev1 = apt1.allocateDevice(dsuid1);
+  ModelJournal journal1(apt1, filename, 100, 0);
+  journal1.write();
+  BOOST_CHECK(!journal1.isCompactionDue());
+
+  dev1->setFloor(1);
+  journal1.write();
+  BOOST_CHECK_EQUAL(journal1.getJournalRecords(), 1);
+  BOOST_CHECK(journal1.isCompactionDue());
+
+  // the next write folds the aged journal even without any changes
+  journal1.write();
+  BOOST_CHECK_EQUAL(journal1.getJournalRecords(), 0);
+  BOOST_CHECK(!boost::filesystem::exists(ModelJournal::getJournalFileName(filename)));
+
+  unlink(filename.c_str());
+  rmdir(dirname);
+}
+
+BOOST_AUTO_TEST_CASE(testModelJournalFlush) {
+  char *dirname, tmpl[] = "/tmp/dss‐persistence-test_journal_XXXXXX";
+  std::string filename;
+
+  dirname = mkdtemp(tmpl);
+  if (dirname == NULL) {
+    BOOST_TEST_MESSAGE("Failed to create temporary folder\n");
+  }
+  filename = std::string(dirname) + "/journal.xml";
+
+  Apartment apt1(NULL);
+  boost::shared_ptr<Device> dev1 = apt1.allocateDevice(dsuid1);
+  ModelJournal journal1(apt1, filename, 100);
+  journal1.write();
+
+  dev1->setFloor(1);
+  journal1.write();
+  BOOST_CHECK_EQUAL(journal1.getJournalRecords(), 1);
+
+  // flushing folds what was written, unsaved changes stay out
+  dev1->setFloor(2);
+  journal1.flush();
+  BOOST_CHECK_EQUAL(journal1.getJournalRecords(), 0);
+  BOOST_CHECK(!boost::filesystem::exists(ModelJournal::getJournalFileName(filename)));
+
+  Apartment apt2(NULL);
+  ModelPersistence persist2(apt2);
+  persist2.readConfigurationFromXML(filename, "");
+  BOOST_CHECK_EQUAL(apt2.getDeviceByDSID(dsuid1)->getFloor(), 1);
+
+  // and are journaled on top of the flushed file as usual
+  journal1.write();
+  BOOST_CHECK_EQUAL(journal1.getJournalRecords(), 1);
+
+  unlink(ModelJournal::getJournalFileName(filename).c_str());
+  unlink(filename.c_str());
+  rmdir(dirname);
+}
+
+BOOST_AUTO_TEST_CASE(testModelFragmentsKeepModelOrder) {
+  char *dirname, tmpl[] = "/tmp/dss‐persistence-test_fragments_XXXXXX";
+  std::string filename;
+
+  dirname = mkdtemp(tmpl);
+  if (dirname == NULL) {
+    BOOST_TEST_MESSAGE("Failed to create temporary folder\n");
+  }
+  filename = std::string(dirname) + "/fragments.xml";
+
+  Apartment apt1(NULL);
+  apt1.allocateZone(2);
+  apt1.allocateZone(10);
+  apt1.allocateDevice(dsuid1);
+  apt1.allocateDevice(dsuid2);
+
+  ModelFragments written;
+  ModelPersistence persist1(apt1);
+  persist1.snapshotFragments(written);
+  BOOST_CHECK(ModelPersistence::writeFragmentsToXML(written, filename));
+
+  // sorting the keys would put dsuid2 first and zone 10 before zone 2
+  ModelFragments read;
+  BOOST_CHECK(ModelPersistence::readFragmentsFromXML(filename, read));
+  std::vector<std::string> keys;
+  foreach(const ModelFragments::value_type& fragment, read) {
+    keys.push_back(fragment.first);
+  }
+  std::vector<std::string> expected;
+  foreach(const ModelFragments::value_type& fragment, written) {
+    expected.push_back(fragment.first);
+  }
+  BOOST_CHECK_EQUAL_COLLECTIONS(keys.begin(), keys.end(), expected.begin(), expected.end());
+
+  std::vector<std::string>::iterator zone2 =
+      std::find(keys.begin(), keys.end(), "zones/2");
+  std::vector<std::string>::iterator zone10 =
+      std::find(keys.begin(), keys.end(), "zones/10");
+  BOOST_CHECK(zone2 < zone10);
+  std::vector<std::string>::iterator device2 =
+      std::find(keys.begin(), keys.end(), "devices/" + dsuid2str(dsuid2));
+  std::vector<std::string>::iterator device1 =
+      std::find(keys.begin(), keys.end(), "devices/" + dsuid2str(dsuid1));
+  BOOST_CHECK(device1 < device2);
+
+  unlink(filename.c_str());
+  rmdir(dirname);
+}
+
+BOOST_AUTO_TEST_CASE(testSnapshotStartup) {
+  typedef boost::chrono::steady_clock Clock;
+  const int kDevices = 3000;
+  char *dirname, tmpl[] = "/tmp/dss‐persistence-test_snapshot_XXXXXX";
+
+  dirname = mkdtemp(tmpl);
+  if (dirname == NULL) {
+    BOOST_TEST_MESSAGE("Failed to create temporary folder\n");
+  }
+  std::string filename = std::string(dirname) + "/apartment.xml";
+  std::string snapshots = std::string(dirname) + "/snapshots/";
+
+  {
+    Apartment apt(NULL);
+    for (int i = 0; i < kDevices; i++) {
+      dsuid_t dsuid = DSUID_NULL;
+      dsuid.id[14] = i >> 8;
+      dsuid.id[15] = i & 0xff;
+      boost::shared_ptr<Device> dev = apt.allocateDevice(dsuid);
+      dev->setName("Device " + intToString(i));
+      dev->setFloor(i % 7);
+      dev->setCardinalDirection(cd_west);
+    }
+    ModelPersistence persist(apt);
+    persist.writeConfigurationToXML(filename);
+  }
+
+  Clock::time_point start = Clock::now();
+  Apartment aptXML(NULL);
+  ModelPersistence persistXML(aptXML);
+  persistXML.readConfigurationFromXML(filename, "");
+  Clock::duration xmlTime = Clock::now() - start;
+
+  // first load with snapshots enabled records one
+  ExpatParser::setSnapshotDirectory(snapshots);
+  {
+    Apartment aptRecord(NULL);
+    ModelPersistence persistRecord(aptRecord);
+    persistRecord.readConfigurationFromXML(filename, "");
+  }
+  BOOST_CHECK(boost::filesystem::exists(ExpatParser::getSnapshotFileName(filename)));
+
+  start = Clock::now();
+  Apartment aptSnapshot(NULL);
+  ModelPersistence persistSnapshot(aptSnapshot);
+  persistSnapshot.readConfigurationFromXML(filename, "");
+  Clock::duration snapshotTime = Clock::now() - start;
+  ExpatParser::setSnapshotDirectory("");
+
+  BOOST_TEST_MESSAGE("loading " << kDevices << " devices, xml: " <<
+      boost::chrono::duration_cast<boost::chrono::milliseconds>(xmlTime).count() <<
+      "ms, snapshot: " <<
+      boost::chrono::duration_cast<boost::chrono::milliseconds>(snapshotTime).count() << "ms");
+
+  BOOST_CHECK_EQUAL(aptSnapshot.getDevicesVector().size(), aptXML.getDevicesVector().size());
+  BOOST_CHECK_EQUAL(aptSnapshot.getDevicesVector().size(), kDevices);
+  foreach(boost::shared_ptr<Device> dev, aptXML.getDevicesVector()) {
+    boost::shared_ptr<Device> other = aptSnapshot.getDeviceByDSID(dev->getDSID());
+    BOOST_CHECK_EQUAL(other->getName(), dev->getName());
+    BOOST_CHECK_EQUAL(other->getFloor(), dev->getFloor());
+    BOOST_CHECK_EQUAL(other->getCardinalDirection(), dev->getCardinalDirection());
+  }
+
+  boost::filesystem::remove_all(dirname);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
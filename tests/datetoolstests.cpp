@@ -139,6 +139,16 @@ BOOST_AUTO_TEST_CASE(testDifference) {
   BOOST_CHECK(dt.difference(dt2) == 2);
 }
 
+BOOST_AUTO_TEST_CASE(testDifferenceMS) {
+  DateTime dt(1000, 900000);
+
+  DateTime dt2 = dt.addMilliSeconds(250);
+  BOOST_CHECK_EQUAL(dt2.differenceMS(dt), 250);
+  BOOST_CHECK_EQUAL(dt.differenceMS(dt2), -250);
+  dt2 = dt.addSeconds(2);
+  BOOST_CHECK_EQUAL(dt2.differenceMS(dt), 2000);
+}
+
 BOOST_AUTO_TEST_CASE(testRFC2445) {
   DateTime dt = DateTime::parseRFC2445("20080506T080102");
   BOOST_CHECK_EQUAL(2008, dt.getYear());
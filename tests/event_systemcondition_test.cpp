@@ -24,14 +24,17 @@
 
 #include <boost/test/unit_test.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
 
 #include "config.h"
 
+#include "src/base.h"
 #include "src/dss.h"
 #include "src/event.h"
 #include "src/propertysystem.h"
 #include "src/property-parser.h"
 #include "src/systemcondition.h"
+#include "src/model/state.h"
 
 #include "tests/util/dss_instance_fixture.h"
 
@@ -147,4 +150,68 @@ R"xml(<?xml version="1.0" encoding="utf-8"?>
   BOOST_CHECK(!checkSystemCondition("/test"));
 }
 
+BOOST_FIXTURE_TEST_CASE(testCompiledConditionFollowsChanges, DSSInstanceFixture) {
+    const char xml[] =
+R"xml(<?xml version="1.0" encoding="utf-8"?>
+<properties version="1">
+  <property name="test">
+    <property name="conditions">
+      <property name="states">
+        <property type="string" name="state0">
+          <value>1</value>
+        </property>
+      </property>
+    </property>
+  </property>
+  <property name="usr">
+    <property name="states">
+      <property type="string" name="state0">
+        <property type="string" name="name">
+          <value>state0</value>
+        </property>
+        <property type="integer" name="value">
+          <value>1</value>
+        </property>
+      </property>
+    </property>
+  </property>
+</properties>)xml";
+
+  initPropertyTree(xml);
+  SystemConditionCache& cache = SystemConditionCache::getInstance();
+  BOOST_CHECK(checkSystemCondition("/test"));
+  int compiled = cache.getCompileCount();
+
+  // data next to the conditions doesn't matter
+  PropertySystem &ps = DSS::getInstance()->getPropertySystem();
+  ps.setIntValue("/test/lastExecuted", 1);
+  BOOST_CHECK(checkSystemCondition("/test"));
+  BOOST_CHECK_EQUAL(cache.getCompileCount(), compiled);
+
+  // state changes don't recompile
+  ps.setIntValue("/usr/states/state0/value", 2);
+  BOOST_CHECK(!checkSystemCondition("/test"));
+  BOOST_CHECK_EQUAL(cache.getCompileCount(), compiled);
+
+  ps.setStringValue("/test/conditions/states/state0", "2");
+  BOOST_CHECK(checkSystemCondition("/test"));
+  BOOST_CHECK_EQUAL(cache.getCompileCount(), compiled + 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(testConditionOnStateObject, DSSInstanceFixture) {
+  boost::shared_ptr<State> state = boost::make_shared<State>("condition-state");
+  state->setState(coTest, State_Active);
+
+  PropertySystem &ps = DSS::getInstance()->getPropertySystem();
+  ps.createProperty("/test/conditions/states/condition-state")
+    ->setStringValue(intToString(State_Active));
+  BOOST_CHECK(checkSystemCondition("/test"));
+
+  // the value node is a proxy, the state has to tell about changes itself
+  state->setState(coTest, State_Inactive);
+  BOOST_CHECK(!checkSystemCondition("/test"));
+  state->setState(coTest, State_Active);
+  BOOST_CHECK(checkSystemCondition("/test"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -24,6 +24,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/bind.hpp>
+#include <boost/chrono.hpp>
 
 #include <iostream>
 
@@ -41,6 +42,7 @@
 #include "src/model/zone.h"
 #include "src/model/group.h"
 #include "src/model/set.h"
+#include "src/handler/system_trigger_index.h"
 #include "src/handler/system_triggers.h"
 #include "src/dss.h"
 #include "src/eventinterpretersystemplugins.h"
@@ -87,8 +89,20 @@ BOOST_FIXTURE_TEST_CASE(testSpeed, DSSInstanceFixture) {
     trigger->run();
     BOOST_CHECK(DSS::getInstance()->getEventQueue().popEvent().get());
   }
-}
 
+  // a scene no trigger waits for, the common case
+  pEvent->setProperty("sceneID", intToString(40));
+  auto idle = boost::make_shared<SystemTrigger>(*pEvent);
+  const int kRuns = 1000;
+  boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+  for (int i = 0; i < kRuns; ++i) {
+    idle->run();
+  }
+  boost::chrono::duration<double> elapsed = boost::chrono::steady_clock::now() - start;
+  BOOST_CHECK(DSS::getInstance()->getEventQueue().popEvent() == NULL);
+  BOOST_TEST_MESSAGE("speed_triggers.xml: " << elapsed.count() * 1e6 / kRuns <<
+                     "us per non-matching event");
+}
 
 // taken from webservice_api_tests
 boost::shared_ptr<Group> createGroup(int id) {
@@ -303,4 +317,61 @@ BOOST_FIXTURE_TEST_CASE(testActionReschedule, DSSInstanceFixture) {
   BOOST_CHECK(expiredTs != DateTime::parseISO8601(lagNode->getProperty(ptn_action_ts)->getStringValue()));
 }
 
+BOOST_FIXTURE_TEST_CASE(testTriggerIndexFollowsChanges, DSSInstanceFixture) {
+  PropertyParser parser;
+  PropertySystem &propSystem = DSS::getInstance()->getPropertySystem();
+
+  parser.loadFromXML(TEST_STATIC_DATADIR + "/rate_triggers.xml", propSystem.createProperty("/"));
+
+  std::string triggerPath("/scripts/foo/entries/0");
+  PropertyNodePtr sceneNode = propSystem.getProperty(triggerPath + "/triggers/0/scene");
+  PropertyNodePtr dampNode = propSystem.getProperty(triggerPath + "/" + ptn_damping);
+  BOOST_CHECK(sceneNode);
+  BOOST_CHECK(dampNode);
+  // no rate limit
+  dampNode->getProperty(ptn_damp_interval)->setIntegerValue(0);
+
+  boost::shared_ptr<Event> pEvent;
+  pEvent = createGroupCallSceneEvent(createGroup(1), 1, 0, 1,
+                                     callOrigin_t(2), dsuid_t(),
+                                     "fake-token", false);
+
+  SystemTrigger trigger(*pEvent);
+  EventQueue &queue(DSS::getInstance()->getEventQueue());
+  trigger.run();
+  BOOST_CHECK(queue.popEvent() != NULL);
+
+  // the runtime data written by damping keeps the compiled trigger
+  SystemTriggerIndex &index(SystemTriggerIndex::getInstance());
+  int compiled = index.getCompileCount();
+  trigger.run();
+  BOOST_CHECK(queue.popEvent() != NULL);
+  BOOST_CHECK_EQUAL(index.getCompileCount(), compiled);
+
+  // changed condition
+  sceneNode->setIntegerValue(2);
+  trigger.run();
+  BOOST_CHECK(queue.popEvent() == NULL);
+  BOOST_CHECK_EQUAL(index.getCompileCount(), compiled + 1);
+
+  sceneNode->setIntegerValue(1);
+  trigger.run();
+  BOOST_CHECK(queue.popEvent() != NULL);
+
+  // trigger pointing to a node created later
+  PropertyNodePtr triggerNode(propSystem.getProperty("/usr/triggers/0"));
+  triggerNode->getProperty("triggerPath")->setStringValue("/usr/events/later");
+  trigger.run();
+  BOOST_CHECK(queue.popEvent() == NULL);
+
+  PropertyNodePtr condition = propSystem.createProperty("/usr/events/later/triggers/0");
+  condition->createProperty(ptn_type)->setStringValue("zone-scene");
+  condition->createProperty("zone")->setIntegerValue(0);
+  condition->createProperty("group")->setIntegerValue(1);
+  condition->createProperty("scene")->setIntegerValue(1);
+  trigger.run();
+  BOOST_CHECK(queue.popEvent() != NULL);
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -26,12 +26,17 @@
 #include <boost/filesystem.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <iostream>
 
 #include "config.h"
 
 #include "src/event.h"
+#include "src/event/event_create.h"
+#include "src/event/event_fields.h"
 #include "src/subscription.h"
 #include "src/eventinterpreterplugins.h"
 #include "src/internaleventrelaytarget.h"
@@ -120,6 +125,51 @@ BOOST_FIXTURE_TEST_CASE(testScheduledEvent, NonRunningFixture) {
   BOOST_CHECK_EQUAL(m_pEventInterpreter->getEventsProcessed(), old);
 }
 
+BOOST_AUTO_TEST_CASE(testRunnerComputesMonitorLazily) {
+  PropertySystem propSys;
+  PropertyNodePtr monitor = propSys.createProperty("/ScheduledEvents");
+  EventInterpreter interpreter(NULL);
+  EventQueue queue(&interpreter);
+  EventRunner runner(&interpreter, monitor);
+  interpreter.initialize();
+  queue.setEventRunner(&runner);
+  runner.setEventQueue(&queue);
+
+  boost::shared_ptr<Event> pEvent = boost::make_shared<Event>("my_event");
+  pEvent->setProperty(EventProperty::Time, "+5");
+  std::string id = queue.pushTimedEvent(pEvent);
+  BOOST_REQUIRE(!id.empty());
+
+  // not due yet, only the deadline gets evaluated
+  BOOST_CHECK_EQUAL(runner.raisePendingEvents(), false);
+  BOOST_CHECK(queue.popEvent() == NULL);
+  BOOST_CHECK_EQUAL(runner.getSize(), 1);
+
+  PropertyNodePtr eventNode = monitor->getProperty(id);
+  BOOST_REQUIRE(eventNode != NULL);
+  int ticks = eventNode->getProperty("ticks")->getIntegerValue();
+  BOOST_CHECK(ticks >= 4 && ticks <= 5);
+  BOOST_CHECK_EQUAL(eventNode->getProperty("time")->getStringValue(),
+                    runner.getEvent(id).getNextOccurenceString());
+
+  runner.removeEvent(id);
+  BOOST_CHECK_EQUAL(runner.getSize(), 0);
+  BOOST_CHECK(monitor->getProperty(id) == NULL);
+} // testRunnerComputesMonitorLazily
+
+BOOST_AUTO_TEST_CASE(testRunnerKeepsDueEventsWithoutQueue) {
+  EventInterpreter interpreter(NULL);
+  EventRunner runner(&interpreter);
+
+  boost::shared_ptr<Event> pEvent = boost::make_shared<Event>("my_event");
+  boost::shared_ptr<Schedule> schedule = boost::make_shared<StaticSchedule>(DateTime());
+  runner.addEvent(new ScheduledEvent(pEvent, schedule, 0));
+
+  // due, but nowhere to go, it has to stay scheduled
+  BOOST_CHECK_EQUAL(runner.raisePendingEvents(), false);
+  BOOST_CHECK_EQUAL(runner.getSize(), 1);
+} // testRunnerKeepsDueEventsWithoutQueue
+
 BOOST_FIXTURE_TEST_CASE(testScheduledEventWithId, NonRunningFixture) {
   boost::shared_ptr<Event> pEvent = boost::make_shared<Event>("my_event");
   pEvent->setProperty(EventProperty::Time, "+1");
@@ -394,6 +444,50 @@ BOOST_AUTO_TEST_CASE(testUniqueEventsOverwriteProperties) {
   BOOST_CHECK_EQUAL(pEventFromQueue->getPropertyByName("aProperty"), "aValue");
 } // testUniqueEventsOverwriteProperties
 
+BOOST_AUTO_TEST_CASE(testTypedEventProperties) {
+  dsuid_t dsuid = str2dsuid("3504175fe0000000000000000000000001");
+  Event evt("my_event");
+  evt.setProperty(ef_sceneID, 5);
+  evt.setProperty(ef_originDSUID, dsuid);
+  evt.setFloatProperty("sensorValueFloat", 21.5);
+  evt.setProperty("aProperty", "-3");
+
+  // rendered like the strings that used to be stored
+  BOOST_CHECK_EQUAL(evt.getPropertyByName(ef_sceneID), "5");
+  BOOST_CHECK_EQUAL(evt.getPropertyByName(ef_originDSUID), dsuid2str(dsuid));
+  BOOST_CHECK_EQUAL(evt.getPropertyByName("sensorValueFloat"), doubleToString(21.5));
+
+  const EventPayload& payload = evt.getProperties();
+  BOOST_CHECK_EQUAL(payload.getInt(ef_sceneID, -1), 5);
+  BOOST_CHECK_EQUAL(payload.getInt("aProperty", 0), -3);
+  BOOST_CHECK_EQUAL(payload.getInt("missing", 42), 42);
+  BOOST_CHECK_EQUAL(payload.getDouble("sensorValueFloat", 0), 21.5);
+  BOOST_CHECK(payload.getDSUID(ef_originDSUID, DSUID_NULL) == dsuid);
+  BOOST_CHECK_THROW(payload.get("missing"), std::runtime_error);
+
+  // well known keys are shared between events, others are owned by the
+  // entry, entries keep their order
+  Event other("other_event");
+  other.setProperty(ef_sceneID, 7);
+  other.setProperty("aProperty", "1");
+  BOOST_CHECK_EQUAL(&other.getProperties().getEntries()[0].getKey(), &ef_sceneID);
+  BOOST_CHECK_EQUAL(&payload.getEntries()[0].getKey(), &ef_sceneID);
+  BOOST_CHECK(&other.getProperties().getEntries()[1].getKey() !=
+              &payload.getEntries()[3].getKey());
+  BOOST_CHECK_EQUAL(payload.getEntries()[3].getKey(), "aProperty");
+  BOOST_CHECK(EventPayload::wellKnownKey(std::string("sceneID")) == &ef_sceneID);
+  BOOST_CHECK(EventPayload::wellKnownKey("aProperty") == NULL);
+
+  other.applyProperties(payload);
+  BOOST_CHECK_EQUAL(other.getProperties().getEntries().size(), 4);
+  BOOST_CHECK_EQUAL(other.getPropertyByName(ef_sceneID), "5");
+  BOOST_CHECK(other.getProperties().getEntries()[2].getType() == EventPayload::vtDSUID);
+
+  evt.unsetProperty(ef_sceneID);
+  BOOST_CHECK(!evt.hasPropertySet(ef_sceneID));
+  BOOST_CHECK_EQUAL(payload.getEntries().size(), 3);
+} // testTypedEventProperties
+
 BOOST_AUTO_TEST_CASE(testUniqueEventsOverwritesTimeProperty) {
   EventInterpreter interpreter(NULL);
   EventQueue queue(&interpreter);
@@ -417,6 +511,72 @@ BOOST_AUTO_TEST_CASE(testUniqueEventsOverwritesTimeProperty) {
   BOOST_CHECK_EQUAL(pEvent->getPropertyByName("time"), "+2");
 } // testUniqueEventsOverwritesTimeProperty
 
+BOOST_AUTO_TEST_CASE(testQueuePrioritizesSceneCalls) {
+  EventInterpreter interpreter(NULL);
+  EventQueue queue(&interpreter);
+  interpreter.initialize();
+
+  queue.pushEvent(boost::make_shared<Event>(EventName::DeviceSensorValue));
+  queue.pushEvent(boost::make_shared<Event>("my_event"));
+  queue.pushEvent(boost::make_shared<Event>(EventName::CallScene));
+
+  BOOST_CHECK_EQUAL(queue.getSize(), 3);
+  BOOST_CHECK_EQUAL(queue.popEvent()->getName(), EventName::CallScene);
+  BOOST_CHECK_EQUAL(queue.popEvent()->getName(), "my_event");
+  BOOST_CHECK_EQUAL(queue.popEvent()->getName(), EventName::DeviceSensorValue);
+  BOOST_CHECK(queue.popEvent() == NULL);
+  BOOST_CHECK_EQUAL(queue.getPeakSize(), 3);
+} // testQueuePrioritizesSceneCalls
+
+BOOST_AUTO_TEST_CASE(testBoundedQueueDropsLowPriorityFirst) {
+  EventInterpreter interpreter(NULL);
+  EventQueue queue(&interpreter);
+  interpreter.initialize();
+  queue.setMaxSize(2);
+
+  boost::shared_ptr<Event> pSensor = boost::make_shared<Event>(EventName::DeviceSensorValue);
+  queue.pushEvent(pSensor);
+  queue.pushEvent(boost::make_shared<Event>("my_event"));
+  queue.pushEvent(boost::make_shared<Event>(EventName::CallScene));
+  BOOST_CHECK_EQUAL(queue.getSize(), 2);
+  BOOST_CHECK_EQUAL(queue.getDropped(), 1);
+
+  // nothing of lower or equal priority left to make room for a sensor value
+  queue.pushEvent(boost::make_shared<Event>(EventName::DeviceSensorValue));
+  BOOST_CHECK_EQUAL(queue.getDropped(), 2);
+
+  BOOST_CHECK_EQUAL(queue.popEvent()->getName(), EventName::CallScene);
+  BOOST_CHECK_EQUAL(queue.popEvent()->getName(), "my_event");
+  BOOST_CHECK(queue.popEvent() == NULL);
+} // testBoundedQueueDropsLowPriorityFirst
+
+BOOST_AUTO_TEST_CASE(testQueueCoalescesSensorValues) {
+  Apartment apt(NULL);
+  boost::shared_ptr<Group> group = apt.getZone(0)->getGroup(1);
+  EventInterpreter interpreter(NULL);
+  EventQueue queue(&interpreter);
+  interpreter.initialize();
+
+  queue.pushEvent(createZoneSensorValueEvent(group, SensorType::TemperatureIndoors, 100, DSUID_NULL));
+  queue.pushEvent(createZoneSensorValueEvent(group, SensorType::BrightnessIndoors, 5, DSUID_NULL));
+  queue.pushEvent(createZoneSensorValueEvent(group, SensorType::TemperatureIndoors, 200, DSUID_NULL));
+  BOOST_CHECK_EQUAL(queue.getSize(), 2);
+  BOOST_CHECK_EQUAL(queue.getMerged(), 1);
+
+  boost::shared_ptr<Event> pEvent = queue.popEvent();
+  BOOST_CHECK_EQUAL(pEvent->getPropertyByName("sensorValue"), "200");
+  queue.popEvent();
+
+  // once dispatched, a new value gets queued again
+  queue.pushEvent(createZoneSensorValueEvent(group, SensorType::TemperatureIndoors, 300, DSUID_NULL));
+  BOOST_CHECK_EQUAL(queue.getSize(), 1);
+  BOOST_CHECK_EQUAL(queue.getMerged(), 1);
+
+  queue.setCoalesceSensorValues(false);
+  queue.pushEvent(createZoneSensorValueEvent(group, SensorType::TemperatureIndoors, 400, DSUID_NULL));
+  BOOST_CHECK_EQUAL(queue.getSize(), 2);
+} // testQueueCoalescesSensorValues
+
 BOOST_AUTO_TEST_CASE(testRemoveAndGetEvents) {
   EventInterpreter interpreter(NULL);
   EventQueue queue(&interpreter);
@@ -458,8 +618,13 @@ BOOST_FIXTURE_TEST_CASE(testEventCollector, NonRunningFixture) {
 
   BOOST_CHECK_EQUAL(collector.hasEvent(), true);
 
-  Event evt = collector.popEvent();
-  BOOST_CHECK_EQUAL(evt.getName(), "my_event");
+  std::vector<boost::shared_ptr<const Event> > events;
+  BOOST_CHECK_EQUAL(collector.popAll(events), 0);
+  BOOST_REQUIRE_EQUAL(events.size(), 1);
+  BOOST_CHECK_EQUAL(events[0]->getName(), "my_event");
+  // shared with the interpreter, not copied
+  BOOST_CHECK_EQUAL(events[0].get(), pEvent.get());
+  BOOST_CHECK_EQUAL(collector.getPendingBytes(), 0);
 
   pEvent.reset(new Event("event2"));
   m_pQueue->pushEvent(pEvent);
@@ -482,6 +647,65 @@ BOOST_FIXTURE_TEST_CASE(testEventCollector, NonRunningFixture) {
   BOOST_CHECK_EQUAL(collector.hasEvent(), false);
 } // testEventCollector
 
+BOOST_FIXTURE_TEST_CASE(testEventCollectorOverflow, NonRunningFixture) {
+  EventInterpreterInternalRelay* relay = new EventInterpreterInternalRelay(m_pEventInterpreter.get());
+  m_pEventInterpreter->addPlugin(relay);
+
+  EventCollector collector(*relay, 3);
+  collector.subscribeTo("my_event");
+
+  for (int i = 0; i < 5; i++) {
+    boost::shared_ptr<Event> pEvent = boost::make_shared<Event>("my_event");
+    pEvent->setProperty("index", i);
+    m_pQueue->pushEvent(pEvent);
+    m_pEventInterpreter->executePendingEvent();
+  }
+  BOOST_CHECK_EQUAL(collector.getPendingCount(), 3);
+  BOOST_CHECK(collector.getPendingBytes() > 0);
+
+  std::vector<boost::shared_ptr<const Event> > events;
+  BOOST_CHECK_EQUAL(collector.popAll(events), 2);
+  BOOST_REQUIRE_EQUAL(events.size(), 3);
+  BOOST_CHECK_EQUAL(events[0]->getPropertyByName("index"), "2");
+  BOOST_CHECK_EQUAL(events[2]->getPropertyByName("index"), "4");
+  BOOST_CHECK_EQUAL(collector.getPendingCount(), 0);
+  BOOST_CHECK_EQUAL(collector.getPendingBytes(), 0);
+
+  // the overflow is only reported once
+  events.clear();
+  BOOST_CHECK_EQUAL(collector.popAll(events), 0);
+  BOOST_CHECK(events.empty());
+} // testEventCollectorOverflow
+
+static void countCall(int* _count) {
+  (*_count)++;
+}
+
+BOOST_FIXTURE_TEST_CASE(testEventCollectorCallbackToken, NonRunningFixture) {
+  EventInterpreterInternalRelay* relay = new EventInterpreterInternalRelay(m_pEventInterpreter.get());
+  m_pEventInterpreter->addPlugin(relay);
+
+  EventCollector collector(*relay);
+  collector.subscribeTo("my_event");
+
+  int first = 0;
+  int second = 0;
+  unsigned firstToken = collector.setEventArrivedCallback(boost::bind(&countCall, &first));
+  unsigned secondToken = collector.setEventArrivedCallback(boost::bind(&countCall, &second));
+
+  // a finishing older request must not remove the newer callback
+  collector.clearEventArrivedCallback(firstToken);
+  m_pQueue->pushEvent(boost::make_shared<Event>("my_event"));
+  m_pEventInterpreter->executePendingEvent();
+  BOOST_CHECK_EQUAL(first, 0);
+  BOOST_CHECK_EQUAL(second, 1);
+
+  collector.clearEventArrivedCallback(secondToken);
+  m_pQueue->pushEvent(boost::make_shared<Event>("my_event"));
+  m_pEventInterpreter->executePendingEvent();
+  BOOST_CHECK_EQUAL(second, 1);
+} // testEventCollectorCallbackToken
+
 class InternalEventRelayTester {
 public:
   InternalEventRelayTester()
@@ -552,6 +776,160 @@ BOOST_FIXTURE_TEST_CASE(testInternalEventRelay, NonRunningFixture) {
   BOOST_CHECK_EQUAL(tester.getCounter(), 4);
 }
 
+class CountingPlugin : public EventInterpreterPlugin {
+public:
+  CountingPlugin(const std::string& _name, EventInterpreter* _interpreter)
+  : EventInterpreterPlugin(_name, _interpreter)
+  {}
+
+  virtual void handleEvent(Event& _event, const EventSubscription& _subscription) {
+    m_Handled.push_back(_event.getName() + ":" + _subscription.getID());
+  }
+
+  std::vector<std::string> m_Handled;
+}; // CountingPlugin
+
+BOOST_FIXTURE_TEST_CASE(testSubscriptionDispatchByEventName, NonRunningFixture) {
+  boost::shared_ptr<EventSubscription> subOne = boost::make_shared<EventSubscription>(
+      "one", "counter", *m_pEventInterpreter, boost::shared_ptr<SubscriptionOptions>());
+  m_pEventInterpreter->subscribe(subOne);
+  boost::shared_ptr<EventSubscription> subTwo = boost::make_shared<EventSubscription>(
+      "two", "counter", *m_pEventInterpreter, boost::shared_ptr<SubscriptionOptions>());
+  m_pEventInterpreter->subscribe(subTwo);
+  boost::shared_ptr<EventSubscription> subOneAgain = boost::make_shared<EventSubscription>(
+      "one", "counter", *m_pEventInterpreter, boost::shared_ptr<SubscriptionOptions>());
+  m_pEventInterpreter->subscribe(subOneAgain);
+  BOOST_CHECK_EQUAL(m_pEventInterpreter->getNumberOfSubscriptions(), 3);
+
+  // plugin registered after the subscriptions gets resolved as well
+  CountingPlugin* plugin = new CountingPlugin("counter", m_pEventInterpreter.get());
+  m_pEventInterpreter->addPlugin(plugin);
+
+  m_pQueue->pushEvent(boost::make_shared<Event>("one"));
+  m_pEventInterpreter->executePendingEvent();
+  BOOST_REQUIRE_EQUAL(plugin->m_Handled.size(), 2);
+  BOOST_CHECK_EQUAL(plugin->m_Handled[0], "one:" + subOne->getID());
+  BOOST_CHECK_EQUAL(plugin->m_Handled[1], "one:" + subOneAgain->getID());
+
+  m_pQueue->pushEvent(boost::make_shared<Event>("three"));
+  m_pEventInterpreter->executePendingEvent();
+  BOOST_CHECK_EQUAL(plugin->m_Handled.size(), 2);
+
+  m_pEventInterpreter->unsubscribe(subOne);
+  BOOST_CHECK_EQUAL(m_pEventInterpreter->getNumberOfSubscriptions(), 2);
+  m_pQueue->pushEvent(boost::make_shared<Event>("one"));
+  m_pEventInterpreter->executePendingEvent();
+  BOOST_REQUIRE_EQUAL(plugin->m_Handled.size(), 3);
+  BOOST_CHECK_EQUAL(plugin->m_Handled[2], "one:" + subOneAgain->getID());
+
+  m_pEventInterpreter->unsubscribe(subTwo->getID());
+  m_pQueue->pushEvent(boost::make_shared<Event>("two"));
+  m_pEventInterpreter->executePendingEvent();
+  BOOST_CHECK_EQUAL(plugin->m_Handled.size(), 3);
+  BOOST_CHECK_EQUAL(m_pEventInterpreter->getEventsProcessed(), 4);
+} // testSubscriptionDispatchByEventName
+
+class LanePlugin : public EventInterpreterPlugin {
+public:
+  LanePlugin(const std::string& _name, EventInterpreter* _interpreter)
+  : EventInterpreterPlugin(_name, _interpreter),
+    m_Blocked(true)
+  {}
+
+  virtual std::string getDispatchLane() const { return getName(); }
+
+  virtual void handleEvent(Event& _event, const EventSubscription& _subscription) {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    while (m_Blocked) {
+      m_Changed.wait(lock);
+    }
+    m_Handled.push_back(_event.getName());
+    _event.setProperty("handledBy", getName());
+    m_Changed.notify_all();
+  }
+
+  void release() {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    m_Blocked = false;
+    m_Changed.notify_all();
+  }
+
+  bool waitForHandled(size_t _count) {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    while (m_Handled.size() < _count) {
+      if (!m_Changed.timed_wait(lock, boost::posix_time::seconds(5))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  boost::mutex m_Mutex;
+  boost::condition_variable m_Changed;
+  bool m_Blocked;
+  std::vector<std::string> m_Handled;
+}; // LanePlugin
+
+BOOST_FIXTURE_TEST_CASE(testParallelDispatchLanes, NonRunningFixture) {
+  LanePlugin* slow = new LanePlugin("slow", m_pEventInterpreter.get());
+  m_pEventInterpreter->addPlugin(slow);
+  CountingPlugin* inlinePlugin = new CountingPlugin("inline", m_pEventInterpreter.get());
+  m_pEventInterpreter->addPlugin(inlinePlugin);
+  m_pEventInterpreter->subscribe(boost::make_shared<EventSubscription>(
+      "one", "slow", *m_pEventInterpreter, boost::shared_ptr<SubscriptionOptions>()));
+  m_pEventInterpreter->subscribe(boost::make_shared<EventSubscription>(
+      "two", "slow", *m_pEventInterpreter, boost::shared_ptr<SubscriptionOptions>()));
+  m_pEventInterpreter->subscribe(boost::make_shared<EventSubscription>(
+      "two", "inline", *m_pEventInterpreter, boost::shared_ptr<SubscriptionOptions>()));
+  m_pEventInterpreter->setParallelDispatch(true);
+
+  // the blocked lane must not hold back the plugins running inline
+  m_pQueue->pushEvent(boost::make_shared<Event>("one"));
+  m_pEventInterpreter->executePendingEvent();
+  m_pQueue->pushEvent(boost::make_shared<Event>("two"));
+  m_pEventInterpreter->executePendingEvent();
+  BOOST_CHECK_EQUAL(inlinePlugin->m_Handled.size(), 1);
+  BOOST_CHECK_EQUAL(m_pEventInterpreter->getEventsProcessed(), 2);
+
+  slow->release();
+  BOOST_REQUIRE(slow->waitForHandled(2));
+  boost::mutex::scoped_lock lock(slow->m_Mutex);
+  BOOST_CHECK_EQUAL(slow->m_Handled[0], "one");
+  BOOST_CHECK_EQUAL(slow->m_Handled[1], "two");
+} // testParallelDispatchLanes
+
+BOOST_FIXTURE_TEST_CASE(testDispatchLaneIsBounded, NonRunningFixture) {
+  LanePlugin* slow = new LanePlugin("slow", m_pEventInterpreter.get());
+  m_pEventInterpreter->addPlugin(slow);
+  boost::shared_ptr<EventSubscription> subscription = boost::make_shared<EventSubscription>(
+      "one", "slow", *m_pEventInterpreter, boost::shared_ptr<SubscriptionOptions>());
+
+  EventDispatchLane lane("bounded", PropertyNodePtr(), 2);
+  Event one("one");
+  BOOST_CHECK(lane.dispatch(slow, one, subscription));
+  BOOST_CHECK(lane.dispatch(slow, one, subscription));
+  BOOST_CHECK(!lane.isCongested());
+
+  // the full lane holds back the dispatcher instead of dropping the event
+  boost::atomic<bool> dispatched(false);
+  bool waited = false;
+  boost::thread dispatcher([&] () {
+    waited = !lane.dispatch(slow, one, subscription);
+    dispatched = true;
+  });
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  BOOST_CHECK(!dispatched);
+
+  slow->release();
+  dispatcher.join();
+  BOOST_CHECK(waited);
+  BOOST_CHECK(lane.isCongested());
+  BOOST_CHECK_EQUAL(lane.getEventsDelayed(), 1);
+  BOOST_REQUIRE(slow->waitForHandled(3));
+  // the plugin modified its own copy
+  BOOST_CHECK(!one.hasPropertySet("handledBy"));
+} // testDispatchLaneIsBounded
+
 class InternalEventRelayCollector {
 public:
   InternalEventRelayCollector()
@@ -5,6 +5,8 @@
 
 #include <boost/test/unit_test.hpp>
 #include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include <boost/filesystem.hpp>
 
 #include "foreach.h"
 #include "logger.h"
@@ -57,4 +59,180 @@ BOOST_AUTO_TEST_CASE(testConcurrentLogToChannel) {
   std::cout.clear();
 }
 
+class CountingLogHandler : public LogHandler {
+public:
+  CountingLogHandler() : m_Lines(0) {}
+
+  void handle(const std::string &_message) {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    m_Lines += std::count(_message.begin(), _message.end(), '\n');
+  }
+
+  int getLines() {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Lines;
+  }
+
+private:
+  boost::mutex m_Mutex;
+  int m_Lines;
+}; // CountingLogHandler
+
+BOOST_AUTO_TEST_CASE(testAsyncLoggingDeliversAllRecords) {
+  CountingLogHandler handler;
+  LogChannel channel("asynctest", lsInfo);
+  Logger::getInstance()->registerHandler(handler);
+  std::cout.setstate(std::ios_base::badbit);
+
+  Logger::getInstance()->setAsync(true);
+  BOOST_CHECK(Logger::getInstance()->isAsync());
+  for (int i = 0; i < 1000; i++) {
+    Logger::getInstance()->log(channel, "async record", lsInfo);
+    Logger::getInstance()->log(channel, "suppressed record", lsDebug);
+  }
+  // flushes and joins the writer
+  Logger::getInstance()->setAsync(false);
+  BOOST_CHECK_EQUAL(handler.getLines(), 1000);
+
+  // errors are written right away
+  Logger::getInstance()->setAsync(true);
+  Logger::getInstance()->log(channel, "error record", lsError);
+  BOOST_CHECK_EQUAL(handler.getLines(), 1001);
+  Logger::getInstance()->log(channel, "fatal record", lsFatal);
+  BOOST_CHECK_EQUAL(handler.getLines(), 1002);
+  Logger::getInstance()->setAsync(false);
+
+  std::cout.clear();
+  Logger::getInstance()->deregisterHandler(handler);
+}
+
+class BlockingLogHandler : public LogHandler {
+public:
+  BlockingLogHandler() : m_Lines(0), m_Notices(0), m_Blocked(true) {}
+
+  void handle(const std::string &_message) {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    while (m_Blocked) {
+      m_Condition.wait(lock);
+    }
+    m_Lines += std::count(_message.begin(), _message.end(), '\n');
+    std::string::size_type pos = 0;
+    while ((pos = _message.find("log records dropped", pos)) != std::string::npos) {
+      m_Notices++;
+      pos++;
+    }
+  }
+
+  void release() {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    m_Blocked = false;
+    m_Condition.notify_all();
+  }
+
+  int getLines() {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Lines;
+  }
+
+  int getNotices() {
+    boost::mutex::scoped_lock lock(m_Mutex);
+    return m_Notices;
+  }
+
+private:
+  boost::mutex m_Mutex;
+  boost::condition_variable m_Condition;
+  int m_Lines;
+  int m_Notices;
+  bool m_Blocked;
+}; // BlockingLogHandler
+
+BOOST_AUTO_TEST_CASE(testAsyncLoggingDropsRecordsWhenBehind) {
+  BlockingLogHandler handler;
+  LogChannel channel("droptest", lsInfo);
+  Logger::getInstance()->registerHandler(handler);
+  std::cout.setstate(std::ios_base::badbit);
+
+  unsigned long droppedBefore = Logger::getInstance()->getDroppedRecords();
+  Logger::getInstance()->setMaxPendingBytes(1024);
+  Logger::getInstance()->setAsync(true);
+  // the writer is stuck in the handler, the buffer has to stay bounded
+  for (int i = 0; i < 200; i++) {
+    Logger::getInstance()->log(channel, "record that won't fit", lsInfo);
+  }
+  unsigned long dropped = Logger::getInstance()->getDroppedRecords() - droppedBefore;
+  BOOST_CHECK(dropped > 0);
+
+  handler.release();
+  Logger::getInstance()->setAsync(false);
+  Logger::getInstance()->setMaxPendingBytes(LOGGER_MAX_PENDING_BYTES);
+
+  // every record is either written or accounted for in a notice
+  BOOST_CHECK(handler.getNotices() >= 1);
+  BOOST_CHECK_EQUAL(handler.getLines() - handler.getNotices() + (int)dropped, 200);
+
+  std::cout.clear();
+  Logger::getInstance()->deregisterHandler(handler);
+}
+
+BOOST_AUTO_TEST_CASE(testLoggingCostPerEvent) {
+  // mimics the debug output of EventInterpreter::executePendingEvent
+  const int kEvents = 20000;
+  LogChannel channel("benchmark", lsInfo);
+  std::string name = "deviceSensorValue";
+  std::string value = "sensorValueFloat";
+  std::string fileName = boost::filesystem::unique_path(boost::filesystem::temp_directory_path() /
+                                                        "dss-logger-%%%%-%%%%.log").string();
+  boost::shared_ptr<LogTarget> fileTarget(new FileLogTarget(fileName));
+  boost::shared_ptr<LogTarget> coutTarget(new CoutLogTarget());
+  BOOST_REQUIRE(Logger::getInstance()->setLogTarget(fileTarget));
+
+  // counts how often the message of a record was built
+  int formatted = 0;
+  auto describe = [&formatted] (const std::string& _name) {
+    formatted++;
+    return "Interpreter: got event from queue: '" + _name + "'";
+  };
+
+  boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+  for (int i = 0; i < kEvents; i++) {
+    Logger::getInstance()->log(channel, describe(name), lsDebug);
+    Logger::getInstance()->log(channel, "Interpreter: - parameter '" + value + "' = '" + value + "'", lsDebug);
+  }
+  boost::chrono::nanoseconds eager = boost::chrono::steady_clock::now() - start;
+  BOOST_CHECK_EQUAL(formatted, kEvents);
+
+  formatted = 0;
+  start = boost::chrono::steady_clock::now();
+  for (int i = 0; i < kEvents; i++) {
+    if (channel.maylog(lsDebug)) {
+      Logger::getInstance()->log(channel, describe(name), lsDebug);
+      Logger::getInstance()->log(channel, "Interpreter: - parameter '" + value + "' = '" + value + "'", lsDebug);
+    }
+  }
+  BOOST_CHECK_EQUAL(formatted, 0);
+  boost::chrono::nanoseconds guarded = boost::chrono::steady_clock::now() - start;
+
+  start = boost::chrono::steady_clock::now();
+  for (int i = 0; i < kEvents; i++) {
+    Logger::getInstance()->log(channel, "Interpreter: got event from queue: '" + name + "'", lsInfo);
+  }
+  boost::chrono::nanoseconds sync = boost::chrono::steady_clock::now() - start;
+
+  Logger::getInstance()->setAsync(true);
+  start = boost::chrono::steady_clock::now();
+  for (int i = 0; i < kEvents; i++) {
+    Logger::getInstance()->log(channel, "Interpreter: got event from queue: '" + name + "'", lsInfo);
+  }
+  boost::chrono::nanoseconds async = boost::chrono::steady_clock::now() - start;
+  Logger::getInstance()->setAsync(false);
+  Logger::getInstance()->setLogTarget(coutTarget);
+  boost::filesystem::remove(fileName);
+
+  BOOST_TEST_MESSAGE("suppressed debug, formatted eagerly: " << eager.count() / kEvents << " ns/event");
+  BOOST_TEST_MESSAGE("suppressed debug, guarded by maylog: " << guarded.count() / kEvents << " ns/event");
+  BOOST_TEST_MESSAGE("written synchronously: " << sync.count() / kEvents << " ns/event");
+  BOOST_TEST_MESSAGE("handed to the writer thread: " << async.count() / kEvents << " ns/event");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -291,6 +291,154 @@ BOOST_AUTO_TEST_CASE(seriesRanges) {
 } // seriesSizes
 
 
+BOOST_AUTO_TEST_CASE(seriesRecentSamples) {
+  Apartment apt(NULL);
+  boost::shared_ptr<DSMeter> pMeter = apt.allocateDSMeter(dsuid);
+  pMeter->setCapability_HasMetering(true);
+  std::vector<boost::shared_ptr<DSMeter> > pMeters;
+  pMeters.push_back(pMeter);
+  dss::Metering metering(NULL);
+
+  // 100 W, i.e. 100 Ws per second, from 30 seconds ago into the near future
+  DateTime sampledAt = DateTime().addSeconds(-30);
+  for (int ctr = 0; ctr < 40; ++ctr) {
+    metering.postMeteringEvent(pMeter, 100, 1000 + ctr * 100, sampledAt);
+    sampledAt = sampledAt.addSeconds(1);
+  }
+
+  {
+    DateTime startTime(DateTime::NullDate);
+    DateTime endTime(DateTime::NullDate);
+    int valueCount = 10;
+    int resolution = 1;
+    boost::shared_ptr<std::deque<Value> > pValues = metering.getSeries(pMeters,
+                                                                       resolution,
+                                                                       dss::Metering::etConsumption,
+                                                                       false,
+                                                                       startTime,
+                                                                       endTime,
+                                                                       valueCount);
+    BOOST_CHECK_EQUAL(resolution, 1);
+    BOOST_CHECK_EQUAL(pValues->size(), 10);
+    for (std::deque<Value>::iterator iter = pValues->begin(); iter != pValues->end(); ++iter) {
+      BOOST_CHECK_EQUAL(iter->getValue(), 100);
+    }
+  }
+  {
+    DateTime startTime(DateTime::NullDate);
+    DateTime endTime(DateTime::NullDate);
+    int valueCount = 10;
+    int resolution = 1;
+    boost::shared_ptr<std::deque<Value> > pValues = metering.getSeries(pMeters,
+                                                                       resolution,
+                                                                       dss::Metering::etEnergyDelta,
+                                                                       false,
+                                                                       startTime,
+                                                                       endTime,
+                                                                       valueCount);
+    BOOST_CHECK_EQUAL(pValues->size(), 10);
+    for (std::deque<Value>::iterator iter = pValues->begin(); iter != pValues->end(); ++iter) {
+      BOOST_CHECK_EQUAL(iter->getValue(), 100);
+    }
+  }
+} // seriesRecentSamples
+
+BOOST_AUTO_TEST_CASE(seriesCacheFollowsNewSamples) {
+  Apartment apt(NULL);
+  boost::shared_ptr<DSMeter> pMeter = apt.allocateDSMeter(dsuid);
+  pMeter->setCapability_HasMetering(true);
+  std::vector<boost::shared_ptr<DSMeter> > pMeters;
+  pMeters.push_back(pMeter);
+  dss::Metering metering(NULL);
+
+  // samples stop a few seconds ago, the latest rows are unknown
+  DateTime sampledAt = DateTime().addSeconds(-40);
+  int ctr = 0;
+  for (; ctr < 35; ++ctr) {
+    metering.postMeteringEvent(pMeter, 100, 1000 + ctr * 100, sampledAt);
+    sampledAt = sampledAt.addSeconds(1);
+  }
+  {
+    DateTime startTime(DateTime::NullDate);
+    DateTime endTime(DateTime::NullDate);
+    int valueCount = 10;
+    int resolution = 1;
+    boost::shared_ptr<std::deque<Value> > pValues = metering.getSeries(pMeters,
+                                                                       resolution,
+                                                                       dss::Metering::etConsumption,
+                                                                       false,
+                                                                       startTime,
+                                                                       endTime,
+                                                                       valueCount);
+    BOOST_CHECK_EQUAL(pValues->size(), 10 - 1);
+    BOOST_CHECK_EQUAL(pValues->back().getValue(), 0);
+  }
+
+  // the same query has to see the samples that arrived meanwhile
+  for (; ctr < 50; ++ctr) {
+    metering.postMeteringEvent(pMeter, 100, 1000 + ctr * 100, sampledAt);
+    sampledAt = sampledAt.addSeconds(1);
+  }
+  {
+    DateTime startTime(DateTime::NullDate);
+    DateTime endTime(DateTime::NullDate);
+    int valueCount = 10;
+    int resolution = 1;
+    boost::shared_ptr<std::deque<Value> > pValues = metering.getSeries(pMeters,
+                                                                       resolution,
+                                                                       dss::Metering::etConsumption,
+                                                                       false,
+                                                                       startTime,
+                                                                       endTime,
+                                                                       valueCount);
+    BOOST_CHECK_EQUAL(pValues->size(), 10);
+    for (std::deque<Value>::iterator iter = pValues->begin(); iter != pValues->end(); ++iter) {
+      BOOST_CHECK_EQUAL(iter->getValue(), 100);
+    }
+  }
+} // seriesCacheFollowsNewSamples
+
+BOOST_AUTO_TEST_CASE(seriesCacheCutsRollingWindows) {
+  Apartment apt(NULL);
+  boost::shared_ptr<DSMeter> pMeter = apt.allocateDSMeter(dsuid);
+  pMeter->setCapability_HasMetering(true);
+  std::vector<boost::shared_ptr<DSMeter> > pMeters;
+  pMeters.push_back(pMeter);
+  dss::Metering metering(NULL);
+
+  DateTime now;
+  DateTime sampledAt = now.addSeconds(-200);
+  for (int ctr = 0; ctr < 200; ++ctr) {
+    metering.postMeteringEvent(pMeter, 100, 1000 + ctr * 100, sampledAt);
+    sampledAt = sampledAt.addSeconds(1);
+  }
+
+  // windows moving by a few seconds share one cached block of rows, each
+  // one has to get exactly its own rows back
+  for (int shift = 0; shift < 15; shift += 5) {
+    DateTime startTime = now.addSeconds(-80 + shift);
+    DateTime endTime = now.addSeconds(-60 + shift);
+    // getSeries() hands back the actual window in start and end time
+    time_t firstRow = startTime.secondsSinceEpoch() + 1;
+    time_t lastRow = endTime.secondsSinceEpoch();
+    int valueCount = 0;
+    int resolution = 1;
+    boost::shared_ptr<std::deque<Value> > pValues = metering.getSeries(pMeters,
+                                                                       resolution,
+                                                                       dss::Metering::etConsumption,
+                                                                       false,
+                                                                       startTime,
+                                                                       endTime,
+                                                                       valueCount);
+    BOOST_REQUIRE_EQUAL(pValues->size(), 20);
+    BOOST_CHECK_EQUAL(pValues->front().getTimeStamp().secondsSinceEpoch(), firstRow);
+    BOOST_CHECK_EQUAL(pValues->back().getTimeStamp().secondsSinceEpoch(), lastRow);
+    for (std::deque<Value>::iterator iter = pValues->begin(); iter != pValues->end(); ++iter) {
+      BOOST_CHECK_EQUAL(iter->getValue(), 100);
+    }
+  }
+} // seriesCacheCutsRollingWindows
+
 BOOST_AUTO_TEST_CASE(seriesDateForward) {
   Apartment apt(NULL);
   boost::shared_ptr<DSMeter> pMeter = apt.allocateDSMeter(dsuid);
@@ -25,6 +25,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
 
 #include "src/model/apartment.h"
 #include "src/model/modelconst.h"
@@ -246,4 +248,42 @@ BOOST_AUTO_TEST_CASE(testChangesBarier) {
   BOOST_CHECK_EQUAL(main.pendingChangesBarrier(0), false);
 }
 
+
+static void produceModelEvents(ModelMaintenanceMock& _main, int _count) {
+  dsuid_t dsuid = DSUID_NULL;
+  for (int i = 0; i < _count; i++) {
+    // what the bus callbacks queue for button presses and sensor values
+    dsuid.id[0] = i & 0xff;
+    _main.addModelEvent(new ModelEventWithDSID(ModelEvent::etDummyEvent, dsuid));
+    _main.addModelEvent(new ModelEvent(ModelEvent::etDummyEvent));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testModelEventThroughput) {
+  ModelMaintenanceMock main;
+  const int kProducers = 4;
+  const int kEventsPerProducer = 50000;
+  const unsigned kEvents = kProducers * kEventsPerProducer * 2;
+  unsigned eventCountInit = main.m_processedEvents;
+
+  boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+  boost::thread_group producers;
+  for (int i = 0; i < kProducers; i++) {
+    producers.create_thread(boost::bind(produceModelEvents, boost::ref(main),
+                                        kEventsPerProducer));
+  }
+  while (main.m_processedEvents - eventCountInit < kEvents) {
+    main.handleModelEvents();
+  }
+  producers.join_all();
+  boost::chrono::duration<double> elapsed = boost::chrono::steady_clock::now() - start;
+
+  BOOST_CHECK_EQUAL(main.m_processedEvents - eventCountInit, kEvents);
+  BOOST_CHECK_EQUAL(main.indexOfNextSyncState(), main.m_processedEvents);
+  BOOST_TEST_MESSAGE("model thread handled " << kEvents << " events from "
+                     << kProducers << " threads in " << elapsed.count()
+                     << "s, " << static_cast<int>(kEvents / elapsed.count())
+                     << " events/s");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
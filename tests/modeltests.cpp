@@ -199,6 +199,229 @@ BOOST_AUTO_TEST_CASE(testApartmentGetDSMeterByName) {
   BOOST_CHECK_EQUAL("mod1", apt.getDSMeter("mod1")->getName());
 } // testApartmentGetDSMeterByName
 
+static void checkDeviceIndexes(Apartment& _apt) {
+  Set devices = _apt.getDevices();
+  for (int i = 0; i < devices.length(); i++) {
+    boost::shared_ptr<Device> dev = devices.get(i).getDevice();
+    BOOST_CHECK_EQUAL(_apt.tryGetDeviceByDSID(dev->getDSID()), dev);
+    BOOST_CHECK_EQUAL(_apt.getDeviceByName(dev->getName()),
+                      devices.getByName(dev->getName()).getDevice());
+    BOOST_CHECK_EQUAL(_apt.getDeviceByBusID(dev->getShortAddress(), dev->getDSMeterDSID()),
+                      devices.getByBusID(dev->getShortAddress(), dev->getDSMeterDSID()).getDevice());
+    uint32_t serial;
+    dsuid_t dsuid = dev->getDSID();
+    if (dsuid_get_serial_number(&dsuid, &serial) == 0) {
+      BOOST_CHECK_EQUAL(_apt.tryGetDeviceBySerial(serial),
+                        devices.getBySerial(serial).getDevice());
+    }
+  }
+} // checkDeviceIndexes
+
+BOOST_AUTO_TEST_CASE(testApartmentDeviceIndexesFollowChanges) {
+  Apartment apt(NULL);
+
+  boost::shared_ptr<DSMeter> meter1 = apt.allocateDSMeter(meter1DSID);
+  boost::shared_ptr<DSMeter> meter2 = apt.allocateDSMeter(meter2DSID);
+
+  boost::shared_ptr<Device> dev1 = apt.allocateDevice(dsuid1);
+  dev1->setShortAddress(1);
+  dev1->setName("dev1");
+  dev1->setDSMeter(meter1);
+
+  boost::shared_ptr<Device> dev2 = apt.allocateDevice(dsuid2);
+  dev2->setShortAddress(2);
+  dev2->setName("dev2");
+  dev2->setDSMeter(meter1);
+  checkDeviceIndexes(apt);
+
+  dev1->setName("renamed");
+  BOOST_CHECK_THROW(apt.getDeviceByName("dev1"), ItemNotFoundException);
+  BOOST_CHECK_EQUAL(apt.getDeviceByName("renamed"), dev1);
+
+  dev2->setShortAddress(5);
+  BOOST_CHECK(apt.tryGetDeviceByBusID(2, meter1DSID) == NULL);
+  BOOST_CHECK_EQUAL(apt.getDeviceByBusID(5, meter1DSID), dev2);
+
+  dev2->setDSMeter(meter2);
+  BOOST_CHECK(apt.tryGetDeviceByBusID(5, meter1DSID) == NULL);
+  BOOST_CHECK_EQUAL(apt.getDeviceByBusID(5, meter2DSID), dev2);
+  checkDeviceIndexes(apt);
+
+  // re-allocating must neither duplicate nor lose index entries
+  BOOST_CHECK_EQUAL(apt.allocateDevice(dsuid1), dev1);
+  checkDeviceIndexes(apt);
+
+  apt.removeDevice(dsuid1);
+  BOOST_CHECK(apt.tryGetDeviceByDSID(dsuid1) == NULL);
+  BOOST_CHECK_THROW(apt.getDeviceByName("renamed"), ItemNotFoundException);
+  BOOST_CHECK(apt.tryGetDeviceByBusID(1, meter1DSID) == NULL);
+  checkDeviceIndexes(apt);
+
+  // renaming a removed device must not resurrect it
+  dev1->setName("ghost");
+  BOOST_CHECK_THROW(apt.getDeviceByName("ghost"), ItemNotFoundException);
+} // testApartmentDeviceIndexesFollowChanges
+
+BOOST_AUTO_TEST_CASE(testApartmentDeviceIndexesKeepAllocationOrder) {
+  Apartment apt(NULL);
+
+  boost::shared_ptr<DSMeter> meter = apt.allocateDSMeter(meter1DSID);
+
+  boost::shared_ptr<Device> dev1 = apt.allocateDevice(dsuid1);
+  boost::shared_ptr<Device> dev2 = apt.allocateDevice(dsuid2);
+  boost::shared_ptr<Device> dev3 = apt.allocateDevice(dsuid3);
+  dev3->setName("twin");
+  dev3->setDSMeter(meter);
+  dev2->setName("twin");
+  dev2->setDSMeter(meter);
+  dev1->setDSMeter(meter);
+
+  // duplicate names and stale short addresses resolve like a linear scan
+  BOOST_CHECK_EQUAL(apt.getDeviceByName("twin"), dev2);
+  BOOST_CHECK_EQUAL(apt.getDeviceByBusID(ShortAddressStaleDevice, meter1DSID), dev1);
+  checkDeviceIndexes(apt);
+
+  dev2->setName("single");
+  BOOST_CHECK_EQUAL(apt.getDeviceByName("twin"), dev3);
+  checkDeviceIndexes(apt);
+} // testApartmentDeviceIndexesKeepAllocationOrder
+
+BOOST_AUTO_TEST_CASE(testApartmentGetDeviceBySerial) {
+  Apartment apt(NULL);
+
+  dsid_t dsid;
+  memset(&dsid, 0, sizeof(dsid));
+  dsid.id[11] = 0x42;
+  dsuid_t dsuid = dsuid_from_dsid(dsid);
+  uint32_t serial;
+  BOOST_REQUIRE_EQUAL(dsuid_get_serial_number(&dsuid, &serial), 0);
+
+  BOOST_CHECK(apt.tryGetDeviceBySerial(serial) == NULL);
+  boost::shared_ptr<Device> dev = apt.allocateDevice(dsuid);
+  BOOST_CHECK_EQUAL(apt.tryGetDeviceBySerial(serial), dev);
+  checkDeviceIndexes(apt);
+
+  dev->setVdcDevice(true);
+  BOOST_CHECK(apt.tryGetDeviceBySerial(serial) == NULL);
+  dev->setVdcDevice(false);
+
+  apt.removeDevice(dsuid);
+  BOOST_CHECK(apt.tryGetDeviceBySerial(serial) == NULL);
+} // testApartmentGetDeviceBySerial
+
+static std::vector<DeviceReference> listOf(const Set& _set) {
+  std::vector<DeviceReference> result;
+  for (int i = 0; i < _set.length(); i++) {
+    result.push_back(_set.get(i));
+  }
+  return result;
+} // listOf
+
+static void checkSameDevices(const Set& _bitmap, const Set& _list) {
+  BOOST_REQUIRE_EQUAL(_bitmap.length(), _list.length());
+  for (int i = 0; i < _list.length(); i++) {
+    BOOST_CHECK_EQUAL(dsuid2str(_bitmap.get(i).getDSID()), dsuid2str(_list.get(i).getDSID()));
+  }
+} // checkSameDevices
+
+BOOST_AUTO_TEST_CASE(testSetBitmapFollowsZonesAndGroups) {
+  Apartment apt(NULL);
+  apt.allocateZone(1);
+  apt.allocateZone(2);
+
+  boost::shared_ptr<Device> dev1 = apt.allocateDevice(dsuid1);
+  boost::shared_ptr<Device> dev2 = apt.allocateDevice(dsuid2);
+  boost::shared_ptr<Device> dev3 = apt.allocateDevice(dsuid3);
+  boost::shared_ptr<Device> dev4 = apt.allocateDevice(dsuid4);
+  dev1->setZoneID(1);
+  dev2->setZoneID(1);
+  dev3->setZoneID(2);
+  dev1->addToGroup(GroupIDYellow);
+  dev3->addToGroup(GroupIDYellow);
+  dev2->addToGroup(GroupIDGray);
+  dev4->addToGroup(GroupIDGray);
+
+  Set bitmap = apt.getDevices();
+  Set list(listOf(bitmap));
+  checkSameDevices(bitmap, list);
+
+  for (int zone = 0; zone <= 3; zone++) {
+    checkSameDevices(bitmap.getByZone(zone), list.getByZone(zone));
+    for (int group = 0; group <= GroupIDGray; group++) {
+      checkSameDevices(bitmap.getByZone(zone).getByGroup(group),
+                       list.getByZone(zone).getByGroup(group));
+    }
+  }
+  BOOST_CHECK_EQUAL(bitmap.getByZone(1).getByGroup(GroupIDYellow).length(), 1);
+
+  dev1->setZoneID(2);
+  dev3->removeFromGroup(GroupIDYellow);
+  dev4->addToGroup(GroupIDYellow);
+  bitmap = apt.getDevices();
+  list = Set(listOf(bitmap));
+  checkSameDevices(bitmap.getByZone(2).getByGroup(GroupIDYellow),
+                   list.getByZone(2).getByGroup(GroupIDYellow));
+  checkSameDevices(bitmap.getByGroup(GroupIDYellow), list.getByGroup(GroupIDYellow));
+  BOOST_CHECK_EQUAL(bitmap.getByZone(2).getByGroup(GroupIDYellow).get(0).getDevice(), dev1);
+
+  // sets taken earlier don't hand out removed devices
+  Set before = apt.getDevices();
+  Set beforeGray = before.getByGroup(GroupIDGray);
+  apt.removeDevice(dsuid2);
+  BOOST_CHECK_EQUAL(before.length(), 3);
+  BOOST_CHECK(!before.isEmpty());
+  for (int i = 0; i < before.length(); i++) {
+    BOOST_CHECK(dsuid2str(before.get(i).getDSID()) != dsuid2str(dsuid2));
+    BOOST_CHECK(before.get(i).getDevice() != NULL);
+  }
+  BOOST_CHECK_EQUAL(beforeGray.length(), 1);
+  BOOST_CHECK_EQUAL(beforeGray.get(0).getDevice(), dev4);
+  BOOST_CHECK_EQUAL(apt.getDevices().length(), 3);
+  BOOST_CHECK_EQUAL(apt.getDevices().getByGroup(GroupIDGray).length(), 1);
+} // testSetBitmapFollowsZonesAndGroups
+
+BOOST_AUTO_TEST_CASE(testSetBitmapCombineAndRemove) {
+  Apartment apt(NULL);
+  apt.allocateZone(1);
+
+  boost::shared_ptr<Device> dev1 = apt.allocateDevice(dsuid1);
+  boost::shared_ptr<Device> dev2 = apt.allocateDevice(dsuid2);
+  boost::shared_ptr<Device> dev3 = apt.allocateDevice(dsuid3);
+  dev1->setZoneID(1);
+  dev2->addToGroup(GroupIDYellow);
+
+  Set all = apt.getDevices();
+  Set zone1 = all.getByZone(1);
+  Set yellow = all.getByGroup(GroupIDYellow);
+
+  Set both = zone1.combine(yellow);
+  BOOST_CHECK_EQUAL(both.length(), 2);
+  BOOST_CHECK(both.contains(dev1));
+  BOOST_CHECK(both.contains(dev2));
+  BOOST_CHECK(!both.contains(dev3));
+
+  Set rest = all.remove(both);
+  BOOST_CHECK_EQUAL(rest.length(), 1);
+  BOOST_CHECK_EQUAL(rest.get(0).getDevice(), dev3);
+
+  // a device allocated later is not part of older sets, but may be added
+  boost::shared_ptr<Device> dev4 = apt.allocateDevice(dsuid4);
+  BOOST_CHECK(!all.contains(dev4));
+  rest.addDevice(dev4);
+  BOOST_CHECK_EQUAL(rest.length(), 2);
+  BOOST_CHECK_EQUAL(rest.combine(all).length(), 4);
+  rest.removeDevice(dev3);
+  BOOST_CHECK_EQUAL(rest.length(), 1);
+  BOOST_CHECK_EQUAL(rest.getByDSID(dsuid4).getDevice(), dev4);
+  BOOST_CHECK_THROW(rest.getByDSID(dsuid3), ItemNotFoundException);
+
+  // mixing with list based sets
+  Set list;
+  list.addDevice(dev1);
+  BOOST_CHECK_EQUAL(all.remove(list).length(), 2);
+  BOOST_CHECK_EQUAL(list.combine(rest).length(), 2);
+} // testSetBitmapCombineAndRemove
+
 BOOST_AUTO_TEST_CASE(testZoneMoving) {
   Apartment apt(NULL);
 
@@ -535,6 +758,62 @@ BOOST_AUTO_TEST_CASE(testSetBuilderTag) {
   BOOST_CHECK_EQUAL(result.length(), 0);
 } // testSetBuilderTag
 
+BOOST_AUTO_TEST_CASE(testSetBuilderCacheFollowsModelChanges) {
+  Apartment apt(NULL);
+  apt.allocateZone(1);
+
+  boost::shared_ptr<Device> dev1 = apt.allocateDevice(dsuid1);
+  dev1->setName("dev1");
+  dev1->addToGroup(GroupIDYellow);
+  DeviceReference devRef1(dev1, &apt);
+  apt.getZone(1)->addDevice(devRef1);
+  boost::shared_ptr<Device> dev2 = apt.allocateDevice(dsuid2);
+
+  SetBuilder builder(apt);
+  BOOST_CHECK_EQUAL(builder.buildSet(".yellow", boost::shared_ptr<Zone>()).length(), 1);
+  unsigned long long generation = apt.getGeneration();
+  BOOST_CHECK_EQUAL(builder.buildSet(".yellow", boost::shared_ptr<Zone>()).length(), 1);
+  BOOST_CHECK_EQUAL(generation, apt.getGeneration());
+
+  dev2->addToGroup(GroupIDYellow);
+  BOOST_CHECK(generation != apt.getGeneration());
+  BOOST_CHECK_EQUAL(builder.buildSet(".yellow", boost::shared_ptr<Zone>()).length(), 2);
+
+  // the same description evaluated in different contexts
+  BOOST_CHECK_EQUAL(builder.buildSet("yellow", apt.getZone(1)).length(), 1);
+  BOOST_CHECK_EQUAL(builder.buildSet("yellow", apt.getZone(0)).length(), 2);
+
+  BOOST_CHECK_EQUAL(builder.buildSet("dev1", apt.getZone(0)).length(), 1);
+  dev1->setName("renamed");
+  BOOST_CHECK_EQUAL(builder.buildSet("dev1", apt.getZone(0)).length(), 0);
+  BOOST_CHECK_EQUAL(builder.buildSet("renamed", apt.getZone(0)).length(), 1);
+
+  // zone and group names resolve without waiting for the model thread
+  BOOST_CHECK_EQUAL(builder.buildSet("kitchen", apt.getZone(0)).length(), 0);
+  apt.getZone(1)->setName("kitchen");
+  BOOST_CHECK_EQUAL(builder.buildSet("kitchen", apt.getZone(0)).length(), 1);
+  BOOST_CHECK_EQUAL(builder.buildSet("lights", apt.getZone(0)).length(), 0);
+  apt.getZone(0)->getGroup(GroupIDYellow)->setName("lights");
+  BOOST_CHECK_EQUAL(builder.buildSet("lights", apt.getZone(0)).length(), 2);
+
+  // a rescan may change the function id
+  generation = apt.getGeneration();
+  DeviceSpec_t spec = {};
+  spec.FunctionID = 0x1234;
+  dev1->setPartiallyFromSpec(spec);
+  BOOST_CHECK(generation != apt.getGeneration());
+
+  // errors are not cached
+  BOOST_CHECK_THROW(builder.buildSet("dsid(" + dsuid2str(dsuid3) + ")", apt.getZone(0)), ItemNotFoundException);
+  apt.allocateDevice(dsuid3);
+  BOOST_CHECK_EQUAL(builder.buildSet("dsid(" + dsuid2str(dsuid3) + ")", apt.getZone(0)).length(), 1);
+
+  // another apartment never sees results of the first one
+  Apartment other(NULL);
+  SetBuilder otherBuilder(other);
+  BOOST_CHECK_EQUAL(otherBuilder.buildSet(".yellow", boost::shared_ptr<Zone>()).length(), 0);
+} // testSetBuilderCacheFollowsModelChanges
+
 // this test checks if the Set::findGroupContainingAllDevices function properly finds group that contain all devices in one set
 BOOST_AUTO_TEST_CASE(testSetFindGroupContainingAllDevices) {
   Apartment apt(NULL);
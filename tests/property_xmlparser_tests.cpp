@@ -22,9 +22,13 @@
 #define BOOST_TEST_DYN_LINK
 
 #include <iostream>
+#include <fstream>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/crc.hpp>
 
 #include "config.h"
 
@@ -177,6 +181,141 @@ R"xml(<?xml version="1.0" encoding="utf-8"?>
   BOOST_CHECK(!ps.getProperty("/leafX"));
 }
 
+BOOST_AUTO_TEST_CASE(testSnapshotReplay) {
+  static const char xml[] =
+R"xml(<?xml version="1.0" encoding="utf-8"?>
+<properties version="1">
+  <property name="snapshot/string" type="string" writable="false">
+    <value>before &amp; after</value>
+  </property>
+  <property name="snapshot/integer" type="integer">
+    <value>17</value>
+  </property>
+</properties>)xml";
+  static const char xmlChanged[] =
+R"xml(<?xml version="1.0" encoding="utf-8"?>
+<properties version="1">
+  <property name="snapshot/string" type="string" writable="false">
+    <value>after &amp; before</value>
+  </property>
+  <property name="snapshot/integer" type="integer">
+    <value>42</value>
+  </property>
+</properties>)xml";
+  BOOST_REQUIRE_EQUAL(sizeof(xml), sizeof(xmlChanged));
+
+  std::string dir = TEST_DYNAMIC_DATADIR + "/snapshots";
+  ExpatParser::setSnapshotDirectory(dir);
+  {
+    TemporaryFile tmp(TEST_DYNAMIC_DATADIR + "/snapshot.xml", xml);
+
+    // only loaders asking for it record snapshots
+    PropertySystem ps0;
+    PropertyParser pp0;
+    BOOST_CHECK(pp0.loadFromXML(tmp.path, ps0.createProperty("/")));
+    BOOST_CHECK(!boost::filesystem::exists(ExpatParser::getSnapshotFileName(tmp.path)));
+
+    PropertySystem ps1;
+    PropertyParser pp1;
+    BOOST_CHECK(pp1.loadFromXML(tmp.path, ps1.createProperty("/"), false, true));
+    BOOST_CHECK(boost::filesystem::exists(ExpatParser::getSnapshotFileName(tmp.path)));
+    BOOST_CHECK_EQUAL(ps1.getStringValue("/snapshot/string"), "before & after");
+
+    // same size, inode and mtime: the snapshot is trusted and replayed
+    struct stat st;
+    BOOST_REQUIRE_EQUAL(stat(tmp.path.c_str(), &st), 0);
+    {
+      std::fstream ofs(tmp.path.c_str(), std::ios::in | std::ios::out);
+      ofs << xmlChanged;
+    }
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    BOOST_REQUIRE_EQUAL(utimensat(AT_FDCWD, tmp.path.c_str(), times, 0), 0);
+
+    PropertySystem ps2;
+    PropertyParser pp2;
+    BOOST_CHECK(pp2.loadFromXML(tmp.path, ps2.createProperty("/"), false, true));
+    BOOST_CHECK_EQUAL(ps2.getStringValue("/snapshot/string"), "before & after");
+    BOOST_CHECK_EQUAL(ps2.getIntValue("/snapshot/integer"), 17);
+    BOOST_CHECK(!ps2.getProperty("/snapshot/string")->hasFlag(PropertyNode::Writeable));
+
+    // any other change to the file makes it stale
+    {
+      std::ofstream ofs(tmp.path.c_str());
+      ofs << xmlChanged << "\n";
+    }
+    PropertySystem ps3;
+    PropertyParser pp3;
+    BOOST_CHECK(pp3.loadFromXML(tmp.path, ps3.createProperty("/"), false, true));
+    BOOST_CHECK_EQUAL(ps3.getStringValue("/snapshot/string"), "after & before");
+    BOOST_CHECK_EQUAL(ps3.getIntValue("/snapshot/integer"), 42);
+
+    // unchanged files keep their snapshot
+    ExpatParser::removeOrphanedSnapshots();
+    BOOST_CHECK(boost::filesystem::exists(ExpatParser::getSnapshotFileName(tmp.path)));
+  }
+  // the file is gone, so is its snapshot
+  ExpatParser::removeOrphanedSnapshots();
+  BOOST_CHECK(boost::filesystem::is_empty(dir));
+  ExpatParser::setSnapshotDirectory("");
+  boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(testMalformedSnapshotFallsBack) {
+  static const char xml[] =
+R"xml(<?xml version="1.0" encoding="utf-8"?>
+<properties version="1">
+  <property name="snapshot/integer" type="integer">
+    <value>17</value>
+  </property>
+</properties>)xml";
+
+  std::string dir = TEST_DYNAMIC_DATADIR + "/snapshots";
+  ExpatParser::setSnapshotDirectory(dir);
+  {
+    TemporaryFile tmp(TEST_DYNAMIC_DATADIR + "/snapshot.xml", xml);
+    PropertySystem ps1;
+    PropertyParser pp1;
+    BOOST_CHECK(pp1.loadFromXML(tmp.path, ps1.createProperty("/"), false, true));
+
+    // drop the terminator of the last recorded string but keep the
+    // checksum intact, so the damage only shows while decoding. Offsets
+    // follow the snapshot header: magic[8], version, crc, payload size
+    std::string snapshot = ExpatParser::getSnapshotFileName(tmp.path);
+    std::string content;
+    {
+      std::ifstream ifs(snapshot.c_str(), std::ios::binary);
+      content.assign(std::istreambuf_iterator<char>(ifs),
+                     std::istreambuf_iterator<char>());
+    }
+    BOOST_REQUIRE(content.size() > 64);
+    uint64_t payloadSize;
+    memcpy(&payloadSize, &content[16], sizeof(payloadSize));
+    BOOST_REQUIRE(payloadSize < content.size());
+    std::string payload = content.substr(content.size() - payloadSize);
+    payload.resize(payload.size() - 1);
+    boost::crc_32_type crc;
+    crc.process_bytes(payload.data(), payload.size());
+    uint32_t payloadCRC = crc.checksum();
+    payloadSize = payload.size();
+    content.resize(content.size() - 1);
+    memcpy(&content[12], &payloadCRC, sizeof(payloadCRC));
+    memcpy(&content[16], &payloadSize, sizeof(payloadSize));
+    {
+      std::ofstream ofs(snapshot.c_str(), std::ios::binary | std::ios::trunc);
+      ofs << content;
+    }
+
+    // nothing of the damaged snapshot is applied, the XML is parsed instead
+    PropertySystem ps2;
+    PropertyParser pp2;
+    BOOST_CHECK(pp2.loadFromXML(tmp.path, ps2.createProperty("/"), false, true));
+    BOOST_CHECK_EQUAL(ps2.getIntValue("/snapshot/integer"), 17);
+    BOOST_CHECK_EQUAL(ps2.getProperty("/snapshot")->getChildCount(), 1);
+  }
+  ExpatParser::setSnapshotDirectory("");
+  boost::filesystem::remove_all(dir);
+}
+
 BOOST_AUTO_TEST_CASE(testLoadMemory) {
   // TODO too much copy&paste to add from memory parsing
   // needs redesign of expat parser, e.g. allocate resources in constructor
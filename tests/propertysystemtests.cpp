@@ -26,6 +26,9 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include <boost/atomic.hpp>
 
 #include <iostream>
 #include <fstream>
@@ -35,6 +38,7 @@
 #include "src/web/webrequests.h"
 
 #include "src/base.h"
+#include "src/foreach.h"
 #include "src/propertysystem.h"
 #include "src/propertyquery.h"
 
@@ -452,6 +456,33 @@ BOOST_AUTO_TEST_CASE(testAddChildMovesNode) {
   BOOST_CHECK_EQUAL(propSys.getProperty("/target/source"), source);
 } // testAddChildMovesNode
 
+BOOST_AUTO_TEST_CASE(testAddChildKeepsEarlierSnapshots) {
+  PropertySystem propSys;
+  PropertyNodePtr parent = propSys.createProperty("/parent");
+
+  // appends share the storage of earlier lists, across the index threshold
+  std::vector<PropertyListSnapshot> snapshots;
+  for (int i = 0; i < 40; i++) {
+    snapshots.push_back(parent->getChildNodes());
+    parent->addChild(PropertyNodePtr(new PropertyNode((i % 2) ? "odd" : "even")));
+  }
+  for (size_t i = 0; i < snapshots.size(); i++) {
+    BOOST_CHECK_EQUAL(snapshots[i]->size(), i);
+  }
+  BOOST_CHECK_EQUAL(parent->getChildCount(), 40);
+  BOOST_CHECK_EQUAL(parent->count("odd"), 20);
+  BOOST_CHECK_EQUAL(propSys.getProperty("/parent/even[19]"), parent->getChild(38));
+  BOOST_CHECK(propSys.getProperty("/parent/even[20]") == NULL);
+
+  // a list published after a removal doesn't see later appends to the old one
+  parent->removeChild(parent->getChild(39));
+  parent->addChild(PropertyNodePtr(new PropertyNode("odd")));
+  BOOST_CHECK_EQUAL(snapshots.back()->size(), 39);
+  BOOST_CHECK_EQUAL(parent->getChildCount(), 40);
+  BOOST_CHECK_EQUAL(parent->count("odd"), 20);
+  BOOST_CHECK_EQUAL(propSys.getProperty("/parent/odd[last]"), parent->getChild(39));
+} // testAddChildKeepsEarlierSnapshots
+
 BOOST_AUTO_TEST_CASE(testIndicesWorkCorrectly) {
   PropertySystem propSys;
   PropertyNodePtr prop1 = propSys.createProperty("/prop");
@@ -635,4 +666,158 @@ BOOST_AUTO_TEST_CASE(testGetSetValue) {
   BOOST_CHECK_EQUAL(node->getValue<std::string>(), "lorum ipsum");
 }
 
+BOOST_AUTO_TEST_CASE(testLookupInLargeChildList) {
+  PropertySystem propSys;
+  PropertyNodePtr base = propSys.createProperty("/base");
+  for (int i = 0; i < 100; i++) {
+    base->createProperty("node" + intToString(i))->setIntegerValue(i);
+  }
+  base->createProperty("node5+")->setIntegerValue(1000);
+
+  BOOST_CHECK_EQUAL(base->getProperty("node42")->getIntegerValue(), 42);
+  BOOST_CHECK_EQUAL(base->count("node5"), 2);
+  BOOST_CHECK_EQUAL(base->getProperty("node5[0]")->getIntegerValue(), 5);
+  BOOST_CHECK_EQUAL(base->getProperty("node5[1]")->getIntegerValue(), 1000);
+  BOOST_CHECK_EQUAL(base->getProperty("node5[last]")->getIntegerValue(), 1000);
+  BOOST_CHECK(base->getProperty("node5[2]") == NULL);
+  BOOST_CHECK(base->getProperty("node100") == NULL);
+  // interned names from a precompiled path hit the same index entries
+  BOOST_CHECK_EQUAL(base->getProperty(PropertyPath("node42"))->getIntegerValue(), 42);
+  BOOST_CHECK_EQUAL(base->getProperty(PropertyPath("node5[last]"))->getIntegerValue(), 1000);
+  BOOST_CHECK(base->getProperty(PropertyPath("node100")) == NULL);
+
+  for (int i = 0; i < 100; i++) {
+    if (i != 42) {
+      base->removeChild(base->getPropertyByName("node" + intToString(i)));
+    }
+  }
+  BOOST_CHECK_EQUAL(base->getChildCount(), 2);
+  BOOST_CHECK_EQUAL(base->getProperty("node42")->getIntegerValue(), 42);
+  BOOST_CHECK_EQUAL(base->getProperty("node5[1]")->getIntegerValue(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(testPropertyPath) {
+  PropertySystem propSys;
+  propSys.createProperty("/foo/bar/baz")->setIntegerValue(1);
+
+  PropertyPath path("/foo/bar/baz");
+  PropertyNodePtr node = propSys.getProperty(path);
+  BOOST_REQUIRE(node != NULL);
+  BOOST_CHECK_EQUAL(node->getIntegerValue(), 1);
+  BOOST_CHECK(propSys.getProperty(path) == node);
+  BOOST_CHECK(propSys.getProperty("/foo")->getProperty(PropertyPath("bar/baz")) == node);
+
+  // removing a node in the path is seen by the next lookup
+  PropertyNodePtr foo = propSys.getProperty("/foo");
+  foo->removeChild(foo->getProperty("bar"));
+  BOOST_CHECK(propSys.getProperty(path) == NULL);
+
+  node = propSys.createProperty(path);
+  node->setIntegerValue(2);
+  BOOST_CHECK_EQUAL(propSys.getIntValue("/foo/bar/baz"), 2);
+  BOOST_CHECK(propSys.getProperty(path) == node);
+
+  PropertyPath append("item+");
+  foo->createProperty(append);
+  foo->createProperty(append);
+  BOOST_CHECK_EQUAL(foo->count("item"), 2);
+
+  BOOST_CHECK(propSys.getProperty(PropertyPath("/")) == propSys.getRootNode());
+}
+
+BOOST_AUTO_TEST_CASE(testChildSnapshotIsStable) {
+  PropertySystem propSys;
+  PropertyNodePtr base = propSys.createProperty("/base");
+  base->createProperty("a");
+  base->createProperty("b");
+
+  PropertyListSnapshot snapshot = base->getChildNodes();
+  base->removeChild(base->getPropertyByName("a"));
+  base->createProperty("c");
+
+  BOOST_CHECK_EQUAL(snapshot->size(), 2);
+  BOOST_CHECK_EQUAL(snapshot->at(0)->getName(), "a");
+  BOOST_CHECK_EQUAL(base->getChildCount(), 2);
+  BOOST_CHECK_EQUAL(base->getChild(0)->getName(), "b");
+  BOOST_CHECK_EQUAL(base->getChild(1)->getName(), "c");
+}
+
+class PropertyReaderThread {
+public:
+  PropertyReaderThread(PropertySystem& _propSys, int _numNodes, int _numLookups)
+  : m_PropSys(_propSys), m_NumNodes(_numNodes), m_NumLookups(_numLookups), m_Failures(0)
+  { }
+
+  void run() {
+    // no BOOST_CHECK in here, it's not threadsafe
+    for (int i = 0; i < m_NumLookups; i++) {
+      int n = i % m_NumNodes;
+      PropertyNodePtr node = m_PropSys.getProperty("/bench/n" + intToString(n) + "/value");
+      if ((node == NULL) || (node->getIntegerValue() != n)) {
+        m_Failures++;
+      }
+    }
+  }
+
+  int getFailures() const { return m_Failures; }
+private:
+  PropertySystem& m_PropSys;
+  int m_NumNodes;
+  int m_NumLookups;
+  int m_Failures;
+};
+
+BOOST_AUTO_TEST_CASE(testConcurrentReadScaling) {
+  const int kNumNodes = 64;
+  const int kNumLookups = 100 * 1000;
+
+  PropertySystem propSys;
+  for (int n = 0; n < kNumNodes; n++) {
+    propSys.createProperty("/bench/n" + intToString(n) + "/value")->setIntegerValue(n);
+  }
+
+  // readers must neither block each other nor see a half modified tree
+  // while the tree is constantly modified
+  boost::atomic<bool> stopWriter(false);
+  boost::thread writer([&propSys, &stopWriter]() {
+    PropertyNodePtr bench = propSys.getProperty("/bench");
+    while (!stopWriter) {
+      bench->removeChild(bench->createProperty("volatile"));
+    }
+  });
+
+  double singleRate = 0;
+  for (int numThreads = 1; numThreads <= 4; numThreads *= 2) {
+    std::vector<PropertyReaderThread> readers(numThreads,
+        PropertyReaderThread(propSys, kNumNodes, kNumLookups));
+    typedef boost::shared_ptr<boost::thread> thread_t;
+    std::vector<thread_t> threads;
+
+    boost::chrono::steady_clock::time_point tic = boost::chrono::steady_clock::now();
+    for (int i = 0; i < numThreads; i++) {
+      threads.push_back(thread_t(new boost::thread(
+          boost::bind(&PropertyReaderThread::run, &readers[i]))));
+    }
+    foreach (thread_t th, threads) {
+      th->join();
+    }
+    boost::chrono::steady_clock::time_point toc = boost::chrono::steady_clock::now();
+
+    foreach (const PropertyReaderThread& reader, readers) {
+      BOOST_CHECK_EQUAL(reader.getFailures(), 0);
+    }
+
+    double elapsedMs = boost::chrono::duration<double, boost::milli>(toc - tic).count();
+    double rate = numThreads * kNumLookups / elapsedMs;
+    if (numThreads == 1) {
+      singleRate = rate;
+    }
+    BOOST_TEST_MESSAGE(numThreads << " reader(s): " << rate << " lookups/ms, "
+                       "speedup " << rate / singleRate);
+  }
+
+  stopWriter = true;
+  writer.join();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -34,6 +34,7 @@ using namespace dss;
 using namespace std;
 
 #include <iostream>
+#include <fstream>
 
 BOOST_AUTO_TEST_SUITE(Scripting)
 
@@ -67,6 +68,97 @@ BOOST_AUTO_TEST_CASE(testSimpleScripts2) {
   boost::filesystem::remove_all(fileName);
 } // testSimpleScripts2
 
+BOOST_AUTO_TEST_CASE(testCompiledScriptsAreCached) {
+  ScriptEnvironment env;
+  env.initialize();
+  boost::scoped_ptr<ScriptContext> ctx(env.getContext());
+  std::string fileName = getTempDir() + "/cached.js";
+  {
+    std::ofstream ofs(fileName.c_str());
+    ofs << "1;\n";
+  }
+  BOOST_CHECK_EQUAL(ctx->evaluateScript<double>(fileName), 1.0);
+  BOOST_CHECK(!ctx->wasLastScriptCached());
+  BOOST_CHECK_EQUAL(ctx->evaluateScript<double>(fileName), 1.0);
+  BOOST_CHECK(ctx->wasLastScriptCached());
+
+  // rewritten right away, likely within the same mtime tick
+  {
+    std::ofstream ofs(fileName.c_str());
+    ofs << "22;\n";
+  }
+  BOOST_CHECK_EQUAL(ctx->evaluateScript<double>(fileName), 22.0);
+  BOOST_CHECK(!ctx->wasLastScriptCached());
+
+  // replaced by a file of the same size
+  std::string newName = fileName + ".new";
+  {
+    std::ofstream ofs(newName.c_str());
+    ofs << "33;\n";
+  }
+  boost::filesystem::rename(newName, fileName);
+  BOOST_CHECK_EQUAL(ctx->evaluateScript<double>(fileName), 33.0);
+  BOOST_CHECK(!ctx->wasLastScriptCached());
+  boost::filesystem::remove_all(fileName);
+} // testCompiledScriptsAreCached
+
+BOOST_AUTO_TEST_CASE(testContextPool) {
+  ScriptEnvironment env;
+  env.initialize();
+  ScriptContextPool pool(env, 1);
+
+  bool pooled = true;
+  boost::shared_ptr<ScriptContext> first = pool.acquire("a", pooled);
+  BOOST_CHECK(!pooled);
+  first->evaluate<void>("var leaked = 42; const once = 1;");
+  pool.release("a", first);
+  BOOST_CHECK_EQUAL(pool.getIdleCount(), 1);
+
+  boost::shared_ptr<ScriptContext> other = pool.acquire("b", pooled);
+  BOOST_CHECK(!pooled);
+  BOOST_CHECK(other != first);
+
+  boost::shared_ptr<ScriptContext> again = pool.acquire("a", pooled);
+  BOOST_CHECK(pooled);
+  BOOST_CHECK(again == first);
+  // a pooled context starts with a fresh global object
+  BOOST_CHECK_EQUAL(again->evaluate<std::string>("typeof leaked"), "undefined");
+  BOOST_CHECK_NO_THROW(again->evaluate<void>("const once = 1;"));
+  BOOST_CHECK_EQUAL(pool.getIdleCount(), 0);
+
+  // only one idle context fits, the older one is dropped
+  pool.release("a", again);
+  pool.release("b", other);
+  BOOST_CHECK_EQUAL(pool.getIdleCount(), 1);
+  pool.acquire("a", pooled);
+  BOOST_CHECK(!pooled);
+} // testContextPool
+
+BOOST_AUTO_TEST_CASE(testPooledContextKeepsCompiledScripts) {
+  ScriptEnvironment env;
+  env.initialize();
+  ScriptContextPool pool(env, 1);
+  std::string fileName = getTempDir() + "/pooled.js";
+  {
+    std::ofstream ofs(fileName.c_str());
+    ofs << "var runs = (typeof runs == 'undefined') ? 1 : runs + 1;\nruns;\n";
+  }
+
+  bool pooled = true;
+  boost::shared_ptr<ScriptContext> ctx = pool.acquire("a", pooled);
+  BOOST_CHECK(!pooled);
+  BOOST_CHECK_EQUAL(ctx->evaluateScript<double>(fileName), 1.0);
+  BOOST_CHECK(!ctx->wasLastScriptCached());
+  pool.release("a", ctx);
+
+  ctx = pool.acquire("a", pooled);
+  BOOST_CHECK(pooled);
+  // compiled once, but run against the fresh global object
+  BOOST_CHECK_EQUAL(ctx->evaluateScript<double>(fileName), 1.0);
+  BOOST_CHECK(ctx->wasLastScriptCached());
+  boost::filesystem::remove_all(fileName);
+} // testPooledContextKeepsCompiledScripts
+
 BOOST_AUTO_TEST_CASE(testSimpleScripts3) {
   ScriptEnvironment env;
   env.initialize();
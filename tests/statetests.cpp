@@ -22,15 +22,20 @@
 #define BOOST_TEST_DYN_LINK
 
 #include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <boost/optional/optional_io.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/test/unit_test.hpp>
 #include "foreach.h"
+#include "base.h"
 
 #include "src/model/apartment.h"
 #include "src/model/group.h"
 #include "src/model/state.h"
+#include "src/model/statestore.h"
 #include "src/model/zone.h"
 
 using namespace dss;
@@ -161,4 +166,113 @@ BOOST_AUTO_TEST_CASE(updateZoneSensorStates)
   BOOST_CHECK_EQUAL(state3->getState(), State_Inactive);
 }
 
+
+BOOST_AUTO_TEST_CASE(testStateStore) {
+  char *dirname, tmpl[] = "/tmp/dss-state-store-test_XXXXXX";
+  dirname = mkdtemp(tmpl);
+  BOOST_REQUIRE(dirname != NULL);
+  std::string filename = StateStore::getFileName(dirname);
+
+  {
+    StateStore store(filename, 50, 1000);
+    for (int i = 0; i < 100; i++) {
+      store.save("state" + intToString(i % 10), intToString(i));
+    }
+    store.flush();
+    // saves within the commit delay share a commit
+    BOOST_CHECK(store.getCommits() < 10);
+
+    std::string data;
+    BOOST_CHECK(store.load("state3", data));
+    BOOST_CHECK_EQUAL(data, "93");
+    BOOST_CHECK(!store.contains("state10"));
+  }
+
+  // a record torn by a crash is dropped, everything before it survives
+  {
+    std::ofstream ofs(filename.c_str(), std::ios::app | std::ios::binary);
+    ofs.write("\x06\x00\x01", 3);
+  }
+  {
+    StateStore store(filename, 0, 1000);
+    std::string data;
+    BOOST_CHECK(store.load("state9", data));
+    BOOST_CHECK_EQUAL(data, "99");
+    store.save("state10", "10");
+    store.flush();
+  }
+  {
+    StateStore store(filename, 0, 1000);
+    std::string data;
+    BOOST_CHECK(store.load("state10", data));
+    BOOST_CHECK_EQUAL(data, "10");
+    BOOST_CHECK_EQUAL(store.getJournalRecords(), 11);
+  }
+
+  unlink(filename.c_str());
+  rmdir(dirname);
+}
+
+BOOST_AUTO_TEST_CASE(testStateStoreRetriesFailedCommits) {
+  char *dirname, tmpl[] = "/tmp/dss-state-store-test_XXXXXX";
+  dirname = mkdtemp(tmpl);
+  BOOST_REQUIRE(dirname != NULL);
+  // the journal can't be written until its directory shows up
+  std::string directory = std::string(dirname) + "/missing";
+  std::string filename = StateStore::getFileName(directory);
+
+  {
+    StateStore store(filename, 0, 1000);
+    store.save("state", "1");
+    BOOST_CHECK(!store.flush());
+
+    BOOST_REQUIRE_EQUAL(mkdir(directory.c_str(), 0755), 0);
+    bool flushed = false;
+    for (int i = 0; (i < 100) && !flushed; i++) {
+      flushed = store.flush();
+      if (!flushed) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+      }
+    }
+    BOOST_CHECK(flushed);
+  }
+  {
+    StateStore store(filename, 0, 1000);
+    std::string data;
+    BOOST_CHECK(store.load("state", data));
+    BOOST_CHECK_EQUAL(data, "1");
+  }
+
+  unlink(filename.c_str());
+  rmdir(directory.c_str());
+  rmdir(dirname);
+}
+
+BOOST_AUTO_TEST_CASE(testStateStoreCompaction) {
+  char *dirname, tmpl[] = "/tmp/dss-state-store-test_XXXXXX";
+  dirname = mkdtemp(tmpl);
+  BOOST_REQUIRE(dirname != NULL);
+  std::string filename = StateStore::getFileName(dirname);
+
+  {
+    StateStore store(filename, 0, 5);
+    for (int i = 0; i < 50; i++) {
+      store.save("state" + intToString(i % 2), intToString(i));
+      store.flush();
+    }
+    BOOST_CHECK(store.getJournalRecords() <= 2 + 5 + 1);
+  }
+  {
+    StateStore store(filename, 0, 5);
+    std::string data;
+    BOOST_CHECK(store.load("state0", data));
+    BOOST_CHECK_EQUAL(data, "48");
+    BOOST_CHECK(store.load("state1", data));
+    BOOST_CHECK_EQUAL(data, "49");
+  }
+
+  unlink(filename.c_str());
+  rmdir(dirname);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
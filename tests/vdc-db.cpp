@@ -33,6 +33,7 @@
 #include "config.h"
 
 #include "src/sqlite3_wrapper.h"
+#include "src/base.h"
 #include "src/foreach.h"
 #include "src/model/device.h"
 #include "src/vdc-db.h"
@@ -473,4 +474,22 @@ BOOST_FIXTURE_TEST_CASE(checkNotFound, Fixture) {
   BOOST_CHECK_MESSAGE(jsonEqual, error);
 }
 
+BOOST_FIXTURE_TEST_CASE(updateDropsCachedResults, DSSInstanceFixture) {
+  DSS &dss = *DSS::getInstance();
+  VdcDb::recreate(dss);
+  {
+    VdcDb db(dss);
+    BOOST_CHECK_EQUAL(db.getStates(gtin).size(), 1);
+    // served from the cache
+    BOOST_CHECK_EQUAL(db.getStates(gtin).size(), 1);
+  }
+
+  std::string sql = readFile(dss.getDataDirectory() + "/vdc-db.sql");
+  VdcDb::update(dss, sql + "\ndelete from callGetStatesBase;");
+
+  VdcDb db(dss);
+  BOOST_CHECK(db.getStates(gtin).empty());
+  BOOST_CHECK_EQUAL(db.getProperties(gtin).size(), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -25,9 +25,351 @@
 #include "src/sessionmanager.h"
 #include "src/web/webserver.h"
 #include "src/web/webrequests.h"
+#include "src/web/websocketclient.h"
+#include "src/web/parkedrequests.h"
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/mutex.hpp>
 
 BOOST_AUTO_TEST_SUITE(Webserver)
 
+namespace {
+  // stands in for a civetweb connection, writes block until opened
+  struct FakeWebSocket {
+    boost::mutex m_Mutex;
+    bool m_Open;
+    bool m_Writing;
+    bool m_Closed;
+    int m_DelayMS;
+    std::vector<std::string> m_Written;
+
+    FakeWebSocket() : m_Open(false), m_Writing(false), m_Closed(false), m_DelayMS(0) {}
+
+    int write(const std::string& _data) {
+      {
+        boost::mutex::scoped_lock lock(m_Mutex);
+        m_Writing = true;
+      }
+      for (;;) {
+        boost::mutex::scoped_lock lock(m_Mutex);
+        if (m_Open) {
+          break;
+        }
+        lock.unlock();
+        dss::sleepMS(1);
+      }
+      dss::sleepMS(m_DelayMS);
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Writing = false;
+      m_Written.push_back(_data);
+      return _data.size();
+    }
+
+    void close() {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Closed = true;
+    }
+
+    void open() {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Open = true;
+    }
+
+    bool isWriting() {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      return m_Writing;
+    }
+
+    bool isClosed() {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      return m_Closed;
+    }
+  };
+
+  boost::shared_ptr<const std::string> wsMessage(const std::string& _text) {
+    return boost::make_shared<const std::string>(_text);
+  }
+
+  // a long-poll that gets ready when fire() is called
+  class FakeDeferredResponse : public dss::DeferredResponse {
+  public:
+    FakeDeferredResponse(int _timeoutMS) : m_TimeoutMS(_timeoutMS), m_Ready(false), m_Finished(0) {}
+
+    virtual void start(boost::function<void()> _wakeup) {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Wakeup = _wakeup;
+    }
+    virtual bool isReady() {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      return m_Ready;
+    }
+    virtual int getTimeoutMS() const { return m_TimeoutMS; }
+    virtual std::string finish(bool _aborted) {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Finished++;
+      return m_Ready ? "events" : "timeout";
+    }
+
+    void fire() {
+      boost::function<void()> wakeup;
+      {
+        boost::mutex::scoped_lock lock(m_Mutex);
+        m_Ready = true;
+        wakeup = m_Wakeup;
+      }
+      wakeup();
+    }
+    int getFinished() {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      return m_Finished;
+    }
+  private:
+    boost::mutex m_Mutex;
+    int m_TimeoutMS;
+    bool m_Ready;
+    int m_Finished;
+    boost::function<void()> m_Wakeup;
+  };
+
+  struct FakeParkedConnection {
+    boost::mutex m_Mutex;
+    bool m_Connected;
+    bool m_Closed;
+    bool m_Aborted;
+    std::string m_Reply;
+
+    FakeParkedConnection() : m_Connected(true), m_Closed(false), m_Aborted(false) {}
+
+    void reply(const std::string& _response, bool _aborted) {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Reply = _response;
+      m_Aborted = _aborted;
+      m_Closed = true;
+    }
+    bool isConnected() {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      return m_Connected;
+    }
+    void disconnect() {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      m_Connected = false;
+    }
+    bool isClosed() {
+      boost::mutex::scoped_lock lock(m_Mutex);
+      return m_Closed;
+    }
+  };
+
+  void park(dss::ParkedRequests& _parked, boost::shared_ptr<FakeDeferredResponse> _response,
+            FakeParkedConnection& _connection) {
+    _parked.park(_response,
+                 boost::bind(&FakeParkedConnection::reply, &_connection, _1, _2),
+                 boost::bind(&FakeParkedConnection::isConnected, &_connection));
+  }
+
+  bool waitForClose(FakeParkedConnection& _connection) {
+    for (int i = 0; i < 1000 && !_connection.isClosed(); i++) {
+      dss::sleepMS(1);
+    }
+    return _connection.isClosed();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testWebSocketClientDropsOldestWhenFull) {
+  FakeWebSocket socket;
+  boost::shared_ptr<dss::WebSocketClient> client =
+    boost::make_shared<dss::WebSocketClient>(boost::bind(&FakeWebSocket::write, &socket, _1),
+                                             boost::bind(&FakeWebSocket::close, &socket),
+                                             2, 60 * 1000);
+  client->start();
+
+  BOOST_CHECK(client->post(wsMessage("m0")));
+  for (int i = 0; (i < 5000) && !socket.isWriting(); ++i) {
+    dss::sleepMS(1);
+  }
+  BOOST_REQUIRE(socket.isWriting());
+
+  // m0 is stuck in the writer, the queue holds two more
+  BOOST_CHECK(client->post(wsMessage("m1")));
+  BOOST_CHECK(client->post(wsMessage("m2")));
+  BOOST_CHECK(client->post(wsMessage("m3")));
+  BOOST_CHECK_EQUAL(client->getQueued(), 2);
+  BOOST_CHECK_EQUAL(client->getDropped(), 1);
+
+  socket.open();
+  for (int i = 0; (i < 5000) && (client->getSent() < 3); ++i) {
+    dss::sleepMS(1);
+  }
+  client->stop();
+
+  BOOST_CHECK_EQUAL(client->getSent(), 3);
+  BOOST_REQUIRE_EQUAL(socket.m_Written.size(), 3);
+  BOOST_CHECK_EQUAL(socket.m_Written[0], "m0");
+  BOOST_CHECK_EQUAL(socket.m_Written[1], "m2");
+  BOOST_CHECK_EQUAL(socket.m_Written[2], "m3");
+  BOOST_CHECK(!client->isSlow());
+  BOOST_CHECK(!socket.isClosed());
+}
+
+BOOST_AUTO_TEST_CASE(testWebSocketClientGivesUpSlowClient) {
+  FakeWebSocket socket;
+  socket.m_DelayMS = 50;
+  socket.open();
+  boost::shared_ptr<dss::WebSocketClient> client =
+    boost::make_shared<dss::WebSocketClient>(boost::bind(&FakeWebSocket::write, &socket, _1),
+                                             boost::bind(&FakeWebSocket::close, &socket),
+                                             16, 10);
+  client->start();
+
+  BOOST_CHECK(client->post(wsMessage("m0")));
+  for (int i = 0; (i < 5000) && !socket.isClosed(); ++i) {
+    dss::sleepMS(1);
+  }
+  BOOST_CHECK(socket.isClosed());
+  BOOST_CHECK(client->isSlow());
+  BOOST_CHECK(!client->post(wsMessage("m1")));
+  client->stop();
+}
+
+BOOST_AUTO_TEST_CASE(testWebSocketClientDetachesStalledWriter) {
+  FakeWebSocket socket;
+  boost::shared_ptr<dss::WebSocketClient> client =
+    boost::make_shared<dss::WebSocketClient>(boost::bind(&FakeWebSocket::write, &socket, _1),
+                                             boost::bind(&FakeWebSocket::close, &socket),
+                                             16, 60 * 1000);
+  client->start();
+
+  BOOST_CHECK(client->post(wsMessage("m0")));
+  for (int i = 0; (i < 5000) && !socket.isWriting(); ++i) {
+    dss::sleepMS(1);
+  }
+  BOOST_REQUIRE(socket.isWriting());
+  BOOST_CHECK(client->post(wsMessage("m1")));
+
+  // returns although m0 is stuck in the writer, which keeps the client alive
+  client->detach();
+  BOOST_CHECK(!client->post(wsMessage("m2")));
+  boost::weak_ptr<dss::WebSocketClient> alive(client);
+  client.reset();
+  BOOST_CHECK(!alive.expired());
+
+  socket.open();
+  for (int i = 0; (i < 5000) && !alive.expired(); ++i) {
+    dss::sleepMS(1);
+  }
+  BOOST_CHECK(alive.expired());
+  BOOST_REQUIRE_EQUAL(socket.m_Written.size(), 1);
+  BOOST_CHECK_EQUAL(socket.m_Written[0], "m0");
+  BOOST_CHECK(!socket.isClosed());
+}
+
+BOOST_AUTO_TEST_CASE(testWebSocketFilterParse) {
+  bool filtered = false;
+  std::vector<dss::WebSocketFilter> filters;
+
+  dss::parseWebSocketFilters("{\"filter\": [{\"name\": \"callScene\", \"zoneID\": 2, \"groupID\": 1},"
+                             " {\"dSUID\": \"0000000000000000000000000000000013\"}]}",
+                             filtered, filters);
+  BOOST_CHECK(filtered);
+  BOOST_REQUIRE_EQUAL(filters.size(), 2);
+  BOOST_CHECK_EQUAL(filters[0].m_EventName, "callScene");
+  BOOST_CHECK_EQUAL(filters[0].m_ZoneID, 2);
+  BOOST_CHECK_EQUAL(filters[0].m_GroupID, 1);
+  BOOST_CHECK(!filters[0].m_HasDSUID);
+  BOOST_CHECK(filters[1].m_EventName.empty());
+  BOOST_CHECK(filters[1].m_HasDSUID);
+
+  dss::parseWebSocketFilters("{\"filter\": null}", filtered, filters);
+  BOOST_CHECK(!filtered);
+  BOOST_CHECK(filters.empty());
+
+  BOOST_CHECK_THROW(dss::parseWebSocketFilters("{}", filtered, filters), std::runtime_error);
+  BOOST_CHECK_THROW(dss::parseWebSocketFilters("{\"filter\": [{\"zoneID\": \"2\"}]}", filtered, filters),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(testWebSocketFilterIndex) {
+  std::vector<dss::WebSocketFilter> filters;
+  dss::WebSocketFilter callSceneInZone;
+  callSceneInZone.m_EventName = "callScene";
+  callSceneInZone.m_ZoneID = 2;
+  filters.push_back(callSceneInZone);
+  dss::WebSocketFilter anyButtonClick;
+  anyButtonClick.m_EventName = "buttonClick";
+  filters.push_back(anyButtonClick);
+
+  dss::WebSocketFilterIndex index;
+  index.addClient(3, true, filters);
+  index.addClient(5, true, std::vector<dss::WebSocketFilter>());
+
+  BOOST_CHECK(index.wantsEvent("callScene"));
+  BOOST_CHECK(index.wantsEvent("buttonClick"));
+  BOOST_CHECK(!index.wantsEvent("sensorValue"));
+  BOOST_CHECK(index.needsSource("callScene"));
+  BOOST_CHECK(!index.needsSource("buttonClick"));
+
+  std::vector<int> clients;
+  dss::WebSocketEventSource zone2;
+  zone2.m_ZoneID = 2;
+  index.match("callScene", zone2, clients);
+  BOOST_REQUIRE_EQUAL(clients.size(), 1);
+  BOOST_CHECK_EQUAL(clients[0], 3);
+
+  dss::WebSocketEventSource zone4;
+  zone4.m_ZoneID = 4;
+  index.match("callScene", zone4, clients);
+  BOOST_CHECK(clients.empty());
+
+  // an unfiltered client gets everything, every client only once
+  index.addClient(1, false, std::vector<dss::WebSocketFilter>());
+  BOOST_CHECK(index.wantsEvent("sensorValue"));
+  index.match("buttonClick", dss::WebSocketEventSource(), clients);
+  BOOST_REQUIRE_EQUAL(clients.size(), 2);
+  BOOST_CHECK_EQUAL(clients[0], 1);
+  BOOST_CHECK_EQUAL(clients[1], 3);
+}
+
+BOOST_AUTO_TEST_CASE(testParkedRequests) {
+  dss::ParkedRequests parked(20);
+  parked.start();
+
+  FakeParkedConnection ready, timedOut, gone, forever;
+  boost::shared_ptr<FakeDeferredResponse> readyResponse = boost::make_shared<FakeDeferredResponse>(0);
+  boost::shared_ptr<FakeDeferredResponse> timedOutResponse = boost::make_shared<FakeDeferredResponse>(30);
+  boost::shared_ptr<FakeDeferredResponse> goneResponse = boost::make_shared<FakeDeferredResponse>(0);
+  boost::shared_ptr<FakeDeferredResponse> foreverResponse = boost::make_shared<FakeDeferredResponse>(0);
+  park(parked, readyResponse, ready);
+  park(parked, timedOutResponse, timedOut);
+  park(parked, goneResponse, gone);
+  park(parked, foreverResponse, forever);
+  BOOST_CHECK_EQUAL(parked.getParkedCount(), 4);
+
+  readyResponse->fire();
+  BOOST_REQUIRE(waitForClose(ready));
+  BOOST_CHECK_EQUAL(ready.m_Reply, "events");
+  BOOST_CHECK(!ready.m_Aborted);
+
+  BOOST_REQUIRE(waitForClose(timedOut));
+  BOOST_CHECK_EQUAL(timedOut.m_Reply, "timeout");
+  BOOST_CHECK(!timedOut.m_Aborted);
+
+  gone.disconnect();
+  BOOST_REQUIRE(waitForClose(gone));
+  BOOST_CHECK(gone.m_Aborted);
+
+  BOOST_CHECK(!forever.isClosed());
+  BOOST_CHECK_EQUAL(parked.getParkedCount(), 1);
+  parked.stop();
+  BOOST_CHECK(forever.isClosed());
+  BOOST_CHECK(forever.m_Aborted);
+
+  BOOST_CHECK_EQUAL(readyResponse->getFinished(), 1);
+  BOOST_CHECK_EQUAL(timedOutResponse->getFinished(), 1);
+  BOOST_CHECK_EQUAL(goneResponse->getFinished(), 1);
+  BOOST_CHECK_EQUAL(foreverResponse->getFinished(), 1);
+}
+
 BOOST_AUTO_TEST_CASE(testCookieGenarateParse) {
   const char set_cookie_str[] =
     "token=4a9b442b2554e794a126f761b953c3b88b5d67d1f665a7e1590b8df67b9c6846; path=/";